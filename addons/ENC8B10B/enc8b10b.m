@@ -1,9 +1,13 @@
-function [ enc ] = enc8b10b( bits )
+function [ enc, rd ] = enc8b10b( bits, rd, useMex, nThreads )
 %ENC8B10B 8b/10b encoder
 %   Input: stream of bits to be encoded
-%     Should be a multiple of 8 bits
+%     Should be a multiple of 8 bits (zero padded otherwise)
+%   rd: initial running disparity, 0 (RD-) or 1 (RD+) (default 0)
+%   useMex: use the native encoder enc8b10b_mex if compiled (default true)
+%   nThreads: threads of the native encoder, 0 for all processors (default 0)
 %   Output: stream of 8b/10b encoded bits
 %     Will be a multiple of 10 bits
+%   rd: final running disparity
 %
 % Alex Forencich <alex@alexforencich.com>
 
@@ -1045,32 +1049,33 @@ tbl8b10b = [
     '11110001010'    % '11111111' +K31.7+ [1023]
     ] - '0';
 
-bits = bits(:)' > 0;
+if nargin < 2, rd = 0; end
+if nargin < 3, useMex = true; end
+if nargin < 4, nThreads = 0; end
 
-rc = size(bits);
+bits = bits(:)' > 0;
 
-m = mod(rc(2), 8);
+m = mod(numel(bits), 8);
 
 if m > 0
-    bits = [bits zeros(1,m)];
+    bits = [bits false(1,8-m)];
 end
 
-rc = size(bits);
-
-bc = rc(2)/8;
-
-bytes = reshape(bits, 8, bc)';
-
-enc = zeros(bc, 10);
+if useMex && hasMex('enc8b10b_mex')
+    [enc, rd] = enc8b10b_mex(bits, rd, nThreads);
+    enc = double(enc);
+    return
+end
 
-rd = 0;
+bytes = reshape(bits, 8, [])' * 2.^(0:7)';
 
-for i = 1:bc
-    val = tbl8b10b(bi2de([bytes(i,:) rd])+1,:);
-    rd = val(1);
-    enc(i,:) = flipdim(val(2:end),2);
-end
+% Only the unbalanced codes flip the RD, and whether a code is unbalanced
+% does not depend on the RD: the RD before each byte is the parity of the
+% flips before it
+flips = cumsum([rd; tbl8b10b(bytes+1,1)]);
+rdPre = mod(flips(1:end-1), 2);
+rd = mod(flips(end), 2);
 
-enc = reshape(enc', 1, bc*10);
+enc = tbl8b10b(bytes + 256*rdPre + 1, end:-1:2);
 
-end
\ No newline at end of file
+enc = reshape(enc', 1, []);
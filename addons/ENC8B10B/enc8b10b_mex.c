@@ -0,0 +1,209 @@
+/*  File:           enc8b10b_mex.c
+ *  Description:    8b/10b encoder with table lookup.  Native engine of
+ *                  enc8b10b, compiled as a MATLAB MEX function (see
+ *                  compileMex).
+ *
+ *  The code of a byte depends on the running disparity (RD) before it,
+ *  and the RD after it is flipped if and only if the code is unbalanced,
+ *  which depends on the byte only.  The RD before every byte is thus the
+ *  parity of the unbalanced codes before it: the bytes are split among
+ *  the threads, the parity of each part is counted, accumulated over the
+ *  parts, and then every part is encoded independently.
+ *
+ *  Table from http://opencores.org/project,async_8b10b_encoder_decoder
+ *  (data characters only), as in enc8b10b.m.
+ */
+
+/*
+ * USAGE:
+ * [enc,rd] = enc8b10b_mex(bits);
+ * [enc,rd] = enc8b10b_mex(bits,rd0);
+ * [enc,rd] = enc8b10b_mex(bits,rd0,nthreads);
+ *
+ * INPUT
+ * bits      Bits to encode, multiple of 8, LSB of each byte first
+ *             (logical or double, nonzero is 1)
+ * rd0       Initial running disparity, 0 (RD-) or 1 (RD+) (default 0)
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * enc       Encoded bits, 1-by-(10*numel(bits)/8) logical, bits abcdeifghj
+ *             of each code in transmission order
+ * rd        Final running disparity
+ */
+
+#include "robomex.h"
+
+#define MINCHUNK 65536       /* minimum bytes per thread */
+
+/* Code (bit 0 is a) of byte + 256*RD */
+static const unsigned short code8b10b[512] = {
+  0x0B9, 0x0AE, 0x0AD, 0x363, 0x0AB, 0x365, 0x366, 0x347,
+  0x0A7, 0x369, 0x36A, 0x34B, 0x36C, 0x34D, 0x34E, 0x0BA,
+  0x0B6, 0x371, 0x372, 0x353, 0x374, 0x355, 0x356, 0x097,
+  0x0B3, 0x359, 0x35A, 0x09B, 0x35C, 0x09D, 0x09E, 0x0B5,
+  0x279, 0x26E, 0x26D, 0x263, 0x26B, 0x265, 0x266, 0x247,
+  0x267, 0x269, 0x26A, 0x24B, 0x26C, 0x24D, 0x24E, 0x27A,
+  0x276, 0x271, 0x272, 0x253, 0x274, 0x255, 0x256, 0x257,
+  0x273, 0x259, 0x25A, 0x25B, 0x25C, 0x25D, 0x25E, 0x275,
+  0x2B9, 0x2AE, 0x2AD, 0x2A3, 0x2AB, 0x2A5, 0x2A6, 0x287,
+  0x2A7, 0x2A9, 0x2AA, 0x28B, 0x2AC, 0x28D, 0x28E, 0x2BA,
+  0x2B6, 0x2B1, 0x2B2, 0x293, 0x2B4, 0x295, 0x296, 0x297,
+  0x2B3, 0x299, 0x29A, 0x29B, 0x29C, 0x29D, 0x29E, 0x2B5,
+  0x339, 0x32E, 0x32D, 0x0E3, 0x32B, 0x0E5, 0x0E6, 0x0C7,
+  0x327, 0x0E9, 0x0EA, 0x0CB, 0x0EC, 0x0CD, 0x0CE, 0x33A,
+  0x336, 0x0F1, 0x0F2, 0x0D3, 0x0F4, 0x0D5, 0x0D6, 0x317,
+  0x333, 0x0D9, 0x0DA, 0x31B, 0x0DC, 0x31D, 0x31E, 0x335,
+  0x139, 0x12E, 0x12D, 0x2E3, 0x12B, 0x2E5, 0x2E6, 0x2C7,
+  0x127, 0x2E9, 0x2EA, 0x2CB, 0x2EC, 0x2CD, 0x2CE, 0x13A,
+  0x136, 0x2F1, 0x2F2, 0x2D3, 0x2F4, 0x2D5, 0x2D6, 0x117,
+  0x133, 0x2D9, 0x2DA, 0x11B, 0x2DC, 0x11D, 0x11E, 0x135,
+  0x179, 0x16E, 0x16D, 0x163, 0x16B, 0x165, 0x166, 0x147,
+  0x167, 0x169, 0x16A, 0x14B, 0x16C, 0x14D, 0x14E, 0x17A,
+  0x176, 0x171, 0x172, 0x153, 0x174, 0x155, 0x156, 0x157,
+  0x173, 0x159, 0x15A, 0x15B, 0x15C, 0x15D, 0x15E, 0x175,
+  0x1B9, 0x1AE, 0x1AD, 0x1A3, 0x1AB, 0x1A5, 0x1A6, 0x187,
+  0x1A7, 0x1A9, 0x1AA, 0x18B, 0x1AC, 0x18D, 0x18E, 0x1BA,
+  0x1B6, 0x1B1, 0x1B2, 0x193, 0x1B4, 0x195, 0x196, 0x197,
+  0x1B3, 0x199, 0x19A, 0x19B, 0x19C, 0x19D, 0x19E, 0x1B5,
+  0x239, 0x22E, 0x22D, 0x1E3, 0x22B, 0x1E5, 0x1E6, 0x1C7,
+  0x227, 0x1E9, 0x1EA, 0x1CB, 0x1EC, 0x1CD, 0x1CE, 0x23A,
+  0x236, 0x3B1, 0x3B2, 0x1D3, 0x3B4, 0x1D5, 0x1D6, 0x217,
+  0x233, 0x1D9, 0x1DA, 0x21B, 0x1DC, 0x21D, 0x21E, 0x235,
+  0x346, 0x351, 0x352, 0x0A3, 0x354, 0x0A5, 0x0A6, 0x0B8,
+  0x358, 0x0A9, 0x0AA, 0x08B, 0x0AC, 0x08D, 0x08E, 0x345,
+  0x349, 0x0B1, 0x0B2, 0x093, 0x0B4, 0x095, 0x096, 0x368,
+  0x34C, 0x099, 0x09A, 0x364, 0x09C, 0x362, 0x361, 0x34A,
+  0x246, 0x251, 0x252, 0x263, 0x254, 0x265, 0x266, 0x278,
+  0x258, 0x269, 0x26A, 0x24B, 0x26C, 0x24D, 0x24E, 0x245,
+  0x249, 0x271, 0x272, 0x253, 0x274, 0x255, 0x256, 0x268,
+  0x24C, 0x259, 0x25A, 0x264, 0x25C, 0x262, 0x261, 0x24A,
+  0x286, 0x291, 0x292, 0x2A3, 0x294, 0x2A5, 0x2A6, 0x2B8,
+  0x298, 0x2A9, 0x2AA, 0x28B, 0x2AC, 0x28D, 0x28E, 0x285,
+  0x289, 0x2B1, 0x2B2, 0x293, 0x2B4, 0x295, 0x296, 0x2A8,
+  0x28C, 0x299, 0x29A, 0x2A4, 0x29C, 0x2A2, 0x2A1, 0x28A,
+  0x0C6, 0x0D1, 0x0D2, 0x323, 0x0D4, 0x325, 0x326, 0x338,
+  0x0D8, 0x329, 0x32A, 0x30B, 0x32C, 0x30D, 0x30E, 0x0C5,
+  0x0C9, 0x331, 0x332, 0x313, 0x334, 0x315, 0x316, 0x0E8,
+  0x0CC, 0x319, 0x31A, 0x0E4, 0x31C, 0x0E2, 0x0E1, 0x0CA,
+  0x2C6, 0x2D1, 0x2D2, 0x123, 0x2D4, 0x125, 0x126, 0x138,
+  0x2D8, 0x129, 0x12A, 0x10B, 0x12C, 0x10D, 0x10E, 0x2C5,
+  0x2C9, 0x131, 0x132, 0x113, 0x134, 0x115, 0x116, 0x2E8,
+  0x2CC, 0x119, 0x11A, 0x2E4, 0x11C, 0x2E2, 0x2E1, 0x2CA,
+  0x146, 0x151, 0x152, 0x163, 0x154, 0x165, 0x166, 0x178,
+  0x158, 0x169, 0x16A, 0x14B, 0x16C, 0x14D, 0x14E, 0x145,
+  0x149, 0x171, 0x172, 0x153, 0x174, 0x155, 0x156, 0x168,
+  0x14C, 0x159, 0x15A, 0x164, 0x15C, 0x162, 0x161, 0x14A,
+  0x186, 0x191, 0x192, 0x1A3, 0x194, 0x1A5, 0x1A6, 0x1B8,
+  0x198, 0x1A9, 0x1AA, 0x18B, 0x1AC, 0x18D, 0x18E, 0x185,
+  0x189, 0x1B1, 0x1B2, 0x193, 0x1B4, 0x195, 0x196, 0x1A8,
+  0x18C, 0x199, 0x19A, 0x1A4, 0x19C, 0x1A2, 0x1A1, 0x18A,
+  0x1C6, 0x1D1, 0x1D2, 0x223, 0x1D4, 0x225, 0x226, 0x238,
+  0x1D8, 0x229, 0x22A, 0x04B, 0x22C, 0x04D, 0x04E, 0x1C5,
+  0x1C9, 0x231, 0x232, 0x213, 0x234, 0x215, 0x216, 0x1E8,
+  0x1CC, 0x219, 0x21A, 0x1E4, 0x21C, 0x1E2, 0x1E1, 0x1CA
+};
+
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+/* Byte k of the input */
+static int get_byte(const mxArray* a,size_t k)
+{
+  int b, byte = 0;
+
+  if (mxIsLogical(a)) {
+    const mxLogical* x = mxGetLogicals(a) + 8*k;
+    for (b = 0; b < 8; b++)
+      byte |= (x[b] != 0) << b;
+  } else {
+    const double* x = mxGetPr(a) + 8*k;
+    for (b = 0; b < 8; b++)
+      byte |= (x[b] > 0) << b;
+  }
+  return byte;
+}
+
+
+/* Nonzero if the code of the byte is unbalanced (flips the RD) */
+static int flips_rd(int byte)
+{
+  int c = code8b10b[byte], ones = 0;
+
+  while (c) {
+    ones += c & 1;
+    c >>= 1;
+  }
+  return ones != 5;
+}
+
+
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  size_t nbytes;     /* bytes to encode */
+  int rd0;           /* initial running disparity */
+  int nthreads;      /* number of threads */
+  int nchunks;       /* parts of the input */
+  int* rd;           /* RD before each part, RD at the end */
+  mxLogical* enc;
+  int ch;
+
+  if (nrhs < 1)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 2)
+    mexErrMsgTxt("Too many output arguments.");
+  if (!mxIsLogical(prhs[0]) && (!mxIsDouble(prhs[0]) || mxIsComplex(prhs[0])))
+    mexErrMsgTxt("The bits must be logical or real double.");
+  if (mxGetNumberOfElements(prhs[0]) % 8)
+    mexErrMsgTxt("The number of bits must be a multiple of 8.");
+
+  /* parse input arguments */
+  nbytes = mxGetNumberOfElements(prhs[0])/8;
+  rd0 = robomex_optional(nrhs,prhs,1,0) != 0;
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,2,0));
+  nchunks = (int) ((nbytes + MINCHUNK - 1)/MINCHUNK);
+  if (nchunks > nthreads)
+    nchunks = nthreads;
+  if (nchunks < 1)
+    nchunks = 1;
+
+  plhs[0] = mxCreateLogicalMatrix(1,10*nbytes);
+  enc = mxGetLogicals(plhs[0]);
+  rd = (int*) mxCalloc(nchunks + 1,sizeof(int));
+
+  /* parity of the unbalanced codes of each part */
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nchunks) schedule(static)
+#endif
+  for (ch = 0; ch < nchunks; ch++) {
+    size_t k, k1 = nbytes*(ch + 1)/nchunks;
+    int p = 0;
+    for (k = nbytes*ch/nchunks; k < k1; k++)
+      p ^= flips_rd(get_byte(prhs[0],k));
+    rd[ch + 1] = p;
+  }
+  rd[0] = rd0;
+  for (ch = 0; ch < nchunks; ch++)
+    rd[ch + 1] ^= rd[ch];
+
+  /* encode */
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nchunks) schedule(static)
+#endif
+  for (ch = 0; ch < nchunks; ch++) {
+    size_t k, k1 = nbytes*(ch + 1)/nchunks;
+    int r = rd[ch], byte, code, b;
+    for (k = nbytes*ch/nchunks; k < k1; k++) {
+      byte = get_byte(prhs[0],k);
+      code = code8b10b[byte + 256*r];
+      for (b = 0; b < 10; b++)
+        enc[10*k + b] = (mxLogical) ((code >> b) & 1);
+      r ^= flips_rd(byte);
+    }
+  }
+
+  if (nlhs > 1)
+    plhs[1] = mxCreateDoubleScalar(rd[nchunks]);
+  mxFree(rd);
+}
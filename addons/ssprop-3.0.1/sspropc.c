@@ -98,6 +98,10 @@ void sspropc_initialize_data(int);
 void cmult(COMPLEX*, COMPLEX*, COMPLEX*);
 void cscale(COMPLEX*, COMPLEX*, REAL);
 int ssconverged(COMPLEX*, COMPLEX*, REAL);
+void nonlinear_kerr(COMPLEX*, COMPLEX*, COMPLEX*, COMPLEX*,
+                    REAL, REAL, REAL, REAL);
+void nonlinear_raman(COMPLEX*, COMPLEX*, COMPLEX*, COMPLEX*,
+                     REAL, REAL, REAL, REAL);
 void mexFunction(int, mxArray* [], int, const mxArray* []);
 
 void sspropc_destroy_data(void)
@@ -206,6 +210,74 @@ int ssconverged(COMPLEX* a, COMPLEX* b, REAL t)
   return (num/denom < t);
 }
 
+/* Nonlinear step kernels: uv = uhalf.*exp(-j*phi)/nt, where phi is
+ * the nonlinear phase of the average of u0 and u1 over the step.
+ * NONLINEAR_KERNEL expands to one kernel per configuration, with the
+ * Raman/self-steepening terms selected at compile time so that the
+ * inner loops carry no runtime branches.  mexFunction picks the kernel
+ * once per call from nonlinear_kernels.
+ *
+ * MATLAB equivalent (nonlinear_kerr):
+ *   uv = uhalf .* exp((-j*gamma*dz/2)*(abs(u0).^2 + abs(u1).^2)) / nt;
+ */
+typedef void (*nonlinear_kernel)(COMPLEX*, COMPLEX*, COMPLEX*, COMPLEX*,
+                                 REAL, REAL, REAL, REAL);
+
+/* nonlinear phase (nlp[0]) and gain (nlp[1]) of sample jj, whose
+ * neighbours are jm and jp */
+#define NONLINEAR_SAMPLE(RAMAN,jj,jm,jp)                                \
+  if (RAMAN) {                                                          \
+    ua = &u0[jm]; ub = &u0[jj]; uc = &u0[jp];                           \
+    nlp[1] = -toptical*(abs2(uc) - abs2(ua) +                           \
+                        prodr(ub,uc) - prodr(ub,ua))/(4*pi*dt);         \
+    nlp[0] = abs2(ub) - traman*(abs2(uc) - abs2(ua))/(2*dt)             \
+      + toptical*(prodi(ub,uc) - prodi(ub,ua))/(4*pi*dt);               \
+    ua = &u1[jm]; ub = &u1[jj]; uc = &u1[jp];                           \
+    nlp[1] += -toptical*(abs2(uc) - abs2(ua) +                          \
+                         prodr(ub,uc) - prodr(ub,ua))/(4*pi*dt);        \
+    nlp[0] += abs2(ub) - traman*(abs2(uc) - abs2(ua))/(2*dt)            \
+      + toptical*(prodi(ub,uc) - prodi(ub,ua))/(4*pi*dt);               \
+    nlp[0] *= coef;                                                     \
+    g = exp(+nlp[1]*coef);                                              \
+  } else {                                                              \
+    nlp[0] = (abs2(&u0[jj]) + abs2(&u1[jj]))*coef;                      \
+    g = 1;                                                              \
+  }                                                                     \
+  c = cos(nlp[0]);                                                      \
+  s = sin(nlp[0]);                                                      \
+  uv[jj][0] = (uhalf[jj][0]*c*g + uhalf[jj][1]*s*g)/nt;                 \
+  uv[jj][1] = (-uhalf[jj][0]*s*g + uhalf[jj][1]*c*g)/nt;
+
+#define NONLINEAR_KERNEL(NAME,RAMAN)                                    \
+void NAME(COMPLEX* uv, COMPLEX* uhalf, COMPLEX* u0, COMPLEX* u1,        \
+          REAL coef, REAL dt, REAL traman, REAL toptical)               \
+{                                                                       \
+  int jj;                                                               \
+  REAL c, s, g;                                                         \
+  COMPLEX nlp, *ua, *ub, *uc;                                           \
+                                                                        \
+  if (RAMAN) {                                                          \
+    NONLINEAR_SAMPLE(RAMAN, 0, nt-1, 1)                                 \
+    for (jj = 1; jj < nt-1; jj++) {                                     \
+      NONLINEAR_SAMPLE(RAMAN, jj, jj-1, jj+1)                           \
+    }                                                                   \
+    NONLINEAR_SAMPLE(RAMAN, nt-1, nt-2, 0)                              \
+  } else {                                                              \
+    for (jj = 0; jj < nt; jj++) {                                       \
+      NONLINEAR_SAMPLE(RAMAN, jj, jj, jj)                               \
+    }                                                                   \
+  }                                                                     \
+}
+
+NONLINEAR_KERNEL(nonlinear_kerr, 0)
+NONLINEAR_KERNEL(nonlinear_raman, 1)
+
+/* indexed by (traman != 0 || toptical != 0) */
+static const nonlinear_kernel nonlinear_kernels[2] = {
+  nonlinear_kerr,
+  nonlinear_raman
+};
+
 void mexFunction(int nlhs, mxArray *plhs[],
                  int nrhs, const mxArray *prhs[])
 {
@@ -222,15 +294,13 @@ void mexFunction(int nlhs, mxArray *plhs[],
   REAL toptical = 0; /* Optical cycle time = lambda/c */
   int maxiter = 4;   /* max number of iterations */
   REAL tol = 1e-5;   /* convergence tolerance */
+  nonlinear_kernel nonlinear;  /* nonlinear step kernel */
 
   REAL* w;           /* vector of angular frequencies */
 
   int iz,ii,jj;      /* loop counters */
   REAL phase, alpha,
     wii, fii;        /* temporary variables */
-  COMPLEX 
-    nlp,             /* nonlinear phase */
-    *ua, *ub, *uc;   /* samples of u at three adjacent times */
   char argstr[100];	 /* string argument */
 
   if (nrhs == 1) {
@@ -322,93 +392,17 @@ void mexFunction(int nlhs, mxArray *plhs[],
 
   mxFree(w);                             /* free w vector */
 
+  /* select the step kernel once for the whole propagation */
+  nonlinear = nonlinear_kernels[(traman != 0.0) || (toptical != 0)];
+
   mexPrintf("Performing split-step iterations ... ");
 
   EXECUTE(p1);                           /* ufft = fft(u0) */
   for (iz = 0; iz < nz; iz++) {
     cmult(uhalf,halfstep,ufft);          /* uhalf = halfstep.*ufft */
     EXECUTE(ip1);                        /* uhalf = nt*ifft(uhalf) */
-    for (ii = 0; ii < maxiter; ii++) {                
-
-      if ((traman == 0.0) && (toptical == 0)) {
-
-        for (jj = 0; jj < nt; jj++) {
-          phase = gamma*(u0[jj][0]*u0[jj][0] +
-                         u0[jj][1]*u0[jj][1] + 
-                         u1[jj][0]*u1[jj][0] +
-                         u1[jj][1]*u1[jj][1])*dz/2;
-          uv[jj][0] = (uhalf[jj][0]*cos(phase) +
-                       uhalf[jj][1]*sin(phase))/nt;
-          uv[jj][1] = (-uhalf[jj][0]*sin(phase) +
-                       uhalf[jj][1]*cos(phase))/nt;
-        }
-
-      } else {
-
-        jj = 0;
-        ua = &u0[nt-1]; ub = &u0[jj]; uc = &u0[jj+1];
-        nlp[1] = -toptical*(abs2(uc) - abs2(ua) + 
-                           prodr(ub,uc) - prodr(ub,ua))/(4*pi*dt);
-        nlp[0] = abs2(ub) - traman*(abs2(uc) - abs2(ua))/(2*dt) 
-          + toptical*(prodi(ub,uc) - prodi(ub,ua))/(4*pi*dt);
-        
-        ua = &u1[nt-1]; ub = &u1[jj]; uc = &u1[jj+1];
-        nlp[1] += -toptical*(abs2(uc) - abs2(ua) + 
-                            prodr(ub,uc) - prodr(ub,ua))/(4*pi*dt);
-        nlp[0] += abs2(ub) - traman*(abs2(uc) - abs2(ua))/(2*dt) 
-          + toptical*(prodi(ub,uc) - prodi(ub,ua))/(4*pi*dt);
-
-        nlp[0] *= gamma*dz/2;
-        nlp[1] *= gamma*dz/2;
-
-        uv[jj][0] = (uhalf[jj][0]*cos(nlp[0])*exp(+nlp[1]) +
-                     uhalf[jj][1]*sin(nlp[0])*exp(+nlp[1]))/nt;
-        uv[jj][1] = (-uhalf[jj][0]*sin(nlp[0])*exp(+nlp[1]) +
-                     uhalf[jj][1]*cos(nlp[0])*exp(+nlp[1]))/nt;
-      
-        for (jj = 1; jj < nt-1; jj++) {
-          ua = &u0[jj-1]; ub = &u0[jj]; uc = &u0[jj+1];
-          nlp[1] = -toptical*(abs2(uc) - abs2(ua) + 
-                             prodr(ub,uc) - prodr(ub,ua))/(4*pi*dt);
-          nlp[0] = abs2(ub) - traman*(abs2(uc) - abs2(ua))/(2*dt) 
-            + toptical*(prodi(ub,uc) - prodi(ub,ua))/(4*pi*dt);
-
-          ua = &u1[jj-1]; ub = &u1[jj]; uc = &u1[jj+1];
-          nlp[1] += -toptical*(abs2(uc) - abs2(ua) + 
-                              prodr(ub,uc) - prodr(ub,ua))/(4*pi*dt);
-          nlp[0] += abs2(ub) - traman*(abs2(uc) - abs2(ua))/(2*dt) 
-            + toptical*(prodi(ub,uc) - prodi(ub,ua))/(4*pi*dt);
-
-          nlp[0] *= gamma*dz/2;
-          nlp[1] *= gamma*dz/2;
-
-          uv[jj][0] = (uhalf[jj][0]*cos(nlp[0])*exp(+nlp[1]) +
-                       uhalf[jj][1]*sin(nlp[0])*exp(+nlp[1]))/nt;
-          uv[jj][1] = (-uhalf[jj][0]*sin(nlp[0])*exp(+nlp[1]) +
-                       uhalf[jj][1]*cos(nlp[0])*exp(+nlp[1]))/nt;
-        }
-
-        /* we now handle the endpoint where jj = nt-1 */
-        ua = &u0[jj-1]; ub = &u0[jj]; uc = &u0[0];
-        nlp[1] = -toptical*(abs2(uc) - abs2(ua) + 
-                           prodr(ub,uc) - prodr(ub,ua))/(4*pi*dt);
-        nlp[0] = abs2(ub) - traman*(abs2(uc) - abs2(ua))/(2*dt) 
-          + toptical*(prodi(ub,uc) - prodi(ub,ua))/(4*pi*dt);
-
-        ua = &u1[jj-1]; ub = &u1[jj]; uc = &u1[0];
-        nlp[1] += -toptical*(abs2(uc) - abs2(ua) + 
-                            prodr(ub,uc) - prodr(ub,ua))/(4*pi*dt);
-        nlp[0] += abs2(ub) - traman*(abs2(uc) - abs2(ua))/(2*dt) 
-          + toptical*(prodi(ub,uc) - prodi(ub,ua))/(4*pi*dt);
-
-        nlp[0] *= gamma*dz/2;
-        nlp[1] *= gamma*dz/2;
-
-        uv[jj][0] = (uhalf[jj][0]*cos(nlp[0])*exp(+nlp[1]) +
-                     uhalf[jj][1]*sin(nlp[0])*exp(+nlp[1]))/nt;
-        uv[jj][1] = (-uhalf[jj][0]*sin(nlp[0])*exp(+nlp[1]) +
-                     uhalf[jj][1]*cos(nlp[0])*exp(+nlp[1]))/nt;
-      }
+    for (ii = 0; ii < maxiter; ii++) {
+      nonlinear(uv,uhalf,u0,u1,gamma*dz/2,dt,traman,toptical);
 
       EXECUTE(p2);                      /* uv = fft(uv) */
       cmult(ufft,uv,halfstep);          /* ufft = uv.*halfstep */
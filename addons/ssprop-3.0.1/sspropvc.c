@@ -23,6 +23,7 @@
  * [u1x,u1y] = sspropvc(u0x,u0y,dt,dz,nz,alphaa,alphab,betapa,betapb,gamma,psp,method);
  * [u1x,u1y] = sspropvc(u0x,u0y,dt,dz,nz,alphaa,alphab,betapa,betapb,gamma,psp,method,maxiter;
  * [u1x,u1y] = sspropvc(u0x,u0y,dt,dz,nz,alphaa,alphab,betapa,betapb,gamma,psp,method,maxiter,tol);
+ * [u1x,u1y,info] = sspropvc(...);
  * sspropvc -option
  *
  * OPTIONS:   (i.e. sspropvc -savewisdom )
@@ -33,6 +34,25 @@
  *  -exhaustive
  *  -measure
  *  -estimate
+ *  -autofir     (FIR linear steps when cheaper than the FFT)
+ *  -fir         (FIR linear steps whenever the impulse response fits)
+ *  -nofir       (default: always FFT linear steps)
+ *
+ * FIR LINEAR STEPS:
+ * For short steps or low dispersion the impulse response of the
+ * linear half-step (ha, hb or the H matrix) is only a few samples
+ * long.  With -autofir or -fir, the routine then truncates it to the
+ * shortest FIR filter whose RMS error over the whole frequency grid
+ * (flat weight, so the bound holds wherever the spectrum spreads
+ * during the propagation) is below tol/(2*nz), and propagates entirely
+ * in the time domain (circular convolution, no FFT).  The FIR path is
+ * used if it fits in FIR_MAXTAPS taps and, with -autofir, if the cost
+ * model (fir_cost_ratio) predicts it is cheaper than the FFT path.
+ * The FFT path is the default, so that the results do not change
+ * unless the FIR steps are requested.  The optional output info reports the
+ * decision: info.fir (0/1), info.taps (length 2*K+1 of the impulse
+ * responses, 0 if not used) and info.cost (estimated FIR to FFT cost
+ * ratio).
  */
 
 
@@ -101,6 +121,34 @@ static int firstcall = 1;       /* =1 when sspropvc first invoked */
 int allocated = 0;              /* =1 when memory is allocated */
 static int method = FFTW_PATIENT;	/* planner method */
 
+#define FIRMODE_AUTO 0          /* FIR linear steps when cheaper */
+#define FIRMODE_ON 1            /* FIR linear steps when they fit */
+#define FIRMODE_OFF 2           /* FFT linear steps only */
+#define FIR_MAXTAPS 129         /* longest FIR filter considered */
+#define FIR_BLOCK 512           /* samples per cache block in prop_linear_fir */
+#define FFT_FLOPS 5.0           /* FFT cost: FFT_FLOPS*nt*log2(nt) */
+#define FIR_EFFICIENCY 1.0      /* FIR flop rate relative to FFTW */
+static int firmode = FIRMODE_OFF;	/* FIR linear step mode */
+
+typedef struct {
+  int K;             /* taps h[-K] ... h[K] */
+  int zero;          /* != 0 if the filter is identically zero */
+  REAL *hr, *hi;     /* real and imaginary parts of the 2*K+1 taps */
+} fir_filter;
+
+typedef struct {
+  REAL *xra,*xia,*xrb,*xib;  /* circularly extended inputs, nt+2*K */
+  REAL *yra,*yia,*yrb,*yib;  /* accumulators, nt */
+} fir_work;
+
+#define BASIS_ELLIPTICAL 0      /* nonlinear kernels (nonlinear_kernels) */
+#define BASIS_LINEAR 1
+#define BASIS_CIRCULAR 2
+
+typedef void (*nonlinear_kernel)(COMPLEX*,COMPLEX*,COMPLEX*,COMPLEX*,
+                                 COMPLEX*,COMPLEX*,COMPLEX*,COMPLEX*,
+                                 REAL,REAL,REAL,int);
+
 void sspropvc_save_wisdom();
 void sspropvc_load_wisdom();
 void cscale(COMPLEX*,COMPLEX*,COMPLEX*,COMPLEX*,REAL,int);
@@ -116,7 +164,18 @@ void prop_linear_circ(COMPLEX*,COMPLEX*,COMPLEX*,COMPLEX*,COMPLEX*,
                       COMPLEX*,COMPLEX*,COMPLEX*,int);
 void nonlinear_propagate(COMPLEX*,COMPLEX*,COMPLEX*,COMPLEX*,COMPLEX*,
                          COMPLEX*,COMPLEX*,COMPLEX*,REAL,REAL,REAL,int);
+void nonlinear_linear(COMPLEX*,COMPLEX*,COMPLEX*,COMPLEX*,COMPLEX*,
+                      COMPLEX*,COMPLEX*,COMPLEX*,REAL,REAL,REAL,int);
+void nonlinear_circular(COMPLEX*,COMPLEX*,COMPLEX*,COMPLEX*,COMPLEX*,
+                        COMPLEX*,COMPLEX*,COMPLEX*,REAL,REAL,REAL,int);
+nonlinear_kernel select_nonlinear(REAL,REAL*,REAL*);
 int is_converged(COMPLEX*,COMPLEX*,COMPLEX*,COMPLEX*,REAL,int);
+void csolve(COMPLEX*,COMPLEX*,int);
+void fir_design(fir_filter*,COMPLEX*,REAL*,COMPLEX*,COMPLEX*,COMPLEX*,
+                PLAN,PLAN,int,REAL,int);
+REAL fir_cost_ratio(int,int,int);
+void prop_linear_fir(COMPLEX*,COMPLEX*,fir_filter*,fir_filter*,fir_filter*,
+                     fir_filter*,COMPLEX*,COMPLEX*,REAL,fir_work*,int);
 void inv_rotate_coord(mxArray*,mxArray*,COMPLEX*,COMPLEX*,
                       REAL,REAL,int);
 void mexFunction(int, mxArray* [], int, const mxArray* []);
@@ -417,6 +476,266 @@ void prop_linear_circ(COMPLEX* uZa, COMPLEX* uZb, COMPLEX* h11,
 }
 
 
+/* Solves the linear system A*x = b (n-by-n, row major) by Gaussian
+ * elimination with partial pivoting.  x overwrites b, A is destroyed. */
+void csolve(COMPLEX* A,COMPLEX* b,int n)
+{
+  int ii,jj,kk,piv;
+  REAL mr,mi,den,tr,ti,best;
+
+  for (kk = 0; kk < n; kk++) {
+    piv = kk;
+    best = abs2(&A[kk*n+kk]);
+    for (ii = kk+1; ii < n; ii++)
+      if (abs2(&A[ii*n+kk]) > best) {
+        best = abs2(&A[ii*n+kk]);
+        piv = ii;
+      }
+    if (best == 0)
+      continue;
+    if (piv != kk) {
+      for (jj = 0; jj < n; jj++) {
+        tr = A[kk*n+jj][0]; A[kk*n+jj][0] = A[piv*n+jj][0]; A[piv*n+jj][0] = tr;
+        ti = A[kk*n+jj][1]; A[kk*n+jj][1] = A[piv*n+jj][1]; A[piv*n+jj][1] = ti;
+      }
+      tr = b[kk][0]; b[kk][0] = b[piv][0]; b[piv][0] = tr;
+      ti = b[kk][1]; b[kk][1] = b[piv][1]; b[piv][1] = ti;
+    }
+    den = abs2(&A[kk*n+kk]);
+    for (ii = kk+1; ii < n; ii++) {
+      /* m = A(ii,kk)/A(kk,kk) */
+      mr = (A[ii*n+kk][0]*A[kk*n+kk][0] + A[ii*n+kk][1]*A[kk*n+kk][1])/den;
+      mi = (A[ii*n+kk][1]*A[kk*n+kk][0] - A[ii*n+kk][0]*A[kk*n+kk][1])/den;
+      for (jj = kk; jj < n; jj++) {
+        A[ii*n+jj][0] -= mr*A[kk*n+jj][0] - mi*A[kk*n+jj][1];
+        A[ii*n+jj][1] -= mr*A[kk*n+jj][1] + mi*A[kk*n+jj][0];
+      }
+      b[ii][0] -= mr*b[kk][0] - mi*b[kk][1];
+      b[ii][1] -= mr*b[kk][1] + mi*b[kk][0];
+    }
+  }
+
+  for (ii = n-1; ii >= 0; ii--) {
+    tr = b[ii][0];
+    ti = b[ii][1];
+    for (jj = ii+1; jj < n; jj++) {
+      tr -= A[ii*n+jj][0]*b[jj][0] - A[ii*n+jj][1]*b[jj][1];
+      ti -= A[ii*n+jj][0]*b[jj][1] + A[ii*n+jj][1]*b[jj][0];
+    }
+    den = abs2(&A[ii*n+ii]);
+    if (den == 0) {
+      b[ii][0] = b[ii][1] = 0;
+      continue;
+    }
+    b[ii][0] = (tr*A[ii*n+ii][0] + ti*A[ii*n+ii][1])/den;
+    b[ii][1] = (ti*A[ii*n+ii][0] - tr*A[ii*n+ii][1])/den;
+  }
+}
+
+
+/* Designs the shortest FIR filter h[-K..K] that approximates the
+ * frequency response H (one linear half-step) in the weighted least
+ * squares sense:
+ *
+ *   min sum(W.*|H - fft(h_K)|.^2)
+ *
+ * where W is a non-negative weight over the frequency grid (flat in
+ * sspropvc, i.e. the plain least squares fit).  K is the smallest value up to kmax for which the weighted RMS
+ * error sqrt(sum(W.*|H-fft(h_K)|.^2)/sum(W)) is below tol (binary
+ * search: the error does not increase with K).  If no such K exists,
+ * f->K is set to FIR_MAXTAPS and no taps are stored.
+ *
+ * c = fft(W) must be precomputed; d and e are scratch buffers with
+ * in-place plans ibd (backward, on d) and fe (forward, on e).
+ *
+ * MATLAB equivalent for a given K (normal equations, k = -K:K):
+ *   c = fft(W);  d = ifft(W.*H)*nt;
+ *   A = c(mod(bsxfun(@minus,k,k'),nt)+1);  % A(m,k) = c(k-m)
+ *   hK = A \ d(mod(k',nt)+1);
+ */
+void fir_design(fir_filter* f,COMPLEX* H,REAL* W,COMPLEX* c,COMPLEX* d,
+                COMPLEX* e,PLAN ibd,PLAN fe,int kmax,REAL tol,int nt)
+{
+  int jj,kk,mm,n,lo,hi,K;
+  REAL wtot,htot,err,er,ei;
+  COMPLEX *A,*b,*best = NULL;
+
+  f->K = FIR_MAXTAPS;
+  f->zero = 0;
+  f->hr = f->hi = NULL;
+
+  for (jj = 0, htot = 0, wtot = 0; jj < nt; jj++) {
+    d[jj][0] = W[jj]*H[jj][0];
+    d[jj][1] = W[jj]*H[jj][1];
+    htot += abs2(&H[jj]);
+    wtot += W[jj];
+  }
+  if (htot == 0) {
+    f->K = 0;
+    f->zero = 1;
+    return;
+  }
+  EXECUTE(ibd);  /* d = ifft(W.*H)*nt */
+
+  lo = 0;
+  hi = kmax;
+  while (lo <= hi) {
+    K = (lo+hi)/2;
+    n = 2*K+1;
+    A = (COMPLEX*) mxMalloc(sizeof(COMPLEX)*n*n);
+    b = (COMPLEX*) mxMalloc(sizeof(COMPLEX)*n);
+    for (mm = -K; mm <= K; mm++) {
+      for (kk = -K; kk <= K; kk++) {
+        A[(mm+K)*n+kk+K][0] = c[(kk-mm+nt)%nt][0];
+        A[(mm+K)*n+kk+K][1] = c[(kk-mm+nt)%nt][1];
+      }
+      b[mm+K][0] = d[(mm+nt)%nt][0];
+      b[mm+K][1] = d[(mm+nt)%nt][1];
+    }
+    csolve(A,b,n);
+    mxFree(A);
+
+    /* weighted error of the design */
+    for (jj = 0; jj < nt; jj++)
+      e[jj][0] = e[jj][1] = 0;
+    for (kk = -K; kk <= K; kk++) {
+      e[(kk+nt)%nt][0] = b[kk+K][0];
+      e[(kk+nt)%nt][1] = b[kk+K][1];
+    }
+    EXECUTE(fe);  /* e = fft(h_K) */
+    for (jj = 0, err = 0; jj < nt; jj++) {
+      er = H[jj][0] - e[jj][0];
+      ei = H[jj][1] - e[jj][1];
+      err += W[jj]*(er*er + ei*ei);
+    }
+
+    if (sqrt(err/wtot) < tol) {
+      if (best)
+        mxFree(best);
+      best = b;
+      f->K = K;
+      hi = K-1;
+    }
+    else {
+      mxFree(b);
+      lo = K+1;
+    }
+  }
+  if (!best)
+    return;
+
+  f->hr = (REAL*) mxMalloc(sizeof(REAL)*(2*f->K+1));
+  f->hi = (REAL*) mxMalloc(sizeof(REAL)*(2*f->K+1));
+  for (kk = 0; kk < 2*f->K+1; kk++) {
+    f->hr[kk] = best[kk][0];
+    f->hi[kk] = best[kk][1];
+  }
+  mxFree(best);
+}
+
+
+/* Cost model: estimated cost of a FIR linear half-step relative to the
+ * FFT one, for 2*K+1 taps and nfilt non-zero filters per output
+ * polarization (1 for the elliptical method and for the circular one
+ * without birefringence, 2 otherwise).
+ *
+ *   FFT: 1.5 transforms per half-step on average (the first half
+ *        reuses the spectrum of the previous step) plus nfilt complex
+ *        multiplications per sample
+ *   FIR: nfilt*(2*K+1) complex multiply-adds per sample, plus the
+ *        copy to the circularly extended buffer
+ *
+ * The FIR path is chosen in automatic mode when the ratio is < 1. */
+REAL fir_cost_ratio(int K,int nt,int nfilt)
+{
+  REAL fftcost,fircost;
+
+  fftcost = 1.5*FFT_FLOPS*nt*log((double) nt)/log(2.0) + 6.0*nfilt*nt;
+  fircost = (8.0*nfilt*(2*K+1)*nt + 4.0*nt)/FIR_EFFICIENCY;
+  return fircost/fftcost;
+}
+
+
+/* Computes the linear propagation in the time domain by circular
+ * convolution with the FIR filters f11 ... f22 (f12 and f21 are NULL
+ * for the elliptical method), scaled by factor.  The output may
+ * overwrite the input.
+ *
+ * MATLAB Equivalent:
+ *   uZa = factor*(cconv(h11,u0a,nt) + cconv(h12,u0b,nt));
+ *   uZb = factor*(cconv(h21,u0a,nt) + cconv(h22,u0b,nt));
+ *
+ * The inputs are copied to split real/imaginary buffers extended by K
+ * samples on both sides, so that the inner loop has no modulo and
+ * unit stride (vectorized by the compiler).  The samples are processed
+ * in cache blocks of FIR_BLOCK. */
+void prop_linear_fir(COMPLEX* uZa,COMPLEX* uZb,fir_filter* f11,
+                     fir_filter* f12,fir_filter* f21,fir_filter* f22,
+                     COMPLEX* u0a,COMPLEX* u0b,REAL factor,fir_work* wk,
+                     int nt)
+{
+  fir_filter *fa[2],*fb[2];
+  REAL *xr,*xi,*yr,*yi;
+  REAL hr,hi;
+  int jj,kk,K,n0,n1,off,ip,ii;
+
+  fa[0] = f11; fa[1] = f12;  /* filters feeding uZa */
+  fb[0] = f21; fb[1] = f22;  /* filters feeding uZb */
+
+  K = f11->K;
+  for (ii = 0; ii < 2; ii++) {
+    if (fa[ii] && !fa[ii]->zero && fa[ii]->K > K) K = fa[ii]->K;
+    if (fb[ii] && !fb[ii]->zero && fb[ii]->K > K) K = fb[ii]->K;
+  }
+
+  /* circularly extended inputs: x[i] = u0[(i-K) mod nt] */
+  for (jj = 0; jj < nt+2*K; jj++) {
+    kk = (jj - K + nt) % nt;
+    wk->xra[jj] = u0a[kk][0];
+    wk->xia[jj] = u0a[kk][1];
+    wk->xrb[jj] = u0b[kk][0];
+    wk->xib[jj] = u0b[kk][1];
+  }
+  memset(wk->yra,0,sizeof(REAL)*nt);
+  memset(wk->yia,0,sizeof(REAL)*nt);
+  memset(wk->yrb,0,sizeof(REAL)*nt);
+  memset(wk->yib,0,sizeof(REAL)*nt);
+
+  for (n0 = 0; n0 < nt; n0 += FIR_BLOCK) {
+    n1 = n0 + FIR_BLOCK < nt ? n0 + FIR_BLOCK : nt;
+    /* ip = 0: input a, ip = 1: input b; ii = 0: output a, ii = 1: output b */
+    for (ip = 0; ip < 2; ip++) {
+      for (ii = 0; ii < 2; ii++) {
+        fir_filter* f = ii == 0 ? fa[ip] : fb[ip];
+        if (!f || f->zero)
+          continue;
+        xr = ip == 0 ? wk->xra : wk->xrb;
+        xi = ip == 0 ? wk->xia : wk->xib;
+        yr = ii == 0 ? wk->yra : wk->yrb;
+        yi = ii == 0 ? wk->yia : wk->yib;
+        for (kk = -f->K; kk <= f->K; kk++) {
+          /* y[n] += h[kk]*x[n-kk], stored at x[n-kk+K] */
+          hr = f->hr[kk+f->K];
+          hi = f->hi[kk+f->K];
+          off = K - kk;
+          for (jj = n0; jj < n1; jj++) {
+            yr[jj] += hr*xr[jj+off] - hi*xi[jj+off];
+            yi[jj] += hr*xi[jj+off] + hi*xr[jj+off];
+          }
+        }
+      }
+    }
+  }
+
+  for (jj = 0; jj < nt; jj++) {
+    uZa[jj][0] = factor*wk->yra[jj];
+    uZa[jj][1] = factor*wk->yia[jj];
+    uZb[jj][0] = factor*wk->yrb[jj];
+    uZb[jj][1] = factor*wk->yib[jj];
+  }
+}
+
+
 /* Computes nonlinear propagation according to the following equations:
  *
  * Elliptical Equivalent:
@@ -426,44 +745,64 @@ void prop_linear_circ(COMPLEX* uZa, COMPLEX* uZb, COMPLEX* h11,
  * Circular Equivalent:
  * dua/dz = (-j*2*gamma/3)*(|ua|^2 + 2*|ub|^2)*ua
  * dub/dz = (-j*2*gamma/3)*(|ub|^2 + 2*|ua|^2)*ub
+ *
+ * with coef = gamma*dz/3 and the self- and cross-phase weights
+ * cself = (2+cos(2X)^2)/2 and ccross = (2+2sin(2X)^2)/2.
+ *
+ * NONLINEAR_KERNEL expands to one kernel per polarization basis: the
+ * weights are compile-time constants for the linear (X = 0) and
+ * circular (X = pi/4) bases and arguments otherwise.  The kernel is
+ * chosen once per call by select_nonlinear.
  */
-void nonlinear_propagate(COMPLEX* uva,COMPLEX* uvb,COMPLEX* uahalf,
-                    COMPLEX* ubhalf,COMPLEX* u0a,COMPLEX* u0b,
-                    COMPLEX* u1a,COMPLEX* u1b,REAL gamma,REAL dz,
-                    REAL chi, int nt)
+#define NONLINEAR_KERNEL(NAME,CSELF,CCROSS)                            \
+void NAME(COMPLEX* uva,COMPLEX* uvb,COMPLEX* uahalf,                   \
+          COMPLEX* ubhalf,COMPLEX* u0a,COMPLEX* u0b,                   \
+          COMPLEX* u1a,COMPLEX* u1b,REAL coef,REAL cself,              \
+          REAL ccross,int nt)                                          \
+{                                                                      \
+  int jj;                                                              \
+  REAL pa,pb,phia,phib,ca,sa,cb,sb;                                    \
+                                                                       \
+  (void) cself;             /* constants in the basis kernels */       \
+  (void) ccross;                                                       \
+  for(jj = 0; jj < nt; jj++) {                                         \
+    pa = abs2(&u0a[jj]) + abs2(&u1a[jj]);                              \
+    pb = abs2(&u0b[jj]) + abs2(&u1b[jj]);                              \
+    phia = coef*((CSELF)*pa + (CCROSS)*pb);                            \
+    phib = coef*((CSELF)*pb + (CCROSS)*pa);                            \
+    ca = cos(phia);                                                    \
+    sa = sin(phia);                                                    \
+    cb = cos(phib);                                                    \
+    sb = sin(phib);                                                    \
+    uva[jj][0] = uahalf[jj][0]*ca + uahalf[jj][1]*sa;                  \
+    uva[jj][1] = uahalf[jj][1]*ca - uahalf[jj][0]*sa;                  \
+    uvb[jj][0] = ubhalf[jj][0]*cb + ubhalf[jj][1]*sb;                  \
+    uvb[jj][1] = ubhalf[jj][1]*cb - ubhalf[jj][0]*sb;                  \
+  }                                                                    \
+}
+
+NONLINEAR_KERNEL(nonlinear_propagate, cself, ccross)
+NONLINEAR_KERNEL(nonlinear_linear, 1.5, 1)
+NONLINEAR_KERNEL(nonlinear_circular, 1, 2)
+
+static const nonlinear_kernel nonlinear_kernels[] = {
+  nonlinear_propagate,     /* BASIS_ELLIPTICAL */
+  nonlinear_linear,        /* BASIS_LINEAR */
+  nonlinear_circular       /* BASIS_CIRCULAR */
+};
+
+
+/* Returns the nonlinear kernel for the basis of ellipticity chi and
+ * sets the weights used by the general (elliptical) kernel */
+nonlinear_kernel select_nonlinear(REAL chi,REAL* cself,REAL* ccross)
 {
-  int jj;
-  REAL coef,twoPcos,twoPsin;
-  coef = (REAL) ((1.0/3.0)*gamma*dz);
-  twoPcos = (2 + cos(2*chi)*cos(2*chi)) / 2;
-  twoPsin = (2 + 2*sin(2*chi)*sin(2*chi)) / 2;
-    
-  for(jj = 0; jj < nt; jj++) {
-    uva[jj][0] = uahalf[jj][0]*cos(coef*(
-                   twoPcos*(abs2(&u0a[jj])+abs2(&u1a[jj])) +
-                   twoPsin*(abs2(&u0b[jj])+abs2(&u1b[jj])) )) 
-               + uahalf[jj][1]*sin(coef*(
-                   twoPcos*(abs2(&u0a[jj])+abs2(&u1a[jj])) +
-                   twoPsin*(abs2(&u0b[jj])+abs2(&u1b[jj])) ));
-    uva[jj][1] = uahalf[jj][1]*cos(coef*(
-                   twoPcos*(abs2(&u0a[jj])+abs2(&u1a[jj])) +
-                   twoPsin*(abs2(&u0b[jj])+abs2(&u1b[jj])) )) 
-               - uahalf[jj][0]*sin(coef*(
-                   twoPcos*(abs2(&u0a[jj])+abs2(&u1a[jj])) +
-                   twoPsin*(abs2(&u0b[jj])+abs2(&u1b[jj])) ));
-    uvb[jj][0] = ubhalf[jj][0]*cos(coef*(
-                   twoPcos*(abs2(&u0b[jj])+abs2(&u1b[jj])) +
-                   twoPsin*(abs2(&u0a[jj])+abs2(&u1a[jj])) )) 
-               + ubhalf[jj][1]*sin(coef*(
-                   twoPcos*(abs2(&u0b[jj])+abs2(&u1b[jj])) +
-                   twoPsin*(abs2(&u0a[jj])+abs2(&u1a[jj])) ));
-    uvb[jj][1] = ubhalf[jj][1]*cos(coef*(
-                   twoPcos*(abs2(&u0b[jj])+abs2(&u1b[jj])) +
-                   twoPsin*(abs2(&u0a[jj])+abs2(&u1a[jj])) )) 
-               - ubhalf[jj][0]*sin(coef*(
-                   twoPcos*(abs2(&u0b[jj])+abs2(&u1b[jj])) +
-                   twoPsin*(abs2(&u0a[jj])+abs2(&u1a[jj])) ));
-  }
+  *cself = (REAL) ((2 + cos(2*chi)*cos(2*chi)) / 2);
+  *ccross = (REAL) ((2 + 2*sin(2*chi)*sin(2*chi)) / 2);
+  if (chi == (REAL) (pi/4))
+    return nonlinear_kernels[BASIS_CIRCULAR];
+  if (chi == 0)
+    return nonlinear_kernels[BASIS_LINEAR];
+  return nonlinear_kernels[BASIS_ELLIPTICAL];
 }
 
 
@@ -553,12 +892,27 @@ void mexFunction(int nlhs, mxArray *plhs[],
   PLAN p2a,p2b,ip2a,ip2b;   /* fft plans for 2nd linear half */
   
   int converged;            /* holds the return of is_converged */
+  nonlinear_kernel nonlinear;  /* nonlinear step kernel */
+  REAL cself,ccross;        /* self- and cross-phase weights */
   char methodstr[11];       /* method name: 'circular or 'elliptical' */
   int elliptical = 1;       /* if elliptical method, then != 0 */
 
   char argstr[100];	 /* string argument */
   
   int iz,ii,jj;      /* loop counters */
+
+  int usefir = 0;           /* if FIR linear steps, then != 0 */
+  fir_filter f11,f12,f21,f22;  /* FIR linear propagation filters */
+  fir_filter *pf12 = NULL, *pf21 = NULL;
+  fir_work wk;              /* FIR work buffers */
+  int K = 0;                /* FIR half length (taps = 2*K+1) */
+  int nfilt;                /* non-zero filters per output */
+  REAL fircost = 0;         /* FIR to FFT cost ratio */
+  REAL *W;                  /* FIR design weight (flat) */
+  int kmax;                 /* longest FIR filter considered */
+  REAL firtol;              /* FIR design tolerance per half-step */
+  PLAN ibd,fe;              /* plans used to design the filters */
+  const char *infonames[] = {"fir", "taps", "cost"};
   
   if (nrhs == 1) {
 	if (mxGetString(prhs[0],argstr,100)) 
@@ -585,6 +939,15 @@ void mexFunction(int nlhs, mxArray *plhs[],
 	else if (!strcmp(argstr,"-estimate")) {
 	  method = FFTW_ESTIMATE;
 	}
+	else if (!strcmp(argstr,"-autofir")) {
+	  firmode = FIRMODE_AUTO;
+	}
+	else if (!strcmp(argstr,"-fir")) {
+	  firmode = FIRMODE_ON;
+	}
+	else if (!strcmp(argstr,"-nofir")) {
+	  firmode = FIRMODE_OFF;
+	}
 	else
 	  mexErrMsgTxt("Unrecognized option.");
 	return;
@@ -592,7 +955,7 @@ void mexFunction(int nlhs, mxArray *plhs[],
   
   if (nrhs < 10) 
     mexErrMsgTxt("Not enough input arguments provided.");
-  if (nlhs > 2)
+  if (nlhs > 3)
     mexErrMsgTxt("Too many output arguments.");
   
   if (firstcall) {  /* attempt to load wisdom file on first call */
@@ -654,18 +1017,6 @@ void mexFunction(int nlhs, mxArray *plhs[],
   plhs[0] = mxCreateDoubleMatrix(nt,1,mxCOMPLEX);
   plhs[1] = mxCreateDoubleMatrix(nt,1,mxCOMPLEX);
   
-  /* fftw3 plans */
-  p1a = MAKE_PLAN(nt, u0a, uafft, FFTW_FORWARD, method);
-  p1b = MAKE_PLAN(nt, u0b, ubfft, FFTW_FORWARD, method);
-  ip1a = MAKE_PLAN(nt, uahalf, uahalf, FFTW_BACKWARD, method);
-  ip1b = MAKE_PLAN(nt, ubhalf, ubhalf, FFTW_BACKWARD, method);
-  p2a = MAKE_PLAN(nt, uva, uva, FFTW_FORWARD, method);
-  p2b = MAKE_PLAN(nt, uvb, uvb, FFTW_FORWARD, method);
-  ip2a = MAKE_PLAN(nt, uafft, uva, FFTW_BACKWARD, method);
-  ip2b = MAKE_PLAN(nt, ubfft, uvb, FFTW_BACKWARD, method);
-
-  allocated = 1;
-  
   /* Compute vector of angular frequency components
    * MATLAB equivalent:  w = wspace(tv); */
   compute_w(w,dt,nt);
@@ -675,113 +1026,206 @@ void mexFunction(int nlhs, mxArray *plhs[],
    * hb = exp[(-alphab(w)/2 - j*betab(w))*dz/2]) 
    * prhs[5]=alphaa  prhs[6]=alphab  prhs[7]=betaa  prhs[8]=betab */
   compute_hahb(ha,hb,prhs[5],prhs[6],prhs[7],prhs[8],w,dz,nt);
+
+  /* Compute H matrix for the circular method (see below) */
+  if (!elliptical)
+    compute_H(h11,h12,h21,h22,ha,hb,chi,psi,nt);
+
+  /* Design the FIR filters of the linear half-step and decide between
+   * FIR and FFT linear steps with the cost model.  The weight of the
+   * design is flat: the error is bounded on the whole frequency grid,
+   * not only on the spectrum of the input field, which the nonlinearity
+   * broadens along the propagation.  In automatic mode only filters
+   * shorter than the break-even length of the cost model are
+   * considered. */
+  if (firmode != FIRMODE_OFF) {
+    W = (REAL*) mxMalloc(sizeof(REAL)*nt);
+    ibd = MAKE_PLAN(nt, uahalf, uahalf, FFTW_BACKWARD, FFTW_ESTIMATE);
+    fe = MAKE_PLAN(nt, uva, uva, FFTW_FORWARD, FFTW_ESTIMATE);
+
+    /* W = 1, c = fft(W) kept in ubhalf */
+    for (jj = 0; jj < nt; jj++) {
+      W[jj] = 1;
+      ubhalf[jj][0] = ubhalf[jj][1] = 0;
+    }
+    ubhalf[0][0] = nt;
+
+    /* the errors of the 2*nz half-steps add up (at most) linearly */
+    firtol = tol/(2*(nz > 0 ? nz : 1));
+
+    nfilt = 1;
+    if (!elliptical)
+      for (jj = 0; jj < nt; jj++)
+        if (abs2(&h12[jj]) > 0 || abs2(&h21[jj]) > 0) {
+          nfilt = 2;
+          break;
+        }
+
+    kmax = (FIR_MAXTAPS-1)/2;
+    if (2*kmax+1 > nt)
+      kmax = (nt-1)/2;
+    if (firmode == FIRMODE_AUTO)
+      while (kmax >= 0 && fir_cost_ratio(kmax,nt,nfilt) >= 1)
+        kmax--;
+
+    if (kmax >= 0) {
+      if (elliptical) {
+        fir_design(&f11,ha,W,ubhalf,uahalf,uva,ibd,fe,kmax,firtol,nt);
+        fir_design(&f22,hb,W,ubhalf,uahalf,uva,ibd,fe,kmax,firtol,nt);
+        f12.zero = f21.zero = 1;
+        f12.hr = f12.hi = f21.hr = f21.hi = NULL;
+        f12.K = f21.K = 0;
+      }
+      else {
+        fir_design(&f11,h11,W,ubhalf,uahalf,uva,ibd,fe,kmax,firtol,nt);
+        fir_design(&f12,h12,W,ubhalf,uahalf,uva,ibd,fe,kmax,firtol,nt);
+        fir_design(&f21,h21,W,ubhalf,uahalf,uva,ibd,fe,kmax,firtol,nt);
+        fir_design(&f22,h22,W,ubhalf,uahalf,uva,ibd,fe,kmax,firtol,nt);
+        pf12 = &f12;
+        pf21 = &f21;
+      }
+      K = 0;
+      if (!f11.zero && f11.K > K) K = f11.K;
+      if (!f12.zero && f12.K > K) K = f12.K;
+      if (!f21.zero && f21.K > K) K = f21.K;
+      if (!f22.zero && f22.K > K) K = f22.K;
+
+      if (K < FIR_MAXTAPS) {
+        fircost = fir_cost_ratio(K,nt,nfilt);
+        usefir = 1;
+      }
+    }
+    else {
+      K = FIR_MAXTAPS;
+      f11.hr = f12.hr = f21.hr = f22.hr = NULL;
+    }
+
+    DESTROY_PLAN(ibd);
+    DESTROY_PLAN(fe);
+    mxFree(W);
+  }
+
+  if (!usefir) {
+    /* fftw3 plans */
+    p1a = MAKE_PLAN(nt, u0a, uafft, FFTW_FORWARD, method);
+    p1b = MAKE_PLAN(nt, u0b, ubfft, FFTW_FORWARD, method);
+    ip1a = MAKE_PLAN(nt, uahalf, uahalf, FFTW_BACKWARD, method);
+    ip1b = MAKE_PLAN(nt, ubhalf, ubhalf, FFTW_BACKWARD, method);
+    p2a = MAKE_PLAN(nt, uva, uva, FFTW_FORWARD, method);
+    p2b = MAKE_PLAN(nt, uvb, uvb, FFTW_FORWARD, method);
+    ip2a = MAKE_PLAN(nt, uafft, uva, FFTW_BACKWARD, method);
+    ip2b = MAKE_PLAN(nt, ubfft, uvb, FFTW_BACKWARD, method);
+  }
+
+  allocated = 1;
   
   mexPrintf("Performing split-step iterations ... ");
   
-  if (elliptical) { /* Elliptical Method */
-    
-    /* Rotate to eignestates of fiber 
-     *   u0a = ( cos(psi)*cos(chi) - j*sin(psi)*sin(chi))*u0x + ...
-     *         ( sin(psi)*cos(chi) + j*cos(psi)*sin(chi))*u0y;
-     *   u0b = (-sin(psi)*cos(chi) + j*cos(psi)*sin(chi))*u0x + ...
-     *         ( cos(psi)*cos(chi) + j*sin(psi)*sin(chi))*u0y;
-     */
-    rotate_coord(u0a,u0b,prhs[0],prhs[1],chi,psi,nt);
-      
-    cscale(u1a,u0a,u1b,u0b,1.0,nt); /* u1a=u0a  u1b=u0b */
-    
-    EXECUTE(p1a);  /* uafft = fft(u0a) */
-    EXECUTE(p1b);  /* ubfft = fft(u0b) */
-    
+  /* Circular method: the propagation basis is fixed to chi = pi/4,
+   * psi = 0 (the fiber eigenstates enter through the H matrix)
+   *   u0a = (1/sqrt(2)).*(u0x + j*u0y);
+   *   u0b = (1/sqrt(2)).*(j*u0x + u0y); */
+  if (!elliptical) {
+    chi = pi/4;
+    psi = 0;
+  }
+
+  /* Select the step kernels once for the whole propagation */
+  nonlinear = select_nonlinear(chi,&cself,&ccross);
+
+  /* Rotate to eignestates of fiber 
+   *   u0a = ( cos(psi)*cos(chi) - j*sin(psi)*sin(chi))*u0x + ...
+   *         ( sin(psi)*cos(chi) + j*cos(psi)*sin(chi))*u0y;
+   *   u0b = (-sin(psi)*cos(chi) + j*cos(psi)*sin(chi))*u0x + ...
+   *         ( cos(psi)*cos(chi) + j*sin(psi)*sin(chi))*u0y;
+   */
+  rotate_coord(u0a,u0b,prhs[0],prhs[1],chi,psi,nt);
+
+  cscale(u1a,u0a,u1b,u0b,1.0,nt); /* u1a=u0a  u1b=u0b */
+
+  if (usefir) { /* FIR linear steps, either method */
+
+    wk.xra = (REAL*) mxMalloc(sizeof(REAL)*(nt+2*K));
+    wk.xia = (REAL*) mxMalloc(sizeof(REAL)*(nt+2*K));
+    wk.xrb = (REAL*) mxMalloc(sizeof(REAL)*(nt+2*K));
+    wk.xib = (REAL*) mxMalloc(sizeof(REAL)*(nt+2*K));
+    wk.yra = (REAL*) mxMalloc(sizeof(REAL)*nt);
+    wk.yia = (REAL*) mxMalloc(sizeof(REAL)*nt);
+    wk.yrb = (REAL*) mxMalloc(sizeof(REAL)*nt);
+    wk.yib = (REAL*) mxMalloc(sizeof(REAL)*nt);
+
     for(iz=1; iz <= nz; iz++)
     {
       /* Linear propagation (1st half):
-       * uahalf = ha .* uafft
-       * ubhalf = hb .* ubfft */
-      prop_linear_ellipt(uahalf,ubhalf,ha,hb,uafft,ubfft,nt);
-      
-      EXECUTE(ip1a);  /* uahalf = ifft(uahalf) */
-      EXECUTE(ip1b);  /* ubhalf = ifft(ubhalf) */
-      
-      /* uahalf=uahalf/nt  ubhalf=ubhalf/nt */
-      cscale(uahalf,uahalf,ubhalf,ubhalf,1.0/nt,nt);
-  
+       * uahalf = h11 * u0a + h12 * u0b
+       * ubhalf = h21 * u0a + h22 * u0b */
+      prop_linear_fir(uahalf,ubhalf,&f11,pf12,pf21,&f22,u0a,u0b,1.0,&wk,nt);
+
       ii = 0;
       do
       {
         /* Calculate nonlinear section: output=uva,uvb */
-        nonlinear_propagate(uva,uvb,uahalf,ubhalf,u0a,u0b,u1a,u1b,
-                            gamma,dz,chi,nt);
-        
-      
-        EXECUTE(p2a);  /* uva = fft(uva) */
-        EXECUTE(p2b);  /* uvb = fft(uvb) */
-      
-        /* Linear propagation (2nd half):
-         * uafft = ha .* uva
-         * ubfft = hb .* uvb */
-         prop_linear_ellipt(uafft,ubfft,ha,hb,uva,uvb,nt);
-     
-        EXECUTE(ip2a);  /* uva = ifft(uafft) */
-        EXECUTE(ip2b);  /* uvb = ifft(ubfft) */
-        
-        /* Check if uva & u1a  and  uvb & u1b converged 
-         * converged = ( ( sqrt(norm(uva-u1a,2).^2+norm(uvb-u1b,2).^2) /...
-         *                 sqrt(norm(u1a,2).^2+norm(u1b,2).^2) ) < tol )
-         */
+        nonlinear(uva,uvb,uahalf,ubhalf,u0a,u0b,u1a,u1b,
+                  (REAL) ((1.0/3.0)*gamma*dz),cself,ccross,nt);
+
+        /* Linear propagation (2nd half), scaled by nt like the
+         * unnormalized inverse FFT of the FFT path:
+         * uva = nt*(h11 * uva + h12 * uvb)
+         * uvb = nt*(h21 * uva + h22 * uvb) */
+        prop_linear_fir(uva,uvb,&f11,pf12,pf21,&f22,uva,uvb,(REAL) nt,&wk,nt);
+
         converged = is_converged(uva,u1a,uvb,u1b,tol,nt);
-      
+
         /* u1a=uva/nt  u1b=uvb/nt */
         cscale(u1a,uva,u1b,uvb,1.0/nt,nt);
-      
+
         ii++;
       } while(!converged && ii < maxiter);  /* end convergence loop */
-    
+
       if(ii == maxiter)
         mexPrintf("Warning: Failed to converge to %f in %d iterations\n",
                   tol,maxiter);
-    
+
       /* u0a=u1a  u0b=u1b */
       cscale(u0a,u1a,u0b,u1b,1.0,nt);
 
     } /* end step loop */
-    
-    /* Rotate back to original x-y basis
-     *  u1x = ( cos(psi)*cos(chi) + j*sin(psi)*sin(chi))*u1a + ...
-     *        (-sin(psi)*cos(chi) - j*cos(psi)*sin(chi))*u1b;
-     *  u1y = ( sin(psi)*cos(chi) - j*cos(psi)*sin(chi))*u1a + ...
-     *        ( cos(psi)*cos(chi) - j*sin(psi)*sin(chi))*u1b;
-     */
-    inv_rotate_coord(plhs[0],plhs[1],u1a,u1b,chi,psi,nt);
-    
-  } 
-  else {  /* Circular method */ 
-    
-    /* Compute H matrix = [ h11 h12 
-     *                      h21 h22 ] for linear propagation
+
+    mxFree(wk.xra);
+    mxFree(wk.xia);
+    mxFree(wk.xrb);
+    mxFree(wk.xib);
+    mxFree(wk.yra);
+    mxFree(wk.yia);
+    mxFree(wk.yrb);
+    mxFree(wk.yib);
+
+  }
+  else { /* FFT linear steps, either method */
+
+    /* H matrix = [ h11 h12 
+     *              h21 h22 ] for linear propagation (circular method,
+     * computed above)
      *   h11 = ( (1+sin(2*chi))*ha + (1-sin(2*chi))*hb )/2;
      *   h12 = -j*exp(+j*2*psi)*cos(2*chi)*(ha-hb)/2;
      *   h21 = +j*exp(-j*2*psi)*cos(2*chi)*(ha-hb)/2;
      *   h22 = ( (1-sin(2*chi))*ha + (1+sin(2*chi))*hb )/2;
      */
-    compute_H(h11,h12,h21,h22,ha,hb,chi,psi,nt);
-      
-    /* Rotate to circular coordinate system 
-     *   u0a = (1/sqrt(2)).*(u0x + j*u0y);
-     *   u0b = (1/sqrt(2)).*(j*u0x + u0y); */
-    rotate_coord(u0a,u0b,prhs[0],prhs[1],pi/4,0,nt);
-      
-    cscale(u1a,u0a,u1b,u0b,1.0,nt); /* u1a=u0a  u1b=u0b */
-    
+
     EXECUTE(p1a);  /* uafft = fft(u0a) */
     EXECUTE(p1b);  /* ubfft = fft(u0b) */
-      
+    
     for(iz=1; iz <= nz; iz++)
     {
       /* Linear propagation (1st half):
-       * uahalf = h11 .* uafft + h12 .* ubfft
+       * uahalf = ha .* uafft                 (elliptical)
+       * ubhalf = hb .* ubfft
+       * uahalf = h11 .* uafft + h12 .* ubfft (circular)
        * ubhalf = h21 .* uafft + h22 .* ubfft */
-      prop_linear_circ(uahalf,ubhalf,h11,h12,h21,h22,uafft,ubfft,nt);
+      if (elliptical)
+        prop_linear_ellipt(uahalf,ubhalf,ha,hb,uafft,ubfft,nt);
+      else
+        prop_linear_circ(uahalf,ubhalf,h11,h12,h21,h22,uafft,ubfft,nt);
       
       EXECUTE(ip1a);  /* uahalf = ifft(uahalf) */
       EXECUTE(ip1b);  /* ubhalf = ifft(ubhalf) */
@@ -793,23 +1237,28 @@ void mexFunction(int nlhs, mxArray *plhs[],
       do
       {
         /* Calculate nonlinear section: output=uva,uvb */
-         nonlinear_propagate(uva,uvb,uahalf,ubhalf,u0a,u0b,u1a,u1b,
-                             gamma,dz,pi/4,nt);
+        nonlinear(uva,uvb,uahalf,ubhalf,u0a,u0b,u1a,u1b,
+                  (REAL) ((1.0/3.0)*gamma*dz),cself,ccross,nt);
       
         EXECUTE(p2a);  /* uva = fft(uva) */
         EXECUTE(p2b);  /* uvb = fft(uvb) */
       
         /* Linear propagation (2nd half):
-         * uafft = h11 .* uva + h12 .* uvb
+         * uafft = ha .* uva                  (elliptical)
+         * ubfft = hb .* uvb
+         * uafft = h11 .* uva + h12 .* uvb    (circular)
          * ubfft = h21 .* uva + h22 .* uvb */
-        prop_linear_circ(uafft,ubfft,h11,h12,h21,h22,uva,uvb,nt);
+        if (elliptical)
+          prop_linear_ellipt(uafft,ubfft,ha,hb,uva,uvb,nt);
+        else
+          prop_linear_circ(uafft,ubfft,h11,h12,h21,h22,uva,uvb,nt);
      
         EXECUTE(ip2a);  /* uva = ifft(uafft) */
         EXECUTE(ip2b);  /* uvb = ifft(ubfft) */
-      
+        
         /* Check if uva & u1a  and  uvb & u1b converged 
-         *   ( sqrt(norm(uva-u1a,2).^2+norm(uvb-u1b,2).^2) /...
-         *     sqrt(norm(u1a,2).^2+norm(u1b,2).^2) ) < tol
+         * converged = ( ( sqrt(norm(uva-u1a,2).^2+norm(uvb-u1b,2).^2) /...
+         *                 sqrt(norm(u1a,2).^2+norm(u1b,2).^2) ) < tol )
          */
         converged = is_converged(uva,u1a,uvb,u1b,tol,nt);
       
@@ -827,27 +1276,49 @@ void mexFunction(int nlhs, mxArray *plhs[],
       cscale(u0a,u1a,u0b,u1b,1.0,nt);
 
     } /* end step loop */
-    
-    /* Rotate back to orignal x-y basis
-     *   u1x = (1/sqrt(2)).*(u1a-j*u1b) ;
-     *   u1y = (1/sqrt(2)).*(-j*u1a+u1b) ; */
-    inv_rotate_coord(plhs[0],plhs[1],u1a,u1b,pi/4,0,nt);
-    
-  } /* end circular method */      
+
+  } /* end FFT linear steps */
+
+  /* Rotate back to original x-y basis
+   *  u1x = ( cos(psi)*cos(chi) + j*sin(psi)*sin(chi))*u1a + ...
+   *        (-sin(psi)*cos(chi) - j*cos(psi)*sin(chi))*u1b;
+   *  u1y = ( sin(psi)*cos(chi) - j*cos(psi)*sin(chi))*u1a + ...
+   *        ( cos(psi)*cos(chi) - j*sin(psi)*sin(chi))*u1b;
+   * (circular: u1x = (1/sqrt(2)).*(u1a-j*u1b);
+   *            u1y = (1/sqrt(2)).*(-j*u1a+u1b); )
+   */
+  inv_rotate_coord(plhs[0],plhs[1],u1a,u1b,chi,psi,nt);
   
 
   mexPrintf("done.\n");
 
+  if (nlhs > 2) { /* info = struct('fir',usefir,'taps',2*K+1,'cost',fircost) */
+    plhs[2] = mxCreateStructMatrix(1,1,3,infonames);
+    mxSetField(plhs[2],0,"fir",mxCreateDoubleScalar(usefir));
+    mxSetField(plhs[2],0,"taps",mxCreateDoubleScalar(
+                 firmode != FIRMODE_OFF && K < FIR_MAXTAPS ? 2*K+1 : 0));
+    mxSetField(plhs[2],0,"cost",mxCreateDoubleScalar(fircost));
+  }
+
+  if (firmode != FIRMODE_OFF) {
+    if (f11.hr) { mxFree(f11.hr); mxFree(f11.hi); }
+    if (f12.hr) { mxFree(f12.hr); mxFree(f12.hi); }
+    if (f21.hr) { mxFree(f21.hr); mxFree(f21.hi); }
+    if (f22.hr) { mxFree(f22.hr); mxFree(f22.hi); }
+  }
+
   if (allocated) {
-    /* destroy fftw3 plans */
-    DESTROY_PLAN(p1a);
-    DESTROY_PLAN(p1b);
-    DESTROY_PLAN(ip1a);
-    DESTROY_PLAN(ip1b);
-    DESTROY_PLAN(p2a);
-    DESTROY_PLAN(p2b);
-    DESTROY_PLAN(ip2a);
-    DESTROY_PLAN(ip2b);
+    if (!usefir) {
+      /* destroy fftw3 plans */
+      DESTROY_PLAN(p1a);
+      DESTROY_PLAN(p1b);
+      DESTROY_PLAN(ip1a);
+      DESTROY_PLAN(ip1b);
+      DESTROY_PLAN(p2a);
+      DESTROY_PLAN(p2b);
+      DESTROY_PLAN(ip2a);
+      DESTROY_PLAN(ip2b);
+    }
 
     /* de-allocate memory */
     mxFree(u0a);
@@ -55,6 +55,27 @@
 %> demodulated_signal = demodulator.traverse(received_signal);
 %> @endcode
 %>
+%> Independent branches of a module (e.g. the channels of a WDM transmitter
+%> or the polarizations after a splitter) can be traversed at the same time
+%> on the workers of the parallel pool by setting maxInFlight, or the
+%> preference used by all the modules:
+%> @code
+%> setpref('robochameleon', 'maxInFlight', 8);
+%> @endcode
+%> A unit is started as soon as all the units it depends on are done, at
+%> most maxInFlight at a time. The outputs are passed and the input buffers
+%> released as in the sequential traverse, and the public properties of the
+%> units (e.g. results) are copied back from the workers. Modules, units
+%> with clientTraverse set (e.g. displays) and units with properties that
+%> cannot be set from outside the class (their state could not be copied
+%> back) are traversed in the client, and no figures are drawn by the
+%> workers. Each unit draws from the global random number generator seeded
+%> with its own seed, drawn from the client generator at the start of the
+%> traverse: a run is reproduced by rng(seed) in the client, whatever the
+%> order in which the units finish, but units using the global generator
+%> get other draws than in the sequential traverse, which stays the
+%> default.
+%>
 %> @see unit
 %>
 %> @author Robert Borkowski
@@ -89,6 +110,13 @@ classdef module < unit
         outputBuffer; % initialized to be a sink with obj.nOutputs inputs
     end
     
+    properties (GetAccess=public,SetAccess=public)
+        %> Maximum number of internal units traversed at the same time on the
+        %> parallel pool, 0 to traverse them sequentially. Empty to use the
+        %> preference robochameleon.maxInFlight (0 if not set). [Default: []]
+        maxInFlight = [];
+    end
+    
     methods (Access=private)
         
         %> @brief Determine order in which to traverse units
@@ -124,6 +152,125 @@ classdef module < unit
             obj.traversingOrder = graphtopoorder(sparse(dg)); % Doesn't work for one vertex
         end    
 
+        %> @brief Traverse the internal units on the parallel pool
+        %>
+        %> Units whose predecessors in the graph are done are started in
+        %> the order of traversingOrder, on the workers (parfeval) or in the
+        %> client, with at most maxInFlight units on the workers. The seeds
+        %> of the units are drawn from the client generator beforehand, in
+        %> the order of the units, so they do not depend on the timing.
+        %>
+        %> @param maxInFlight maximum number of units on the workers
+        function traverseParallel(obj, maxInFlight)
+            dg = obj.biograph_struct.dg;
+            N = numel(obj.internalUnits);
+            generator = rng;
+            seeds = randi([0 2^32-1], 1, N);
+            nPending = full(sum(dg,1)); % Unfinished predecessors of each unit
+            started = false(1,N);
+            done = false(1,N);
+            debugMode = ispref('robochameleon','debugMode') && getpref('robochameleon','debugMode');
+            pool = gcp;
+            futures = parallel.FevalFuture.empty;
+            running = zeros(1,0); % Unit of each future
+            while ~all(done)
+                for i=obj.traversingOrder
+                    if started(i) || nPending(i)>0
+                        continue
+                    end
+                    u = obj.internalUnits{i};
+                    if inherits_from(u,'module') || u.clientTraverse || ~module.isCopyable(u)
+                        started(i) = true;
+                        % Own seed too: the order of the client units depends on the timing
+                        rng(seeds(i), generator.Type);
+                        traverseNode(u);
+                        done(i) = true;
+                        nPending = nPending - dg(i,:);
+                    elseif numel(running) < maxInFlight
+                        started(i) = true;
+                        % Send the unit without the rest of the graph
+                        nextNodes = u.nextNodes;
+                        u.nextNodes = {};
+                        futures(end+1) = parfeval(pool, @module.processInputsCopy, 2, u, seeds(i), generator.Type); %#ok<AGROW>
+                        u.nextNodes = nextNodes;
+                        running(end+1) = i; %#ok<AGROW>
+                        if ~debugMode
+                            u.inputBuffer = {}; % Released as in processInputs
+                        end
+                    end
+                end
+                if isempty(running)
+                    if ~all(done)
+                        robolog('Units %s cannot be traversed. Is it a DAG?', 'ERR', strjoin(cellfun(@(u)u.label, obj.internalUnits(~done), 'UniformOutput', false), ', '));
+                    end
+                    break
+                end
+                % Wait for a unit on the workers
+                try
+                    [k, outputs, u] = fetchNext(futures);
+                catch e
+                    cancel(futures);
+                    robolog('Traversing on the parallel pool failed: %s', 'ERR', e.message);
+                end
+                i = running(k);
+                futures(k) = [];
+                running(k) = [];
+                module.copyUnitState(obj.internalUnits{i}, u);
+                writeOutputs(obj.internalUnits{i}, outputs);
+                done(i) = true;
+                nPending = nPending - dg(i,:);
+            end
+        end
+    end
+    
+    methods (Static, Hidden)
+        
+        %> @brief processInputs of a unit copied to a worker, without figures
+        %>
+        %> @param u the unit
+        %> @param seed seed of the global random number generator
+        %> @param type generator type of the client
+        %>
+        %> @retval outputs cell array of output signals
+        %> @retval u the unit after traverse
+        function [outputs, u] = processInputsCopy(u, seed, type)
+            rng(seed, type);
+            u.draw = false;
+            outputs = processInputs(u);
+        end
+
+        %> @brief True if the state of a unit can be copied back from a worker
+        %>
+        %> The properties defined by the unit classes must be settable from
+        %> outside (public SetAccess), constant, dependent or transient.
+        function tf = isCopyable(u)
+            props = metaclass(u).PropertyList;
+            for j=1:numel(props)
+                p = props(j);
+                if p.Dependent || p.Constant || p.Transient || any(strcmp(p.DefiningClass.Name, {'unit', 'module'}))
+                    continue
+                end
+                if ~ischar(p.SetAccess) || ~strcmp(p.SetAccess, 'public')
+                    tf = false;
+                    return
+                end
+            end
+            tf = true;
+        end
+        
+        %> @brief Copy the public properties of a unit returned by a worker
+        function copyUnitState(dst, src)
+            skip = {'draw', 'inputBuffer', 'nextNodes', 'destInputs', 'ID', 'clientTraverse'};
+            props = metaclass(src).PropertyList;
+            for j=1:numel(props)
+                p = props(j);
+                if p.Dependent || p.Constant || ~ischar(p.SetAccess) || ~strcmp(p.SetAccess, 'public') ...
+                        || any(strcmp(p.Name, skip))
+                    continue
+                end
+                dst.(p.Name) = src.(p.Name);
+            end
+        end
     end
     
     
@@ -223,6 +370,11 @@ classdef module < unit
         %>
         %> @param varargin input signal
         function varargout = traverse(obj,varargin)
+            profiling = roboProfiler.enabled();
+            if profiling
+                depth = roboProfiler.enter(obj, varargin);
+                unwind = onCleanup(@()roboProfiler.unwind(depth)); %#ok<NASGU>
+            end
             % Rewrite internal buffers to appropriate objects
             for i=1:obj.nInputs
                 %FIXME when there's only one obj.destInternalUnits it must
@@ -238,10 +390,24 @@ classdef module < unit
                 end
             end
 
-            for i=obj.traversingOrder
-                traverseNode(obj.internalUnits{i});
-            end            
+            maxInFlight = obj.maxInFlight;
+            if isempty(maxInFlight)
+                maxInFlight = 0;
+                if ispref('robochameleon','maxInFlight')
+                    maxInFlight = getpref('robochameleon','maxInFlight');
+                end
+            end
+            if maxInFlight > 0 && numel(obj.internalUnits) > 1 && ~isempty(ver('distcomp'))
+                traverseParallel(obj, maxInFlight);
+            else
+                for i=obj.traversingOrder
+                    traverseNode(obj.internalUnits{i});
+                end
+            end
             [varargout{1:obj.nOutputs}] = readBuffer(obj.outputBuffer);
+            if profiling
+                roboProfiler.leave(varargout);
+            end
         end        
     end
     
@@ -40,6 +40,19 @@
 %> calculated numerically from the waveform.
 %> @see pwr, getPColFromNumeric_v1
 %>
+%> __Signals on disk__
+%> A signal_interface can be constructed over a signal file (sigfile)
+%> instead of a waveform. The parameters are then taken from the file
+%> (unless given) and the waveform is read from disk when needed: indexing
+%> the signal, e.g. sig(rows, :) for chunk by chunk processing, reads the
+%> selected samples only. Methods returning a new waveform (fun1, set, ...)
+%> return a signal in memory.
+%> @code
+%> sig = signal_interface(sigfile('capture.rsig'));
+%> first = sig(1:1e6, :);
+%> @endcode
+%> @see sigfile
+%>
 %> __Example__
 %> @code
 %> s1= rand(10,1);
@@ -70,7 +83,8 @@ classdef signal_interface
     end
 
     properties (SetAccess=protected,Hidden=true)
-        %> Complex baseband LxN (L = length, N = number of components)
+        %> Complex baseband LxN (L = length, N = number of components),
+        %> or the sigfile holding it
         E;
     end
 
@@ -90,11 +104,26 @@ classdef signal_interface
         %> precedence if both are specified).
         %> In case power is not specified, a warning will be displayed, and
         %> the total signal power will be calculated from the waveform.
+        %> s1 can also be a sigfile, whose parameters are used when param
+        %> does not give them.
         function obj = signal_interface(signal,param)
+            if nargin<2
+                param = struct();
+            end
+            if isa(signal,'sigfile')
+                fileparam = struct('Fs', signal.Fs, 'Rs', signal.Rs, 'Fc', signal.Fc, 'PCol', signal.PCol);
+                if isfield(param,'P') || isfield(param,'PCol')
+                    fileparam = rmfield(fileparam,'PCol');
+                end
+                f = fieldnames(fileparam);
+                for i=1:numel(f)
+                    if ~isfield(param,f{i}), param.(f{i}) = fileparam.(f{i}); end
+                end
+            end
             if isfield(param,'Fc') && isscalar(param.Fc), obj.Fc = param.Fc; else obj.Fc = 1; end
             if isfield(param,'Fs') && isscalar(param.Fs), obj.Fs = param.Fs; else robolog('Sampling frequency must be specified','ERR'); end
             if isfield(param,'Rs') && isscalar(param.Rs), obj.Rs = param.Rs; else obj.Rs = 1; end
-            if isvector(signal)
+            if ~isa(signal,'sigfile') && isvector(signal)
                 signal = signal(:);
             end
             obj.E = signal;
@@ -116,7 +145,7 @@ classdef signal_interface
                     robolog('Power cannot be an array of "pwr" object. Use PCol instead.','ERR');
                 end
                 obj.P = param.P;
-                avpow = pwr.meanpwr(signal);
+                avpow = rawPower(obj);
                 pwrfraction = avpow/sum(avpow);
                 obj.PCol = repmat(obj.P, obj.N, 1).*pwrfraction;
             else
@@ -125,7 +154,7 @@ classdef signal_interface
                 robolog('    signal = signal_interface(waveform, struct(''P'', pwr(SNR, Ptot), ...);', 'NFO0');
                 robolog('  where SNR is in dB and Ptot is in dBm', 'NFO0');
                 robolog('  See signal_interface and pwr documentation for more options', 'NFO0');
-                avpow = pwr.meanpwr(signal);
+                avpow = rawPower(obj);
                 obj.PCol = pwr(inf, {avpow(1),'W'});
                 for jj=2:obj.N
                     obj.PCol(jj) = pwr(inf, {avpow(jj),'W'});
@@ -198,6 +227,33 @@ classdef signal_interface
             obj.PCol = PCol_new;
             obj.P = setPtot(obj);
         end
+        
+        %> @brief Apply a column-wise function to all the columns at once
+        %>
+        %> Like fun1, but the function is called once with the whole
+        %> L-by-N field, so it must operate on each column independently
+        %> (e.g. fft, filter, or a native kernel processing all the
+        %> columns together). Changes in power are tracked as in fun1.
+        %>
+        %> @code
+        %> filtered = funCols(signal, @(X)ifft(bsxfun(@times, fft(X), H)));
+        %> @endcode
+        function obj = funCols(obj,fun)
+            obj.enforceLhs(nargout);
+            s = fun(get(obj));
+            if size(s,2)~=obj.N
+                robolog('The output of funCols must have one column per signal component.','ERR');
+            end
+            obj.E = s;
+            % Compute new power.
+            % WARNING: SNR is not updated
+            Pout = pwr.meanpwr(obj.getRaw);
+            for i=1:length(obj.PCol)
+                PCol_new(i) = pwr(obj.PCol(i).SNR, {Pout(i), 'W'});
+            end
+            obj.PCol = PCol_new;
+            obj.P = setPtot(obj);
+        end
 
         %> @brief Returns signal parameters in a struct
         %>
@@ -312,6 +368,14 @@ classdef signal_interface
                     % called
                     % length(s) <= 2 seems unuseful. Can be removed?
                     if length(s) <= 2 && length(obj) == 1
+                        if numel(s(1).subs) == 2 && isa(obj.E,'sigfile')
+                            % Read the selected samples only
+                            sref = getScaled(obj, s(1).subs{:});
+                            if length(s) == 2
+                                sref = builtin('subsref',sref,s(2));
+                            end
+                            return
+                        end
                         EScaled = obj.get;
                         sref = builtin('subsref',EScaled,s);
                         return
@@ -330,20 +394,47 @@ classdef signal_interface
         end
 
         %> @brief Retrieve raw waveform.  Use with caution.
-        function s = getRaw(obj)
-            s = obj.E;
+        %>
+        %> @param rows Samples [Default: all]
+        %> @param cols Columns [Default: all]
+        function s = getRaw(obj,rows,cols)
+            if nargin<2, rows = ':'; end
+            if nargin<3, cols = ':'; end
+            if isa(obj.E,'sigfile')
+                s = read(obj.E,rows,cols);
+            elseif nargin>1
+                s = obj.E(rows,cols);
+            else
+                s = obj.E;
+            end
+        end
+
+        %> @brief True if the waveform is kept in a signal file
+        function tf = isMapped(obj)
+            tf = isa(obj.E,'sigfile');
         end
 
         %> @brief Retrieve the signal with appropriate power scaling
         %>
         %> Retrieve the signal with appropriate power scaling.  Scaling is
         %> applied based on the per-column signal power
-        function s = getScaled(obj)
+        %>
+        %> @param rows Samples [Default: all]
+        %> @param cols Columns [Default: all]
+        function s = getScaled(obj,rows,cols)
             % Modified by Robert to include power scaling (28.08.2014).
-            s = obj.E;
-            Pin = pwr.meanpwr(s);
-            for jj=1:obj.N
-                Pout(jj) = obj.PCol(jj).Ptot('W');
+            if nargin<2, rows = ':'; end
+            if nargin<3, cols = ':'; end
+            if ischar(cols), cols = 1:obj.N; end
+            if nargin>1
+                s = getRaw(obj,rows,cols);
+            else
+                s = getRaw(obj);
+            end
+            Pin = rawPower(obj);
+            Pin = Pin(cols);
+            for jj=1:numel(cols)
+                Pout(jj) = obj.PCol(cols(jj)).Ptot('W');
             end
             if Pin ~=0
                 s = bsxfun(@times, s, sqrt(Pout./Pin));
@@ -371,7 +462,7 @@ classdef signal_interface
         %> Since we mostly use this for DSP, stored power is changed to
         %> track new value so that get returns desired, normalized field.
         function sigout=normalize(obj)
-            s = obj.E;
+            s = getRaw(obj);
             s = s/sqrt(mean(pwr.meanpwr(s)));
             sigout = set(obj, s);
         end
@@ -414,8 +505,7 @@ classdef signal_interface
         %> @brief Truncate signal length
         function obj = truncate(obj, L)
             obj.enforceLhs(nargout);
-            sig = get(obj);
-            obj = set(obj, sig(1:L, :));
+            obj = set(obj, getScaled(obj, 1:L, ':'));
         end
 
         %> @brief Combine multiple signals
@@ -437,7 +527,7 @@ classdef signal_interface
         function disp(obj)
             % Overload display function (for easy viewing in the console and
             % debugger)
-            if isreal(get(obj))
+            if isreal(obj.E)
                 txt_sig = 'Real';
             else
                 txt_sig = 'Complex';
@@ -536,6 +626,19 @@ classdef signal_interface
 
     end
 
+    methods (Access=private)
+
+        %> @brief Mean power of each column of the raw waveform
+        function P = rawPower(obj)
+            if isa(obj.E,'sigfile')
+                P = obj.E.Praw;
+            else
+                P = pwr.meanpwr(obj.E);
+            end
+        end
+
+    end
+
     methods (Access=private,Hidden,Static)
 
         function enforceLhs(n,minimum)
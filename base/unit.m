@@ -46,6 +46,15 @@ classdef unit < handle
         ID;
     end
     
+    properties (GetAccess=public,SetAccess=public,Hidden)
+        %> Traverse in the MATLAB client when the module runs its units in
+        %> parallel (units with figures or other side effects, see module.maxInFlight)
+        clientTraverse = false;
+        %> Look up the outputs in the traverse cache before traversing
+        %> (see traverseCache)
+        cacheTraverse = false;
+    end
+    
     properties (Abstract=true,Hidden=true)
         %> Number of signals traverse expects
         nInputs; 
@@ -75,14 +84,23 @@ classdef unit < handle
         %> unit on input signal(s).
         %>
         function traverseNode(obj)
+            writeOutputs(obj, processInputs(obj));
+        end
+        
+        %> @brief Traverse the unit on the signals of its input buffer
+        %>
+        %> First half of traverseNode: checks the inputs, runs traverse (or
+        %> reads its outputs from the traverse cache if cacheTraverse is set)
+        %> and releases the input buffer. A module running its units in
+        %> parallel calls it on a copy of the unit in a worker.
+        %>
+        %> @retval outputs cell array of output signals
+        function outputs = processInputs(obj)
             robolog('Traversing ...');
-            %Check # of inputs and outputs
+            %Check # of inputs
             if obj.nInputs~=numel(obj.inputBuffer);
                 robolog('Number of connected inputs must be equal to the number of module inputs. %s has %d inputs; %d in were given', 'ERR', obj.label, obj.nInputs, numel(obj.inputBuffer));
             end
-            if obj.nOutputs~=numel(obj.nextNodes);
-                robolog('Number of outputs must be equal to the number of connected units. %s has %d outputs; %d destination units were specified', 'ERR', obj.label, obj.nOutputs, numel(obj.nextNodes));
-            end
             
             % Helper function with one argument. Checks if all elements of
             % a cell array are of class signal_interface
@@ -92,7 +110,23 @@ classdef unit < handle
             if ~areallsignalinterfaces(obj.inputBuffer)
                 robolog('The inputs are not ready yet. Incorrect topology ordering.', 'ERR');
             end
-            [outputs{1:obj.nOutputs}] = traverse(obj,obj.inputBuffer{:}); % Traverse the unit
+            profiling = roboProfiler.enabled() && ~isa(obj,'module'); % Modules are recorded by their traverse
+            if profiling
+                depth = roboProfiler.enter(obj, obj.inputBuffer);
+                unwind = onCleanup(@()roboProfiler.unwind(depth)); %#ok<NASGU>
+            end
+            useCache = obj.cacheTraverse && ~isempty(traverseCache.folder());
+            hit = false;
+            if useCache
+                key = traverseCache.key(obj);
+                [hit, outputs] = traverseCache.fetch(obj, key);
+            end
+            if ~hit
+                [outputs{1:obj.nOutputs}] = traverse(obj,obj.inputBuffer{:}); % Traverse the unit
+                if useCache
+                    traverseCache.store(obj, key, outputs);
+                end
+            end
             if(~ispref('robochameleon','debugMode') || ~getpref('robochameleon','debugMode'))
                 obj.inputBuffer = {}; % Remove processed inputs to save memory
             end
@@ -111,14 +145,26 @@ classdef unit < handle
                 %robolog('Size of the outputs cell is incorrect (expected vector with length %d, got %d).',obj.nOutputs,numel(outputs));
                 robolog('Size of the outputs cell has changed (expected vector with length %d, got %d).', 'WRN', obj.nOutputs,numel(outputs));
             end
-            
+            if profiling
+                roboProfiler.leave(outputs);
+            end
+        end
+        
+        %> @brief Pass the outputs of the unit to the connected units
+        %>
+        %> Second half of traverseNode.
+        %>
+        %> @param outputs cell array of output signals
+        function writeOutputs(obj, outputs)
+            if obj.nOutputs~=numel(obj.nextNodes);
+                robolog('Number of outputs must be equal to the number of connected units. %s has %d outputs; %d destination units were specified', 'ERR', obj.label, obj.nOutputs, numel(obj.nextNodes));
+            end
             % Find all connected outputs
             conn = find(cellfun(@(obj)inherits_from(obj,'unit'),obj.nextNodes));
             % Write all outputs to the inputBuffer of the connected units
             for i=conn
                 writeInputBuffer(obj.nextNodes{i},outputs{i},obj.destInputs(i));
             end
-        
         end
         
         %> @brief Specify where signal should go next
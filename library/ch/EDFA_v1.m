@@ -13,6 +13,12 @@
 %> The noise power is determined as Noise spectral density * Sampling frequency. For a complex baseband
 %> signal the sampling frequency corresponds to the "simulation" bandwidth.
 %>
+%> The ASE is generated with philoxRandn, a counter-based generator: the noise of a traverse is
+%> determined by (seed, noiseStream, number of the traverse, polarization), so it can be
+%> regenerated without storing it, and is the same for any number of threads. Give each amplifier
+%> of a link its own noiseStream (e.g. the span number). If no seed is set, a new one is drawn from
+%> MATLAB's global random number generator at each traverse.
+%>
 %> __Example:__
 %> @code
 %>   param.edfa.gain  = 16;
@@ -45,6 +51,19 @@ classdef EDFA_v1 < unit
         gain;
         %> EDFA noise figure [dB]
         NF = 3;
+        %> Seed of the ASE noise (empty: drawn from MATLAB's generator)
+        seed = [];
+        %> Noise stream of this amplifier
+        noiseStream = 0;
+        %> Use the native noise generator (philox_mex) if compiled
+        mexEnabled = true;
+        %> Number of threads of the native noise generator. 0: all processors
+        nThreads = 0;
+    end
+    
+    properties (Hidden=true)
+        %> Number of traverses so far (substream of the noise)
+        nTraversed = 0;
     end
     
     methods
@@ -55,6 +74,10 @@ classdef EDFA_v1 < unit
         %>
         %> @param param.gain     Gain [dB].
         %> @param param.NF       Noise figure [dB].
+        %> @param param.seed     Seed of the ASE noise, integer in [0, 2^32-1]. [Default: drawn at each traverse]
+        %> @param param.noiseStream  Noise stream of the amplifier, e.g. span number. [Default: 0]
+        %> @param param.mexEnabled   Use the native noise generator if compiled. [Default: true]
+        %> @param param.nThreads     Number of threads of the native noise generator. [Default: 0, all processors]
         function obj = EDFA_v1(param)
             obj.setparams(param);
         end
@@ -78,7 +101,14 @@ classdef EDFA_v1 < unit
                                                     % is near zero, can be approximated to negative number,
                                                     % so let's round it to zero.
             
-            noise = wgn(in.L, in.N, Pn, 'linear', 'complex');
+            if isempty(obj.seed)
+                seed = randi([0 2^32-1]);
+            else
+                seed = obj.seed;
+            end
+            noise = sqrt(Pn/2)*philoxRandn(in.L, in.N, seed, [obj.noiseStream obj.nTraversed], true, ...
+                obj.mexEnabled, obj.nThreads);
+            obj.nTraversed = obj.nTraversed + 1;
             
             % Create the output power object
             PCol_ASE_noise = repmat(pwr(-inf, {Pn, 'W'}), 1, in.N);
@@ -0,0 +1,306 @@
+%>@file GNModel_v1.m
+%>@brief Gaussian-noise (GN) model link estimator class definition
+%>
+%>@class GNModel_v1
+%>@brief Link estimator based on the Gaussian-noise (GN) model
+%>
+%>  @ingroup physModels
+%>
+%> Estimates the per-channel SNR of a multi-span WDM link from the
+%> amplified spontaneous emission (ASE) of the amplifiers and from the
+%> nonlinear interference (NLI) predicted by the GN model [1]. The link is
+%> described with the same span parameters as NonlinearChannel_v1 (L,
+%> alphaa, D, S, gamma, EDFAGain, EDFANF), plus a channel plan.
+%>
+%> The estimate takes milliseconds instead of a full split-step
+%> propagation, so it can be used for launch power or span count sweeps.
+%> The full NonlinearChannel_v1 is only needed to validate selected points.
+%>
+%> The unit can be used in two ways:
+%>
+%> 1. estimate: returns the SNR of each channel for a given launch power,
+%> without any signal.
+%>
+%> 2. traverse: surrogate of NonlinearChannel_v1 for an ideally
+%> dispersion-compensated channel of interest. The signal is amplified by
+%> the net link gain and Gaussian noise with the estimated ASE and NLI
+%> power is added to it. Symbol rate and launch power are taken from the
+%> signal if not specified.
+%>
+%> __Observations:__
+%>
+%> 1. Channels have a rectangular (Nyquist) spectrum of width equal to the
+%> symbol rate. The NLI is assumed white over each channel.
+%>
+%> 2. The model is the GN model for dual polarization signals (16/27
+%> factor). The modulation format correction of the enhanced GN model (EGN)
+%> is not included, so the NLI is slightly overestimated for QAM signals.
+%>
+%> 3. The NLI of the spans is summed coherently. Inline dispersion
+%> compensation is not modelled.
+%>
+%> 4. The NLI integral is evaluated by the native engine (gnmodel_mex) if
+%> compiled (see compileMex). Otherwise the equivalent MATLAB implementation
+%> is used.
+%>
+%> __Example:__
+%> @code
+%>   param.gn.nSpans = 20;
+%>   param.gn.L = 80;
+%>   param.gn.EDFAGain = 16;
+%>   param.gn.EDFANF = 5;
+%>   param.gn.nChannels = 9;
+%>   param.gn.channelSpacing = 50e9;
+%>   param.gn.symbolRate = 32e9;
+%>
+%>   gn = GNModel_v1(param.gn);
+%>
+%>   Pch = -4:0.5:4;
+%>   for n = 1:length(Pch)
+%>       SNR(n) = gn.estimate(Pch(n), 5);
+%>   end
+%>   plot(Pch, SNR)
+%> @endcode
+%>
+%> __References:__
+%>
+%> * [1] P. Poggiolini, "The GN model of non-linear propagation in uncompensated coherent optical systems,"
+%> J. Lightwave Technol. 30, 3857-3879 (2012)
+%> * [2] Agrawal, Gowind P.: Fiber-Optic Communication Systems. 3rd : John Wiley & Sons, 2002.
+%>
+%> @version 1
+classdef GNModel_v1 < unit
+
+    properties
+        %> Number of fiber spans (fiber + amplifier)
+        nSpans = 1;
+        %> Length of each span in km: 1-by-nSpans vector;
+        L = 80;
+        %> Fiber attenuation coefficient in dB/km: 1-by-nSpans vector;
+        alphaa = 0.2;
+        %> Nonlinear coefficient of the fiber in W^-1*km^-1: 1-by-nSpans vector;
+        gamma = 1.2;
+        %> Dispersion coefficient [ps/nm/km]: 1-by-nSpans vector;
+        D = 17;
+        %> Dispersion slope [ps/nm^2/km]: 1-by-nSpans vector;
+        S = 0;
+        %> Gain of each optical amplifier [dB]: 1-by-nSpans vector;
+        EDFAGain = 16;
+        %> Noise figure of the optical amplifiers [dB]: 1-by-nSpans vector;
+        EDFANF = 3;
+        %> Number of WDM channels
+        nChannels = 1;
+        %> Channel spacing [Hz]
+        channelSpacing = 50e9;
+        %> Channel frequencies relative to the carrier [Hz]: 1-by-nChannels vector. Empty: uniform grid centred on the carrier
+        channelFrequencies = [];
+        %> Symbol rate [Hz]: scalar or 1-by-nChannels vector. Empty: taken from the signal
+        symbolRate = [];
+        %> Launch power per channel [dBm]: scalar or 1-by-nChannels vector. Empty: taken from the signal
+        launchPower = [];
+        %> Channel propagated by traverse. Empty: central channel
+        channelOfInterest = [];
+        %> Resolution of the NLI integration grid [Hz]. Empty: symbol rate/32
+        frequencyResolution = [];
+        %> Number of threads of the native engine. 0: all processors
+        nThreads = 0;
+        %> Use the native engine if available
+        mexEnabled = true;
+        %> Number of inputs
+        nInputs = 1;
+        %> Number of outputs
+        nOutputs = 1;
+    end
+
+    methods
+
+        %> @brief Class constructor
+        %>
+        %> Constructs an object of type GNModel_v1.
+        %>
+        %> @param param.nSpans               Number of spans. [Default: 1]
+        %> @param param.L                    Span lengths [km]. Vector [1 x nSpans] or scalar. [Default: 80]
+        %> @param param.alphaa               Fiber attenuation coefficients [dB/km]. Vector [1 x nSpans] or scalar. [Default: 0.2]
+        %> @param param.D                    Fiber dispersion coefficients [ps/nm/km]. Vector [1 x nSpans] or scalar. [Default: 17]
+        %> @param param.S                    Fiber dispersion slope [ps/nm^2/km]. Vector [1 x nSpans] or scalar. [Default: 0]
+        %> @param param.gamma                Fiber nonlinear coefficients [W^-1*km^-1]. Vector [1 x nSpans] or scalar. [Default: 1.2]
+        %> @param param.EDFAGain             EDFA's gain [dB]. Vector [1 x nSpans] or scalar. [Default: 16]
+        %> @param param.EDFANF               EDFA's noise figure [dB]. Vector [1 x nSpans] or scalar. [Default: 3]
+        %> @param param.nChannels            Number of WDM channels. [Default: 1]
+        %> @param param.channelSpacing       Channel spacing [Hz]. [Default: 50e9]
+        %> @param param.channelFrequencies   Channel frequencies relative to the carrier [Hz]. [Default: uniform grid]
+        %> @param param.symbolRate           Symbol rate [Hz]. Vector [1 x nChannels] or scalar. [Default: signal Rs]
+        %> @param param.launchPower          Launch power per channel [dBm]. Vector [1 x nChannels] or scalar. [Default: signal power]
+        %> @param param.channelOfInterest    Channel propagated by traverse. [Default: central channel]
+        %> @param param.frequencyResolution  Resolution of the NLI integration [Hz]. [Default: symbol rate/32]
+        %> @param param.nThreads             Number of threads (native engine). 0 uses all processors. [Default: 0]
+        %> @param param.mexEnabled           Use the native engine if compiled. [Default: true]
+        function obj = GNModel_v1(param)
+            if ~exist('param', 'var')
+                param = struct();
+            end
+            % Accept the parameters of NonlinearChannel_v1
+            if ~isfield(param, 'alphaa') && isfield(param, 'alpha')
+                param.alphaa = param.alpha;
+            end
+            param = rmfield(param, intersect(fieldnames(param), {'alpha', 'alphab'}));
+            obj.setparams(param);
+            if obj.nSpans > 1
+                propNames = {'L', 'alphaa', 'D', 'S', 'gamma', 'EDFAGain', 'EDFANF'};
+                for prop=propNames
+                    prop=prop{:};
+                    if length(obj.(prop)) == 1
+                        obj.(prop) = repmat(obj.(prop), 1, obj.nSpans);
+                    end
+                end
+            end
+            if isempty(obj.channelFrequencies)
+                obj.channelFrequencies = ((1:obj.nChannels)-(obj.nChannels+1)/2)*obj.channelSpacing;
+            elseif length(obj.channelFrequencies) ~= obj.nChannels
+                robolog('channelFrequencies must have nChannels elements.', 'ERR');
+            end
+            if isempty(obj.channelOfInterest)
+                obj.channelOfInterest = ceil(obj.nChannels/2);
+            end
+        end
+
+        %> @brief Estimates the SNR of the channels
+        %>
+        %> @param launchPower   Launch power per channel [dBm]. Scalar or vector [1 x nChannels]. [Default: obj.launchPower]
+        %> @param channels      Channels to evaluate. [Default: all]
+        %> @param Fc            Carrier frequency [Hz]. [Default: 193.1e12]
+        %> @param symbolRate    Symbol rate [Hz]. Scalar or vector [1 x nChannels]. [Default: obj.symbolRate]
+        %>
+        %> @retval SNR          SNR of each channel in the symbol rate bandwidth [dB]
+        %> @retval PASE         ASE power in the band of each channel at the receiver [W]
+        %> @retval PNLI         NLI power in the band of each channel at the receiver [W]
+        function [SNR, PASE, PNLI] = estimate(obj, launchPower, channels, Fc, symbolRate)
+            if ~exist('launchPower', 'var') || isempty(launchPower)
+                launchPower = obj.launchPower;
+            end
+            if ~exist('channels', 'var') || isempty(channels)
+                channels = 1:obj.nChannels;
+            end
+            if ~exist('Fc', 'var') || isempty(Fc)
+                Fc = 193.1e12;
+            end
+            if ~exist('symbolRate', 'var') || isempty(symbolRate)
+                symbolRate = obj.symbolRate;
+            end
+            if isempty(symbolRate) || isempty(launchPower)
+                robolog('Symbol rate and launch power must be specified.', 'ERR');
+            end
+            Rs = symbolRate.*ones(1, obj.nChannels);
+            Pch = 1e-3*10.^(launchPower/10).*ones(1, obj.nChannels);
+            df = obj.frequencyResolution;
+            if isempty(df)
+                df = min(Rs)/32;
+            end
+
+            cKms       = const.c*1e-3;
+            lambda     = cKms/Fc;                               % Central lambda in km;
+            beta2      = -obj.D*lambda^2/(2*pi*cKms);           % Beta2 dispersion polynomial coefficient (chromatic dispersion)
+            beta3      = beta2.^2./obj.D.*(obj.S./obj.D + 2/lambda);  % Beta3 dispersion polynomial coefficient (dispersion slope)
+            beta3(obj.D == 0) = 0;
+            alphalin   = obj.alphaa/(10*log10(exp(1)));         % Fiber attenuation: convert dB/km to 1/km
+            A          = exp(-alphalin.*obj.L);                 % Span loss (linear)
+            G          = 10.^(obj.EDFAGain/10);                 % Amplifier gain (linear)
+            gSpan      = cumprod([1, A(1:end-1).*G(1:end-1)]);  % Power gain from the launch point to the input of each span
+            gEnd       = prod(A.*G);                            % Net link gain
+
+            % ASE (Agrawal eq. 6.1.15): both polarizations, referred to the receiver
+            NFlin = 10.^(obj.EDFANF/10);
+            nsp = (G.*NFlin-1)./(2*(G-1));
+            N0 = bsxfun(@times, 2*(G-1).*nsp*const.h, Fc+obj.channelFrequencies(channels)');
+            gAfter = fliplr(cumprod([1, fliplr(A(2:end).*G(2:end))]));  % Gain from each amplifier to the receiver
+            PASE = sum(bsxfun(@times, max(0, N0), gAfter), 2)'.*Rs(channels);
+
+            % NLI, referred to the launch point
+            if obj.mexEnabled && hasMex('gnmodel_mex')
+                PNLI = gnmodel_mex(obj.channelFrequencies, Rs, Pch, obj.L, alphalin, beta2, beta3, ...
+                    obj.gamma, gSpan, df, channels, obj.nThreads);
+            else
+                PNLI = obj.nliIntegral(Rs, Pch, alphalin, beta2, beta3, gSpan, df, channels);
+            end
+            PNLI = PNLI*gEnd;
+
+            SNR = 10*log10(Pch(channels)*gEnd./(PASE + PNLI));
+        end
+
+        %> @brief MATLAB implementation of the NLI integral (same algorithm as gnmodel_mex)
+        %>
+        %> @param Rs        Symbol rates [Hz]
+        %> @param Pch       Launch powers [W]
+        %> @param alphalin  Attenuation [1/km]
+        %> @param beta2     Group velocity dispersion [s^2/km]
+        %> @param beta3     Dispersion slope [s^3/km]
+        %> @param gSpan     Power gain from the launch point to the input of each span
+        %> @param df        Frequency resolution [Hz]
+        %> @param channels  Channels of interest
+        %>
+        %> @retval PNLI     NLI power of the channels of interest, referred to the launch point [W]
+        function PNLI = nliIntegral(obj, Rs, Pch, alphalin, beta2, beta3, gSpan, df, channels)
+            fch = obj.channelFrequencies;
+            fmin = min(fch-Rs/2);
+            fmax = max(fch+Rs/2);
+            PNLI = zeros(1, length(channels));
+            for ic = 1:length(channels)
+                f0 = fch(channels(ic));
+                m = floor((fmin-f0)/df):ceil((fmax-f0)/df);
+                psd = zeros(size(m));
+                for ch = 1:obj.nChannels
+                    psd = psd + (abs(f0+m*df-fch(ch)) < Rs(ch)/2)*Pch(ch)/Rs(ch);
+                end
+                [m1, m2] = ndgrid(m, m);
+                i3 = m1 + m2 - m(1) + 1;
+                valid = i3 >= 1 & i3 <= length(m);
+                G3 = zeros(size(i3));
+                G3(valid) = psd(i3(valid));
+                GGG = bsxfun(@times, psd', psd).*G3;
+                eta = zeros(size(m1));
+                theta = zeros(size(m1));
+                for k = 1:obj.nSpans
+                    dbeta = 4*pi^2*(m1*df).*(m2*df).*(beta2(k) + pi*beta3(k)*(2*f0+(m1+m2)*df));
+                    den = alphalin(k) - 1j*dbeta;
+                    mu = (1-exp((-alphalin(k)+1j*dbeta)*obj.L(k)))./den;
+                    mu(abs(den)*obj.L(k) < 1e-10) = obj.L(k);
+                    eta = eta + obj.gamma(k)*gSpan(k)*mu.*exp(1j*theta);
+                    theta = theta + dbeta*obj.L(k);
+                end
+                PNLI(ic) = 16/27*sum(sum(GGG.*abs(eta).^2))*df^2*Rs(channels(ic));
+            end
+        end
+
+        %> @brief Amplifies the channel of interest and adds the estimated ASE and NLI noise
+        %>
+        %> @param in    The signal_interface of the channel of interest at the launch point
+        %>
+        %> @retval out  The signal_interface of the channel of interest at the receiver
+        function out = traverse(obj, in)
+            Rs = obj.symbolRate;
+            if isempty(Rs)
+                Rs = in.Rs;
+            end
+            Pch = obj.launchPower;
+            if isempty(Pch)
+                Pch = in.P.Ps('dBm');
+            end
+            [SNR, PASE, PNLI] = obj.estimate(Pch, obj.channelOfInterest, in.Fc, Rs);
+            obj.results.SNR = SNR;
+            obj.results.PASE = PASE;
+            obj.results.PNLI = PNLI;
+            robolog('GN model: channel %d of %d, SNR %1.2f dB (ASE %1.2f dBm, NLI %1.2f dBm).', ...
+                obj.channelOfInterest, obj.nChannels, SNR, 10*log10(PASE/1e-3), 10*log10(PNLI/1e-3));
+
+            % White noise in the symbol rate bandwidth -> power per column over the simulation bandwidth
+            A = exp(-obj.alphaa/(10*log10(exp(1))).*obj.L);
+            gEnd = prod(A.*10.^(obj.EDFAGain/10));
+            Pn = (PASE + PNLI)*in.Fs/Rs(min(end, obj.channelOfInterest))/in.N;
+            noise = wgn(in.L, in.N, Pn, 'linear', 'complex');
+            Eout = sqrt(gEnd)*in.get + noise;
+
+            PCol_out = in.PCol*gEnd + repmat(pwr(-inf, {Pn, 'W'}), 1, in.N);
+            out = signal_interface(Eout, struct('Fs', in.Fs, 'Rs', in.Rs, 'PCol', PCol_out, 'Fc', in.Fc));
+        end
+    end
+end
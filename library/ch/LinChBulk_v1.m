@@ -23,6 +23,12 @@
 %> and that these have a bandwidth that is larger than the signal bandwidth.
 %> This is fine for SMF, but potentially problematic for multimode fiber.
 %> 
+%> 5. Dispersion, principal mode delays and mode mixing are applied as one
+%> N-by-N operator per frequency: one FFT and one inverse FFT per mode
+%> (instead of N^2 inverse FFTs for the delays). The native engine
+%> (linch_mex) is used if compiled (see compileMex), otherwise the
+%> equivalent MATLAB implementation.
+%> 
 %>
 %> __Examples__
 %> 
@@ -82,6 +88,10 @@ classdef LinChBulk_v1 < unit
         DGD_mode = 'set';
         %> loss (dB/km)
         loss = nan;       
+        %> Number of threads of the native engine. 0: all processors
+        nThreads = 0;
+        %> Use the native engine if available
+        mexEnabled = true;
     end
     
     methods (Static)
@@ -173,6 +183,8 @@ classdef LinChBulk_v1 < unit
         %> @param param.loss       Fiber loss [dB/km]
         %> @param param.tau        Vector of differential group delays to apply [s]
         %> @param param.P          Matrix describing polarization alignment of DGD vector [au] [Default: randomly generated]
+        %> @param param.nThreads   Number of threads (native engine). 0 uses all processors. [Default: 0]
+        %> @param param.mexEnabled Use the native engine if compiled. [Default: true]
         %>
         %> @retval obj      An instance of the class ClassTemplate_v1
         function obj = LinChBulk_v1(param)
@@ -190,17 +202,17 @@ classdef LinChBulk_v1 < unit
         %> @retval results.Stokes Rotation matrix of fiber in Stokes space (SMF only)
         function out = traverse(obj,in)
             
-            %CD
-            ECD=obj.cd_loading(in);
+            %CD, applied with the PMD/polarization mixing
+            H=obj.cd_transfer(in);
             
             %PMD/polarization mixing
             if isnan(obj.U)
                 obj.U=obj.random_unitary(in.N);
             end
             if (obj.DGD>0)||(~any(isnan(obj.tau)))
-                [EPMD, mod_tau]=obj.pmd_loading(ECD);
+                [EPMD, mod_tau]=obj.pmd_loading(in, H);
             else
-                EPMD=ECD*obj.U;
+                EPMD=obj.mixing_loading(in, H);
                 mod_tau=0;
             end
             
@@ -238,6 +250,19 @@ classdef LinChBulk_v1 < unit
         %> @retval H Transfer function of dispersion operator
         function [Eout,H] = cd_loading(param, Ein)
             
+            H = param.cd_transfer(Ein);
+            Nfft = Ein.L;
+            Eout = fun1(Ein,@(E)ifft(H.*fft(E,Nfft),Nfft));
+            
+        end
+        
+        %> @brief Transfer function of the chromatic dispersion
+        %>
+        %> @param Ein input signal (signal_interface)
+        %>
+        %> @retval H Transfer function of dispersion operator (FFT order)
+        function H = cd_transfer(param, Ein)
+            
             c = const.c;
             %lambda = param.lambda;
             if Ein.Fc>0
@@ -258,8 +283,61 @@ classdef LinChBulk_v1 < unit
             H = exp(-1j/2*CD(1)*(lambda^2/(2*pi*c))*omega.^2 ...
                 -1j/6*CD(2)*(lambda^2/(2*pi*c))^2*omega.^3); % Taylor expansion
             
-            Eout = fun1(Ein,@(E)ifft(H.*fft(E,Nfft),Nfft));
+        end
+        
+        %> @brief Mode mixing loading (no PMD)
+        %>
+        %> Applies the dispersion H and the Jones matrix in one pass, as
+        %> cd_loading followed by the product with obj.U (signal_interface
+        %> mtimes), with the same power tracking.
+        %>
+        %> @param in input signal (signal_interface)
+        %> @param H Transfer function of dispersion operator (see cd_transfer)
+        %>
+        %> @retval Eout output signal
+        function Eout = mixing_loading(obj, in, H)
+            
+            F_in=getScaled(in);
+            Fout=obj.mimo_operator(F_in, H, eye(in.N), zeros(in.N,1), obj.U.', in.Fs);
             
+            %track power: |H|=1, then scaling of mtimes (column norms of U)
+            P_in = pwr.meanpwr(F_in);
+            Pscale = sum(abs(obj.U).^2, 1).';
+            P_out = in.PCol;        % allocate
+            for jj=1:in.N
+                P_out(jj) = pwr(in.PCol(jj).SNR, {P_in(jj)*Pscale(jj), 'W'});
+            end
+            
+            Eout = signal_interface(Fout, struct('Fs', in.Fs, 'Rs', in.Rs, 'Fc', in.Fc, 'PCol', P_out));
+        end
+        
+        %> @brief Frequency-domain MIMO operator
+        %>
+        %> Y(w,:) = X(w,:)*H(w)*B*diag(exp(-1j*w*tau))*C at each frequency w,
+        %> with one FFT and one inverse FFT per mode.
+        %>
+        %> @param X input field, L-by-N
+        %> @param H Transfer function of dispersion operator, or [] for none
+        %> @param B rotation before the delays, N-by-N
+        %> @param tau delays of the principal modes [s]
+        %> @param C rotation after the delays, N-by-N
+        %> @param Fs sampling rate [Hz]
+        %>
+        %> @retval Y output field, L-by-N, of the class of X
+        function Y = mimo_operator(obj, X, H, B, tau, C, Fs)
+            if obj.mexEnabled && hasMex('linch_mex')
+                Y = linch_mex(X, double(H), double(B), double(tau(:)), double(C), Fs, obj.nThreads);
+            else
+                Nfft = size(X,1);
+                omega = 2*pi*[(0:Nfft/2-1),(-Nfft/2:-1)]'/(Nfft/Fs) ;
+                S = fft(double(X), Nfft, 1)*B;
+                S = S.*exp(-1i*omega*double(tau(:).'));
+                if ~isempty(H)
+                    S = bsxfun(@times, S, H);
+                end
+                Y = ifft(S*C, Nfft, 1);
+            end
+            Y = cast(Y, class(X));
         end
         
         %> @brief PMD loading
@@ -287,12 +365,19 @@ classdef LinChBulk_v1 < unit
         %> Fiber with Strong Mode Coupling," J. Light. Technol., vol. 29, pp.
         %> 31193128, 2011.
         %>
-        %> @param U Jones matrix of fiber
+        %> The dispersion, the delays and the mixing are applied in one pass,
+        %> see mimo_operator.
+        %>
         %> @param in input signal (signal_interface class)
+        %> @param H Transfer function of dispersion operator, applied first [Default: none]
         %>
         %> @retval Eout output signal
         %> @retval mod_tau modulus of DGD vector
-        function [Eout, mod_tau] = pmd_loading(obj, in)
+        function [Eout, mod_tau] = pmd_loading(obj, in, H)
+            
+            if nargin < 3
+                H = [];
+            end
             
             %get modulus of PMD vector
             switch obj.DGD_mode
@@ -377,46 +462,10 @@ classdef LinChBulk_v1 < unit
             %      [~, inds(jj)]=min(abs(T-delays(jj)));
             %end
             
-            %frequency domain
-            Nfft = in.L;
-            omega = 2*pi*[(0:Nfft/2-1),(-Nfft/2:-1)]'/(Nfft/in.Fs) ;
-            
-            %shift/spread input
-            %E_sh(1:N) all correspond to the same spatial mode at the input
-            E_sh=zeros(in.L, in.N^2);
+            %frequency domain: in PM space (P.'), delayed, then moved from
+            %PM space to output spatial modes (U*P)
             F_in=getScaled(in);     %be sure...
-            %No point having high-precision delays if input isn't high-precision
-            c=whos('F_in');
-            switch c.class
-                case 'single'
-                    omega = single(omega);
-                    delays = single(delays);
-            end
-            
-            F_in_spec = fft(F_in, Nfft, 1); %calculate N times, not N^2 times
-            for jj=1:in.N^2
-                mode_no=ceil(jj/in.N);
-                delay_no=mod(jj-1, in.N)+1;
-                %E_sh(:,jj)=circshift(F_in(:,mode_no), inds(delay_no));
-                E_sh(:,jj)=ifft(F_in_spec(:,mode_no).*exp(-1i*omega*delays(delay_no)), Nfft);   %times faster than bsxfun(@times)
-            end
-                        
-            %add
-            Fnew=zeros(size(F_in));
-            for jj=1:in.N
-                delay_no=mod(jj-1, in.N)+1;
-                %draw from PM number delay_no
-                mode_set=(1:in.N:in.N^2)+delay_no-1;
-                %<field launched into PM(mode number) by our N inputs><appropriate
-                %weights>, added = appropriately time-delayed outputs in PM 1, 2, ... N
-                Fnew(:,jj)=E_sh(:,mode_set)*P(delay_no, :).';
-                %
-            end
-            %so Fnew is in PM space
-            
-            %Move from PM space to output spatial modes
-            P_out=obj.U*P;
-            Fout=Fnew*P_out;
+            Fout=obj.mimo_operator(F_in, H, P.', delays, obj.U*P, in.Fs);
             
             %track power
             P_out = in.PCol;        % allocate
@@ -26,6 +26,25 @@
 %> Laboratory at the University of Maryland (Baltimore).  ssprop has PMD
 %> included, but this unit does not have an interface to support it.
 %>
+%> 4. Split-band mode: if bandFrequencies is set, each span is propagated
+%> band by band, each band (e.g. one WDM channel) sampled at bandRate
+%> instead of the rate of the whole signal. The spectrum is split among
+%> the bands (each bin goes to the nearest band), the bands are coupled
+%> by self- and cross-phase modulation, and by four-wave mixing between
+%> bands at most fwmOrder positions apart on the band grid, then merged
+%> back before the amplifier. The dispersion of each band is evaluated at
+%> its own frequency (walk-off). The spectrum farther than bandRate/2 from
+%> all the bands is removed. The nonlinearity is the one of the full-band
+%> mode (sspropv, circular method): the Kerr term of an isotropic fiber
+%> rather than its Manakov average over the polarization states, i.e. the
+%> self-phase modulation (2/3)*gamma*(|a|^2+2*|b|^2) of the circular
+%> components a and b, with the corresponding cross-phase modulation and
+%> four-wave mixing between the bands; a single band covering the whole
+%> signal only differs from the full-band mode by its steps (see
+%> wdmssf_mex). This mode uses alphaa for both polarizations and the
+%> native engine (wdmssf_mex) if compiled (see compileMex), otherwise the
+%> equivalent MATLAB implementation.
+%>
 %>
 %> __Conventions:__
 %> * Dispersion coeff.: D = 2*pi*c/lambda^2, (2.3.5)                                    [1]
@@ -113,6 +132,16 @@ classdef NonlinearChannel_v1 < unit
         doublePrecisionEnabled = 1;
         %> Don't put EDFA
         noEDFAEnabled = 0;
+        %> Frequencies of the bands relative to Fc [Hz]. Empty: full-band propagation
+        bandFrequencies = [];
+        %> Sampling rate of each band [Hz]. Empty: twice the smallest band spacing
+        bandRate = [];
+        %> Largest distance on the band grid of the FWM products. 0: SPM and XPM only
+        fwmOrder = 0;
+        %> Number of threads of the native engine. 0: all processors
+        nThreads = 0;
+        %> Use the native engine if available
+        mexEnabled = true;
         %> Number of inputs
         nInputs = 1;
         %> EDFA spontaneous emission factor (population inversion factor)
@@ -168,6 +197,11 @@ classdef NonlinearChannel_v1 < unit
     %> @param param.dispersionCompensationFraction     Fraction of span dispersion to compensate. [Default: 1]
     %> @param param.polarizationMixingEnabled          Polarization mixing flag. [Default: 0]
     %> @param param.doublePrecisionEnabled             Precision flag. Set to 0 for speed. [Default: 1]
+    %> @param param.bandFrequencies                    Frequencies of the bands relative to Fc [Hz]. Enables the split-band mode. [Default: []]
+    %> @param param.bandRate                           Sampling rate of each band [Hz]. [Default: twice the smallest band spacing]
+    %> @param param.fwmOrder                           Largest grid distance of the FWM products (split-band mode). [Default: 0]
+    %> @param param.nThreads                           Number of threads (native engine). 0 uses all processors. [Default: 0]
+    %> @param param.mexEnabled                         Use the native engine if compiled. [Default: true]
     function obj = NonlinearChannel_v1(param)
         if ~exist('param', 'var')
             param = struct();
@@ -233,7 +267,11 @@ classdef NonlinearChannel_v1 < unit
             % and scale the power (PCOl) properly
             robolog('Span #%d input       - Total power: %1.2f dBm. OSNR: %1.1f', k, in.P.Ptot, in.P.getOSNR(in));
             Pin =  mean(pwr.meanpwr([x y]));
-            if obj.doublePrecisionEnabled
+            if ~isempty(obj.bandFrequencies)
+                E = obj.splitBandSpan([x y], in.Fs, obj.L(k), nz(k), alphaalin(k), betaa(:,k), obj.gamma(k));
+                x = E(:,1);
+                y = E(:,2);
+            elseif obj.doublePrecisionEnabled
                 [x,y] = sspropv_robo2(x,y,in.Ts,dz(k),nz(k),alphaalin(k),alphablin(k),...
                     -betaa(:,k),-betab(:,k),-obj.gamma(k),[0,0],'circular',...
                     obj.iterMax); % Obs: signs of beta and gamma are inverted to keep compatibility with sspropv.
@@ -285,5 +323,192 @@ classdef NonlinearChannel_v1 < unit
         %out=in.set([x, y]);
         out=in;
     end
+
+    %> @brief Propagates the field through one span in split-band mode
+    %>
+    %> @param E         Field, one column per polarization [sqrt(W)]
+    %> @param Fs        Sampling rate of the field [Hz]
+    %> @param L         Span length [km]
+    %> @param nz        Number of steps
+    %> @param alphalin  Attenuation [1/km]
+    %> @param beta      Dispersion polynomial
+    %> @param gamma     Nonlinear coefficient [W^-1*km^-1]
+    %>
+    %> @retval E        Field at the end of the span
+    function E = splitBandSpan(obj, E, Fs, L, nz, alphalin, beta, gamma)
+        [nt, P] = size(E);
+        df = Fs/nt;
+        kb = round(obj.bandFrequencies(:).'/df);             % Band frequencies in bins
+        B = numel(kb);
+        if numel(unique(kb)) < B
+            robolog('The band frequencies must be at least Fs/N apart.', 'ERR');
+        end
+        Fb = obj.bandRate;
+        if isempty(Fb)
+            Fb = Fs;
+            if B > 1
+                Fb = min(2*min(diff(sort(kb)))*df, Fs);
+            end
+        end
+        ntb = round(Fb/df);                                   % Samples per band
+        if ntb > nt || ntb < 1
+            robolog('The band rate must be positive and at most Fs.', 'ERR');
+        end
+        % Assign each bin to the nearest band, within +-bandRate/2
+        q = [(0:ceil(nt/2)-1), (-floor(nt/2):-1)]';
+        [~, band] = min(abs(bsxfun(@minus, q, kb)), [], 2);
+        rel = q-kb(band).';
+        band(rel < -floor(ntb/2) | rel >= ceil(ntb/2)) = 0;
+        % Band grid
+        g = 0;
+        for m = 2:B
+            g = gcd(g, abs(kb(m)-kb(1)));
+        end
+        grid = zeros(1, B);
+        if g > 0
+            grid = (kb-min(kb))/g;
+        end
+        % Split
+        F = fft(E)*(ntb/nt);
+        U = zeros(ntb, P*B);
+        for m = 1:B
+            idx = find(band == m);
+            U(mod(rel(idx), ntb)+1, (m-1)*P+(1:P)) = F(idx,:);
+        end
+        U = ifft(U);
+        if obj.mexEnabled && hasMex('wdmssf_mex')
+            U = wdmssf_mex(U, 1/Fb, kb/ntb, grid, L, nz, alphalin, beta, gamma, obj.fwmOrder, obj.nThreads);
+        else
+            U = obj.propagateBands(U, 1/Fb, kb/ntb, grid, L, nz, alphalin, beta, gamma);
+        end
+        % Merge
+        U = fft(U)*(nt/ntb);
+        F = zeros(nt, P);
+        for m = 1:B
+            idx = find(band == m);
+            F(idx,:) = U(mod(rel(idx), ntb)+1, (m-1)*P+(1:P));
+        end
+        E = ifft(F);
+    end
+
+    %> @brief MATLAB implementation of the split-band propagation (same algorithm as wdmssf_mex)
+    %>
+    %> @param U         Fields of the bands, the polarizations of band 1, then of band 2, ... [sqrt(W)]
+    %> @param dt        Sampling period of the bands [s]
+    %> @param fn        Frequencies of the bands (in units of 1/dt)
+    %> @param grid      Positions of the bands on the band grid
+    %> @param L         Span length [km]
+    %> @param nz        Number of steps
+    %> @param alphalin  Attenuation [1/km]
+    %> @param beta      Dispersion polynomial
+    %> @param gamma     Nonlinear coefficient [W^-1*km^-1]
+    %>
+    %> @retval U        Fields of the bands at the end of the span
+    function U = propagateBands(obj, U, dt, fn, grid, L, nz, alphalin, beta, gamma)
+        nt = size(U, 1);
+        B = numel(fn);
+        P = size(U, 2)/B;
+        c = 1;
+        if P == 2
+            c = 2/3;
+            % circular basis of sspropv
+            X = U(:,1:2:end);
+            Y = U(:,2:2:end);
+            U(:,1:2:end) = (X+1j*Y)/sqrt(2);
+            U(:,2:2:end) = (1j*X+Y)/sqrt(2);
+        end
+        h = L/nz;
+        if alphalin > 0
+            Leff = (1-exp(-alphalin*h))/alphalin;
+        else
+            Leff = h;
+        end
+        phi = c*gamma*Leff;
+        w = 2*pi*[(0:ceil(nt/2)-1), (-floor(nt/2):-1)]'/(dt*nt);
+        nb = numel(beta);
+        Hs = zeros(nt, B);
+        for m = 1:B
+            Hs(:,m) = exp(1j*polyval(flipud(beta(:)./factorial(0:nb-1)'), w+2*pi*fn(m)/dt)*h - alphalin*h/2);
+        end
+        Hs = Hs(:, ceil((1:P*B)/P));
+        for n = 1:nz
+            if gamma ~= 0
+                if obj.fwmOrder > 0
+                    D = 1j*phi*obj.fwmIncrement(U, grid, P);
+                end
+                if P == 1
+                    T = 2*sum(abs(U).^2, 2);
+                    U = U.*exp(1j*phi*bsxfun(@minus, T, abs(U).^2));
+                else
+                    X = U(:,1:2:end);
+                    Y = U(:,2:2:end);
+                    px = abs(X).^2;
+                    py = abs(Y).^2;
+                    T = 2*sum(px+py, 2);
+                    m11 = bsxfun(@minus, T, px);
+                    m22 = bsxfun(@minus, T, py);
+                    m12 = 2*bsxfun(@minus, sum(X.*conj(Y), 2), X.*conj(Y));
+                    dd = (m11-m22)/2;
+                    r = sqrt(dd.^2+abs(m12).^2);
+                    sr = sin(phi*r)./r;
+                    sr(r*phi <= 1e-12) = phi;
+                    e = exp(1j*phi*(m11+m22)/2);
+                    U(:,1:2:end) = e.*(cos(phi*r).*X + 1j*sr.*(dd.*X + m12.*Y));
+                    U(:,2:2:end) = e.*(cos(phi*r).*Y + 1j*sr.*(conj(m12).*X - dd.*Y));
+                end
+                if obj.fwmOrder > 0
+                    U = U+D;
+                end
+            end
+            U = ifft(Hs.*fft(U));
+        end
+        if P == 2
+            X = U(:,1:2:end);
+            Y = U(:,2:2:end);
+            U(:,1:2:end) = (X-1j*Y)/sqrt(2);
+            U(:,2:2:end) = (-1j*X+Y)/sqrt(2);
+        end
+    end
+
+    %> @brief Four-wave mixing products of each band, sum of (A_n'*A_l)*A_k over k+l-n = m
+    %>
+    %> For dual polarization (circular basis), the term
+    %> (a_k*b_l+b_k*a_l)/2*[conj(b_n) conj(a_n)] is added (see wdmssf_mex).
+    %>
+    %> @param U         Fields of the bands
+    %> @param grid      Positions of the bands on the band grid
+    %> @param P         Number of polarizations per band
+    %>
+    %> @retval D        FWM products, same size as U
+    function D = fwmIncrement(obj, U, grid, P)
+        B = numel(grid);
+        bandAt = zeros(1, max(grid)-min(grid)+1);
+        bandAt(grid-min(grid)+1) = 1:B;
+        cols = @(m) (m-1)*P+(1:P);
+        D = zeros(size(U));
+        for m = 1:B
+            for k = 1:B
+                for l = 1:B
+                    gn = grid(k)+grid(l)-grid(m);
+                    if max(abs([grid(k) grid(l) gn]-grid(m))) > obj.fwmOrder || gn < min(grid) || gn > max(grid)
+                        continue
+                    end
+                    n = bandAt(gn-min(grid)+1);
+                    if n == 0 || (k == m && l == n) || (k == n && l == m)
+                        continue
+                    end
+                    Ak = U(:,cols(k));
+                    Al = U(:,cols(l));
+                    An = U(:,cols(n));
+                    s = sum(conj(An).*Al, 2);
+                    D(:,cols(m)) = D(:,cols(m)) + bsxfun(@times, s, Ak);
+                    if P == 2
+                        q = (Ak(:,1).*Al(:,2)+Ak(:,2).*Al(:,1))/2;
+                        D(:,cols(m)) = D(:,cols(m)) + bsxfun(@times, q, conj(An(:,[2 1])));
+                    end
+                end
+            end
+        end
+    end
    end
 end
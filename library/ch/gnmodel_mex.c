@@ -0,0 +1,216 @@
+/*  File:           gnmodel_mex.c
+ *  Description:    Nonlinear interference (NLI) power of a multi-span
+ *                  WDM link according to the Gaussian-noise (GN) model.
+ *                  Native engine of GNModel_v1, compiled as a MATLAB MEX
+ *                  function (see compileMex).
+ *
+ *  The NLI power spectral density at the centre frequency f of a channel
+ *  of interest (referred to the launch point) is
+ *
+ *    G_NLI(f) = 16/27 * sum_{m1,m2} G(f1)*G(f2)*G(f1+f2-f)*|eta(f1,f2,f)|^2 * df^2
+ *
+ *    eta = sum_k gamma_k * g_k * mu_k * exp(j*theta_k)
+ *    mu_k = (1 - exp((-alpha_k + j*dbeta_k)*L_k)) / (alpha_k - j*dbeta_k)
+ *    dbeta_k = 4*pi^2*(f1-f)*(f2-f)*(beta2_k + pi*beta3_k*(f1+f2))
+ *    theta_k = sum_{i<k} dbeta_i*L_i
+ *
+ *  where G is the launch power spectral density (rectangular Nyquist
+ *  channels), g_k the power gain from the launch point to the input of
+ *  span k and alpha the power attenuation.  The integral is evaluated with
+ *  the midpoint rule on the grid f1,f2 = f + m*df, on which f1+f2-f also
+ *  falls.  The NLI power of the channel is G_NLI(f)*Rs (local white noise
+ *  approximation).
+ *
+ *  Consecutive spans with the same fiber reuse mu and the phase
+ *  increment, so that a homogeneous link costs one complex exponential
+ *  per grid point.  The grid rows are distributed over the threads.
+ */
+
+/*
+ * USAGE:
+ * Pnli = gnmodel_mex(fch,Rs,Pch,L,alpha,beta2,beta3,gamma,g,df,coi);
+ * Pnli = gnmodel_mex(fch,Rs,Pch,L,alpha,beta2,beta3,gamma,g,df,coi,nthreads);
+ *
+ * INPUT
+ * fch       Channel centre frequencies relative to the carrier, 1-by-nCh [Hz]
+ * Rs        Symbol rates, scalar or 1-by-nCh [Hz]
+ * Pch       Launch powers, scalar or 1-by-nCh [W]
+ * L         Span lengths, 1-by-nSpans [km]
+ * alpha     Power attenuation, scalar or 1-by-nSpans [1/km]
+ * beta2     Group velocity dispersion, scalar or 1-by-nSpans [s^2/km]
+ * beta3     Dispersion slope, scalar or 1-by-nSpans [s^3/km]
+ * gamma     Nonlinear coefficient, scalar or 1-by-nSpans [1/W/km]
+ * g         Power gain from the launch point to the input of each span,
+ *             scalar or 1-by-nSpans
+ * df        Frequency resolution of the integration grid [Hz]
+ * coi       Channels of interest (1-based indices)
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * Pnli      NLI power in the band of each channel of interest, referred
+ *             to the launch point [W]
+ */
+
+#include "robomex.h"
+
+typedef struct {
+  REAL L, alpha, beta2, beta3, gamma, g;
+  int same;          /* !=0 if the fiber is the same as the previous span */
+} gn_span;
+
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+/* Launch power spectral density on the grid f = f0 + m*df,
+ * m = mlo ... mlo+nm-1 */
+void compute_psd(REAL* G,REAL f0,REAL df,int mlo,int nm,
+                 const mxArray* mxF,const mxArray* mxRs,const mxArray* mxP)
+{
+  int nch = (int) mxGetNumberOfElements(mxF);
+  int ii,ich;
+  REAL f,fc,rs;
+
+  for (ii = 0; ii < nm; ii++) {
+    G[ii] = 0;
+    f = f0 + (mlo+ii)*df;
+    for (ich = 0; ich < nch; ich++) {
+      fc = (REAL) robomex_elem(mxF,ich);
+      rs = (REAL) robomex_elem(mxRs,ich);
+      if (fabs(f-fc) < rs/2)
+        G[ii] += (REAL) robomex_elem(mxP,ich)/rs;
+    }
+  }
+}
+
+
+/* Evaluates |eta|^2 at (f1,f2) = (f0+df1,f0+df2) */
+REAL eta2(const gn_span* spans,int nspans,REAL f0,REAL df1,REAL df2)
+{
+  int k;
+  REAL db = 0,ar,ai,den,er,ei,mr = 0,mi = 0,cr = 1,ci = 0,tr,w;
+  REAL sr = 0, si = 0;
+
+  for (k = 0; k < nspans; k++) {
+    if (!spans[k].same) {
+      db = 4*ROBOMEX_PI*ROBOMEX_PI*df1*df2*(spans[k].beta2 + ROBOMEX_PI*spans[k].beta3*(2*f0+df1+df2));
+      /* mu = (1-exp((-alpha+j*db)*L))/(alpha-j*db) */
+      den = spans[k].alpha*spans[k].alpha + db*db;
+      if (den*spans[k].L*spans[k].L < 1e-20) {
+        mr = spans[k].L;
+        mi = 0;
+      } else {
+        w = exp(-spans[k].alpha*spans[k].L);
+        er = 1 - w*cos(db*spans[k].L);
+        ei = -w*sin(db*spans[k].L);
+        ar = spans[k].alpha;
+        ai = db;          /* 1/(alpha-j*db) = (alpha+j*db)/den */
+        mr = (er*ar - ei*ai)/den;
+        mi = (er*ai + ei*ar)/den;
+      }
+    }
+    /* accumulate gamma*g*mu*exp(j*theta) */
+    w = spans[k].gamma*spans[k].g;
+    sr += w*(mr*cr - mi*ci);
+    si += w*(mr*ci + mi*cr);
+    /* theta += db*L */
+    er = cos(db*spans[k].L);
+    ei = sin(db*spans[k].L);
+    tr = cr*er - ci*ei;
+    ci = cr*ei + ci*er;
+    cr = tr;
+  }
+  return sr*sr + si*si;
+}
+
+
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  int nch;           /* number of channels */
+  int nspans;        /* number of spans */
+  int ncoi;          /* number of channels of interest */
+  REAL df;           /* grid resolution */
+  int nthreads = 0;  /* number of threads */
+
+  gn_span* spans;
+  REAL* G;           /* launch PSD on the grid */
+  double* pnli;
+  REAL fmin,fmax,f0,rs,sum;
+  int ic,ich,k,i1,i2,i3,mlo,nm;
+
+  if (nrhs < 11)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 1)
+    mexErrMsgTxt("Too many output arguments.");
+
+  /* parse input arguments */
+  nch = (int) mxGetNumberOfElements(prhs[0]);
+  nspans = (int) mxGetNumberOfElements(prhs[3]);
+  df = (REAL) mxGetScalar(prhs[9]);
+  ncoi = (int) mxGetNumberOfElements(prhs[10]);
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,11,0));
+
+  if (nch == 0 || nspans == 0)
+    mexErrMsgTxt("Empty channel plan or link.");
+  if (df <= 0)
+    mexErrMsgTxt("The frequency resolution must be positive.");
+
+  spans = (gn_span*) mxMalloc(sizeof(gn_span)*nspans);
+  for (k = 0; k < nspans; k++) {
+    spans[k].L = (REAL) robomex_elem(prhs[3],k);
+    spans[k].alpha = (REAL) robomex_elem(prhs[4],k);
+    spans[k].beta2 = (REAL) robomex_elem(prhs[5],k);
+    spans[k].beta3 = (REAL) robomex_elem(prhs[6],k);
+    spans[k].gamma = (REAL) robomex_elem(prhs[7],k);
+    spans[k].g = (REAL) robomex_elem(prhs[8],k);
+    spans[k].same = k > 0 &&
+      spans[k].L == spans[k-1].L && spans[k].alpha == spans[k-1].alpha &&
+      spans[k].beta2 == spans[k-1].beta2 && spans[k].beta3 == spans[k-1].beta3;
+  }
+
+  /* occupied band */
+  fmin = fmax = (REAL) robomex_elem(prhs[0],0);
+  for (ich = 0; ich < nch; ich++) {
+    rs = (REAL) robomex_elem(prhs[1],ich);
+    if (robomex_elem(prhs[0],ich) - rs/2 < fmin)
+      fmin = (REAL) robomex_elem(prhs[0],ich) - rs/2;
+    if (robomex_elem(prhs[0],ich) + rs/2 > fmax)
+      fmax = (REAL) robomex_elem(prhs[0],ich) + rs/2;
+  }
+
+  plhs[0] = mxCreateDoubleMatrix(1,ncoi,mxREAL);
+  pnli = mxGetPr(plhs[0]);
+
+  for (ic = 0; ic < ncoi; ic++) {
+    ich = (int) mxGetPr(prhs[10])[ic] - 1;
+    if (ich < 0 || ich >= nch)
+      mexErrMsgTxt("Channel of interest out of range.");
+    f0 = (REAL) robomex_elem(prhs[0],ich);
+
+    /* grid f0 + m*df covering the occupied band */
+    mlo = (int) floor((fmin - f0)/df);
+    nm = (int) ceil((fmax - f0)/df) - mlo + 1;
+    G = (REAL*) mxMalloc(sizeof(REAL)*nm);
+    compute_psd(G,f0,df,mlo,nm,prhs[0],prhs[1],prhs[2]);
+
+    sum = 0;
+#ifdef _OPENMP
+#pragma omp parallel for private(i2,i3) reduction(+:sum) num_threads(nthreads) schedule(dynamic)
+#endif
+    for (i1 = 0; i1 < nm; i1++) {
+      if (G[i1] == 0)
+        continue;
+      for (i2 = 0; i2 < nm; i2++) {
+        i3 = i1 + i2 + mlo;       /* index of f1+f2-f0 */
+        if (G[i2] == 0 || i3 < 0 || i3 >= nm || G[i3] == 0)
+          continue;
+        sum += G[i1]*G[i2]*G[i3]*eta2(spans,nspans,f0,(mlo+i1)*df,(mlo+i2)*df);
+      }
+    }
+
+    pnli[ic] = 16.0/27.0*sum*df*df*robomex_elem(prhs[1],ich);
+    mxFree(G);
+  }
+
+  mxFree(spans);
+}
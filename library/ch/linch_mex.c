@@ -0,0 +1,235 @@
+/*  File:           linch_mex.c
+ *  Description:    Frequency-domain MIMO operator of a linear channel.
+ *                  Native engine of LinChBulk_v1, compiled as a MATLAB
+ *                  MEX function (see compileMex).
+ *
+ *  Applies to the N modes of X, at each frequency w of the FFT grid,
+ *
+ *    Y(w,:) = X(w,:)*H(w)*B*diag(exp(-1j*w*tau))*C
+ *
+ *  i.e. the chromatic dispersion H, a mode rotation B, the group delays
+ *  tau of the principal modes and a second rotation C, fused into one
+ *  N-by-N operator per frequency.  The modes are transformed once each
+ *  (N forward and N inverse FFTs, one mode per thread) instead of one
+ *  inverse FFT per pair of mode and delay.  The operator is applied in
+ *  parallel over tiles of TILE frequencies, so that the N modes of a
+ *  tile, which are L samples apart, stay in the cache.
+ */
+
+/*
+ * USAGE:
+ * Y = linch_mex(X,H,B,tau,C,Fs);
+ * Y = linch_mex(X,H,B,tau,C,Fs,nthreads);
+ * linch_mex -option
+ *
+ * INPUT
+ * X         Field, L-by-N (one mode per column)
+ * H         Transfer function in FFT order, L-by-1, or [] for none
+ * B         Rotation before the delays, N-by-N
+ * tau       Delays of the principal modes [s], N elements (0: none)
+ * C         Rotation after the delays, N-by-N
+ * Fs        Sampling rate [Hz]
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * Y         Field at the output, L-by-N
+ *
+ * OPTIONS (i.e. linch_mex -estimate): see plancache.h
+ */
+
+#include "robomex.h"
+#include "plancache.h"
+
+#define TILE 64              /* frequencies per tile */
+
+void get_matrix(COMPLEX*,const mxArray*,int);
+void apply_tile(COMPLEX*,int,int,int,int,COMPLEX*,COMPLEX*,const double*,
+                COMPLEX*,double,COMPLEX*);
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+/* Copies an N-by-N MATLAB matrix into m, row-major: m[i*N + j] = A(i,j) */
+void get_matrix(COMPLEX* m,const mxArray* a,int N)
+{
+  double *pr = mxGetPr(a), *pi_ = mxGetPi(a);
+  int i,j;
+
+  if ((int) mxGetM(a) != N || (int) mxGetN(a) != N)
+    mexErrMsgTxt("The rotations must be N-by-N.");
+  for (i = 0; i < N; i++)
+    for (j = 0; j < N; j++) {
+      m[i*N + j][0] = (REAL) pr[j*N + i];
+      m[i*N + j][1] = pi_ ? (REAL) pi_[j*N + i] : 0;
+    }
+}
+
+
+/* Operator of the frequencies k0 ... k0+n-1 on the spectra u (N columns
+ * of L samples), in place; tile has room for 2*N*TILE samples */
+void apply_tile(COMPLEX* u,int L,int N,int k0,int n,COMPLEX* h,
+                COMPLEX* B,const double* tau,COMPLEX* C,
+                double dw,COMPLEX* tile)
+{
+  COMPLEX *x = tile,*t = tile + N*TILE;
+  int i,j,k;
+  REAL ar,ai,er,ei,re;
+  double w,ph;
+
+  /* gather: x[k*N + i] = u(k0+k, i) */
+  for (i = 0; i < N; i++)
+    for (k = 0; k < n; k++) {
+      x[k*N + i][0] = u[(size_t) i*L + k0 + k][0];
+      x[k*N + i][1] = u[(size_t) i*L + k0 + k][1];
+    }
+
+  for (k = 0; k < n; k++) {
+    COMPLEX* xk = x + k*N;
+    COMPLEX* tk = t + k*N;
+    int jj = k0 + k;
+
+    /* t = x*B */
+    for (j = 0; j < N; j++) {
+      ar = ai = 0;
+      for (i = 0; i < N; i++) {
+        ar += xk[i][0]*B[i*N + j][0] - xk[i][1]*B[i*N + j][1];
+        ai += xk[i][0]*B[i*N + j][1] + xk[i][1]*B[i*N + j][0];
+      }
+      tk[j][0] = ar;
+      tk[j][1] = ai;
+    }
+
+    /* t = t.*exp(-1j*w*tau)*H(w) */
+    w = dw*(jj <= (L-1)/2 ? jj : jj - L);
+    for (j = 0; j < N; j++) {
+      ph = -w*tau[j];
+      er = (REAL) cos(ph);
+      ei = (REAL) sin(ph);
+      if (h) {
+        re = er*h[jj][0] - ei*h[jj][1];
+        ei = er*h[jj][1] + ei*h[jj][0];
+        er = re;
+      }
+      re = tk[j][0]*er - tk[j][1]*ei;
+      tk[j][1] = tk[j][0]*ei + tk[j][1]*er;
+      tk[j][0] = re;
+    }
+
+    /* x = t*C */
+    for (j = 0; j < N; j++) {
+      ar = ai = 0;
+      for (i = 0; i < N; i++) {
+        ar += tk[i][0]*C[i*N + j][0] - tk[i][1]*C[i*N + j][1];
+        ai += tk[i][0]*C[i*N + j][1] + tk[i][1]*C[i*N + j][0];
+      }
+      x[k*N + j][0] = ar;
+      x[k*N + j][1] = ai;
+    }
+  }
+
+  /* scatter */
+  for (i = 0; i < N; i++)
+    for (k = 0; k < n; k++) {
+      u[(size_t) i*L + k0 + k][0] = x[k*N + i][0];
+      u[(size_t) i*L + k0 + k][1] = x[k*N + i][1];
+    }
+}
+
+
+/* This is the gateway function between MATLAB and LINCH_MEX.  It serves
+ * as the main(). */
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  int L;             /* samples */
+  int N;             /* modes */
+  int nthreads;
+  int ntiles,tt,col;
+  double Fs,dw,*tau;
+  COMPLEX *u,*h = NULL,*B,*C,*tiles;
+  PLAN pf,pb;
+
+  if (plancache_option(nrhs,prhs))
+    return;
+
+  if (nrhs < 6)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 1)
+    mexErrMsgTxt("Too many output arguments.");
+  if (!(mxIsDouble(prhs[0]) || mxIsSingle(prhs[0])) || !mxIsDouble(prhs[2])
+      || !mxIsDouble(prhs[3]) || !mxIsDouble(prhs[4]))
+    mexErrMsgTxt("The arguments must be floating point arrays.");
+
+  plancache_begin();
+
+  /* parse input arguments */
+  L = (int) mxGetM(prhs[0]);
+  N = (int) mxGetN(prhs[0]);
+  if ((int) mxGetNumberOfElements(prhs[3]) != N)
+    mexErrMsgTxt("tau must have one delay per mode.");
+  if (!mxIsEmpty(prhs[1]) && ((int) mxGetNumberOfElements(prhs[1]) != L || !mxIsDouble(prhs[1])))
+    mexErrMsgTxt("H must have one double element per sample.");
+  tau = mxGetPr(prhs[3]);
+  Fs = mxGetScalar(prhs[5]);
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,6,0));
+  dw = 2*ROBOMEX_PI*Fs/(L > 0 ? L : 1);
+
+  plhs[0] = mxCreateDoubleMatrix(L,N,mxCOMPLEX);
+  if (L == 0 || N == 0)
+    return;
+
+  /* allocate memory */
+  u = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*L*N);
+  B = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*N*N);
+  C = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*N*N);
+  get_matrix(B,prhs[2],N);
+  get_matrix(C,prhs[4],N);
+  if (!mxIsEmpty(prhs[1])) {
+    h = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*L);
+    robomex_get_column(h,prhs[1],0);
+  }
+  ntiles = (L + TILE - 1)/TILE;
+  tiles = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*2*N*TILE*nthreads);
+
+  /* fftw3 plans (from the session cache), one mode per transform */
+  pf = plancache_get(PLANCACHE_FORWARD, L, 1, 1);
+  pb = plancache_get(PLANCACHE_BACKWARD, L, 1, 1);
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+#endif
+  for (col = 0; col < N; col++) {
+    robomex_get_column(u + (size_t) col*L,prhs[0],col);
+    EXECUTE_DFT(pf,u + (size_t) col*L,u + (size_t) col*L);
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+#endif
+  for (tt = 0; tt < ntiles; tt++) {
+    COMPLEX* tile;
+#ifdef _OPENMP
+    tile = tiles + (size_t) omp_get_thread_num()*2*N*TILE;
+#else
+    tile = tiles;
+#endif
+    apply_tile(u,L,N,tt*TILE,(tt + 1)*TILE <= L ? TILE : L - tt*TILE,
+               h,B,tau,C,dw,tile);
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+#endif
+  for (col = 0; col < N; col++)
+    EXECUTE_DFT(pb,u + (size_t) col*L,u + (size_t) col*L);
+
+  for (col = 0; col < N; col++)
+    robomex_set_column(plhs[0], col, u + (size_t) col*L, (REAL) (1.0/L));
+
+  /* de-allocate memory */
+  FFTW_FREE(u);
+  FFTW_FREE(B);
+  FFTW_FREE(C);
+  if (h)
+    FFTW_FREE(h);
+  FFTW_FREE(tiles);
+}
@@ -0,0 +1,472 @@
+/*  File:           wdmssf_mex.c
+ *  Description:    Split-band split-step propagation of a WDM field
+ *                  through one fiber span.  Native engine of the
+ *                  split-band mode of NonlinearChannel_v1, compiled as a
+ *                  MATLAB MEX function (see compileMex).
+ *
+ *  The field is the sum of B bands A_m(t)*exp(j*W_m*t), W_m = 2*pi*df(m),
+ *  each sampled at the low rate of the band instead of the whole WDM
+ *  bandwidth.  With the convention of NonlinearChannel_v1 (see dbp_mex),
+ *  each band solves
+ *
+ *    dA_m/dz = (j*beta(w + W_m) - alpha/2)*A_m + j*gamma*N_m
+ *
+ *  where N_m is the part of the Kerr term at the frequency of band m.
+ *  For a single polarization,
+ *
+ *    N_m = sum over k + l - n = m of A_n'*A_l*A_k
+ *
+ *  where the indices are positions on the band grid (grid).  For dual
+ *  polarization, the model is the one of sspropv with the circular
+ *  method (full-band mode of NonlinearChannel_v1), i.e. the Kerr term
+ *  (2/3)*(E'*E)*E + (1/3)*(E.'*E)*conj(E) of an isotropic fiber rather
+ *  than its Manakov average over the polarization states.  The bands are
+ *  propagated in the circular basis of sspropv, a = (x + j*y)/sqrt(2),
+ *  b = (j*x + y)/sqrt(2), where
+ *
+ *    N_m = (2/3)*sum over k + l - n = m of
+ *            (A_n'*A_l)*A_k + (a_k*b_l + b_k*a_l)/2*[conj(b_n); conj(a_n)]
+ *
+ *  and a single band has the self-phase modulation (2/3)*(|a|^2 + 2*|b|^2)
+ *  of sspropv.  The terms with {k,l} = {m,n} are the self- and
+ *  cross-phase modulation, N_m = c*M_m*A_m with c = 1 and
+ *
+ *    M_m = T - |A_m|^2,   T = 2*sum_n |A_n|^2
+ *
+ *  for a single polarization, c = 2/3 and
+ *
+ *    M_m = [t - |a_m|^2, t12 - 2*a_m*b_m'; conj(t12 - 2*a_m*b_m'), t - |b_m|^2],
+ *    t = 2*sum_n (|a_n|^2 + |b_n|^2),  t12 = 2*sum_n a_n*b_n'
+ *
+ *  for dual polarization.  It is applied exactly as the unitary rotation
+ *  exp(j*phi*M_m), phi = c*gamma*Leff.  The other terms are the
+ *  four-wave mixing (FWM) products, computed only if fwm > 0 for the
+ *  triplets whose bands are at most fwm grid positions from band m, and
+ *  added to first order.
+ *  The dispersion of each band is evaluated at its own frequency, so
+ *  the walk-off between the bands and the phase matching of the FWM are
+ *  included.  Each step of length h applies the nonlinear step
+ *  concentrated at its beginning, where the power is highest, followed
+ *  by the linear step of the band.  The FFTs of the bands are run in
+ *  parallel, one band per thread.
+ */
+
+/*
+ * USAGE:
+ * U = wdmssf_mex(U0,dt,df,grid,L,nz,alpha,betap,gamma);
+ * U = wdmssf_mex(U0,dt,df,grid,L,nz,alpha,betap,gamma,fwm);
+ * U = wdmssf_mex(U0,dt,df,grid,L,nz,alpha,betap,gamma,fwm,nthreads);
+ * wdmssf_mex -option
+ *
+ * INPUT
+ * U0        Fields of the bands, nt-by-(P*B), the P = 1 or 2
+ *             polarizations of band 1, then of band 2, ... [sqrt(W)]
+ * dt        Sampling period of the bands
+ * df        Frequency of each band relative to the carrier, 1-by-B
+ *             (in units of 1/dt)
+ * grid      Position of each band on the band grid (integers), 1-by-B
+ * L         Span length
+ * nz        Number of steps
+ * alpha     Power attenuation coefficient
+ * betap     Dispersion polynomial coefs [beta_0 ... beta_m] at the carrier
+ * gamma     Nonlinear coefficient
+ * fwm       Largest distance on the grid of the FWM products, 0 for
+ *             self- and cross-phase modulation only (default 0)
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * U         Fields of the bands after the span, nt-by-(P*B)
+ *
+ * OPTIONS (i.e. wdmssf_mex -estimate): see plancache.h
+ */
+
+#include "robomex.h"
+#include "plancache.h"
+
+#define MINCHUNK 4096        /* minimum samples per thread */
+
+typedef struct {
+  COMPLEX* u;        /* field, P*nt */
+  COMPLEX* hs;       /* linear step, nt */
+  COMPLEX* d;        /* FWM increment, P*nt (NULL without FWM) */
+} wdm_band;
+
+void compute_hband(COMPLEX*,REAL,const mxArray*,REAL,REAL,REAL,int);
+void to_circular(COMPLEX*,int,int);
+void coherency(wdm_band*,int,int,int,int,int,REAL*,COMPLEX*);
+void xpm_band(wdm_band*,int,int,const REAL*,COMPLEX*,REAL);
+void fwm_band(wdm_band*,int,int,int,int,const int*,const int*,int,int,int,REAL);
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+/* Compute the linear operator of one step of length h of a band at
+ * frequency df, including the 1/nt normalization of the inverse FFT
+ *
+ * MATLAB equivalent:
+ *   hs = exp(1j*polyval(flipud(betap./factorial(0:nb-1)'),w+2*pi*df/dt)*h - alpha*h/2)/nt;
+ */
+void compute_hband(COMPLEX* hs,REAL dt,const mxArray* mxBeta,REAL df,
+                   REAL h,REAL alpha,int nt)
+{
+  int nb = (int) mxGetNumberOfElements(mxBeta);
+  double* beta = mxGetPr(mxBeta);
+  REAL fii,wii,w,phase,gain;
+  int jj,ii;
+
+  gain = exp(-alpha*h/2)/nt;
+  for (jj = 0; jj < nt; jj++) {
+    w = 2*ROBOMEX_PI*((jj <= (nt-1)/2 ? jj : jj - nt)/(REAL) nt + df)/dt;
+    for (ii = 0, phase = 0, fii = 1, wii = 1;
+         ii < nb;
+         ii++, fii*=ii, wii*=w)
+      phase += wii*((REAL)beta[ii])/fii;
+    hs[jj][0] = gain*cos(phase*h);
+    hs[jj][1] = gain*sin(phase*h);
+  }
+}
+
+
+/* Change of basis of the two polarizations u (x then y, nt samples
+ * each): to the circular basis of sspropv, a = (x + j*y)/sqrt(2),
+ * b = (j*x + y)/sqrt(2) (inverse = 0), or back to x = (a - j*b)/sqrt(2),
+ * y = (-j*a + b)/sqrt(2) (inverse = 1) */
+void to_circular(COMPLEX* u,int nt,int inverse)
+{
+  COMPLEX *x = u,*y = u + nt;
+  REAL s = (REAL) (inverse ? -1 : 1)/sqrt(2.0),g = (REAL) (1/sqrt(2.0));
+  REAL xr,xi,yr,yi;
+  int jj;
+
+  for (jj = 0; jj < nt; jj++) {
+    xr = x[jj][0]; xi = x[jj][1];
+    yr = y[jj][0]; yi = y[jj][1];
+    x[jj][0] = g*xr - s*yi;
+    x[jj][1] = g*xi + s*yr;
+    y[jj][0] = g*yr - s*xi;
+    y[jj][1] = g*yi + s*xr;
+  }
+}
+
+
+/* Coherency of the total field, samples a..b-1: t11 = 2*sum_n |A_n|^2
+ * and, for dual polarization (circular basis), t12 = 2*sum_n a_n*b_n' */
+void coherency(wdm_band* bands,int nbands,int npol,int nt,int a,int b,
+               REAL* t11,COMPLEX* t12)
+{
+  int m,jj;
+  COMPLEX *x,*y;
+
+  for (jj = a; jj < b; jj++) {
+    t11[jj] = 0;
+    if (npol == 2)
+      t12[jj][0] = t12[jj][1] = 0;
+  }
+  for (m = 0; m < nbands; m++) {
+    x = bands[m].u;
+    if (npol == 1) {
+      for (jj = a; jj < b; jj++)
+        t11[jj] += 2*abs2(&x[jj]);
+    } else {
+      y = x + nt;
+      for (jj = a; jj < b; jj++) {
+        t11[jj] += 2*(abs2(&x[jj]) + abs2(&y[jj]));
+        t12[jj][0] += 2*(x[jj][0]*y[jj][0] + x[jj][1]*y[jj][1]);
+        t12[jj][1] += 2*(x[jj][1]*y[jj][0] - x[jj][0]*y[jj][1]);
+      }
+    }
+  }
+}
+
+
+/* Self- and cross-phase modulation of a band: A = exp(j*phi*M)*A with
+ * M the matrix M_m above.  For a Hermitian M = tr*I + [dd m12; m12* -dd],
+ *
+ *   exp(j*phi*M) = exp(j*phi*tr)*(cos(phi*r)*I + j*sin(phi*r)/r*(M - tr*I))
+ *
+ * with r = sqrt(dd^2 + |m12|^2). */
+void xpm_band(wdm_band* b,int npol,int nt,const REAL* t11,COMPLEX* t12,
+              REAL phi)
+{
+  int jj;
+  COMPLEX *x = b->u,*y = b->u + nt;
+  REAL m11,m22,m12r,m12i,tr,dd,r,c,s,sr,er,ei,ar,ai,br,bi,xr,xi,yr,yi;
+
+  if (npol == 1) {
+    for (jj = 0; jj < nt; jj++) {
+      tr = phi*(t11[jj] - abs2(&x[jj]));
+      c = cos(tr);
+      s = sin(tr);
+      xr = x[jj][0];
+      x[jj][0] = xr*c - x[jj][1]*s;
+      x[jj][1] = xr*s + x[jj][1]*c;
+    }
+    return;
+  }
+
+  for (jj = 0; jj < nt; jj++) {
+    xr = x[jj][0]; xi = x[jj][1];
+    yr = y[jj][0]; yi = y[jj][1];
+    m11 = t11[jj] - (xr*xr + xi*xi);
+    m22 = t11[jj] - (yr*yr + yi*yi);
+    m12r = t12[jj][0] - 2*(xr*yr + xi*yi);
+    m12i = t12[jj][1] - 2*(xi*yr - xr*yi);
+    tr = (m11 + m22)/2;
+    dd = (m11 - m22)/2;
+    r = sqrt(dd*dd + m12r*m12r + m12i*m12i);
+    c = cos(phi*r);
+    sr = (r*phi > 1e-12) ? sin(phi*r)/r : phi;
+    er = cos(phi*tr);
+    ei = sin(phi*tr);
+    /* x' = c*x + j*sr*(dd*x + m12*y), y' = c*y + j*sr*(m12'*x - dd*y) */
+    ar = c*xr - sr*(dd*xi + m12r*yi + m12i*yr);
+    ai = c*xi + sr*(dd*xr + m12r*yr - m12i*yi);
+    br = c*yr - sr*(m12r*xi - m12i*xr - dd*yi);
+    bi = c*yi + sr*(m12r*xr + m12i*xi - dd*yr);
+    x[jj][0] = er*ar - ei*ai;
+    x[jj][1] = er*ai + ei*ar;
+    y[jj][0] = er*br - ei*bi;
+    y[jj][1] = er*bi + ei*br;
+  }
+}
+
+
+/* Four-wave mixing increment of band m: d = j*phi*sum (A_n'*A_l)*A_k,
+ * plus (a_k*b_l + b_k*a_l)/2*[conj(b_n); conj(a_n)] for dual
+ * polarization, over k + l - n = m on the grid, {k,l} != {m,n}, with
+ * the three bands at most fwm positions from m.  band_at[g - gmin] is the band at grid
+ * position g (-1 if none), for gmin <= g < gmin + gspan. */
+void fwm_band(wdm_band* bands,int nbands,int m,int npol,int nt,
+              const int* grid,const int* band_at,int gmin,int gspan,
+              int fwm,REAL phi)
+{
+  int k,l,n,gn,jj,ip;
+  COMPLEX *d = bands[m].d,*ak,*al,*an;
+  REAL sr,si,qr,qi,re;
+
+  for (jj = 0; jj < npol*nt; jj++)
+    d[jj][0] = d[jj][1] = 0;
+
+  for (k = 0; k < nbands; k++) {
+    if (abs(grid[k] - grid[m]) > fwm)
+      continue;
+    for (l = 0; l < nbands; l++) {
+      gn = grid[k] + grid[l] - grid[m];
+      if (abs(grid[l] - grid[m]) > fwm || abs(gn - grid[m]) > fwm
+          || gn < gmin || gn >= gmin + gspan)
+        continue;
+      n = band_at[gn - gmin];
+      if (n < 0 || (k == m && l == n) || (k == n && l == m))
+        continue;
+      ak = bands[k].u;
+      al = bands[l].u;
+      an = bands[n].u;
+      for (jj = 0; jj < nt; jj++) {
+        /* s = A_n'*A_l */
+        sr = si = 0;
+        for (ip = 0; ip < npol; ip++) {
+          sr += an[ip*nt + jj][0]*al[ip*nt + jj][0] + an[ip*nt + jj][1]*al[ip*nt + jj][1];
+          si += an[ip*nt + jj][0]*al[ip*nt + jj][1] - an[ip*nt + jj][1]*al[ip*nt + jj][0];
+        }
+        for (ip = 0; ip < npol; ip++) {
+          d[ip*nt + jj][0] += sr*ak[ip*nt + jj][0] - si*ak[ip*nt + jj][1];
+          d[ip*nt + jj][1] += sr*ak[ip*nt + jj][1] + si*ak[ip*nt + jj][0];
+        }
+        if (npol == 2) {
+          /* q = (a_k*b_l + b_k*a_l)/2, d += q*[conj(b_n); conj(a_n)] */
+          qr = (ak[jj][0]*al[nt + jj][0] - ak[jj][1]*al[nt + jj][1]
+                + ak[nt + jj][0]*al[jj][0] - ak[nt + jj][1]*al[jj][1])/2;
+          qi = (ak[jj][0]*al[nt + jj][1] + ak[jj][1]*al[nt + jj][0]
+                + ak[nt + jj][0]*al[jj][1] + ak[nt + jj][1]*al[jj][0])/2;
+          d[jj][0] += qr*an[nt + jj][0] + qi*an[nt + jj][1];
+          d[jj][1] += qi*an[nt + jj][0] - qr*an[nt + jj][1];
+          d[nt + jj][0] += qr*an[jj][0] + qi*an[jj][1];
+          d[nt + jj][1] += qi*an[jj][0] - qr*an[jj][1];
+        }
+      }
+    }
+  }
+
+  /* d = j*phi*d */
+  for (jj = 0; jj < npol*nt; jj++) {
+    re = d[jj][0];
+    d[jj][0] = -phi*d[jj][1];
+    d[jj][1] = phi*re;
+  }
+}
+
+
+/* This is the gateway function between MATLAB and WDMSSF_MEX.  It
+ * serves as the main(). */
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  REAL dt;           /* sampling period of the bands */
+  REAL h;            /* step length */
+  REAL alpha,gamma,leff,phi;
+  int nz;            /* number of steps */
+  int nt;            /* samples per band */
+  int nbands,npol;   /* bands, polarizations per band */
+  int fwm;           /* FWM order */
+  int nthreads;
+  int gmin,gmax,gspan,*grid,*band_at;
+  double *df;
+  wdm_band* bands;
+  REAL* t11;
+  COMPLEX* t12 = NULL;
+  PLAN pf,pb;
+  int m,kk,iz,nchunks,ch;
+
+  if (plancache_option(nrhs,prhs))
+    return;
+
+  if (nrhs < 9)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 1)
+    mexErrMsgTxt("Too many output arguments.");
+
+  plancache_begin();
+
+  /* parse input arguments */
+  if (!mxIsDouble(prhs[0]) || !mxIsDouble(prhs[2]) || !mxIsDouble(prhs[3]) || !mxIsDouble(prhs[7]))
+    mexErrMsgTxt("The arguments must be double arrays.");
+  nt = (int) mxGetM(prhs[0]);
+  dt = (REAL) mxGetScalar(prhs[1]);
+  nbands = (int) mxGetNumberOfElements(prhs[2]);
+  if (nbands < 1 || (int) mxGetNumberOfElements(prhs[3]) != nbands)
+    mexErrMsgTxt("df and grid must have one element per band.");
+  if (mxGetN(prhs[0]) % nbands || mxGetN(prhs[0])/nbands > 2)
+    mexErrMsgTxt("The field must have 1 or 2 columns per band.");
+  npol = (int) (mxGetN(prhs[0])/nbands);
+  nz = (int) mxGetScalar(prhs[5]);
+  if (nz < 1)
+    mexErrMsgTxt("At least one step is required.");
+  h = (REAL) (mxGetScalar(prhs[4])/nz);
+  alpha = (REAL) mxGetScalar(prhs[6]);
+  gamma = (REAL) mxGetScalar(prhs[8]);
+  fwm = (int) robomex_optional(nrhs,prhs,9,0);
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,10,0));
+  df = mxGetPr(prhs[2]);
+
+  /* band at each grid position */
+  grid = (int*) mxMalloc(sizeof(int)*nbands);
+  gmin = gmax = (int) mxGetPr(prhs[3])[0];
+  for (m = 0; m < nbands; m++) {
+    grid[m] = (int) mxGetPr(prhs[3])[m];
+    if (grid[m] < gmin) gmin = grid[m];
+    if (grid[m] > gmax) gmax = grid[m];
+  }
+  gspan = gmax - gmin + 1;
+  band_at = (int*) mxMalloc(sizeof(int)*gspan);
+  for (m = 0; m < gspan; m++)
+    band_at[m] = -1;
+  for (m = 0; m < nbands; m++) {
+    if (band_at[grid[m] - gmin] >= 0)
+      mexErrMsgTxt("Two bands are at the same grid position.");
+    band_at[grid[m] - gmin] = m;
+  }
+
+  /* allocate memory */
+  bands = (wdm_band*) mxMalloc(sizeof(wdm_band)*nbands);
+  for (m = 0; m < nbands; m++) {
+    bands[m].u = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*nt*npol);
+    bands[m].hs = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*nt);
+    bands[m].d = fwm > 0 ? (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*nt*npol) : NULL;
+    for (kk = 0; kk < npol; kk++)
+      robomex_get_column(bands[m].u + kk*nt, prhs[0], m*npol + kk);
+    if (npol == 2)
+      to_circular(bands[m].u,nt,0);
+  }
+  t11 = (REAL*) robomex_malloc(sizeof(REAL)*nt);
+  if (npol == 2)
+    t12 = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*nt);
+
+  /* fftw3 plans (from the session cache) */
+  pf = plancache_get(PLANCACHE_FORWARD, nt, npol, 1);
+  pb = plancache_get(PLANCACHE_BACKWARD, nt, npol, 1);
+
+  leff = (alpha > 0) ? (1-exp(-alpha*h))/alpha : h;
+  phi = (npol == 2 ? 2.0/3.0 : 1.0)*gamma*leff;
+  nchunks = (nt + MINCHUNK - 1)/MINCHUNK;
+  if (nchunks > nthreads)
+    nchunks = nthreads;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+#endif
+  for (m = 0; m < nbands; m++)
+    compute_hband(bands[m].hs,dt,prhs[7],(REAL) df[m],h,alpha,nt);
+
+  for (iz = 0; iz < nz; iz++) {
+
+    /* Nonlinear step: coherency of the total field, by chunks of samples */
+    if (gamma != 0) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nchunks) schedule(static)
+#endif
+      for (ch = 0; ch < nchunks; ch++)
+        coherency(bands,nbands,npol,nt,(int) ((double) nt*ch/nchunks),
+                  (int) ((double) nt*(ch + 1)/nchunks),t11,t12);
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+      for (m = 0; m < nbands; m++)
+        if (fwm > 0)
+          fwm_band(bands,nbands,m,npol,nt,grid,band_at,gmin,gspan,fwm,phi);
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+      for (m = 0; m < nbands; m++) {
+        int jj;
+        xpm_band(&bands[m],npol,nt,t11,t12,phi);
+        if (fwm > 0)
+          for (jj = 0; jj < npol*nt; jj++) {
+            bands[m].u[jj][0] += bands[m].d[jj][0];
+            bands[m].u[jj][1] += bands[m].d[jj][1];
+          }
+      }
+    }
+
+    /* Linear step of each band: u = ifft(hs.*fft(u)) */
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+    for (m = 0; m < nbands; m++) {
+      int jj,ip;
+      REAL re;
+      COMPLEX *u,*hs = bands[m].hs;
+      EXECUTE_DFT(pf,bands[m].u,bands[m].u);
+      for (ip = 0; ip < npol; ip++) {
+        u = bands[m].u + ip*nt;
+        for (jj = 0; jj < nt; jj++) {
+          re = hs[jj][0]*u[jj][0] - hs[jj][1]*u[jj][1];
+          u[jj][1] = hs[jj][0]*u[jj][1] + hs[jj][1]*u[jj][0];
+          u[jj][0] = re;
+        }
+      }
+      EXECUTE_DFT(pb,bands[m].u,bands[m].u);
+    }
+  }
+
+  /* allocate space for returned matrix */
+  plhs[0] = mxCreateDoubleMatrix(nt,nbands*npol,mxCOMPLEX);
+  for (m = 0; m < nbands; m++) {
+    if (npol == 2)
+      to_circular(bands[m].u,nt,1);
+    for (kk = 0; kk < npol; kk++)
+      robomex_set_column(plhs[0], m*npol + kk, bands[m].u + kk*nt, 1.0);
+    FFTW_FREE(bands[m].u);
+    FFTW_FREE(bands[m].hs);
+    if (bands[m].d)
+      FFTW_FREE(bands[m].d);
+  }
+
+  /* de-allocate memory */
+  mxFree(bands);
+  mxFree(grid);
+  mxFree(band_at);
+  FFTW_FREE(t11);
+  if (t12)
+    FFTW_FREE(t12);
+}
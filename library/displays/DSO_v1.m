@@ -12,6 +12,10 @@
 %> Learns most information from the signal - it is best to not pass
 %> parameters yourself.
 %>
+%> The spectrum is a Welch estimate (welchPSD) and the eye diagrams and
+%> constellations are density histograms of all the samples
+%> (densityHistogram), so that long signals are displayed quickly.
+%>
 %> While debugging, you can call the static method
 %> DSO_v1.plot(signal_interface object) or DSO_v1.plotSignal(y, Nss, Fs)
 %> to see how your signal looks.
@@ -53,6 +57,7 @@ classdef DSO_v1 < unit
             obj.maxlength = paramdefault(param, 'maxlength', 0);
             obj.only = paramdefault(param,'only',[]);
             obj.enable = paramdefault(param, 'enable', 1);
+            obj.clientTraverse = true; % Figures are drawn by the client
         end
         
         %> @brief Gathers information about signal, plots
@@ -240,8 +245,9 @@ classdef DSO_v1 < unit
         
         function plotSpectrum(y, Nss, Fs)
             colors;
-            [ f, spectrum ] = spectra(y, Fs, 0);
-            s = 10*log10(spectrum.*conj(spectrum)*1e3);
+            nfft = min(2^nextpow2(length(y)), 2^13);
+            [P, f] = welchPSD(y, Fs, nfft);
+            s = 10*log10(P*Fs/nfft*1e3); % Power per bin
             sm = smooth(s,length(s)/100);
             adj = max(s)-max(sm);
             BW = find(sm>max(sm(10:end))-3);
@@ -256,7 +262,7 @@ classdef DSO_v1 < unit
             gridxy(BW*1e-9, (max(sm)-3), 'LineStyle', '--', 'color', [1 1 1]./1.5)
             hold off
             ylim([mean(s) max(s(100:end))])
-            xlim([0 Fs/2*1e-9])
+            xlim([f(1) f(end)]*1e-9)
             grid on
             ylabel('dBm')
             xlabel('GHz')
@@ -281,10 +287,11 @@ classdef DSO_v1 < unit
             y_eye=y(1:Nss*NumberOfEyes*NumberOfStoredTraces);
             y_eyeI = reshape(real(y_eye),Nss*NumberOfEyes,length(y_eye)/Nss/NumberOfEyes);
             t_eye=(0:(Nss*NumberOfEyes-1))/Fs*1e12;
-            for e=1:size(y_eyeI,2)
-                patchline(t_eye, y_eyeI(:,e), 'edgecolor', blue, 'edgealpha',0.1,'linewidth',1 )
-            end
-%             plot(t_eye, y_eyeI, 'color', blue, 'linewidth',5)
+            % Density of all the traces, one column per sample
+            [H, ~, yc] = densityHistogram(real(y), DSO_v1.ylim_time(y), [Nss*NumberOfEyes 256], [], Nss*NumberOfEyes);
+            imagesc(t_eye, yc, log10(1+H))
+            axis xy
+            colormap(gca, DSO_v1.densityColormap(blue))
             hold on
             
             y_opt = var(y_eyeI,0,2);
@@ -303,8 +310,11 @@ classdef DSO_v1 < unit
         function plotConstellation(varargin)
             srx = double(varargin{1});
             colors;
-            scatplot(real(srx),imag(srx),'voronoi');
-%             plot(srx, '.', 'color', blue, 'MarkerSize',3);
+            r = max(1.1*max(abs([real(srx(:)); imag(srx(:))])), eps);
+            [H, xc, yc] = densityHistogram(srx, r*[-1 1 -1 1], [256 256]);
+            imagesc(xc, yc, log10(1+H))
+            axis xy
+            colormap(gca, DSO_v1.densityColormap(blue))
             hold on
             if nargin >1
                 % Plot clusters centroids
@@ -331,6 +341,10 @@ classdef DSO_v1 < unit
         function ylim_time = ylim_time(y)
             ylim_time = 1.1*[min(real(y)) max(real(y))];
         end
+        %> @brief Colormap of the density plots, from white to color
+        function cmap = densityColormap(color)
+            cmap = 1-bsxfun(@times, linspace(0,1,64).', 1-color);
+        end
     end
 end
 
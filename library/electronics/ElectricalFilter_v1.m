@@ -12,6 +12,10 @@
 %> __Observations__
 %> The input signal shall be a complex signal_interface signal.
 %>
+%> The frequency response of the filters is cached for the last filter
+%> parameters and signal size, and the components are filtered together
+%> with fftFilter.
+%>
 %>
 %> __Bypass Example__
 %> If one does not define Rectangular, Gaussian and Bessel filters, the
@@ -102,7 +106,17 @@ classdef ElectricalFilter_v1 < unit
         amplitudeImbalance = 1;
         %> DC level
         levelDC = 0;
-        
+        %> Use the native filtering engine (fftfilter_mex) if compiled
+        mexEnabled = true;
+        %> Number of threads of the native engine. 0: all processors
+        nThreads = 0;
+    end
+    
+    properties (Hidden=true)
+        %> Parameters of the cached response
+        filterKey = {};
+        %> Cached frequency response (FFT order)
+        filterH;
     end
     
     methods
@@ -138,9 +152,14 @@ classdef ElectricalFilter_v1 < unit
         %> @param param.levelDC                 A vector containing DC levels to be ADDED to each of in-phase and
         %>                                      quadrature signals. [Default: 0].
         %>
+        %> @param param.mexEnabled              Use the native filtering engine if compiled. [Default: true]
+        %>
+        %> @param param.nThreads                Number of threads of the native engine, 0 for all processors.
+        %>                                      [Default: 0]
+        %>
         function obj = ElectricalFilter_v1(param)
             
-            obj.setparams(param, {}, {'besselOrder','gaussianOrder','rectangularFilter', 'outputVoltage', 'amplitudeImbalance', 'levelDC','rectangularBandwidth', 'gaussianBandwidth', 'besselBandwidth'})
+            obj.setparams(param, {}, {'besselOrder','gaussianOrder','rectangularFilter', 'outputVoltage', 'amplitudeImbalance', 'levelDC','rectangularBandwidth', 'gaussianBandwidth', 'besselBandwidth', 'mexEnabled', 'nThreads'})
             
             if isempty(obj.gaussianBandwidth) && obj.gaussianOrder
                 robolog('As "param.gaussianOrder ~=0", so you should define "param.gaussianBandwidth" for ElectricalFilter.', 'ERR');
@@ -159,32 +178,12 @@ classdef ElectricalFilter_v1 < unit
         function out = traverse(obj, in)
             
             %% First part: Driver Filtering
-            
-            filterFreqDomain = 1;
-            
-            % Defining Rectangular Filter
-            if obj.rectangularFilter
-                rectCoeffs = (2*obj.rectangularBandwidth/(in.Fs))*sinc(2*in.Nss*(obj.rectangularBandwidth/(in.Fs))*linspace(-floor(in.L/2-1)/(in.Nss), floor(in.L/2-1)/(in.Nss), floor(in.L/2-1)*2+1)).';
-                shiftLength = floor(length(rectCoeffs)/2);
-                rectCoeffs(in.L) = 0;
-                filterFreqDomain = filterFreqDomain.*fftshift(fft(circshift(rectCoeffs(:), [-shiftLength 0])));
-                clear rectCoeffs
-            end
-            
-            % Defining Gaussian Filter
-            if obj.gaussianOrder
-                filterFreqDomain = filterFreqDomain.*exp(-log(sqrt(2))*((linspace(-0.5,0.5,in.L)/(obj.gaussianBandwidth/(in.Fs))).').^(2*obj.gaussianOrder));
-            end
-            
-            % Defining Bessel Filter
-            if obj.besselOrder
-                [B,A] = besself(obj.besselOrder, obj.besselBandwidth);
-                besselFilter = polyval(B, in.Fs*2j*pi*linspace(-0.5,0.5,in.L))./polyval(A, in.Fs*2j*pi*linspace(-0.5,0.5,in.L));
-                filterFreqDomain = filterFreqDomain.*exp(1j*angle(besselFilter(:)));
-            end
+            H = obj.response(in.Fs, in.L, in.Nss);
             
             % Filtering the input data
-            in = in.fun1(@(x) obj.filterByFFT(x, filterFreqDomain));
+            if ~isscalar(H)
+                in = in.funCols(@(X) fftFilter(X, H, obj.mexEnabled, obj.nThreads));
+            end
             
             %% Driver Amplitude
             outputSignal = in.getRaw;
@@ -232,8 +231,58 @@ classdef ElectricalFilter_v1 < unit
             out = signal_interface(outputSignal, struct('Rs', in.Rs, 'Fs', in.Fs, 'Fc', in.Fc, 'PCol', [Power{:}]));
             
         end
+
+        %> @brief Frequency response of the driver filters
+        %>
+        %> Product of the rectangular, Gaussian and Bessel responses, in
+        %> FFT order (the fftshift of filterByFFT is folded in). The
+        %> response is cached for the last filter parameters and signal
+        %> size.
+        %>
+        %> @param Fs    Sampling rate [Hz]
+        %> @param L     Number of samples
+        %> @param Nss   Number of samples per symbol
+        %>
+        %> @retval H    Frequency response, L-by-1 (1 if there is no filter)
+        function H = response(obj, Fs, L, Nss)
+            key = {obj.rectangularFilter, obj.rectangularBandwidth, obj.gaussianOrder, obj.gaussianBandwidth, ...
+                obj.besselOrder, obj.besselBandwidth, Fs, L, Nss};
+            if isequal(key, obj.filterKey)
+                H = obj.filterH;
+                return
+            end
+            
+            filterFreqDomain = 1;
+            
+            % Defining Rectangular Filter
+            if obj.rectangularFilter
+                rectCoeffs = (2*obj.rectangularBandwidth/(Fs))*sinc(2*Nss*(obj.rectangularBandwidth/(Fs))*linspace(-floor(L/2-1)/(Nss), floor(L/2-1)/(Nss), floor(L/2-1)*2+1)).';
+                shiftLength = floor(length(rectCoeffs)/2);
+                rectCoeffs(L) = 0;
+                filterFreqDomain = filterFreqDomain.*fftshift(fft(circshift(rectCoeffs(:), [-shiftLength 0])));
+                clear rectCoeffs
+            end
+            
+            % Defining Gaussian Filter
+            if obj.gaussianOrder
+                filterFreqDomain = filterFreqDomain.*exp(-log(sqrt(2))*((linspace(-0.5,0.5,L)/(obj.gaussianBandwidth/(Fs))).').^(2*obj.gaussianOrder));
+            end
+            
+            % Defining Bessel Filter
+            if obj.besselOrder
+                [B,A] = besself(obj.besselOrder, obj.besselBandwidth);
+                besselFilter = polyval(B, Fs*2j*pi*linspace(-0.5,0.5,L))./polyval(A, Fs*2j*pi*linspace(-0.5,0.5,L));
+                filterFreqDomain = filterFreqDomain.*exp(1j*angle(besselFilter(:)));
+            end
+            
+            % ifft(ifftshift(fftshift(fft(x)).*F)) = ifft(fft(x).*ifftshift(F))
+            H = ifftshift(filterFreqDomain);
+            obj.filterH = H;
+            obj.filterKey = key;
+        end
     end
     methods (Static)
+        %> @brief Filter a column with a response centered at DC
         function io = filterByFFT(io, filter)
             io = fftshift(fft(io(:)));
             io = ifft(ifftshift(io.*filter(:)));
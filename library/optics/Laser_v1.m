@@ -14,6 +14,9 @@
 %>  -# FM noise PSD is converted to time domain using IDFT
 %>  -# FM noise PSD is convolved with white Gaussian noise
 %>  -# PM noise is generated by integrating FM noise
+%> The white noise is generated with philoxRandn from (seed, noiseStream,
+%> number of the noise sequence), so a laser with a seed produces a
+%> reproducible phase noise that can be regenerated without storing it.
 %> The length of the FM noise PSD is specified in model.Lpsd, or in the
 %> constructor, param.L. Noise at the lowest frequency component (DC) is
 %> forced to zero unless L=1.  This means phase noise will be zero-mean
@@ -106,6 +109,14 @@ classdef Laser_v1 < unit
         Lnoise;
         %> Saves the waveform onto a file for speed porposes
         cacheEnabled = 0;
+        %> Seed of the phase noise (empty: drawn from MATLAB's generator)
+        seed = [];
+        %> Noise stream of this laser
+        noiseStream = 0;
+        %> Use the native noise generator (philox_mex) if compiled
+        mexEnabled = true;
+        %> Number of threads of the native noise generator. 0: all processors
+        nThreads = 0;
         
         % General properties
         %> Output power (pwr object)
@@ -141,6 +152,11 @@ classdef Laser_v1 < unit
         alpha;
     end
     
+    properties (Hidden=true)
+        %> Number of noise sequences generated so far (substream of the noise)
+        nGenerated = 0;
+    end
+    
     methods
         
         %> @brief Class constructor
@@ -161,13 +177,17 @@ classdef Laser_v1 < unit
         %> @param param.fr relaxation resonance frequency [Hz]
         %> @param param.K Damping factor
         %> @param param.alpha Linewidth enhancement factor [unitless]
+        %> @param param.seed Seed of the phase noise, integer in [0, 2^32-1]. Default: drawn for each sequence
+        %> @param param.noiseStream Noise stream of the laser. Default: 0
+        %> @param param.mexEnabled Use the native noise generator if compiled. Default: true
+        %> @param param.nThreads Number of threads of the native noise generator. Default: 0 (all processors)
         %>
         function obj = Laser_v1(param)
             % Check Fs and Rs is given (source) or takes it from an input
             REQUIRED_PARAMS = {};
             QUIET_PARAMS = {'Fs', 'Lnoise', 'model', 'nInputs', 'nOutputs', ...
                 'FMnoiseCal', 'PMnoiseCal', 'fn', 'pn', 'results', 'label', ...
-                'L', 'draw','cacheEnabled', 'Power'};
+                'L', 'draw','cacheEnabled', 'Power', 'seed', 'noiseStream', 'mexEnabled', 'nThreads'};
             
             if isfield(param, 'Fs') && isfield(param, 'Lnoise')
                 obj.Fs=param.Fs;
@@ -320,7 +340,14 @@ classdef Laser_v1 < unit
                                 %gives this equation
             end
             % Frequency and phase noise generation
-            noise = awgn(zeros(2*obj.Lnoise,1),0)/sqrt(obj.Fs);
+            if isempty(obj.seed)
+                seed = randi([0 2^32-1]);
+            else
+                seed = obj.seed;
+            end
+            noise = philoxRandn(2*obj.Lnoise, 1, seed, [obj.noiseStream obj.nGenerated], false, ...
+                obj.mexEnabled, obj.nThreads)/sqrt(obj.Fs);
+            obj.nGenerated = obj.nGenerated + 1;
             fn =conv(noise,h_fn,'valid');
             pn = cumsum(2*pi*fn/obj.Fs);
             if obj.limitPn>0
@@ -0,0 +1,261 @@
+%> @file CoherentDetector_v1.m
+%> @brief Fused optical hybrid and balanced detection
+%>
+%> @class CoherentDetector_v1
+%> @brief Fused optical hybrid and balanced detection
+%>
+%> @ingroup physModels
+%>
+%> Equivalent of an OpticalHybrid_v1 followed by two BalancedPair_v1 (I and
+%> Q, modeAdditionEnabled = false) and a complex interleaving Combiner_v1,
+%> as in CoherentFrontend_v2, computed in one pass: the four outputs of the
+%> hybrid and the photocurrents of the balanced pairs are never stored, the
+%> output is the complex current I + 1j*Q of each mode.
+%>
+%> The model and the power/SNR bookkeeping are those of the three units:
+%> responsivity, finite CMRR, shot and thermal noise, 2nd order Butterworth
+%> low-pass filter (the first 15 samples are dropped). The noise currents
+%> are generated with philoxRandn (columns I1, Q1, I2, Q2, ...), so they
+%> are determined by (seed, noiseStream, number of the traverse) and do
+%> not depend on the number of threads. The native engine (cohrx_mex) is
+%> used if compiled (see compileMex), otherwise the equivalent MATLAB
+%> implementation.
+%>
+%> __Example__
+%> @code
+%> detector = CoherentDetector_v1(struct('R', 1, 'CMRR', 30, 'f3dB', 32e9));
+%> out = detector.traverse(sig, lo);
+%> @endcode
+%>
+%> Signal inputs: 2
+%>      -Signal to input 1, LO to input 2 (swapping them swaps I and Q)
+%>
+%> @version 1
+classdef CoherentDetector_v1 < unit
+
+    properties
+        %> Optical hybrid phase angle [rad]
+        phase_angle = pi/2;
+        %> Responsivity (A/W)
+        R = 1;
+        %> Common-mode rejection ratio (dB)
+        CMRR = inf;
+        %> 3dB cutoff frequency (Hz)
+        f3dB = 40e9;
+        %> thermal resistance (ohm)
+        Rtherm = 50;
+        %> Temperature (K)
+        T = 290;
+        %> Seed of the noise currents (empty: drawn from MATLAB's generator)
+        seed = [];
+        %> Noise stream of this detector
+        noiseStream = 0;
+        %> Number of threads of the native engine. 0: all processors
+        nThreads = 0;
+        %> Use the native engine if available
+        mexEnabled = true;
+
+        %> Number of input arguments
+        nInputs = 2;
+        %> Number of output arguments
+        nOutputs = 1;
+    end
+
+    properties (Hidden=true)
+        %> Number of traverses so far (substream of the noise)
+        nTraversed = 0;
+    end
+
+    methods (Static)
+
+        %> @brief MATLAB implementation of the detection (same algorithm as cohrx_mex)
+        %>
+        %> @param S      signal, L-by-N
+        %> @param LO     local oscillator, L-by-N
+        %> @param dnu    frequency of the signal relative to the LO [cycles/sample]
+        %> @param phase  hybrid phase exp(1j*phase_angle) of each mode
+        %> @param R      responsivity of each mode
+        %> @param Rmix   mixing ratio of the balanced pairs of each mode
+        %> @param sigma  standard deviation of the noise currents, 2-by-N (I, Q)
+        %> @param b      low-pass filter numerator
+        %> @param a      low-pass filter denominator
+        %> @param skip   number of samples dropped at the beginning
+        %> @param seed   noise seed
+        %> @param stream noise stream [id subid]
+        %>
+        %> @retval Y     I + 1j*Q, (L-skip)-by-N
+        %> @retval stats 8-by-N statistics (see cohrx_mex)
+        function [Y, stats] = detect(S, LO, dnu, phase, R, Rmix, sigma, b, a, skip, seed, stream)
+            [L, N] = size(S);
+            beat = bsxfun(@times, S.*conj(LO), exp(2j*pi*mod(dnu*(0:L-1)', 1)));
+            common = bsxfun(@times, abs(S).^2+abs(LO).^2, Rmix(:).'/8);
+            I = bsxfun(@times, real(beat)/4+common, R(:).');
+            Q = bsxfun(@times, real(bsxfun(@times, beat, conj(phase(:).')))/4+common, R(:).');
+            stats = [mean(abs(S).^2, 1); mean(abs(LO).^2, 1); real(mean(beat, 1)); imag(mean(beat, 1)); ...
+                mean(I.^2, 1); mean(Q.^2, 1); zeros(2, N)];
+            noise = philoxRandn(L, 2*N, seed, stream);
+            I = filter(b, a, I+bsxfun(@times, noise(:,1:2:end), sigma(1,:)));
+            Q = filter(b, a, Q+bsxfun(@times, noise(:,2:2:end), sigma(2,:)));
+            Y = complex(I(skip+1:end,:), Q(skip+1:end,:));
+            stats(7:8,:) = [mean(real(Y).^2, 1); mean(imag(Y).^2, 1)];
+        end
+
+        %> @brief Measured powers of the hybrid outputs (I+, I-, Q+, Q-)
+        %>
+        %> @param Ps    mean(|s|^2) of each mode, 1-by-N
+        %> @param Plo   mean(|lo|^2) of each mode, 1-by-N
+        %> @param beat  mean of the beat of each mode, 1-by-N
+        %> @param phase hybrid phase of each mode, N-by-1
+        %>
+        %> @retval Pport 4-by-N powers [W]
+        function Pport = portPowers(Ps, Plo, beat, phase)
+            c = [ones(numel(phase),1) -ones(numel(phase),1) phase(:) -phase(:)];
+            Pport = (repmat(Ps+Plo, 4, 1)+2*real(bsxfun(@times, c.', conj(beat))))/16;
+        end
+
+        %> @brief Sum of an array of power objects
+        function P = total(PCol)
+            P = PCol(1);
+            for jj=2:numel(PCol)
+                P = P + PCol(jj);
+            end
+        end
+
+    end
+
+    methods
+
+        %>  @brief Class constructor
+        %>
+        %> @param param.phase_angle Hybrid phase angle [rad] [Default: pi/2]
+        %> @param param.R Responsivity [A/W] [Default: 1]
+        %> @param param.f3dB electrical 3dB bandwidth [Hz] [Default: 40G]
+        %> @param param.Rtherm resistance for thermal noise calculation [ohm] [Default: 50]
+        %> @param param.CMRR common-mode rejection ratio [dB][Default: inf]
+        %> @param param.T Temperature [K][Default: 290]
+        %> @param param.seed Seed of the noise currents, integer in [0, 2^32-1]. [Default: drawn at each traverse]
+        %> @param param.noiseStream Noise stream of the detector. [Default: 0]
+        %> @param param.nThreads Number of threads (native engine). 0 uses all processors. [Default: 0]
+        %> @param param.mexEnabled Use the native engine if compiled. [Default: true]
+        %>
+        %> @retval CoherentDetector object
+        function obj = CoherentDetector_v1(param)
+            if nargin<1, param = struct([]); end
+            obj.setparams(param);
+        end
+
+        %>  @brief Traverse function
+        %>
+        %> @param sig Input signal
+        %> @param lo Input local oscillator
+        %>
+        %> @retval out I + 1j*Q of each mode
+        %> @retval results.Rmix mixing ratio from CMRR calculation
+        function out = traverse(obj, sig, lo)
+            if sig.Fs~=lo.Fs || sig.N~=lo.N || sig.L~=lo.L
+                robolog('Sampling rate, and signal sizes of both signals must be equal.','ERR');
+            end
+            N = sig.N;
+            phase = obj.perMode(exp(1j*obj.phase_angle), N, 'phase angles');
+            R = obj.perMode(obj.R, N, 'responsivities');
+            Rmix = 0.5./(10.^(obj.perMode(obj.CMRR, N, 'CMRRs')/10));
+
+            dnu = (sig.Fc-lo.Fc)/sig.Fs;
+            S = double(getScaled(sig));
+            LO = double(getScaled(lo));
+
+            % Noise currents of each balanced pair (as BalancedPair_v1):
+            % shot noise of the measured power at its two inputs, summed
+            % over the modes, and thermal noise. The beats of the two
+            % outputs of a pair cancel, so their powers follow from the
+            % measured signal and LO powers without a pass over the beat.
+            Pport = obj.portPowers(pwr.meanpwr(S), pwr.meanpwr(LO), zeros(1, N), phase);
+            Pin_an = [sum(Pport(1,:)+Pport(2,:)); sum(Pport(3,:)+Pport(4,:))];
+            Pnshot = 2*const.q*Pin_an*R.'*obj.f3dB;
+            Pntherm = 4*const.kB*obj.T/obj.Rtherm*obj.f3dB;
+            sigma = sqrt(Pnshot+Pntherm);
+
+            % low-pass filter
+            filtered = 2*obj.f3dB/sig.Fs < 1;
+            if filtered
+                [b, a] = butter(2, 2*obj.f3dB/sig.Fs);
+                skip = min([16, sig.L])-1;      %filter messes up first few samples
+            else
+                robolog('Sample rate too low to apply low-pass filter', 'WRN');
+                b = 1;
+                a = 1;
+                skip = 0;
+            end
+
+            if isempty(obj.seed)
+                seed = randi([0 2^32-1]);
+            else
+                seed = obj.seed;
+            end
+            stream = [obj.noiseStream obj.nTraversed];
+            obj.nTraversed = obj.nTraversed + 1;
+
+            if obj.mexEnabled && hasMex('cohrx_mex')
+                [Y, stats] = cohrx_mex(S, LO, dnu, complex(phase), R, Rmix, sigma, b, a, skip, seed, stream, obj.nThreads);
+            else
+                [Y, stats] = obj.detect(S, LO, dnu, phase, R, Rmix, sigma, b, a, skip, seed, stream);
+            end
+
+            % Power tracking of the hybrid outputs (I+, I-, Q+, Q-): SNR of
+            % the sum of the inputs, measured power
+            PColIn = sig.PCol + lo.PCol;
+            Pport = obj.portPowers(stats(1,:), stats(2,:), stats(3,:)+1j*stats(4,:), phase);
+            PColPort = cell(1, 4);
+            for k=1:4
+                for jj=1:N
+                    PColPort{k}(jj) = pwr(PColIn(jj).SNR, {Pport(k,jj), 'W'});
+                end
+            end
+
+            % Power tracking of the balanced pairs (I, Q)
+            PColIQ = cell(1, 2);
+            for p=1:2
+                P1 = obj.total(PColPort{2*p-1});
+                P2 = obj.total(PColPort{2*p});
+                Ps_an = P1.Ps('W')+P2.Ps('W');
+                Pn_an = P1.Pn('W')+P2.Pn('W');
+                Ps_out = stats(4+p,:)/(1+Pn_an/Ps_an);
+                Pn_out = Ps_out*Pn_an/Ps_an+Pnshot(p,:)+Pntherm;
+                for jj=1:N
+                    PColIQ{p}(jj) = pwr(10*log10(Ps_out(jj)/Pn_out(jj)), {Ps_out(jj), 'W'});
+                    if filtered
+                        PColIQ{p}(jj) = pwr(PColIQ{p}(jj).SNR, {stats(6+p,jj), 'W'});
+                    end
+                end
+            end
+            if ~filtered
+                % the currents are scaled to their power when combined
+                scale = sqrt([10.^([PColIQ{1}.P_dBW]/10); 10.^([PColIQ{2}.P_dBW]/10)]./stats(7:8,:));
+                Y = complex(bsxfun(@times, real(Y), scale(1,:)), bsxfun(@times, imag(Y), scale(2,:)));
+            end
+
+            % I + 1j*Q
+            PCol = PColIQ{1} + PColIQ{2};
+            Pout = pwr.meanpwr(Y);
+            for jj=1:N
+                PCol(jj) = pwr(PCol(jj).SNR, {Pout(jj), 'W'});
+            end
+            out = signal_interface(Y, struct('Fs', sig.Fs, 'Rs', sig.Rs, 'Fc', 0, 'PCol', PCol));
+
+            obj.results = struct('Rmix', Rmix);
+        end
+
+        %> @brief Expand a parameter to one value per mode
+        function x = perMode(obj, x, N, name)
+            if isscalar(x)
+                x = repmat(x, N, 1);
+            elseif numel(x) == N
+                x = x(:);
+            else
+                robolog('Number of specified %s must be 1 or match input signal', 'ERR', name);
+            end
+        end
+
+    end
+
+end
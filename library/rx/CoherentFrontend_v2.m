@@ -16,6 +16,7 @@
 %> - one PBS (PBS_1xN_v1 for LO)
 %> - one optical hybrid (OpticalHybrid_v1)
 %> - two  balanced pairs (BalancedPair_v1)
+%>   (fused in one CoherentDetector_v1 unless fusedDetection is false)
 %> - one electrical low pass filter (ElectricalFilter_v1)
 %> - one ADC (ResampleSkewJitter_v1)
 %> - one quantizer (Quantizer_v1)
@@ -23,6 +24,13 @@
 %>
 %> The one output is a down-sampled complex baseband signal.
 %>
+%> By default the hybrid, the balanced pairs and the I/Q combination are
+%> computed in one pass by CoherentDetector_v1 (same model), so the four
+%> hybrid outputs and the photocurrents of each mode are not stored as
+%> separate signals. The noise currents are then drawn with philoxRandn
+%> (see CoherentDetector_v1). Set param.fusedDetection = false to use the
+%> separate units.
+%>
 %>
 %> __Example__
 %> Constructor with minimum parameter set
@@ -78,6 +86,7 @@ classdef CoherentFrontend_v2 < module
         %>  Class constructor
         %>
         %> @param param.nModes Number of optical modes in input [integer] [Default: 2]
+        %> @param param.fusedDetection Hybrid and balanced pairs computed by CoherentDetector_v1 [flag] [Default: true]
         %>
         %> Laser_v1
         %> @param param.Power Output power (pwr object). Default: SNR:inf, P: 13 dBm
@@ -99,6 +108,10 @@ classdef CoherentFrontend_v2 < module
         %> @param param.T Temperature [K][Default: 290]
         %> @param param.modeAdditionEnabled [flag] [Default: false]
         %>
+        %> CoherentDetector_v1 (fusedDetection)
+        %> @param param.seed Seed of the noise currents [Default: drawn at each traverse]
+        %> @param param.noiseStream Noise stream of the detector [Default: 0]
+        %>
         %> ElectricalFilter_v1
         %> @param param.gaussianOrder           The order of frequency-domain gaussian filter. Turn OFF = 0 (zero) / Turn ON = any other positive number.
         %> @param param.gaussianBandwidth       Baseband bandwidth of gaussian filter.
@@ -144,16 +157,22 @@ classdef CoherentFrontend_v2 < module
                 param.LOCombiner.nInputs = param.LOPBS.nOutputs;
                 param.LOCombiner.type = 'add';
                 
-                %optical hybrid params
-                param.Hybrid = paramDeepCopy('OpticalHybrid_v1',param);
-                
-                %balanced photodiode parameters
-                param.BalancedPairI = paramDeepCopy('BalancedPair_v1', param);
-                param.BalancedPairI.modeAdditionEnabled = false;
-                param.BalancedPairQ = param.BalancedPairI;
-                
-                param.IQCombiner.type = 'complexInterleave';
-                param.IQCombiner.nInputs = 2;
+                param.fusedDetection = paramdefault(param, 'fusedDetection', true);
+                if param.fusedDetection
+                    %fused hybrid and balanced photodiode parameters
+                    param.Detector = paramDeepCopy('CoherentDetector_v1', param);
+                else
+                    %optical hybrid params
+                    param.Hybrid = paramDeepCopy('OpticalHybrid_v1',param);
+                    
+                    %balanced photodiode parameters
+                    param.BalancedPairI = paramDeepCopy('BalancedPair_v1', param);
+                    param.BalancedPairI.modeAdditionEnabled = false;
+                    param.BalancedPairQ = param.BalancedPairI;
+                    
+                    param.IQCombiner.type = 'complexInterleave';
+                    param.IQCombiner.nInputs = 2;
+                end
                 
                 %ADC params
                 param.ELPF = paramDeepCopy('ElectricalFilter_v1',param);
@@ -169,10 +188,14 @@ classdef CoherentFrontend_v2 < module
                     pbs = PBS_1xN_v1(param.LOPBS);   %for LO
                     combiner = Combiner_v1(param.LOCombiner);
                 end
-                hybrid = OpticalHybrid_v1(param.Hybrid);
-                bpdI = BalancedPair_v1(param.BalancedPairI);
-                bpdQ = BalancedPair_v1(param.BalancedPairQ);
-                IQcombine = Combiner_v1(param.IQCombiner);
+                if param.fusedDetection
+                    detector = CoherentDetector_v1(param.Detector);
+                else
+                    hybrid = OpticalHybrid_v1(param.Hybrid);
+                    bpdI = BalancedPair_v1(param.BalancedPairI);
+                    bpdQ = BalancedPair_v1(param.BalancedPairQ);
+                    IQcombine = Combiner_v1(param.IQCombiner);
+                end
                 ElectricalFilter = ElectricalFilter_v1(param.ELPF);
                 ADC = ResampleSkewJitter_v1(param.ADCparam);
                 Quantizer = Quantizer_v1(param.Quantparam);
@@ -181,21 +204,33 @@ classdef CoherentFrontend_v2 < module
                 obj.connectInputs({branch}, 1);
                 
                 %internal connections
-                branch.connectOutputs({hybrid lo}, [1 1]);
-                if param.nModes>1
-                    lo.connectOutputs(pbs, 1);
-                    pbs.connectOutputs(combiner);
-                    combiner.connectOutputs(hybrid, 2);
+                if param.fusedDetection
+                    branch.connectOutputs({detector lo}, [1 1]);
+                    if param.nModes>1
+                        lo.connectOutputs(pbs, 1);
+                        pbs.connectOutputs(combiner);
+                        combiner.connectOutputs(detector, 2);
+                    else
+                        lo.connectOutputs(detector, 2);
+                    end
+                    detector.connectOutputs(ElectricalFilter, 1);
                 else
-                    lo.connectOutputs(hybrid, 2);
+                    branch.connectOutputs({hybrid lo}, [1 1]);
+                    if param.nModes>1
+                        lo.connectOutputs(pbs, 1);
+                        pbs.connectOutputs(combiner);
+                        combiner.connectOutputs(hybrid, 2);
+                    else
+                        lo.connectOutputs(hybrid, 2);
+                    end
+                    hybrid.connectOutputs({bpdI bpdI bpdQ bpdQ}, [1 2 1 2]);
+                    
+                    %external connections at output
+                    bpdI.connectOutputs(IQcombine,1);
+                    bpdQ.connectOutputs(IQcombine,2);
+                    
+                    IQcombine.connectOutputs(ElectricalFilter, 1);
                 end
-                hybrid.connectOutputs({bpdI bpdI bpdQ bpdQ}, [1 2 1 2]);
-                
-                %external connections at output
-                bpdI.connectOutputs(IQcombine,1);
-                bpdQ.connectOutputs(IQcombine,2);
-                
-                IQcombine.connectOutputs(ElectricalFilter, 1);
                 ElectricalFilter.connectOutputs(ADC, 1);
                 ADC.connectOutputs(Quantizer, 1);
                 
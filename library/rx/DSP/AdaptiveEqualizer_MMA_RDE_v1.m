@@ -37,6 +37,21 @@
 %> 1. There are inherent limitations to blind equalization.  This doesn't
 %> attempt to solve any of them.
 %>
+%> 2. The native engine (rde_mex) is used if compiled (see compileMex) and
+%> mexEnabled is true. It runs the same algorithm as the MATLAB loops, with
+%> both polarizations processed in parallel.
+%>
+%> 3. For long channel memories (hundreds of taps), set blockSize > 0 to use
+%> frequency-domain block LMS \ref Shynk "[1]": the filter is applied by
+%> overlap-save and the taps are updated once per block with the gradient
+%> summed over the blockSize symbols of the block, both computed with FFTs.
+%> The error rules (CMA/MMA/data-aided), mu, the orthogonalization and the
+%> tap outputs are the same as in symbol-by-symbol mode; the
+%> orthogonalization is applied at the end of the block that contains
+%> symbol cma_preconv. The cost per symbol grows with log(taps) instead of
+%> taps. A block of about taps/Nss symbols is a good trade-off between
+%> speed and tracking.
+%>
 %> __Example:__
 %> @code
 %> paramDSP.eq.iter = 4;        %Run 4 iterations of CMA/MMA on training seq. (default 1)
@@ -55,6 +70,11 @@
 %> @endcode
 %>
 %>
+%> __References:__
+%>
+%> * \anchor Shynk [1] J. J. Shynk, "Frequency-domain and multirate adaptive
+%> filtering," IEEE Signal Processing Magazine 9(1), 14-37 (1992)
+%>
 %> @author Edson Porto da Silva
 %> @author Robert Borkowski
 %>
@@ -90,6 +110,10 @@ classdef AdaptiveEqualizer_MMA_RDE_v1 < unit
         trainingType   = 'blind';
         %> N-by-2 training symbols matrix for dataAided mode.
         trainingSequences;
+        %> Use the native engine (rde_mex) if compiled {true | false}
+        mexEnabled = true;
+        %> Output symbols per block of the frequency-domain block LMS (0: symbol-by-symbol adaptation)
+        blockSize = 0;
     end
     
     properties (Hidden=true)
@@ -241,6 +265,10 @@ classdef AdaptiveEqualizer_MMA_RDE_v1 < unit
             else
                 robolog('Incorrect equalizer type: %s.','ERR',obj.type);
             end
+            
+            if ~isscalar(obj.blockSize) || obj.blockSize < 0 || ~iswhole(obj.blockSize)
+                robolog('blockSize must be a nonnegative integer.','ERR');
+            end
         end
         
         function [out1] = train_equalizer(obj,in)
@@ -284,51 +312,70 @@ classdef AdaptiveEqualizer_MMA_RDE_v1 < unit
             errsq = nan(L+1,2);
             E_Nss = zeros(size(in.E));
             
+            useBlock = obj.blockSize > 0;
+            useMex = ~useBlock && obj.mexEnabled && hasMex('rde_mex');
+            if flagTrain
+                ref = R2;
+                i = [1 1];
+            else
+                ref = obj.R;
+            end
+            
             % Equalizer training section:
             for iter_k=1:obj.iter
                 robolog('Equalizer training iteration #%d','NFO', iter_k)
-                temp = (1:obj.taps); % modified for speed
-                temp1 = in.Nss;      % modified for speed
-                fieldtemp = in.E;    % modified for speed
-                for n=1:L
-                    progress(n, L);
-                    idx = temp+(n-1)*temp1; % Selects the window of samples to equalize
-                    field = fieldtemp(idx,:);    % modified for speed
-                    E_tmp(:,1) = sum([obj.hxx obj.hxy].*field,2); % Faster than matrix multiplication
-                    E_tmp(:,2) = sum([obj.hyx obj.hyy].*field,2);
-                    
-                    E_hat(n,:) = sum(E_tmp,1); % Equalized output
-                    
-                    A = abs(E_hat(n,:));       % X
-                    
-                    if flagTrain % dataAided
-                        errsq(n,:) = R2(n,:)-A.^2;
-                    else % blind
-                        if n>obj.cma_preconv || iter_k > 1
-                            if mma, [~,i] = min(ipdm(obj.R,A')); end % Radius choice for MMA taps adaptation
+                if useBlock
+                    [E_hat, errsq(1:L,:), E_Nss_k] = obj.equalizeBlock(in.E, in.Nss, L, ref, i, ...
+                        obj.cma_preconv*(iter_k == 1), obj.cma_preconv*(obj.h_ortho && iter_k == 1), false);
+                    E_Nss = E_Nss + E_Nss_k;
+                elseif useMex
+                    [E_hat, errsq(1:L,:), E_Nss_k] = obj.equalizeMex(in.E, in.Nss, L, ref, i, ...
+                        obj.cma_preconv*(iter_k == 1), obj.cma_preconv*(obj.h_ortho && iter_k == 1), false);
+                    E_Nss = E_Nss + E_Nss_k;
+                else
+                    temp = (1:obj.taps); % modified for speed
+                    temp1 = in.Nss;      % modified for speed
+                    fieldtemp = in.E;    % modified for speed
+                    for n=1:L
+                        progress(n, L);
+                        idx = temp+(n-1)*temp1; % Selects the window of samples to equalize
+                        field = fieldtemp(idx,:);    % modified for speed
+                        E_tmp(:,1) = sum([obj.hxx obj.hxy].*field,2); % Faster than matrix multiplication
+                        E_tmp(:,2) = sum([obj.hyx obj.hyy].*field,2);
+                        
+                        E_hat(n,:) = sum(E_tmp,1); % Equalized output
+                        
+                        A = abs(E_hat(n,:));       % X
+                        
+                        if flagTrain % dataAided
+                            errsq(n,:) = R2(n,:)-A.^2;
+                        else % blind
+                            if n>obj.cma_preconv || iter_k > 1
+                                if mma, [~,i] = min(abs(bsxfun(@minus, obj.R(:), A))); end % Radius choice for MMA taps adaptation
+                            end
+                            errsq(n,:) = R2(i)-A.^2; % Calculates the square error accordind to the CMA|MMA rules.
+                        end
+                                                      
+                        % Adaptive step size for the equalizer error update (to implement!!):
+                        e_xx = errsq(n,1);
+                        e_yx = errsq(n,2);
+                        e_xy = errsq(n,1);
+                        e_yy = errsq(n,2);
+                        
+                        E_Nss(idx,:) = E_Nss(idx,:) + E_tmp;
+                        
+                        % Update the equalizer taps:
+                        obj.hxx = obj.hxx + obj.mu(1)*e_xx*E_hat(n,1)*conj(fieldtemp(idx,1));
+                        obj.hyx = obj.hyx + obj.mu(2)*e_yx*E_hat(n,2)*conj(fieldtemp(idx,1));
+                        obj.hxy = obj.hxy + obj.mu(3)*e_xy*E_hat(n,1)*conj(fieldtemp(idx,2));
+                        obj.hyy = obj.hyy + obj.mu(4)*e_yy*E_hat(n,2)*conj(fieldtemp(idx,2));
+                        
+                        if n==obj.cma_preconv && obj.h_ortho && iter_k== 1
+                            % Set Y polarization to be orthogonal to X to avoid
+                            % converging to the same polarization (CMA singularity avoidance)
+                            obj.hxy = -conj(obj.hyx);
+                            obj.hyy =  conj(obj.hxx);
                         end
-                        errsq(n,:) = R2(i)-A.^2; % Calculates the square error accordind to the CMA|MMA rules.
-                    end
-                                                  
-                    % Adaptive step size for the equalizer error update (to implement!!):
-                    e_xx = errsq(n,1);
-                    e_yx = errsq(n,2);
-                    e_xy = errsq(n,1);
-                    e_yy = errsq(n,2);
-                    
-                    E_Nss(idx,:) = E_Nss(idx,:) + E_tmp;
-                    
-                    % Update the equalizer taps:
-                    obj.hxx = obj.hxx + obj.mu(1)*e_xx*E_hat(n,1)*conj(fieldtemp(idx,1));
-                    obj.hyx = obj.hyx + obj.mu(2)*e_yx*E_hat(n,2)*conj(fieldtemp(idx,1));
-                    obj.hxy = obj.hxy + obj.mu(3)*e_xy*E_hat(n,1)*conj(fieldtemp(idx,2));
-                    obj.hyy = obj.hyy + obj.mu(4)*e_yy*E_hat(n,2)*conj(fieldtemp(idx,2));
-                    
-                    if n==obj.cma_preconv && obj.h_ortho && iter_k== 1
-                        % Set Y polarization to be orthogonal to X to avoid
-                        % converging to the same polarization (CMA singularity avoidance)
-                        obj.hxy = -conj(obj.hyx);
-                        obj.hyy =  conj(obj.hxx);
                     end
                 end
                 robolog('Equalizer MSE = %.6f.', mean(mean(errsq(1:end-1,:))))
@@ -397,51 +444,70 @@ classdef AdaptiveEqualizer_MMA_RDE_v1 < unit
             errsq = nan(L+1,2);
             E_Nss = zeros(size(in.E));
             
+            useBlock = obj.blockSize > 0;
+            useMex = ~useBlock && obj.mexEnabled && hasMex('rde_mex');
+            if flagTrain
+                ref = R2;
+                i = [1 1];
+            else
+                ref = obj.R;
+            end
+            
             % Equalizer training section:
             for iter_k=1:obj.iter
                 robolog('Equalizer training iteration #%d...   ','NFO', iter_k)
-                temp = (1:obj.taps); % modified for speed
-                temp1 = in.Nss;      % modified for speed
-                fieldtemp = in.E;    % modified for speed
-                for n=1:L
-                    progress(n, L);
-                    idx = temp+(n-1)*temp1; % Selects the window of samples to equalize
-                    field = fieldtemp(idx,:);    % modified for speed
-                    E_tmp(:,1) = sum([obj.hxx obj.hxy].*field,2); % Faster than matrix multiplication
-                    E_tmp(:,2) = sum([obj.hyx obj.hyy].*field,2);
-                    
-                    E_hat(n,:) = sum(E_tmp,1); % Equalized output
-                    
-                    A = abs(E_hat(n,:));       % X
-                    
-                    if flagTrain % dataAided
-                        errsq(n,:) = R2(n,:)-A.^2;
-                    else % blind
-                        if n>obj.cma_preconv || iter_k > 1
-                            if mma, [~,i] = min(ipdm(obj.R,A')); end % Radius choice for MMA taps adaptation
+                if useBlock
+                    [E_hat, errsq(1:L,:), E_Nss_k] = obj.equalizeBlock(in.E, in.Nss, L, ref, i, ...
+                        obj.cma_preconv*(iter_k == 1), obj.cma_preconv*(obj.h_ortho && iter_k == 1), false);
+                    E_Nss = E_Nss + E_Nss_k;
+                elseif useMex
+                    [E_hat, errsq(1:L,:), E_Nss_k] = obj.equalizeMex(in.E, in.Nss, L, ref, i, ...
+                        obj.cma_preconv*(iter_k == 1), obj.cma_preconv*(obj.h_ortho && iter_k == 1), false);
+                    E_Nss = E_Nss + E_Nss_k;
+                else
+                    temp = (1:obj.taps); % modified for speed
+                    temp1 = in.Nss;      % modified for speed
+                    fieldtemp = in.E;    % modified for speed
+                    for n=1:L
+                        progress(n, L);
+                        idx = temp+(n-1)*temp1; % Selects the window of samples to equalize
+                        field = fieldtemp(idx,:);    % modified for speed
+                        E_tmp(:,1) = sum([obj.hxx obj.hxy].*field,2); % Faster than matrix multiplication
+                        E_tmp(:,2) = sum([obj.hyx obj.hyy].*field,2);
+                        
+                        E_hat(n,:) = sum(E_tmp,1); % Equalized output
+                        
+                        A = abs(E_hat(n,:));       % X
+                        
+                        if flagTrain % dataAided
+                            errsq(n,:) = R2(n,:)-A.^2;
+                        else % blind
+                            if n>obj.cma_preconv || iter_k > 1
+                                if mma, [~,i] = min(abs(bsxfun(@minus, obj.R(:), A))); end % Radius choice for MMA taps adaptation
+                            end
+                            errsq(n,:) = R2(i)-A.^2; % Calculates the square error accordind to the CMA|MMA rules.
+                        end
+                        
+                        % Adaptive step size for the equalizer error update (to implement!!):
+                        e_xx = errsq(n,1);
+                        e_yx = errsq(n,2);
+                        e_xy = errsq(n,1);
+                        e_yy = errsq(n,2);
+                        
+                        E_Nss(idx,:) = E_Nss(idx,:) + E_tmp;
+                        
+                        % Update the equalizer taps:
+                        obj.hxx = obj.hxx + obj.mu(1)*e_xx*E_hat(n,1)*conj(fieldtemp(idx,1));
+                        obj.hyx = obj.hyx + obj.mu(2)*e_yx*E_hat(n,2)*conj(fieldtemp(idx,1));
+                        obj.hxy = obj.hxy + obj.mu(3)*e_xy*E_hat(n,1)*conj(fieldtemp(idx,2));
+                        obj.hyy = obj.hyy + obj.mu(4)*e_yy*E_hat(n,2)*conj(fieldtemp(idx,2));
+                        
+                        if n==obj.cma_preconv && obj.h_ortho && iter_k== 1
+                            % Set Y polarization to be orthogonal to X to avoid
+                            % converging to the same polarization (CMA singularity avoidance)
+                            obj.hxy = -conj(obj.hyx);
+                            obj.hyy =  conj(obj.hxx);
                         end
-                        errsq(n,:) = R2(i)-A.^2; % Calculates the square error accordind to the CMA|MMA rules.
-                    end
-                    
-                    % Adaptive step size for the equalizer error update (to implement!!):
-                    e_xx = errsq(n,1);
-                    e_yx = errsq(n,2);
-                    e_xy = errsq(n,1);
-                    e_yy = errsq(n,2);
-                    
-                    E_Nss(idx,:) = E_Nss(idx,:) + E_tmp;
-                    
-                    % Update the equalizer taps:
-                    obj.hxx = obj.hxx + obj.mu(1)*e_xx*E_hat(n,1)*conj(fieldtemp(idx,1));
-                    obj.hyx = obj.hyx + obj.mu(2)*e_yx*E_hat(n,2)*conj(fieldtemp(idx,1));
-                    obj.hxy = obj.hxy + obj.mu(3)*e_xy*E_hat(n,1)*conj(fieldtemp(idx,2));
-                    obj.hyy = obj.hyy + obj.mu(4)*e_yy*E_hat(n,2)*conj(fieldtemp(idx,2));
-                    
-                    if n==obj.cma_preconv && obj.h_ortho && iter_k== 1
-                        % Set Y polarization to be orthogonal to X to avoid
-                        % converging to the same polarization (CMA singularity avoidance)
-                        obj.hxy = -conj(obj.hyx);
-                        obj.hyy =  conj(obj.hxx);
                     end
                 end
                 robolog('Equalizer MSE = %.6f.', mean(mean(errsq(1:end-1,:))))
@@ -470,18 +536,24 @@ classdef AdaptiveEqualizer_MMA_RDE_v1 < unit
             
             robolog('Equalization started','NFO')
             if ~strcmp(obj.operation, 'training')
-                temp = (1:obj.taps);        % modified for speed
-                temp1 = in.Nss;             % modified for speed
-                temp2 = [obj.hxx obj.hxy];  % modified for speed
-                temp3 = [obj.hyx obj.hyy];  % modified for speed
-                fieldtemp = in.E;           % modified for speed
-                for n=1:L
-                    progress(n, L);
-                    idx = temp+(n-1)*temp1;     % Selects the window of samples to equalize
-                    field = fieldtemp(idx,:);   % modified for speed
-                    E_tmp(:,1) = sum(temp2.*field,2); % Faster than matrix multiplication
-                    E_tmp(:,2) = sum(temp3.*field,2);
-                    E_hat_out(n,:) = sum(E_tmp,1);
+                if useBlock
+                    E_hat_out = obj.equalizeBlock(in.E, in.Nss, L, []);
+                elseif useMex
+                    E_hat_out = obj.equalizeMex(in.E, in.Nss, L, []);
+                else
+                    temp = (1:obj.taps);        % modified for speed
+                    temp1 = in.Nss;             % modified for speed
+                    temp2 = [obj.hxx obj.hxy];  % modified for speed
+                    temp3 = [obj.hyx obj.hyy];  % modified for speed
+                    fieldtemp = in.E;           % modified for speed
+                    for n=1:L
+                        progress(n, L);
+                        idx = temp+(n-1)*temp1;     % Selects the window of samples to equalize
+                        field = fieldtemp(idx,:);   % modified for speed
+                        E_tmp(:,1) = sum(temp2.*field,2); % Faster than matrix multiplication
+                        E_tmp(:,2) = sum(temp3.*field,2);
+                        E_hat_out(n,:) = sum(E_tmp,1);
+                    end
                 end
                 robolog('Equalization completed.')
             else
@@ -546,56 +618,71 @@ classdef AdaptiveEqualizer_MMA_RDE_v1 < unit
             E_hat_out = nan(L,2);
             
             robolog('Equalization started','NFO')
-            %store values locally for speed
-            temp = (1:obj.taps);
-            temp1 = in.Nss;
-            hxxtemp = obj.hxx;
-            hxytemp = obj.hxy;
-            hyxtemp = obj.hyx;
-            hyytemp = obj.hyy;
-            fieldtemp = in.E;
-            mutemp = obj.mu;
             errsq2 = nan(L+1,2);
-            for n=1:L
-                progress(n, L);
-                idx = temp+(n-1)*temp1;     % Selects the window of samples to equalize
-                field = fieldtemp(idx,:);   % modified for speed
-                E_tmp(:,1) = sum([hxxtemp hxytemp].*field,2); % Faster than matrix multiplication
-                E_tmp(:,2) = sum([hyxtemp hyytemp].*field,2);
-                E_hat_out(n,:) = sum(E_tmp,1); % Equalized output
-                
-                %calculate error
-                A = abs(E_hat_out(n,:));       % X
-                if flagTrain % dataAided
-                    errsq2(n,:) = R2(n,:)-A.^2;
-                else % blind
-                    if mma, [~,i] = min(ipdm(obj.R,A')); end % Radius choice for MMA taps adaptation
-                    errsq2(n,:) = R2(i)-A.^2; % Calculates the square error accordind to the CMA|MMA rules.
+            useBlock = obj.blockSize > 0;
+            if useBlock || (obj.mexEnabled && hasMex('rde_mex'))
+                if flagTrain
+                    ref = R2;
+                    i = [1 1];
+                else
+                    ref = obj.R;
                 end
-                e_xx = errsq2(n,1);
-                e_yx = errsq2(n,2);
-                e_xy = errsq2(n,1);
-                e_yy = errsq2(n,2);
+                if useBlock
+                    [E_hat_out, errsq2(1:L,:)] = obj.equalizeBlock(in.E, in.Nss, L, ref, i, 0, 0, false);
+                else
+                    [E_hat_out, errsq2(1:L,:)] = obj.equalizeMex(in.E, in.Nss, L, ref, i, 0, 0, false);
+                end
+            else
+                %store values locally for speed
+                temp = (1:obj.taps);
+                temp1 = in.Nss;
+                hxxtemp = obj.hxx;
+                hxytemp = obj.hxy;
+                hyxtemp = obj.hyx;
+                hyytemp = obj.hyy;
+                fieldtemp = in.E;
+                mutemp = obj.mu;
+                for n=1:L
+                    progress(n, L);
+                    idx = temp+(n-1)*temp1;     % Selects the window of samples to equalize
+                    field = fieldtemp(idx,:);   % modified for speed
+                    E_tmp(:,1) = sum([hxxtemp hxytemp].*field,2); % Faster than matrix multiplication
+                    E_tmp(:,2) = sum([hyxtemp hyytemp].*field,2);
+                    E_hat_out(n,:) = sum(E_tmp,1); % Equalized output
+                
+                    %calculate error
+                    A = abs(E_hat_out(n,:));       % X
+                    if flagTrain % dataAided
+                        errsq2(n,:) = R2(n,:)-A.^2;
+                    else % blind
+                        if mma, [~,i] = min(abs(bsxfun(@minus, obj.R(:), A))); end % Radius choice for MMA taps adaptation
+                        errsq2(n,:) = R2(i)-A.^2; % Calculates the square error accordind to the CMA|MMA rules.
+                    end
+                    e_xx = errsq2(n,1);
+                    e_yx = errsq2(n,2);
+                    e_xy = errsq2(n,1);
+                    e_yy = errsq2(n,2);
+                
+                    % Update the equalizer taps:
+                    hxxtemp = hxxtemp + mutemp(1)*e_xx*E_hat_out(n,1)*conj(fieldtemp(idx,1));
+                    hyxtemp = hyxtemp + mutemp(2)*e_yx*E_hat_out(n,2)*conj(fieldtemp(idx,1));
+                    hxytemp = hxytemp + mutemp(3)*e_xy*E_hat_out(n,1)*conj(fieldtemp(idx,2));
+                    hyytemp = hyytemp + mutemp(4)*e_yy*E_hat_out(n,2)*conj(fieldtemp(idx,2));
                 
-                % Update the equalizer taps:
-                hxxtemp = hxxtemp + mutemp(1)*e_xx*E_hat_out(n,1)*conj(fieldtemp(idx,1));
-                hyxtemp = hyxtemp + mutemp(2)*e_yx*E_hat_out(n,2)*conj(fieldtemp(idx,1));
-                hxytemp = hxytemp + mutemp(3)*e_xy*E_hat_out(n,1)*conj(fieldtemp(idx,2));
-                hyytemp = hyytemp + mutemp(4)*e_yy*E_hat_out(n,2)*conj(fieldtemp(idx,2));
+                end
                 
+                %save taps and step size
+                obj.hxx = hxxtemp;
+                obj.hxy = hxytemp;
+                obj.hyx = hyxtemp;
+                obj.hyy = hyytemp;
+                obj.mu = mutemp;
             end
             robolog('Equalization completed.')
             robolog('Equalizer MSE = %.6f.', mean(mean(errsq2(1:end-1,:))))
             
             out1 = in.set('E', E_hat_out, 'Fs', in.Rs);
             
-            %save taps and step size
-            obj.hxx = hxxtemp;
-            obj.hxy = hxytemp;
-            obj.hyx = hyxtemp;
-            obj.hyy = hyytemp;
-            obj.mu = mutemp;
-            
             %save & draw convergence
             obj.results.errsq = errsq2;
             if obj.draw
@@ -652,69 +739,84 @@ classdef AdaptiveEqualizer_MMA_RDE_v1 < unit
             E_hat_out = nan(L,2);
             
             robolog('Equalization started','NFO')
-            %store values locally for speed
-            temp = (1:obj.taps);
-            temp1 = in.Nss;
-            hxxtemp = obj.hxx;
-            hxytemp = obj.hxy;
-            hyxtemp = obj.hyx;
-            hyytemp = obj.hyy;
-            fieldtemp = in.E;
-            mutemp = obj.mu;
             errsq2 = nan(L+1,2);
-            for n=1:L
-                progress(n, L);
-                idx = temp+(n-1)*temp1;     % Selects the window of samples to equalize
-                field = fieldtemp(idx,:);   % modified for speed
-                E_tmp(:,1) = sum([hxxtemp hxytemp].*field,2); % Faster than matrix multiplication
-                E_tmp(:,2) = sum([hyxtemp hyytemp].*field,2);
-                E_hat_out(n,:) = sum(E_tmp,1); % Equalized output
-                
-                %calculate error
-                A = abs(E_hat_out(n,:));       % X
-                if flagTrain % dataAided
-                    errsq2(n,:) = R2(n,:)-A.^2;
-                else % blind
-                    if mma, [~,i] = min(ipdm(obj.R,A')); end % Radius choice for MMA taps adaptation
-                    errsq2(n,:) = R2(i)-A.^2; % Calculates the square error accordind to the CMA|MMA rules.
+            useBlock = obj.blockSize > 0;
+            if useBlock || (obj.mexEnabled && hasMex('rde_mex'))
+                if flagTrain
+                    ref = R2;
+                    i = [1 1];
+                else
+                    ref = obj.R;
+                end
+                if useBlock
+                    [E_hat_out, errsq2(1:L,:)] = obj.equalizeBlock(in.E, in.Nss, L, ref, i, 0, 0, true);
+                else
+                    [E_hat_out, errsq2(1:L,:)] = obj.equalizeMex(in.E, in.Nss, L, ref, i, 0, 0, true);
                 end
-                e_xx = errsq2(n,1);
-                e_yx = errsq2(n,2);
-                e_xy = errsq2(n,1);
-                e_yy = errsq2(n,2);
+            else
+                %store values locally for speed
+                temp = (1:obj.taps);
+                temp1 = in.Nss;
+                hxxtemp = obj.hxx;
+                hxytemp = obj.hxy;
+                hyxtemp = obj.hyx;
+                hyytemp = obj.hyy;
+                fieldtemp = in.E;
+                mutemp = obj.mu;
+                for n=1:L
+                    progress(n, L);
+                    idx = temp+(n-1)*temp1;     % Selects the window of samples to equalize
+                    field = fieldtemp(idx,:);   % modified for speed
+                    E_tmp(:,1) = sum([hxxtemp hxytemp].*field,2); % Faster than matrix multiplication
+                    E_tmp(:,2) = sum([hyxtemp hyytemp].*field,2);
+                    E_hat_out(n,:) = sum(E_tmp,1); % Equalized output
                 
-                % Update the equalizer taps:
-                hxxtemp = hxxtemp + mutemp(1)*e_xx*E_hat_out(n,1)*conj(fieldtemp(idx,1));
-                hyxtemp = hyxtemp + mutemp(2)*e_yx*E_hat_out(n,2)*conj(fieldtemp(idx,1));
-                hxytemp = hxytemp + mutemp(3)*e_xy*E_hat_out(n,1)*conj(fieldtemp(idx,2));
-                hyytemp = hyytemp + mutemp(4)*e_yy*E_hat_out(n,2)*conj(fieldtemp(idx,2));
+                    %calculate error
+                    A = abs(E_hat_out(n,:));       % X
+                    if flagTrain % dataAided
+                        errsq2(n,:) = R2(n,:)-A.^2;
+                    else % blind
+                        if mma, [~,i] = min(abs(bsxfun(@minus, obj.R(:), A))); end % Radius choice for MMA taps adaptation
+                        errsq2(n,:) = R2(i)-A.^2; % Calculates the square error accordind to the CMA|MMA rules.
+                    end
+                    e_xx = errsq2(n,1);
+                    e_yx = errsq2(n,2);
+                    e_xy = errsq2(n,1);
+                    e_yy = errsq2(n,2);
                 
-                % Update the equalizer step size:
-                if n==1
-                    mutemp(1)=mutemp(1)/(1+mutemp(1)*(abs(e_xx)^2));
-                    mutemp(2)= mutemp(2)/(1+mutemp(2)*(abs(e_yy)^2));
-                elseif ~((sign(real(e_xx))==sign(real(errsq2(n-1, 1)))) && (sign(imag(e_xx))==sign(imag(errsq2(n-1, 1)))))
-                    mutemp(1)=mutemp(1)/(1+mutemp(1)*(abs(e_xx)^2));
-                    if ~((sign(real(e_yy))==sign(real(errsq2(n-1, 2)))) && (sign(imag(e_yy))==sign(imag(errsq2(n-1, 1)))))
+                    % Update the equalizer taps:
+                    hxxtemp = hxxtemp + mutemp(1)*e_xx*E_hat_out(n,1)*conj(fieldtemp(idx,1));
+                    hyxtemp = hyxtemp + mutemp(2)*e_yx*E_hat_out(n,2)*conj(fieldtemp(idx,1));
+                    hxytemp = hxytemp + mutemp(3)*e_xy*E_hat_out(n,1)*conj(fieldtemp(idx,2));
+                    hyytemp = hyytemp + mutemp(4)*e_yy*E_hat_out(n,2)*conj(fieldtemp(idx,2));
+                
+                    % Update the equalizer step size:
+                    if n==1
+                        mutemp(1)=mutemp(1)/(1+mutemp(1)*(abs(e_xx)^2));
                         mutemp(2)= mutemp(2)/(1+mutemp(2)*(abs(e_yy)^2));
+                    elseif ~((sign(real(e_xx))==sign(real(errsq2(n-1, 1)))) && (sign(imag(e_xx))==sign(imag(errsq2(n-1, 1)))))
+                        mutemp(1)=mutemp(1)/(1+mutemp(1)*(abs(e_xx)^2));
+                        if ~((sign(real(e_yy))==sign(real(errsq2(n-1, 2)))) && (sign(imag(e_yy))==sign(imag(errsq2(n-1, 1)))))
+                            mutemp(2)= mutemp(2)/(1+mutemp(2)*(abs(e_yy)^2));
+                        end
                     end
+                    mutemp(3) = mutemp(1);
+                    mutemp(4) = mutemp(2);
+                
                 end
-                mutemp(3) = mutemp(1);
-                mutemp(4) = mutemp(2);
                 
+                %save taps and step size
+                obj.hxx = hxxtemp;
+                obj.hxy = hxytemp;
+                obj.hyx = hyxtemp;
+                obj.hyy = hyytemp;
+                obj.mu = mutemp;
             end
             robolog('Equalization completed.')
             robolog('Equalizer MSE = %.6f.', mean(mean(errsq2(1:end-1,:))))
             
             out1 = in.set('E', E_hat_out, 'Fs', in.Rs);
             
-            %save taps and step size
-            obj.hxx = hxxtemp;
-            obj.hxy = hxytemp;
-            obj.hyx = hyxtemp;
-            obj.hyy = hyytemp;
-            obj.mu = mutemp;
-            
             %save & draw convergence
             obj.results.errsq = errsq2;
             if obj.draw
@@ -723,6 +825,157 @@ classdef AdaptiveEqualizer_MMA_RDE_v1 < unit
         end
         
         
+        %> @brief Runs the equalizer with the native engine (rde_mex)
+        %>
+        %> Equivalent to the MATLAB loops of the equalization routines. The
+        %> taps and the step size are updated in the object.
+        %>
+        %> @param E             Input field, N-by-2
+        %> @param Nss           Input samples per output symbol
+        %> @param L             Number of output symbols
+        %> @param ref           Radii (blind) or target powers (dataAided). Empty: filter only, no adaptation
+        %> @param i             Initial radius index of each polarization
+        %> @param radiusFrom    Radius selection for symbols n > radiusFrom
+        %> @param orthoAt       Orthogonalize the taps after symbol orthoAt (0: never)
+        %> @param adaptiveMu    Adapt the step size
+        %>
+        %> @retval E_hat        Equalized output, L-by-2
+        %> @retval errsq        Error of each symbol, L-by-2
+        %> @retval E_Nss        Output accumulated at the input sample positions, N-by-2
+        function [E_hat, errsq, E_Nss] = equalizeMex(obj, E, Nss, L, ref, i, radiusFrom, orthoAt, adaptiveMu)
+            H = [obj.hxx obj.hxy obj.hyx obj.hyy];
+            if isempty(ref)
+                E_hat = rde_mex(E, H, [], Nss, L);
+                return
+            end
+            dataAided = strcmp(obj.trainingType, 'dataAided');
+            if nargout > 2
+                [E_hat, H, errsq, obj.mu, E_Nss] = rde_mex(E, H, obj.mu, Nss, L, double(ref), i, ...
+                    dataAided, radiusFrom, orthoAt, adaptiveMu);
+            else
+                [E_hat, H, errsq, obj.mu] = rde_mex(E, H, obj.mu, Nss, L, double(ref), i, ...
+                    dataAided, radiusFrom, orthoAt, adaptiveMu);
+            end
+            obj.hxx = H(:,1);
+            obj.hxy = H(:,2);
+            obj.hyx = H(:,3);
+            obj.hyy = H(:,4);
+        end
+        
+        %> @brief Runs the equalizer as a frequency-domain block LMS
+        %>
+        %> Same interface as equalizeMex. Within each block of blockSize
+        %> symbols the taps are fixed: the outputs are computed by
+        %> overlap-save and the tap update is the sum of the updates of
+        %> the symbol-by-symbol equalizer over the block, computed as a
+        %> cross-correlation with FFTs. The taps and the step size are
+        %> updated in the object.
+        %>
+        %> @param E             Input field, N-by-2
+        %> @param Nss           Input samples per output symbol
+        %> @param L             Number of output symbols
+        %> @param ref           Radii (blind) or target powers (dataAided). Empty: filter only, no adaptation
+        %> @param i             Initial radius index of each polarization
+        %> @param radiusFrom    Radius selection for symbols n > radiusFrom
+        %> @param orthoAt       Orthogonalize the taps after the block of symbol orthoAt (0: never)
+        %> @param adaptiveMu    Adapt the step size
+        %>
+        %> @retval E_hat        Equalized output, L-by-2
+        %> @retval errsq        Error of each symbol, L-by-2
+        %> @retval E_Nss        Output accumulated at the input sample positions, N-by-2
+        function [E_hat, errsq, E_Nss] = equalizeBlock(obj, E, Nss, L, ref, i, radiusFrom, orthoAt, adaptiveMu)
+            H = [obj.hxx obj.hxy obj.hyx obj.hyy];
+            B = obj.blockSize;
+            Nfft = 2^nextpow2(B*Nss+obj.taps-1);
+            adapt = ~isempty(ref);
+            dataAided = strcmp(obj.trainingType, 'dataAided');
+            R = ref(:).';
+            E_hat = zeros(L, 2);
+            errsq = zeros(L, 2);
+            if nargout > 2
+                E_Nss = zeros(size(E));
+            end
+            mu = obj.mu;
+            eprev = [];
+            for n0 = 0:B:L-1
+                nb = min(B, L-n0);
+                n = n0+(1:nb)';                     % Symbols of the block
+                seg = n0*Nss+(1:(nb-1)*Nss+obj.taps);
+                iy = (0:nb-1)*Nss+1;                % Output positions in the block
+                X = fft(E(seg,:), Nfft);
+                Hr = Nfft*ifft(H, Nfft);            % Correlation with the taps
+                z = ifft([X(:,1).*Hr(:,1)+X(:,2).*Hr(:,2), X(:,1).*Hr(:,3)+X(:,2).*Hr(:,4)]);
+                y = z(iy,:);
+                E_hat(n,:) = y;
+                
+                if nargout > 2
+                    d = zeros(Nfft, 1);
+                    d(iy) = 1;
+                    W = ifft(bsxfun(@times, fft(d), fft(H, Nfft)));
+                    W = W(1:numel(seg),:);
+                    E_Nss(seg,1) = E_Nss(seg,1) + E(seg,1).*W(:,1) + E(seg,2).*W(:,2);
+                    E_Nss(seg,2) = E_Nss(seg,2) + E(seg,1).*W(:,3) + E(seg,2).*W(:,4);
+                end
+                if ~adapt
+                    continue
+                end
+                
+                % Errors of the block (CMA|MMA rules or data-aided)
+                A2 = abs(y).^2;
+                if dataAided
+                    e = ref(n,:)-A2;
+                else
+                    ii = repmat(i, nb, 1);
+                    sel = n > radiusFrom;
+                    for p = 1:2
+                        [~, ii(sel,p)] = min(abs(bsxfun(@minus, sqrt(A2(sel,p)), R)), [], 2);
+                    end
+                    i = ii(end,:);
+                    e = R(ii).^2-A2;
+                end
+                errsq(n,:) = e;
+                
+                % Step size applied to each symbol of the block
+                if adaptiveMu
+                    muv = zeros(nb, 4);
+                    for k = 1:nb
+                        muv(k,:) = mu(:).';
+                        if isempty(eprev)
+                            mu(1) = mu(1)/(1+mu(1)*(abs(e(k,1))^2));
+                            mu(2) = mu(2)/(1+mu(2)*(abs(e(k,2))^2));
+                        elseif ~((sign(real(e(k,1)))==sign(real(eprev(1)))) && (sign(imag(e(k,1)))==sign(imag(eprev(1)))))
+                            mu(1) = mu(1)/(1+mu(1)*(abs(e(k,1))^2));
+                            if ~((sign(real(e(k,2)))==sign(real(eprev(2)))) && (sign(imag(e(k,2)))==sign(imag(eprev(1)))))
+                                mu(2) = mu(2)/(1+mu(2)*(abs(e(k,2))^2));
+                            end
+                        end
+                        mu(3) = mu(1);
+                        mu(4) = mu(2);
+                        eprev = e(k,:);
+                    end
+                else
+                    muv = repmat(mu(:).', nb, 1);
+                end
+                
+                % Block gradient: sum over the block of mu*e*y*conj(x)
+                U = zeros(Nfft, 4);
+                U(iy,:) = conj(bsxfun(@times, muv(:,[1 3 2 4]), e(:,[1 1 2 2]).*y(:,[1 1 2 2])));
+                G = conj(ifft(X(:,[1 2 1 2]).*(Nfft*ifft(U))));
+                H = H+G(1:obj.taps,:);
+                
+                if orthoAt > n0 && orthoAt <= n0+nb
+                    % Set Y polarization to be orthogonal to X (CMA singularity avoidance)
+                    H(:,2) = -conj(H(:,3));
+                    H(:,4) =  conj(H(:,1));
+                end
+            end
+            obj.hxx = H(:,1);
+            obj.hxy = H(:,2);
+            obj.hyx = H(:,3);
+            obj.hyy = H(:,4);
+            obj.mu = mu;
+        end
+        
         %> @brief Plot equalizer convergence
         function f = plotConv(obj)
             WND_L=3000;
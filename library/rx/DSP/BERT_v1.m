@@ -85,6 +85,8 @@ classdef BERT_v1 < unit
         PostProcessMethod;
         %> Disables Counter and plots only 10000 symbols
         FastMode;
+        %> Replace the PRBS extracted from the 2nd input by the matching error-free PRBS {true | false}
+        RegeneratePRBS;
         %> Only calculate the signal columuns specified in this vector
         Only;
         %> (internal) Vector containing what columns to demodulate
@@ -151,6 +153,11 @@ classdef BERT_v1 < unit
         %> - param.FastMode \n
         %      Enabling this flag will only calculate the metrics and plot
         %      100k symbols.
+        %> - param.RegeneratePRBS \n
+        %>     When the reference is taken from the 2nd input, replace the
+        %>     extracted period by the error-free PRBS that matches it
+        %>     (see BERT_v1::regeneratePRBS).  Disabled by default: a
+        %>     reference with bit errors is then used as received.
         %> - param.draw \n
         %>     Enable or disable plotting (true results in the plot being
         %>     generated).
@@ -184,6 +191,7 @@ classdef BERT_v1 < unit
         %> @param param.EnableMetrics Enable calculating Q, EVM, etc. {true | false}
         %> @param param.EnableCounter Enable calculating BER, SER, errorgram etc. 
         %> @param param.PostProcessMethod How to choose what blocks to count {'none' | 'threshold' | 'probability'}
+        %> @param param.RegeneratePRBS Regenerate the reference PRBS from the 2nd input {true | false} (default false)
         %> @param param.draw Turn plotting on/off {true | false}
         %>
         %> @retval obj Instance of the BERT_v1 class
@@ -211,6 +219,7 @@ classdef BERT_v1 < unit
             obj.EnableCounter = paramdefault(param,'EnableCounter',true);
             obj.PostProcessMethod = paramdefault(param, 'PostProcessMethod', 'none');
             obj.FastMode = paramdefault(param,{'FastMode','fast'},false);
+            obj.RegeneratePRBS = paramdefault(param,'RegeneratePRBS',false);
             % Make sure we're doing something
             if ~(obj.EnableMetrics || obj.EnableCounter)
                 obj.EnableMetrics = true;
@@ -328,7 +337,7 @@ classdef BERT_v1 < unit
                 switch obj.CounterMethod
                     case 'generic'
                         counterparams.ber_th = 0.45;        %set threshold high; we will deal with
-                        [res.ber, res.ser,res.ber_block,res.ser_block,~,res.err_bits,res.totalbits,res.err_symb,res.totalsymb,ORIG_SYMBOLS, RX_SYMBOLS] =error_counter_v7c(srx,obj.TxData,counterparams);
+                        [res.ber, res.ser,res.ber_block,res.ser_block,~,res.err_bits,res.totalbits,res.err_symb,res.totalsymb,ORIG_SYMBOLS, RX_SYMBOLS, evm] =error_counter_v7c(srx,obj.TxData,counterparams);
                         ErrorMap = RX_SYMBOLS ~= ORIG_SYMBOLS;
                         ErrorMap = ErrorMap(obj.BlockLength:end).';
                     case 'miguel'
@@ -373,7 +382,11 @@ classdef BERT_v1 < unit
                         res.Pb = res.Ps/log2(obj.M);
                         res.est_bit_errors = round(res.Pb*length(srx)*log2(obj.M));
                     case 'QAM'
-                        res.evm = obj.getEVM(srx,c(:));
+                        if exist('evm', 'var') && strcmp(obj.DecisionType, 'hard')
+                            res.evm = evm;  % Computed by the counter with the same constellation
+                        else
+                            res.evm = obj.getEVM(srx,c(:));
+                        end
                         res.Pb = obj.BERfromQAMEVM(res.evm, obj.M);
                         res.est_bit_errors = round(res.Pb*length(srx)*obj.M);
                         
@@ -394,7 +407,9 @@ classdef BERT_v1 < unit
         
         %> @brief Locates and returns the repeating sequence
         %>
-        %> This can be used to find the PRBS in a sequence
+        %> This can be used to find the PRBS in a sequence. If RegeneratePRBS
+        %> is set and the period is binary, bit errors are removed by
+        %> regeneratePRBS
         %>
         %> @param sig input signal (any)
         %> 
@@ -411,6 +426,9 @@ classdef BERT_v1 < unit
             end
             prbs = obj.rx(sig.getNormalized(), obj.M, obj.Coding);
             prbs = obj.trimPRBS(prbs);
+            if obj.RegeneratePRBS
+                prbs = obj.regeneratePRBS(prbs);
+            end
             prbs = logical(prbs);
         end
         
@@ -784,13 +802,13 @@ classdef BERT_v1 < unit
         %>
         %> @retval evm error vector magnitude
         function evm = getEVM(srx, c)
-            for q=1:length(srx)
-                for j=1:length(c)
-                    ekc(j)=abs(srx(q,:) - c(j,:));
-                end
-                ek(q)=min(ekc.^2);
+            blockLength = 2^16; % Symbols per block (bounds the size of the distance matrix)
+            ek = 0;
+            for n0=0:blockLength:length(srx)-1
+                [~, dist] = hd_euclid(srx(n0+1:min(n0+blockLength, end)), c);
+                ek = ek + sum(dist.^2);
             end
-            evm=sqrt(sum(ek)/length(srx));
+            evm=sqrt(ek/length(srx));
         end
         
         %> @brief Calculates BER from EVM
@@ -873,6 +891,46 @@ classdef BERT_v1 < unit
             end
         end
         
+        %> @brief  Regenerates a received PRBS
+        %>
+        %> Replaces a received period of a PRBS, possibly with bit errors, with
+        %> the PRBS of the same order that matches it (polynomial of
+        %> OrthogonalCodeGenerator_v1.PNgenpoly, or its reciprocal). The
+        %> register is loaded with a few windows of received bits, and the
+        %> sequence is generated at their position with prbsWindow
+        %> (jump-ahead). The input is returned if no candidate matches.
+        %>
+        %> @param in  received period, 2^order-1 bits
+        %>
+        %> @retval out regenerated PRBS
+        function out = regeneratePRBS(in)
+            out = in;
+            period = numel(in);
+            order = log2(period+1);
+            if ~iswhole(order) || order < 2 || ~all(in(:) == 0 | in(:) == 1)
+                return
+            end
+            try
+                taps = OrthogonalCodeGenerator_v1.PNgenpoly(order);
+            catch
+                return
+            end
+            taps = taps(taps > 0);
+            candidates = {taps, sort([order order-taps(2:end)], 'descend')};
+            useMex = hasMex('prbs_mex');
+            bits = in(:) == 1;
+            for k=1:numel(candidates)
+                for pos=0:order:min(8*order, period-order)
+                    seed = sum(bits(pos+(1:order)).'.*2.^(0:order-1));
+                    x = prbsWindow(candidates{k}, seed, mod(period-pos, period), period, useMex);
+                    if mean(x ~= bits) < 0.25
+                        robolog('Reference PRBS replaced by the regenerated one, %d bit errors removed', 'WRN', nnz(x ~= bits));
+                        out(:) = x;
+                        return
+                    end
+                end
+            end
+        end
        
         %> @brief  K-means based demodulation
         %>
@@ -9,6 +9,10 @@
 %> The filter is based on the WaveShaper model. There is also an
 %> option to used a "ideal" rectangular filter model.
 %>
+%> The frequency response is cached for the last type, bandwidth,
+%> sampling rate and signal length, and the signal is filtered with
+%> fftFilter (all the components at once).
+%>
 %> __Example:__
 %> @code
 %> param.bandwidth = 28e9;             % Cutoff bandwidth
@@ -29,6 +33,17 @@ classdef BaseBandFilter_v1 < unit
         nInputs = 1;
         %> Number of outputs
         nOutputs = 1;
+        %> Use the native filtering engine (fftfilter_mex) if compiled {true | false}
+        mexEnabled = true;
+        %> Number of threads of the native engine. 0: all processors
+        nThreads = 0;
+    end
+    
+    properties (Hidden=true)
+        %> Parameters of the cached response {type, bandwidth, Fs, L}
+        filterKey = {};
+        %> Cached frequency response (FFT order)
+        filterH;
     end
     
     methods
@@ -40,6 +55,8 @@ classdef BaseBandFilter_v1 < unit
         %> @param param.type          Filter type. Possible values = {'gaussian', 'rectangular', 'ideal'}.
         %>                            [Default: ideal]
         %> @param param.bandwidth     Cutoff bandwidth [Hz]. 3dB bandwidth? Add more detailed explanation.
+        %> @param param.mexEnabled    Use the native filtering engine if compiled. [Default: true]
+        %> @param param.nThreads      Number of threads of the native engine, 0 for all processors. [Default: 0]
         function obj = BaseBandFilter_v1(param)
             obj.setparams(param);
         end
@@ -52,23 +69,58 @@ classdef BaseBandFilter_v1 < unit
         function Eout = traverse(obj, Ein)
             
             %> @brief Main filter
+            [Sf, f] = obj.response(Ein.Fs, Ein.L);
+            
+            % Perform filtering
+            Eout = Ein.funCols(@(X)fftFilter(X, Sf, obj.mexEnabled, obj.nThreads));
             
+            if obj.draw
+                figure;
+                plot(f*Ein.Fs/1e9,10*log10(Sf),'linewidth',4);
+                hold on;
+                B3dB = -3*ones(1,length(Sf));
+                plot(f*Ein.Fs/1e9,B3dB,'r--','linewidth',4);
+                xlabel('Frequency (GHz)');
+                ylabel('Att (dB)');
+                title(['Baseband Eq. Filter Frequency Response: BW = ' num2str(obj.bandwidth/1e9) ' GHz']);
+                legend('Attenuation Response','3dB Cutoff','location','SouthWest');
+                ylim([-20 1]);
+                xlim([-1.2*obj.bandwidth/1e9 1.2*obj.bandwidth/1e9]);
+            end
+        end
+        
+        %> @brief Frequency response of the filter
+        %>
+        %> The response is cached for the last type, bandwidth, sampling
+        %> rate and length.
+        %>
+        %> @param Fs    Sampling rate [Hz]
+        %> @param L     Number of samples
+        %>
+        %> @retval Sf   Frequency response in FFT order, L-by-1
+        %> @retval f    Normalized frequency axis
+        function [Sf, f] = response(obj, Fs, L)
             %> Frequency domain filtering:
-            f = linspace(-1/2,1/2,Ein.L);  %> Define frequency range
+            f = linspace(-1/2,1/2,L);  %> Define frequency range
+            key = {lower(obj.type), obj.bandwidth, Fs, L};
+            if isequal(key, obj.filterKey)
+                Sf = obj.filterH;
+                return
+            end
             
             switch lower(obj.type)
                    %> Extracted from WaveShaper Model of Finisar:
                 case 'gaussian'
-                    filt_sigma = (obj.bandwidth - 3.5e9)/Ein.Fs/2;
-                    filt_BW = 1e9/Ein.Fs;
+                    filt_sigma = (obj.bandwidth - 3.5e9)/Fs/2;
+                    filt_BW = 1e9/Fs;
                     %> Extracted from WaveShaper Model of Finisar:
                     %> Frequency domaing filter:
                     Sf  = filt_sigma*sqrt(2*pi)*(erf((filt_BW/2-f)/(filt_sigma*sqrt(2)))-erf((-filt_BW/2-f)/(filt_sigma*sqrt(2))));
                     Sf = Sf/max(abs(Sf));
                     
                 case 'rectangular'
-                    filt_sigma = 4.2466e9/Ein.Fs;
-                    filt_BW = obj.bandwidth/Ein.Fs;
+                    filt_sigma = 4.2466e9/Fs;
+                    filt_BW = obj.bandwidth/Fs;
                     %> Extracted from WaveShaper Model of Finisar:
                     %> Frequency domaing filter:
                     Sf  = filt_sigma*sqrt(2*pi)*(erf((filt_BW/2-f)/(filt_sigma*sqrt(2)))-erf((-filt_BW/2-f)/(filt_sigma*sqrt(2))));
@@ -76,30 +128,14 @@ classdef BaseBandFilter_v1 < unit
                     
                 case 'ideal'
                     %> Frequency domain ideal filter:
-                    filt_BW = obj.bandwidth/Ein.Fs/2;
-                    Sf = ones(1,Ein.L);
+                    filt_BW = obj.bandwidth/Fs/2;
+                    Sf = ones(1,L);
                     Sf(abs(f)>=filt_BW) = 0;
             end
             
             Sf = [Sf(ceil(length(Sf)/2):end) Sf(1:ceil(length(Sf)/2)-1)].';
-            
-            % Perform filtering
-            % FIXME: fun1 is twice as slow as manual filtering. How to improve?
-            Eout = Ein.fun1(@(x) ifft(fft(x).*Sf));
-            
-            if obj.draw
-                figure;
-                plot(f*Ein.Fs/1e9,10*log10(Sf),'linewidth',4);
-                hold on;
-                B3dB = -3*ones(1,length(Sf));
-                plot(f*Ein.Fs/1e9,B3dB,'r--','linewidth',4);
-                xlabel('Frequency (GHz)');
-                ylabel('Att (dB)');
-                title(['Baseband Eq. Filter Frequency Response: BW = ' num2str(obj.bandwidth/1e9) ' GHz']);
-                legend('Attenuation Response','3dB Cutoff','location','SouthWest');
-                ylim([-20 1]);
-                xlim([-1.2*obj.bandwidth/1e9 1.2*obj.bandwidth/1e9]);
-            end
+            obj.filterH = Sf;
+            obj.filterKey = key;
         end
     end
 end
@@ -9,6 +9,28 @@
 %> FFT-based chromatic dispersion compensation.  Applies dispersion
 %> transfer function to signal - reverse signs to compensate (e.g. if the
 %> fiber has a dispersion slope of 16.3 ps/nm/km, set obj.D = -16.3).
+%>
+%> By default the transfer function is applied with a single full-length
+%> FFT (exact circular filtering). If Nfft is set, it is applied by
+%> overlap-save in blocks of Nfft samples, the signal being treated as
+%> periodic as with the full-length FFT. Long captures can be compensated
+%> in chunks of any size with compensateChunk, in bounded memory, also by
+%> overlap-save (Nfft chosen automatically, minimum FFT cost per output
+%> sample, unless it is set).
+%>
+%> The overlap-save truncates the dispersion impulse response to the
+%> overlap: the overlap is the shortest one keeping all but tolerance^2
+%> of the energy of the impulse response, so that the relative rms error
+%> with respect to the exact filtering is at most tolerance for a white
+%> input filling the band [-Fs/2, Fs/2] (and smaller for narrower
+%> signals). The response decays slowly at full band: the overlap is a
+%> few times the group delay spread for tolerance = 1e-3, and grows
+%> quickly for smaller tolerances. The transfer function is cached for
+%> the last (Fs, D, S, L, lambda, Nfft, tolerance) combination.
+%>
+%> The native engine (cdcomp_mex, see compileMex) processes the
+%> polarizations with batched FFTW plans cached for the session and the
+%> blocks in parallel.
 %> 
 %> @author Robert Borkowski <rbor@fotonik.dtu.dk>
 %> @version 1
@@ -30,8 +52,25 @@ classdef CDCompensation_v1 < unit
         S = 0; 
         %> Compensation wavelength, m
         lambda = 1550e-9; 
-        %> FFT size, Sa
+        %> FFT block size of the overlap-save, Sa. 0: single full-length FFT (traverse), automatic (compensateChunk)
         Nfft = 0;
+        %> Maximum relative rms error of the overlap-save (truncated impulse response)
+        tolerance = 1e-3;
+        %> Use the native engine (cdcomp_mex) if compiled {true | false}
+        mexEnabled = true;
+        %> Number of threads of the native engine. 0: all processors
+        nThreads = 0;
+    end
+    
+    properties (Hidden=true)
+        %> Parameters of the cached filter [Fs D S L lambda Nfft tolerance]
+        filterKey = [];
+        %> Cached transfer function (FFT order)
+        filterH;
+        %> Cached overlap, Sa
+        filterOverlap;
+        %> Last input samples of the previous chunk (compensateChunk)
+        chunkState = [];
     end
     
     
@@ -49,6 +88,10 @@ classdef CDCompensation_v1 < unit
         %>
         %> @param param.D Dispersion parameter (ps/nm/km) (default 17)
         %> @param param.S Dispersion slope, ps/nm^2/km (default 0)
+        %> @param param.Nfft FFT block size of the overlap-save (default 0, single full-length FFT)
+        %> @param param.tolerance Maximum relative error of the overlap-save (default 1e-3)
+        %> @param param.mexEnabled Use the native engine if compiled (default true)
+        %> @param param.nThreads Number of threads of the native engine, 0 for all processors (default 0)
         %>
         %> @retval CDCompensation object
         function obj = CDCompensation_v1(params)
@@ -58,7 +101,6 @@ classdef CDCompensation_v1 < unit
             if obj.S
                 robolog('Dispersion slope compensation never tested. Use with caution.', 'WRN');
             end
-            %TODO add obj.Nfft setting
         end
         
         %>  @brief Traverse function
@@ -71,21 +113,119 @@ classdef CDCompensation_v1 < unit
         %> @retval out compensated signal
         %> @retval results no results
         function out = traverse(obj,in)
-            if obj.Nfft % If obj.Nfft is nonzero
-                % Set the specified FFT size
-                Nfft = obj.Nfft; %#ok<*PROP>
-            else
-                % Automatically choose FFT size based on the signal size
-                Nfft = in.L;
-            end            
-            if mod(Nfft/2, 1)==0
-                omega = 2*pi*[(0:Nfft/2-1),(-Nfft/2:-1)]'/(Nfft/in.Fs);
+            if obj.Nfft
+                [H, Nov] = obj.getFilter(in.Fs);
+            end
+            if ~obj.Nfft || in.L < Nov
+                % Single full-length FFT (one block, no overlap): exact
+                H = cdtransfun(obj,obj.fftOmega(in.L,in.Fs));
+                out = in.funCols(@(E)obj.overlapSave(E, H, 0, []));
             else
-                omega = 2*pi*[(0:Nfft/2-.5),(-Nfft/2:-1)]'/(Nfft/in.Fs);
+                % Periodic extension: the state holds the end of the signal
+                out = in.funCols(@(E)obj.periodicOverlapSave(E, H, Nov));
+            end
+        end
+        
+        %>  @brief Compensates a chunk of a long capture
+        %>
+        %>  Consecutive calls give the same result as compensating the
+        %>  concatenated chunks by overlap-save, delayed by half the
+        %>  overlap (the first call starts from zeros), i.e. the exact
+        %>  filtering within the tolerance. Call resetChunks before a new
+        %>  capture.
+        %>
+        %> @param x Chunk of the field, one column per component
+        %> @param Fs Sampling rate, Hz
+        %>
+        %> @retval y Compensated chunk, same size as x
+        function y = compensateChunk(obj,x,Fs)
+            [H, Nov] = obj.getFilter(Fs);
+            if ~isequal(size(obj.chunkState), [Nov size(x,2)])
+                obj.chunkState = zeros(Nov, size(x,2));
+            end
+            [y, obj.chunkState] = obj.overlapSave(x, H, Nov, obj.chunkState);
+        end
+        
+        %>  @brief Restarts the chunk processing (see compensateChunk)
+        function resetChunks(obj)
+            obj.chunkState = [];
+        end
+        
+        %>  @brief Overlap-save transfer function and overlap
+        %>
+        %>  The overlap is the shortest window [-Nov/2, Nov/2] holding all
+        %>  but tolerance^2 of the energy of the impulse response over the
+        %>  band [-Fs/2, Fs/2]. The result is cached.
+        %>
+        %> @param Fs Sampling rate, Hz
+        %>
+        %> @retval H transfer function, Nfft-by-1 (FFT order)
+        %> @retval Nov overlap, Sa (even)
+        function [H, Nov] = getFilter(obj,Fs)
+            key = [Fs obj.D obj.S obj.L obj.lambda obj.Nfft obj.tolerance];
+            if ~isequal(key, obj.filterKey)
+                % Impulse response on a grid much longer than the group
+                % delay spread, energy at each distance from t = 0
+                omega = linspace(-pi*Fs, pi*Fs, 1001)';
+                [~, tau] = cdtransfun(obj,omega);
+                N = 2^nextpow2(64*((max(tau)-min(tau))*Fs + 8));
+                e = abs(ifft(cdtransfun(obj,obj.fftOmega(N,Fs)))).^2;
+                e = [e(1); e(2:N/2)+e(N:-1:N/2+2); e(N/2+1)];
+                Nov = 2*max(find(cumsum(e) >= (1-obj.tolerance^2)*sum(e), 1)-1, 1);
+                if obj.Nfft
+                    Nfft = obj.Nfft; %#ok<*PROP>
+                    if Nfft <= Nov
+                        robolog('Nfft must be larger than the dispersion memory (%d samples at tolerance %g).', 'ERR', Nov, obj.tolerance);
+                    end
+                else
+                    % Minimum cost per output sample: Nfft*log2(Nfft)/(Nfft-Nov),
+                    % blocks of at least 256 samples (per-block overhead)
+                    Nfft = 2.^(max(nextpow2(Nov+1), 8)+(0:5));
+                    [~, k] = min(Nfft.*log2(Nfft)./(Nfft-Nov));
+                    Nfft = Nfft(k);
+                end
+                obj.filterH = cdtransfun(obj,obj.fftOmega(Nfft,Fs));
+                obj.filterOverlap = Nov;
+                obj.filterKey = key;
             end
-            H = cdtransfun(obj,omega);
-            out = fun1(in,@(s)ifft(H.*fft(s,Nfft),Nfft));
-        end        
+            H = obj.filterH;
+            Nov = obj.filterOverlap;
+        end
+        
+        %>  @brief Overlap-save filtering of a periodic signal
+        function Y = periodicOverlapSave(obj,E,H,Nov)
+            Y = obj.overlapSave([E; E(1:Nov/2,:)], H, Nov, E(end-Nov+1:end,:));
+            Y = Y(Nov/2+1:end,:);
+        end
+        
+        %>  @brief Streaming overlap-save filtering (see cdcomp_mex)
+        %>
+        %> @param X Input chunk, one column per component
+        %> @param H Transfer function (FFT order)
+        %> @param Nov Overlap (even)
+        %> @param state Last Nov input samples of the previous chunk
+        %>
+        %> @retval Y Filtered chunk, delayed by Nov/2 samples
+        %> @retval state Last Nov input samples, for the next chunk
+        function [Y, state] = overlapSave(obj,X,H,Nov,state)
+            if obj.mexEnabled && hasMex('cdcomp_mex')
+                [Y, state] = cdcomp_mex(X, H, Nov, state, obj.nThreads);
+                return
+            end
+            Nfft = numel(H);
+            S = Nfft-Nov;
+            M = size(X,1);
+            nBlocks = ceil(M/S);
+            z = [state; X];
+            z = [z; zeros(nBlocks*S+Nov-size(z,1), size(z,2))]; % Zero padding of the last block
+            Y = zeros(nBlocks*S, size(X,2));
+            for b=0:nBlocks-1
+                blk = ifft(bsxfun(@times, H, fft(z(b*S+(1:Nfft),:))));
+                Y(b*S+(1:S),:) = blk(Nov/2+(1:S),:);
+            end
+            Y = Y(1:M,:);
+            state = z(M+(1:Nov),:);
+        end
         
         %>  @brief Calculate CD transfer function
         %>
@@ -94,23 +234,35 @@ classdef CDCompensation_v1 < unit
         %> @param omega angular frequencies at which to calculate transfer function
         %>
         %> @retval H transfer function
-        function H = cdtransfun(obj,omega)
+        %> @retval tau group delay, s
+        function [H, tau] = cdtransfun(obj,omega)
             DL = obj.D.*obj.L*1e-3; % Convert to base SI units (ps/nm -> s/m)
             SL = obj.S.*obj.L*1e+6;
             SL = SL+2*DL/obj.lambda;
             dispersion = [DL SL];
             
-            phi = zeros(size(omega));
-            for term=1:numel(dispersion)
-                phi = phi + dispersion(term)/factorial(term+1) * (obj.lambda^2/(2*pi*const.c))^term * omega.^(term+1);
-            end
+            % Coefficients of omega.^2 and omega.^3
+            coef = dispersion./[2 6].*(obj.lambda^2/(2*pi*const.c)).^(1:2);
+            phi = omega.^2.*(coef(1)+coef(2)*omega);
             H = exp(1j*phi);
+            if nargout > 1
+                tau = omega.*(2*coef(1)+3*coef(2)*omega);
+            end
 %             terms = 1:numel(dispersion);
 %             phi = sum(dispersion./factorial(terms+1) * (lambda^2/(2*pi*const.c)).^terms * omega.^(terms+1));     
         end
         
     end
     
-    
+    methods (Static)
+        %> @brief Angular frequencies of an N-point FFT, rad/s
+        function omega = fftOmega(N,Fs)
+            if mod(N/2, 1)==0
+                omega = 2*pi*[(0:N/2-1),(-N/2:-1)]'/(N/Fs);
+            else
+                omega = 2*pi*[(0:N/2-.5),(-N/2:-1)]'/(N/Fs);
+            end
+        end
+    end
     
 end
\ No newline at end of file
@@ -0,0 +1,219 @@
+%> @file DBP_v1.m
+%> @brief Digital back-propagation for fiber nonlinearity compensation
+%>
+%> @class DBP_v1
+%> @brief Digital back-propagation for fiber nonlinearity compensation
+%>
+%> @ingroup coreDSP
+%>
+%> Compensates chromatic dispersion and self-phase modulation jointly by
+%> propagating the received field backwards through a model of the link
+%> (inverse split-step method). The link is described with the same
+%> parameters as NonlinearChannel_v1, so the same parameter structure can
+%> be passed to both units.
+%>
+%> To reach near full-DBP performance at 1-2 steps per span, the nonlinear
+%> step can be filtered and weighted \ref DuLowery "[1]": the nonlinear
+%> phase is computed from a low-pass filtered version of the total
+%> intensity and scaled by a weight (nonlinearWeight) smaller than one.
+%> Each nonlinear step is placed at the beginning of its segment, where the
+%> power is highest, and uses the segment effective length.
+%>
+%> __Observations__
+%>
+%> 1. The signal power is used as-is: the field must have the power it had
+%> at the output of the last amplifier (signal_interface tracks it).
+%>
+%> 2. Single polarization signals use the scalar NLSE, dual polarization
+%> signals the Manakov equation (8/9 factor).
+%>
+%> 3. If nChannels > 1, the columns are split into nChannels groups of 1 or 2
+%> columns (e.g. demultiplexed WDM channels) which are back-propagated
+%> independently, in parallel (per-channel DBP).
+%>
+%> 4. The native engine (dbp_mex) is used if compiled (see compileMex).
+%> Otherwise the equivalent MATLAB implementation is used.
+%>
+%> 5. Inline dispersion compensation (NonlinearChannel_v1.dispersionCompensationEnabled)
+%> and polarization mixing are not modelled.
+%>
+%> __Example__
+%> @code
+%>   param.dbp.nSpans = 10;
+%>   param.dbp.L = 80;
+%>   param.dbp.stepsPerSpan = 2;
+%>   param.dbp.nonlinearWeight = 0.8;
+%>   param.dbp.filterBandwidth = 10e9;
+%>
+%>   dbp = DBP_v1(param.dbp);
+%>
+%>   sigOut = dbp.traverse(sigIn);
+%> @endcode
+%>
+%> __References__
+%>
+%> * \anchor DuLowery [1] L. B. Du and A. J. Lowery, "Improved single channel backpropagation for
+%> intra-channel fiber nonlinearity compensation in long-haul optical communication systems,"
+%> Opt. Express 18, 17075-17088 (2010)
+%>
+%> @version 1
+classdef DBP_v1 < unit
+
+    properties
+        %> Number of fiber spans
+        nSpans = 1;
+        %> Length of each span [km]: 1-by-nSpans vector
+        L = 80;
+        %> Fiber attenuation [dB/km]: 1-by-nSpans vector
+        alpha = 0.2;
+        %> Dispersion coefficient [ps/nm/km]: 1-by-nSpans vector
+        D = 17;
+        %> Dispersion slope [ps/nm^2/km]: 1-by-nSpans vector
+        S = 0;
+        %> Nonlinear coefficient [W^-1*km^-1]: 1-by-nSpans vector
+        gamma = 1.2;
+        %> Gain of the amplifier after each span [dB]: 1-by-nSpans vector. Empty: compensates the span loss
+        EDFAGain = [];
+        %> Number of back-propagation steps per span: 1-by-nSpans vector
+        stepsPerSpan = 1;
+        %> Weight of the nonlinear phase
+        nonlinearWeight = 1;
+        %> 3-dB bandwidth of the Gaussian intensity filter [Hz]. 0: no filter
+        filterBandwidth = 0;
+        %> Number of independent channels in the signal columns
+        nChannels = 1;
+        %> Number of threads of the native engine. 0: all processors
+        nThreads = 0;
+        %> Use the native engine if available
+        mexEnabled = true;
+        %> Number of inputs
+        nInputs = 1;
+        %> Number of outputs
+        nOutputs = 1;
+    end
+
+    methods
+
+        %> @brief Class constructor
+        %>
+        %> Constructs an object of type DBP_v1.
+        %>
+        %> @param param.nSpans              Number of spans. [Default: 1]
+        %> @param param.L                   Span lengths [km]. Vector [1 x nSpans] or scalar. [Default: 80]
+        %> @param param.alpha               Fiber attenuation [dB/km]. Vector [1 x nSpans] or scalar. [Default: 0.2]
+        %> @param param.D                   Fiber dispersion coefficient [ps/nm/km]. Vector [1 x nSpans] or scalar. [Default: 17]
+        %> @param param.S                   Fiber dispersion slope [ps/nm^2/km]. Vector [1 x nSpans] or scalar. [Default: 0]
+        %> @param param.gamma               Fiber nonlinear coefficient [W^-1*km^-1]. Vector [1 x nSpans] or scalar. [Default: 1.2]
+        %> @param param.EDFAGain            Amplifier gains [dB]. Vector [1 x nSpans] or scalar. [Default: span loss]
+        %> @param param.stepsPerSpan        Number of steps per span. Vector [1 x nSpans] or scalar. [Default: 1]
+        %> @param param.nonlinearWeight     Weight of the nonlinear phase. [Default: 1]
+        %> @param param.filterBandwidth     Bandwidth of the intensity filter [Hz]. 0 disables the filter. [Default: 0]
+        %> @param param.nChannels           Number of channels back-propagated independently. [Default: 1]
+        %> @param param.nThreads            Number of threads (native engine). 0 uses all processors. [Default: 0]
+        %> @param param.mexEnabled          Use the native engine if compiled. [Default: true]
+        %>
+        %> @retval obj      An instance of the class DBP_v1
+        function obj = DBP_v1(param)
+            if ~exist('param', 'var')
+                param = struct();
+            end
+            % Accept the parameters of NonlinearChannel_v1
+            if ~isfield(param, 'alpha') && isfield(param, 'alphaa')
+                param.alpha = param.alphaa;
+            end
+            param = rmfield(param, intersect(fieldnames(param), {'alphaa', 'alphab'}));
+            obj.setparams(param);
+            if obj.nSpans > 1
+                propNames = {'L', 'alpha', 'D', 'S', 'gamma', 'EDFAGain', 'stepsPerSpan'};
+                for prop=propNames
+                    prop=prop{:};
+                    if length(obj.(prop)) == 1
+                        obj.(prop) = repmat(obj.(prop), 1, obj.nSpans);
+                    end
+                end
+            end
+            if isempty(obj.EDFAGain)
+                obj.EDFAGain = obj.alpha.*obj.L;
+            end
+        end
+
+        %> @brief Back-propagates the signal through the link
+        %>
+        %> @param in    The signal_interface of the received signal
+        %>
+        %> @retval out  The signal_interface of the back-propagated signal
+        function out = traverse(obj, in)
+            cKms       = const.c*1e-3;
+            lambda     = cKms/in.Fc;                        % Central lambda in km;
+            beta2      = -obj.D*lambda^2/(2*pi*cKms);       % Beta2 dispersion polynomial coefficient (chromatic dispersion)
+            beta3      = beta2.^2./obj.D.*(obj.S./obj.D + 2/lambda);  % Beta3 dispersion polynomial coefficient (dispersion slope)
+            beta3(obj.D == 0) = 0;
+            beta       = [zeros(2,obj.nSpans); beta2; beta3]; % Dispersion polynomial (NonlinearChannel_v1 convention)
+            alphalin   = obj.alpha/(10*log10(exp(1)));       % Fiber attenuation: convert dB/km to 1/km
+            G          = 10.^(obj.EDFAGain/10);
+
+            robolog('Digital back-propagation: %d spans, %d steps per span, %d channel(s).', ...
+                obj.nSpans, max(obj.stepsPerSpan), obj.nChannels);
+
+            E = in.get;
+            Pin = mean(pwr.meanpwr(E));
+            if obj.mexEnabled && hasMex('dbp_mex')
+                E = dbp_mex(E, in.Ts, obj.L, obj.stepsPerSpan, alphalin, beta, obj.gamma, G, ...
+                    obj.nonlinearWeight, obj.filterBandwidth, obj.nChannels, obj.nThreads);
+            else
+                E = obj.backPropagate(E, in.Ts, beta, alphalin, G);
+            end
+            Pout = mean(pwr.meanpwr(E));
+            out = in.set(E);
+            out = out.set('PCol', in.PCol*(Pout/Pin));
+        end
+
+        %> @brief MATLAB implementation of the back-propagation (same algorithm as dbp_mex)
+        %>
+        %> @param E         Received field [sqrt(W)]
+        %> @param dt        Sampling period [s]
+        %> @param beta      Dispersion polynomial, one column per span
+        %> @param alphalin  Attenuation [1/km]
+        %> @param G         Amplifier gains (linear)
+        %>
+        %> @retval E        Back-propagated field
+        function E = backPropagate(obj, E, dt, beta, alphalin, G)
+            nt = size(E, 1);
+            nCols = size(E, 2)/obj.nChannels;
+            if ~iswhole(nCols) || nCols > 2
+                robolog('The columns must split in groups of 1 or 2 polarizations.', 'ERR');
+            end
+            c = 1;
+            if nCols == 2
+                c = 8/9; % Manakov
+            end
+            w = 2*pi*[(0:ceil(nt/2)-1), (-floor(nt/2):-1)]'/(dt*nt);
+            if obj.filterBandwidth > 0
+                Hlpf = exp(-log(2)/2*(w/(2*pi*obj.filterBandwidth)).^2);
+            end
+            nb = size(beta, 1);
+            for k = obj.nSpans:-1:1
+                h = obj.L(k)/obj.stepsPerSpan(k);
+                Hs = exp(-1j*polyval(flipud(beta(:,k)./factorial(0:nb-1)'), w)*h + alphalin(k)*h/2);
+                if alphalin(k) > 0
+                    Leff = (1-exp(-alphalin(k)*h))/alphalin(k);
+                else
+                    Leff = h;
+                end
+                E = E/sqrt(G(k));
+                for n = 1:obj.stepsPerSpan(k)
+                    E = ifft(bsxfun(@times, Hs, fft(E)));
+                    for ch = 1:obj.nChannels
+                        cols = (ch-1)*nCols + (1:nCols);
+                        P = sum(abs(E(:,cols)).^2, 2);
+                        if obj.filterBandwidth > 0
+                            P = real(ifft(Hlpf.*fft(P)));
+                        end
+                        phi = obj.nonlinearWeight*c*obj.gamma(k)*Leff*P;
+                        E(:,cols) = bsxfun(@times, E(:,cols), exp(-1j*phi));
+                    end
+                end
+            end
+        end
+    end
+end
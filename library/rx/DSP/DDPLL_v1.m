@@ -50,6 +50,13 @@
 %> ddpll = DDPLL_v1(param.ddpll);
 %> @endcode
 %>
+%> __Native engine__
+%>
+%> If compiled (see compileMex), the loop runs in ddpll_mex, which gives the same
+%> results as the MATLAB loop. The hard decisions use a precomputed decision grid
+%> (only the constellation points that can be the closest in each cell are
+%> compared) and the components are processed in parallel.
+%>
 %> __Results:__
 %> * phaseEstimates - Vectors containing the phases estimated by the DDPLL
 %> * frequencyOffsets - Estimation of the frequency offset for each component
@@ -83,6 +90,10 @@ classdef DDPLL_v1 < unit
         initialPhase = 0;
         %> Flag to process a single polarization and apply the results to all the others
         speedupEnabled = 0;
+        %> Use the native engine (ddpll_mex) if compiled {true | false}
+        mexEnabled = true;
+        %> Number of threads of the native engine. 0: all processors
+        nThreads = 0;
         %Baud rate (for plotting, taken from input signal)
         Rs;
         %> Number of inputs
@@ -106,6 +117,8 @@ classdef DDPLL_v1 < unit
         %> @param param.initialPhase Phse used to initialize the DDPLL. Default: 0
         %> @param param.speedupEnabled If true the phase is estimated for a single component and used to
         %>                             compensate all the other components. Default: False.
+        %> @param param.mexEnabled Use the native engine if compiled. Default: true
+        %> @param param.nThreads Number of threads of the native engine. 0 uses all processors. Default: 0
         %>
         %> @retval obj instance of DDPLL_v1 class
         function obj = DDPLL_v1(param)
@@ -177,15 +190,24 @@ classdef DDPLL_v1 < unit
             
             robolog('Carrier recovery started.','NFO');
             Ts = 1/sig.Rs;
+            useMex = obj.mexEnabled && hasMex('ddpll_mex');
             if obj.speedupEnabled
                 % Compute the phase for the first component only and then apply the same to all the other
                 % components
-                [~, phaseEstimate] = obj.pll(Ein(:,1), Ts, obj.Kv(1), obj.tau1, obj.tau2, ...
-                    obj.refConstellation, obj.initialPhase, obj.N);
+                if useMex
+                    [~, phaseEstimate] = obj.pllMex(Ein(:,1), Ts, obj.Kv(1));
+                else
+                    [~, phaseEstimate] = obj.pll(Ein(:,1), Ts, obj.Kv(1), obj.tau1, obj.tau2, ...
+                        obj.refConstellation, obj.initialPhase);
+                end
                 % Save phase estimates in the results
                 obj.results.phaseEstimates = repmat(phaseEstimate, 1);
                 % Create a new signal_interface with the new field with the correct phase
                 out = sig.fun1( @(x) x.*exp(-1i*phaseEstimate));
+            elseif useMex
+                % All the components at once, in parallel
+                [E_hat, obj.results.phaseEstimates] = obj.pllMex(Ein, Ts, obj.Kv);
+                out = sig.set(E_hat);
             else
                 E_hat = zeros(sig.L, sig.N);
                 for i=1:sig.N
@@ -215,7 +237,8 @@ classdef DDPLL_v1 < unit
             end
             lw_eq = zeros(1,N);
             for i=1:N
-                [Sphi, f] = periodogram(diff(detrend(obj.results.phaseEstimates(end-L_est:end, i))), [],[],sig.Rs);
+                dphi = diff(detrend(obj.results.phaseEstimates(end-L_est:end, i)));
+                [Sphi, f] = welchPSD(dphi, sig.Rs, max(256, 2^nextpow2(L_est)), ones(L_est,1), 0); % Periodogram
                 cfact=4*(sin(pi*f/sig.Rs)./f).^2;
                 loop_bw = sqrt(2*obj.Kv(i)*sig.Rs/obj.tau1)/(2*pi);
                 [~,idx] = min(abs(f-loop_bw));
@@ -276,6 +299,22 @@ classdef DDPLL_v1 < unit
             phaseEstimate = phaseEstimate(1:end-1); % Remove the last estimate, which is unuseful
         end
         
+        %> @brief PLL core processing with the native engine (ddpll_mex)
+        %>
+        %> Same algorithm and results as pll, for all the columns of Ein at once.
+        %>
+        %> @param Ein Input complex field, one component per column.
+        %> @param Ts Symbol period.
+        %> @param Kv Loop constant. Scalar or one value per column.
+        %>
+        %> @retval E_hat Input signal with phase corrected.
+        %> @retval phaseEstimate Phase error estimates, one column per component.
+        function [E_hat, phaseEstimate] = pllMex(obj, Ein, Ts, Kv)
+            % Loop filter coefficients
+            a1b = [1 Ts/(2*obj.tau1) * ( 1+[-1 1]/tan(Ts/(2*obj.tau2)) ) ];
+            [E_hat, phaseEstimate] = ddpll_mex(Ein, a1b, Kv, obj.refConstellation, obj.initialPhase, obj.nThreads);
+        end
+        
         %> @brief Plot phase estimates
         %>
         %> Plots phase estimates and delta of the phase estimates as a function of the number of samples
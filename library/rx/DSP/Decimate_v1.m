@@ -8,6 +8,11 @@
 %> 
 %> Performs decimation according to the user-specified criterion.
 %>
+%> The criteria of all the sampling phases are computed in one pass over
+%> the signal by the native engine (timing_mex, see compileMex) when it is
+%> compiled, without building the symbol matrices of the MATLAB
+%> implementation.
+%>
 %>
 %> __Example:__
 %> @code
@@ -42,6 +47,10 @@ classdef Decimate_v1 < unit
         offset = 0;
         %> Decimation method
         method = 'variance';
+        %> Use the native engine (timing_mex) if compiled {true | false}
+        mexEnabled = true;
+        %> Number of threads of the native engine. 0: all processors
+        nThreads = 0;
     end
 
     
@@ -55,6 +64,8 @@ classdef Decimate_v1 < unit
         %> @param param.Nss          Target number of samples per symbol out. [Default: 1]
         %> @param param.offset       Number of samples to shift by [Default: 0].
         %> @param param.method       Decimation criterion {'variance' | 'gardner' | 'SLN' | 'gardner4nyquist'}. [Default: variance]
+        %> @param param.mexEnabled   Use the native engine if compiled. [Default: true]
+        %> @param param.nThreads     Number of threads of the native engine, 0 for all processors. [Default: 0]
         %>
         %> @retval obj      An instance of the class Decimate_v1
         function obj = Decimate_v1(param)
@@ -68,6 +79,9 @@ classdef Decimate_v1 < unit
         %> @retval out downsampled signal
         function out = traverse(obj,in)
             s = cell(1,in.N);
+            useMex = obj.mexEnabled && hasMex('timing_mex');
+            % Column of the native criteria used by each method
+            metricColumn = struct('variance', 1, 'gardner', 2, 'gardner4nyquist', 3, 'SLN', 4);
             for i=1:in.N
                 if strcmpi(obj.mode, 'separate')||i==1
                     if numel(obj.offset)>1
@@ -75,17 +89,26 @@ classdef Decimate_v1 < unit
                     else
                         colwiseOffset = obj.offset;
                     end
+                    metric = [];
+                    if useMex
+                        metric = timing_mex(in.E(:,i), in.Nss, 1e5, obj.nThreads);
+                        if isfield(metricColumn, obj.method)
+                            metric = metric(:,metricColumn.(obj.method)).';
+                        else
+                            metric = metric(:,1).';
+                        end
+                    end
                     switch obj.method
                         case 'variance'
-                            [s{i},idx,symb] = obj.decimate(in.E(:,i),in.Nss,obj.Nss,colwiseOffset);
+                            [s{i},idx,symb] = obj.decimate(in.E(:,i),in.Nss,obj.Nss,colwiseOffset,metric);
                         case 'gardner'
-                            [s{i},idx,symb] = obj.GardDecimate(in.E(:,i),in.Nss,obj.Nss,colwiseOffset);
+                            [s{i},idx,symb] = obj.GardDecimate(in.E(:,i),in.Nss,obj.Nss,colwiseOffset,metric);
                         case 'gardner4nyquist'
-                            [s{i},idx,symb] = obj.NyquistGardDecimate(in.E(:,i),in.Nss,obj.Nss,colwiseOffset);
+                            [s{i},idx,symb] = obj.NyquistGardDecimate(in.E(:,i),in.Nss,obj.Nss,colwiseOffset,metric);
                         case 'SLN'
-                            [s{i},idx,symb] = obj.SLNDecimate(in.E(:,i),in.Nss,obj.Nss,colwiseOffset);
+                            [s{i},idx,symb] = obj.SLNDecimate(in.E(:,i),in.Nss,obj.Nss,colwiseOffset,metric);
                         otherwise
-                            [s{i},idx,symb] = obj.decimate(in.E(:,i),in.Nss,obj.Nss,colwiseOffset);
+                            [s{i},idx,symb] = obj.decimate(in.E(:,i),in.Nss,obj.Nss,colwiseOffset,metric);
                     end
                 else
                     s{i} = in.E(idx(1):in.Nss/obj.Nss:end, i);
@@ -140,11 +163,12 @@ classdef Decimate_v1 < unit
         %> @param Nss_in Number of samples per symbol in
         %> @param Nss_out Number of samples per symbol out
         %> @param offset offset to apply
+        %> @param metric criterion of each sampling phase computed by timing_mex (optional)
         %>
         %> @retval out downsampled signal
         %> @retval idx sampling point
         %> @retval symbols reshaped input
-        function [out, idx, symbols] = decimate(x, Nss_in, Nss_out, offset)
+        function [out, idx, symbols] = decimate(x, Nss_in, Nss_out, offset, metric)
             if ~isvector(x)
                 warning('Input signal should be a vector.');
             end
@@ -154,18 +178,15 @@ classdef Decimate_v1 < unit
                 error('Ratio of the number of input to output samples must be an integer.');
             end
             if nargin<4, offset = 0; end
+            if nargin<5, metric = []; end
             N = Nss_in*fix(numel(x)/Nss_in);
-            %FIXME Two lines below: quick fix for out of memory errors          
-            x = x(1:N);
-            
-            SYMBOLS_LIMIT = 1e5;
-%             LIM = Nss_in*fix(SYMBOLS_LIMIT/Nss_in);
-            LIM = SYMBOLS_LIMIT*Nss_in;
-            LIM = min(LIM,N);
             
-            symbols = reshape(x(1:LIM),Nss_in,[]).'; % reshape signal into columns (column=symbol)
+            symbols = Decimate_v1.firstSymbols(x, Nss_in); % reshape signal into columns (column=symbol)
             
-            [~,ptr] = max(var(symbols)); % find maximum variance point
+            if isempty(metric)
+                metric = var(symbols);
+            end
+            [~,ptr] = max(metric); % find maximum variance point
             ptr = mod(ptr-1+offset,r)+1;
             idx = ptr:r:N;
             out = x(idx);
@@ -186,11 +207,12 @@ classdef Decimate_v1 < unit
         %> @param Nss_in Number of samples per symbol in
         %> @param Nss_out Number of samples per symbol out
         %> @param offset offset to apply
+        %> @param metric criterion of each sampling phase computed by timing_mex (optional)
         %>
         %> @retval out downsampled signal
         %> @retval idx sampling point
         %> @retval symbols reshaped input
-        function [out, idx, symbols]= GardDecimate(x, Nss_in, Nss_out, offset)
+        function [out, idx, symbols]= GardDecimate(x, Nss_in, Nss_out, offset, metric)
              if ~isvector(x)
                 warning('Input signal should be a vector.');
             end
@@ -200,21 +222,26 @@ classdef Decimate_v1 < unit
                 error('Ratio of the number of input to output samples must be an integer.');
             end
             if nargin<4, offset = 0; end
+            if nargin<5, metric = []; end
             if mod(Nss_in, 2), error('Input Nss must be even'); end
             N = Nss_in*fix(numel(x)/Nss_in);
-            x = x(1:N);
-            symbols = buffer(x,2*Nss_in+1, 1, 'nodelay'); % reshape signal into columns (column=symbol)
-            cstart=Nss_in/2;
-            for jj=1:Nss_in
-                err_gard(jj) = mean(real((symbols(cstart+jj-Nss_in/2, :)-symbols(cstart+jj+Nss_in/2, :)).*conj(symbols(cstart+jj, :))));
-               % var_err_gard(jj) = var(real((symbols(cstart+jj-Nss_in/2, :)-symbols(cstart+jj+Nss_in/2, :)).*conj(symbols(cstart+jj, :))));
+            if isempty(metric)
+                symbols = buffer(x(1:N),2*Nss_in+1, 1, 'nodelay'); % reshape signal into columns (column=symbol)
+                cstart=Nss_in/2;
+                for jj=1:Nss_in
+                    err_gard(jj) = mean(real((symbols(cstart+jj-Nss_in/2, :)-symbols(cstart+jj+Nss_in/2, :)).*conj(symbols(cstart+jj, :))));
+                   % var_err_gard(jj) = var(real((symbols(cstart+jj-Nss_in/2, :)-symbols(cstart+jj+Nss_in/2, :)).*conj(symbols(cstart+jj, :))));
+                end
+                symbols = symbols.';
+            else
+                err_gard = metric;
+                symbols = Decimate_v1.firstSymbols(x, Nss_in);
             end
                         
             [~,ptr] = min(abs(err_gard)); % find maximum variance point
             ptr = mod(ptr-1+offset,r)+1;
             idx = ptr:r:N;
             out = x(idx);
-            symbols = symbols.';
         end
         
         %> @brief Decimation using Nyquist/Gardner criteria
@@ -224,11 +251,12 @@ classdef Decimate_v1 < unit
         %> @param Nss_in Number of samples per symbol in
         %> @param Nss_out Number of samples per symbol out
         %> @param offset offset to apply
+        %> @param metric criterion of each sampling phase computed by timing_mex (optional)
         %>
         %> @retval out downsampled signal
         %> @retval idx sampling point
         %> @retval symbols reshaped input
-        function [out, idx, symbols]= NyquistGardDecimate(x, Nss_in, Nss_out, offset)
+        function [out, idx, symbols]= NyquistGardDecimate(x, Nss_in, Nss_out, offset, metric)
              if ~isvector(x)
                 warning('Input signal should be a vector.');
             end
@@ -238,19 +266,22 @@ classdef Decimate_v1 < unit
                 error('Ratio of the number of input to output samples must be an integer.');
             end
             if nargin<4, offset = 0; end
+            if nargin<5, metric = []; end
             if mod(Nss_in, 2), error('Input Nss must be even'); end
             N = Nss_in*fix(numel(x)/Nss_in);
             x = x(1:N);
-            symbols = buffer(x,2*Nss_in+1, 1, 'nodelay'); % reshape signal into columns (column=symbol)
-            cstart=Nss_in/2;
-            for jj=1:Nss_in
-                err_gard(jj) = mean(real((symbols(cstart+jj-Nss_in/2, :).*conj(symbols(cstart+jj-Nss_in/2, :))...
-                                         -symbols(cstart+jj+Nss_in/2, :).*conj(symbols(cstart+jj+Nss_in/2, :)))...
-                                         .*conj(symbols(cstart+jj, :)).*symbols(cstart+jj, :)));
-                                     
-                var_err_gard(jj) = var(real((symbols(cstart+jj-Nss_in/2, :).*conj(symbols(cstart+jj-Nss_in/2, :))...
-                                         -symbols(cstart+jj+Nss_in/2, :).*conj(symbols(cstart+jj+Nss_in/2, :)))...
-                                         .*conj(symbols(cstart+jj, :)).*symbols(cstart+jj, :)));
+            if isempty(metric)
+                symbols = buffer(x,2*Nss_in+1, 1, 'nodelay'); % reshape signal into columns (column=symbol)
+                cstart=Nss_in/2;
+                for jj=1:Nss_in
+                    err_gard(jj) = mean(real((symbols(cstart+jj-Nss_in/2, :).*conj(symbols(cstart+jj-Nss_in/2, :))...
+                                             -symbols(cstart+jj+Nss_in/2, :).*conj(symbols(cstart+jj+Nss_in/2, :)))...
+                                             .*conj(symbols(cstart+jj, :)).*symbols(cstart+jj, :)));
+                end
+                symbols = symbols.';
+            else
+                err_gard = metric;
+                symbols = Decimate_v1.firstSymbols(x, Nss_in);
             end
             
             %figure, plot(err_gard, '-o');
@@ -294,11 +325,12 @@ classdef Decimate_v1 < unit
         %> @param Nss_in Number of samples per symbol in
         %> @param Nss_out Number of samples per symbol out
         %> @param offset offset to apply
+        %> @param metric criterion of each sampling phase computed by timing_mex (optional)
         %>
         %> @retval out downsampled signal
         %> @retval idx sampling point
         %> @retval symbols reshaped input
-        function [out, idx, symbols]= SLNDecimate(x, Nss_in, Nss_out, offset)
+        function [out, idx, symbols]= SLNDecimate(x, Nss_in, Nss_out, offset, metric)
             if ~isvector(x)
                 warning('Input signal should be a vector.');
             end
@@ -308,12 +340,17 @@ classdef Decimate_v1 < unit
                 error('Ratio of the number of input to output samples must be an integer.');
             end
             if nargin<4, offset = 0; end
+            if nargin<5, metric = []; end
             if mod(Nss_in, 4), error('Input Nss must be a multiple of 4'); end
             N = Nss_in*fix(numel(x)/Nss_in);
-            x = x(1:N);
-            symbols = buffer(x,2*Nss_in+1, 1, 'nodelay').'; % reshape signal into columns (column=symbol)
-            for jj=1:Nss_in
-                err_SLN(jj) = mean(angle(abs(symbols(:, jj:Nss_in/4:jj+Nss_in-1)).^2*exp(-1i*.5*pi*(0:3)).'));
+            if isempty(metric)
+                symbols = buffer(x(1:N),2*Nss_in+1, 1, 'nodelay').'; % reshape signal into columns (column=symbol)
+                for jj=1:Nss_in
+                    err_SLN(jj) = mean(angle(abs(symbols(:, jj:Nss_in/4:jj+Nss_in-1)).^2*exp(-1i*.5*pi*(0:3)).'));
+                end
+            else
+                err_SLN = metric;
+                symbols = Decimate_v1.firstSymbols(x, Nss_in);
             end
             [~,ptr] = min(abs(err_SLN)); % find maximum variance point
             ptr = mod(ptr-1+offset,r)+1;
@@ -321,5 +358,17 @@ classdef Decimate_v1 < unit
             out = x(idx);
         end
         
+        %> @brief First symbols of a signal, one row per symbol
+        %>
+        %> @param x signal
+        %> @param Nss_in Number of samples per symbol
+        %>
+        %> @retval symbols at most 1e5 symbols, symbols-by-Nss_in
+        function symbols = firstSymbols(x, Nss_in)
+            SYMBOLS_LIMIT = 1e5;
+            LIM = min(SYMBOLS_LIMIT, fix(numel(x)/Nss_in))*Nss_in;
+            symbols = reshape(x(1:LIM),Nss_in,[]).';
+        end
+        
     end
 end
\ No newline at end of file
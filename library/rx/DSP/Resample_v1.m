@@ -8,6 +8,15 @@
 %> 
 %> RESAMPLER resamples the signal. Use normal and fast matlab (arbitrary clock phase), 
 %> a clock phase based on the Gardner estimate, or spline interpolation
+%>
+%> The spline interpolation of the 'gardner' and 'spline' methods runs on
+%> the native engine (resample_mex, see compileMex) when it is compiled.
+%> It computes the cubic spline with a recursive prefilter and evaluates
+%> it with a Farrow structure; when the ratio of the sampling rates is a
+%> ratio of small integers the interpolation weights are tabulated per
+%> phase (polyphase). The result is the one of interp1(...,'spline')
+%> except for the first and last few samples (mirror instead of
+%> not-a-knot end conditions).
 %> 
 %> @author Miguel Iglesias Olmedo
 %> @version 1
@@ -22,25 +31,36 @@ classdef Resample_v1 < unit
         method = 'spline';
         %> Sampling frequency of output signal (Hz)
         newFs;
+        %> Use the native engine (resample_mex) if compiled {true | false}
+        mexEnabled = true;
+        %> Number of threads of the native engine. 0: all processors
+        nThreads = 0;
     end
     methods
         %> @brief Class constructor
         %>
         %> @param param.method Resampling method ['matlab' | 'gardner'|'spline']; [default spline]
         %> @param param.newFs New sampling frequency [Hz]
+        %> @param param.mexEnabled Use the native engine if compiled [default true]
+        %> @param param.nThreads Number of threads of the native engine, 0 for all processors [default 0]
         function obj = Resample_v1(params)
             setparams(obj,params,{'newFs'}); %#ok<*EMCA>
         end
         
         %> @brief main
         function out = traverse(obj, sig)
+            if any(strcmpi(obj.method, {'gardner', 'spline'})) && obj.mexEnabled && hasMex('resample_mex')
+                nThreads = obj.nThreads;
+            else
+                nThreads = [];
+            end
             switch lower(obj.method)
                 case 'gardner'
-                    sig = sig.fun1(@(x)Resample_v1.resampler(x,sig.Fs,obj.newFs, sig.Rs)); %#ok<*EMFH>
+                    sig = sig.fun1(@(x)Resample_v1.resampler(x,sig.Fs,obj.newFs, sig.Rs, nThreads)); %#ok<*EMFH>
                 case 'matlab'
                     sig = sig.fun1(@(x)resample(x,obj.newFs,sig.Fs));
                 case 'spline'
-                    sig = sig.fun1(@(x)Resample_v1.splineResampler(x,sig.Fs,obj.newFs)); %#ok<*EMFH>
+                    sig = sig.fun1(@(x)Resample_v1.splineResampler(x,sig.Fs,obj.newFs, nThreads)); %#ok<*EMFH>
             end
             out = set(sig,'Fs',obj.newFs);
 %             out = signal_interface(sig.get, struct('Rs', sig.Rs, 'Fs', obj.newFs, 'Fc', sig.Fc, 'P', sig.P));
@@ -61,10 +81,12 @@ classdef Resample_v1 < unit
         %> @param Fs sampling frequency of input signal
         %> @param Fs_new sampling frequency of output signal
         %> @param Fb symbol rate
+        %> @param nThreads threads of the native interpolation (empty: MATLAB interp1) [default empty]
         %>
         %> @retval out resampled output
         %> @retval PD_gardner error detector output
-        function [out, PD_gardner] = resampler(in, Fs, Fs_new, Fb)
+        function [out, PD_gardner] = resampler(in, Fs, Fs_new, Fb, nThreads)
+            if nargin<5, nThreads = []; end
             
             % dt_rec = param_rx.Fs/(2*param_rx.baudrate);
             dt_rec = Fs/Fs_new;
@@ -93,7 +115,11 @@ classdef Resample_v1 < unit
             
             [~,PD_min] = min( abs(PD_gardner).^2 );
             Toff = var(PD_min)*nom_v;
-            out = interp1(in,t_new+Toff,'spline',0);
+            if isempty(nThreads)
+                out = interp1(in,t_new+Toff,'spline',0);
+            else
+                out = resample_mex(in(:), Toff, Resample_v1.interpStep(dt_rec), numel(t_new), nThreads);
+            end
             out = out(:);
         end
         
@@ -137,7 +163,22 @@ classdef Resample_v1 < unit
             
         end
         
-        function [out] = splineResampler(in, Fs, Fs_new)
+        %> @brief Resample using cubic spline interpolation
+        %>
+        %> @param in input signal
+        %> @param Fs sampling frequency of input signal
+        %> @param Fs_new sampling frequency of output signal
+        %> @param nThreads threads of the native interpolation (empty: MATLAB interp1) [default empty]
+        %>
+        %> @retval out resampled output
+        function [out] = splineResampler(in, Fs, Fs_new, nThreads)
+            if nargin<4, nThreads = []; end
+            if ~isempty(nThreads)
+                % Same samples as 0:1/Fs_new:(length(in)-1)/Fs
+                n = floor((length(in)-1)*Fs_new/Fs + 1e-10) + 1;
+                out = resample_mex(in(:), 0, Resample_v1.interpStep(Fs/Fs_new), n, nThreads);
+                return
+            end
             
             % dt_rec = param_rx.Fs/(2*param_rx.baudrate);
             dt_in = 0:1/Fs:((length(in)-1)/Fs);
@@ -146,5 +187,19 @@ classdef Resample_v1 < unit
             out = interp1(dt_in, in(:).', dt_out,'spline',0);
             out = out(:);
         end
+        
+        %> @brief Step of the native interpolation
+        %>
+        %> @param dt step between output samples, in input samples
+        %>
+        %> @retval step [p q] if dt = p/q with q <= 1024 (polyphase), dt otherwise
+        function step = interpStep(dt)
+            [p, q] = rat(dt, 1e-12*dt);
+            if q <= 1024 && abs(p/q-dt) <= 1e-12*dt
+                step = [p q];
+            else
+                step = dt;
+            end
+        end
     end
 end
@@ -0,0 +1,178 @@
+/*  File:           cdcomp_mex.c
+ *  Description:    Streaming overlap-save filtering of a multi-column
+ *                  field with a frequency-domain transfer function.
+ *                  Native engine of CDCompensation_v1, compiled as a
+ *                  MATLAB MEX function (see compileMex).
+ *
+ *  The input chunk X is appended to the last nov input samples of the
+ *  previous chunk (state), z = [state; X], and filtered in blocks of
+ *  nfft = numel(H) samples overlapping by nov samples:
+ *
+ *    block b = z(b*S + (1:nfft),:),  S = nfft - nov
+ *    Y(b*S + (1:S),:) = ifft(H.*fft(block))(nov/2 + (1:S),:)
+ *
+ *  The impulse response of H is centered at t = 0 and must be shorter
+ *  than nov+1 samples, so that each block gives S samples of the linear
+ *  convolution.  The output is thus delayed by nov/2 samples with
+ *  respect to the input and consecutive chunks give the same result as
+ *  a single one.  The new state is the last nov samples of z.
+ *
+ *  The columns of a block are transformed together (one batched plan
+ *  from the plan cache) and the blocks are distributed over the
+ *  threads.
+ */
+
+/*
+ * USAGE:
+ * [Y,state] = cdcomp_mex(X,H,nov);
+ * [Y,state] = cdcomp_mex(X,H,nov,state);
+ * [Y,state] = cdcomp_mex(X,H,nov,state,nthreads);
+ * cdcomp_mex -option
+ *
+ * INPUT
+ * X         Input chunk, M-by-N
+ * H         Transfer function in FFT order, nfft-by-1
+ * nov       Overlap between blocks (even, smaller than nfft)
+ * state     Last nov input samples of the previous chunk, nov-by-N.
+ *             Empty: zeros (default)
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * Y         Filtered chunk, M-by-N, delayed by nov/2 samples
+ * state     Last nov input samples, for the next chunk
+ *
+ * OPTIONS (i.e. cdcomp_mex -estimate): see plancache.h
+ */
+
+#include "robomex.h"
+#include "plancache.h"
+
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  int M;             /* samples in the chunk */
+  int N;             /* number of columns */
+  int ncols;         /* number of output columns (N, can be 0) */
+  int nfft;          /* block size */
+  int nov;           /* overlap */
+  int S;             /* output samples per block */
+  int nz;            /* samples of z = [state; X] */
+  int nblocks;       /* number of blocks */
+  int nthreads = 0;  /* number of threads */
+
+  COMPLEX* z;        /* [state; X] per column, zero padded */
+  COMPLEX* h;        /* transfer function scaled by 1/nfft */
+  COMPLEX* buf;      /* one block buffer per thread */
+  PLAN pf, pb;
+  double *yr, *yi, *sr, *si;
+  int ii, col, b;
+  size_t nzpad;
+
+  if (plancache_option(nrhs,prhs))
+    return;
+
+  if (nrhs < 3)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 2)
+    mexErrMsgTxt("Too many output arguments.");
+
+  plancache_begin();
+
+  /* parse input arguments */
+  M = (int) mxGetM(prhs[0]);
+  N = (int) mxGetN(prhs[0]);
+  nfft = (int) mxGetNumberOfElements(prhs[1]);
+  nov = (int) mxGetScalar(prhs[2]);
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,4,0));
+  ncols = N;
+
+  if ((int) mxGetM(prhs[1]) != nfft)
+    mexErrMsgTxt("The transfer function must be a column vector.");
+  if (nov < 0 || nov % 2 || nov >= nfft)
+    mexErrMsgTxt("The overlap must be even and smaller than the FFT size.");
+  if (nrhs > 3 && !mxIsEmpty(prhs[3]) &&
+      ((int) mxGetM(prhs[3]) != nov || (int) mxGetN(prhs[3]) != N))
+    mexErrMsgTxt("The state must be nov-by-N.");
+  if (N == 0)
+    N = 1;
+  S = nfft - nov;
+  nz = nov + M;
+  nblocks = (M + S - 1)/S;
+  if (nthreads > nblocks)
+    nthreads = nblocks > 0 ? nblocks : 1;
+
+  /* z = [state; X], padded to nblocks*S + nov samples */
+  nzpad = (size_t) nblocks*S + nov;
+  z = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*nzpad*N);
+  memset(z,0,sizeof(COMPLEX)*nzpad*N);
+  for (col = 0; col < ncols; col++) {
+    if (nrhs > 3 && !mxIsEmpty(prhs[3]) && nov > 0)
+      robomex_get_column(z + col*nzpad,prhs[3],col);
+    robomex_get_column(z + col*nzpad + nov,prhs[0],col);
+  }
+
+  h = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*nfft);
+  robomex_get_column(h,prhs[1],0);
+  for (ii = 0; ii < nfft; ii++) {
+    h[ii][0] /= nfft;
+    h[ii][1] /= nfft;
+  }
+
+  /* fftw3 plans (from the session cache), all columns at once */
+  pf = plancache_get(PLANCACHE_FORWARD, nfft, N, 1);
+  pb = plancache_get(PLANCACHE_BACKWARD, nfft, N, 1);
+  buf = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*nfft*N*nthreads);
+
+  plhs[0] = mxCreateDoubleMatrix(M,ncols,mxCOMPLEX);
+  yr = mxGetPr(plhs[0]);
+  yi = mxGetPi(plhs[0]);
+
+#ifdef _OPENMP
+#pragma omp parallel for private(ii,col) num_threads(nthreads) schedule(static)
+#endif
+  for (b = 0; b < nblocks; b++) {
+    COMPLEX* u;
+    REAL re;
+    int nout;
+#ifdef _OPENMP
+    u = buf + (size_t) omp_get_thread_num()*nfft*N;
+#else
+    u = buf;
+#endif
+    for (col = 0; col < N; col++)
+      memcpy(u + col*nfft,z + col*nzpad + (size_t) b*S,sizeof(COMPLEX)*nfft);
+    EXECUTE_DFT(pf,u,u);
+    for (col = 0; col < N; col++)
+      for (ii = 0; ii < nfft; ii++) {
+        re = u[col*nfft+ii][0]*h[ii][0] - u[col*nfft+ii][1]*h[ii][1];
+        u[col*nfft+ii][1] = u[col*nfft+ii][0]*h[ii][1] + u[col*nfft+ii][1]*h[ii][0];
+        u[col*nfft+ii][0] = re;
+      }
+    EXECUTE_DFT(pb,u,u);
+    nout = (b + 1)*S <= M ? S : M - b*S;
+    for (col = 0; col < ncols; col++)
+      for (ii = 0; ii < nout; ii++) {
+        yr[(size_t) col*M + b*S + ii] = u[col*nfft + nov/2 + ii][0];
+        yi[(size_t) col*M + b*S + ii] = u[col*nfft + nov/2 + ii][1];
+      }
+  }
+
+  /* new state: the last nov samples of z */
+  if (nlhs > 1) {
+    plhs[1] = mxCreateDoubleMatrix(nov,ncols,mxCOMPLEX);
+    sr = mxGetPr(plhs[1]);
+    si = mxGetPi(plhs[1]);
+    for (col = 0; col < ncols; col++)
+      for (ii = 0; ii < nov; ii++) {
+        sr[col*nov + ii] = z[col*nzpad + nz - nov + ii][0];
+        si[col*nov + ii] = z[col*nzpad + nz - nov + ii][1];
+      }
+  }
+
+  FFTW_FREE(z);
+  FFTW_FREE(h);
+  FFTW_FREE(buf);
+}
@@ -0,0 +1,321 @@
+/*  File:           dbp_mex.c
+ *  Description:    Digital back-propagation of a single or dual
+ *                  polarization field through a multi-span link using a
+ *                  reduced-step split-step method with filtered and
+ *                  weighted nonlinear steps.  Native engine of DBP_v1,
+ *                  compiled as a MATLAB MEX function (see compileMex).
+ *
+ *  The field is assumed to have been forward propagated with the
+ *  convention of NonlinearChannel_v1, i.e. each span solves
+ *
+ *    dA/dz = (j*beta(w) - alpha/2)*A + j*c*gamma*|A|^2*A
+ *
+ *  and is followed by an amplifier of power gain G.  The spans are
+ *  undone in reverse order.  Each step of length h applies the inverse
+ *  linear operator exp(-j*beta(w)*h + alpha*h/2) and then the inverse
+ *  nonlinear phase concentrated at the beginning of the step, where the
+ *  power is highest:
+ *
+ *    A = A .* exp(-j*xi*c*gamma*Leff*LPF(sum|A|^2)),  Leff = (1-exp(-alpha*h))/alpha
+ *
+ *  with c = 8/9 (Manakov) for dual polarization and c = 1 otherwise.
+ *  The low-pass filter (LPF) of the intensity and the weight xi < 1
+ *  allow near full-DBP performance with 1-2 steps per span.
+ */
+
+/*
+ * USAGE:
+ * U = dbp_mex(U0,dt,L,nsteps,alpha,betap,gamma,G,xi);
+ * U = dbp_mex(U0,dt,L,nsteps,alpha,betap,gamma,G,xi,flpf);
+ * U = dbp_mex(U0,dt,L,nsteps,alpha,betap,gamma,G,xi,flpf,ngroups);
+ * U = dbp_mex(U0,dt,L,nsteps,alpha,betap,gamma,G,xi,flpf,ngroups,nthreads);
+ * dbp_mex -option
+ *
+ * INPUT
+ * U0        Received field, nt-by-N [sqrt(W)]
+ * dt        Sampling period
+ * L         Span lengths, 1-by-nSpans (propagation order)
+ * nsteps    Steps per span, scalar or 1-by-nSpans
+ * alpha     Power attenuation coefficient, scalar or 1-by-nSpans
+ * betap     Dispersion polynomial coefs [beta_0 ... beta_m],
+ *             nb-by-1 or nb-by-nSpans
+ * gamma     Nonlinear coefficient, scalar or 1-by-nSpans
+ * G         Amplifier power gain after each span (linear), scalar or
+ *             1-by-nSpans
+ * xi        Nonlinear weight
+ * flpf      3-dB bandwidth of the Gaussian intensity filter (in units
+ *             of 1/dt).  0 or empty disables the filter (default)
+ * ngroups   Number of independent channels the columns are split into,
+ *             each with N/ngroups (1 or 2) columns (default 1)
+ * nthreads  Number of threads used to process the channels (default 0,
+ *             i.e. all processors)
+ *
+ * OPTIONS (i.e. dbp_mex -estimate): see plancache.h
+ */
+
+#include "robomex.h"
+#include "plancache.h"
+
+typedef struct {
+  int ncols;         /* columns (polarizations) in the group */
+  COMPLEX* u;        /* field, ncols*nt */
+  REAL* p;           /* intensity (in place r2c), 2*(nt/2+1) */
+} dbp_group;
+
+void compute_w(REAL*,REAL,int);
+void compute_hspan(COMPLEX*,REAL*,const mxArray*,int,REAL,REAL,int);
+void compute_hlpf(REAL*,REAL,REAL,int);
+void dbp_span(dbp_group*,COMPLEX*,REAL*,PLAN,PLAN,PLAN,PLAN,int,REAL,int);
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+/* Compute vector of angular frequency components
+ * MATLAB equivalent:  w = wspace(tv); */
+void compute_w(REAL* w,REAL dt,int nt)
+{
+  int jj;
+  for (jj = 0; jj <= (nt-1)/2; jj++) {
+    w[jj] = 2*ROBOMEX_PI*jj/(dt*nt);
+  }
+  for (; jj < nt; jj++) {
+    w[jj] = 2*ROBOMEX_PI*jj/(dt*nt) - 2*ROBOMEX_PI/dt;
+  }
+}
+
+
+/* Compute the inverse linear operator of one step of length h of span
+ * ispan, including the 1/nt normalization of the inverse FFT
+ *
+ * MATLAB equivalent:
+ *   hs = exp(-1j*polyval(flipud(betap./factorial(0:nb-1)'),w)*h + alpha*h/2)/nt;
+ */
+void compute_hspan(COMPLEX* hs,REAL* w,const mxArray* mxBeta,int ispan,
+                   REAL h,REAL alpha,int nt)
+{
+  int nb = (int) mxGetM(mxBeta);
+  double* beta = mxGetPr(mxBeta);
+  REAL fii,wii,phase,gain;
+  int jj,ii;
+
+  if (mxGetN(mxBeta) == 1)
+    ispan = 0;
+  beta += ispan*nb;
+  gain = exp(alpha*h/2)/nt;
+
+  for (jj = 0; jj < nt; jj++) {
+    for (ii = 0, phase = 0, fii = 1, wii = 1;
+         ii < nb;
+         ii++, fii*=ii, wii*=w[jj])
+      phase += wii*((REAL)beta[ii])/fii;
+    hs[jj][0] = +gain*cos(phase*h);
+    hs[jj][1] = -gain*sin(phase*h);
+  }
+}
+
+
+/* Compute the Gaussian intensity filter for the one-sided spectrum,
+ * including the 1/nt normalization of the inverse FFT
+ *
+ * MATLAB equivalent:
+ *   hl = exp(-log(2)/2*(f/flpf).^2)/nt;
+ */
+void compute_hlpf(REAL* hl,REAL dt,REAL flpf,int nt)
+{
+  int jj;
+  REAL f;
+  for (jj = 0; jj < nt/2+1; jj++) {
+    f = jj/(dt*nt);
+    hl[jj] = exp(-0.5*log(2.0)*(f/flpf)*(f/flpf))/nt;
+  }
+}
+
+
+/* Back-propagates one channel through nsteps steps of a span.  The
+ * amplifier gain must already have been removed. */
+void dbp_span(dbp_group* g,COMPLEX* hs,REAL* hl,PLAN pf,PLAN pb,
+              PLAN pr2c,PLAN pc2r,int nsteps,REAL nlphase,int nt)
+{
+  int iz,jj,kk;
+  int nc = nt/2+1;
+  REAL phi,c,s,re,*p = g->p;
+  COMPLEX *u,*pf_ = (COMPLEX*) g->p;
+
+  for (iz = 0; iz < nsteps; iz++) {
+
+    /* Linear step: u = ifft(hs.*fft(u)) for all the columns */
+    EXECUTE_DFT(pf,g->u,g->u);
+    for (kk = 0; kk < g->ncols; kk++) {
+      u = g->u + kk*nt;
+      for (jj = 0; jj < nt; jj++) {
+        re = hs[jj][0]*u[jj][0] - hs[jj][1]*u[jj][1];
+        u[jj][1] = hs[jj][0]*u[jj][1] + hs[jj][1]*u[jj][0];
+        u[jj][0] = re;
+      }
+    }
+    EXECUTE_DFT(pb,g->u,g->u);
+
+    /* Total intensity: p = sum(abs(u).^2,2) */
+    for (jj = 0; jj < nt; jj++)
+      p[jj] = abs2(&g->u[jj]);
+    for (kk = 1; kk < g->ncols; kk++) {
+      u = g->u + kk*nt;
+      for (jj = 0; jj < nt; jj++)
+        p[jj] += abs2(&u[jj]);
+    }
+
+    /* Filtered intensity: p = ifft(hl.*fft(p)) */
+    if (hl) {
+      EXECUTE_R2C(pr2c,p,pf_);
+      for (jj = 0; jj < nc; jj++) {
+        pf_[jj][0] *= hl[jj];
+        pf_[jj][1] *= hl[jj];
+      }
+      EXECUTE_C2R(pc2r,pf_,p);
+    }
+
+    /* Nonlinear step: u = u.*exp(-1j*nlphase*p) */
+    for (kk = 0; kk < g->ncols; kk++) {
+      u = g->u + kk*nt;
+      for (jj = 0; jj < nt; jj++) {
+        phi = nlphase*p[jj];
+        c = cos(phi);
+        s = sin(phi);
+        re = u[jj][0]*c + u[jj][1]*s;
+        u[jj][1] = u[jj][1]*c - u[jj][0]*s;
+        u[jj][0] = re;
+      }
+    }
+  }
+}
+
+
+/* This is the gateway function between MATLAB and DBP_MEX.  It
+ * serves as the main(). */
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  REAL dt;           /* time step */
+  int nspans;        /* number of spans */
+  REAL xi;           /* nonlinear weight */
+  REAL flpf = 0;     /* intensity filter bandwidth */
+  int ngroups = 1;   /* number of independent channels */
+  int nthreads = 0;  /* number of threads */
+
+  int nt, ncols;     /* field size */
+  REAL* w;           /* vector of angular frequencies */
+  COMPLEX* hs;       /* inverse linear step of the current span */
+  REAL* hl = NULL;   /* intensity filter */
+  dbp_group* groups;
+  PLAN pf,pb,pr2c = NULL,pc2r = NULL;
+
+  REAL h,alpha,gamma,gain,leff,c,nlphase;
+  REAL hprev = -1, alphaprev = -1;
+  int nsteps,ispan,ig,kk,sameop;
+
+  if (plancache_option(nrhs,prhs))
+    return;
+
+  if (nrhs < 9)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 1)
+    mexErrMsgTxt("Too many output arguments.");
+
+  plancache_begin();
+
+  /* parse input arguments */
+  nt = (int) mxGetM(prhs[0]);
+  ncols = (int) mxGetN(prhs[0]);
+  dt = (REAL) mxGetScalar(prhs[1]);
+  nspans = (int) mxGetNumberOfElements(prhs[2]);
+  xi = (REAL) mxGetScalar(prhs[8]);
+  flpf = (REAL) robomex_optional(nrhs,prhs,9,0);
+  ngroups = (int) robomex_optional(nrhs,prhs,10,1);
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,11,0));
+
+  if (!mxIsDouble(prhs[5]) || mxGetM(prhs[5]) == 0)
+    mexErrMsgTxt("Invalid dispersion polynomial (betap).");
+  if (mxGetN(prhs[5]) != 1 && (int) mxGetN(prhs[5]) != nspans)
+    mexErrMsgTxt("betap must have one column or one column per span.");
+  if (ngroups < 1 || ncols % ngroups || ncols/ngroups > 2)
+    mexErrMsgTxt("The columns must split in groups of 1 or 2 polarizations.");
+  if (mxGetNumberOfElements(prhs[4]) == 0 || mxGetNumberOfElements(prhs[6]) == 0 ||
+      mxGetNumberOfElements(prhs[7]) == 0)
+    mexErrMsgTxt("Empty parameter vector.");
+
+  /* all spans are checked before any buffer is allocated */
+  for (ispan = 0; ispan < nspans; ispan++)
+    if ((int) robomex_elem(prhs[3],ispan) < 1)
+      mexErrMsgTxt("At least one step per span is required.");
+
+  /* allocate memory */
+  w = (REAL*) mxMalloc(sizeof(REAL)*nt);
+  hs = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*nt);
+  groups = (dbp_group*) mxMalloc(sizeof(dbp_group)*ngroups);
+  for (ig = 0; ig < ngroups; ig++) {
+    groups[ig].ncols = ncols/ngroups;
+    groups[ig].u = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*nt*groups[ig].ncols);
+    groups[ig].p = (REAL*) robomex_malloc(sizeof(REAL)*2*(nt/2+1));
+    for (kk = 0; kk < groups[ig].ncols; kk++)
+      robomex_get_column(groups[ig].u + kk*nt, prhs[0], ig*groups[ig].ncols + kk);
+  }
+
+  /* fftw3 plans (from the session cache) */
+  pf = plancache_get(PLANCACHE_FORWARD, nt, ncols/ngroups, 1);
+  pb = plancache_get(PLANCACHE_BACKWARD, nt, ncols/ngroups, 1);
+  if (flpf > 0) {
+    pr2c = plancache_get(PLANCACHE_R2C, nt, 1, 1);
+    pc2r = plancache_get(PLANCACHE_C2R, nt, 1, 1);
+    hl = (REAL*) mxMalloc(sizeof(REAL)*(nt/2+1));
+    compute_hlpf(hl,dt,flpf,nt);
+  }
+
+  compute_w(w,dt,nt);
+  c = (ncols/ngroups == 2) ? 8.0/9.0 : 1.0;
+
+  for (ispan = nspans-1; ispan >= 0; ispan--) {
+    nsteps = (int) robomex_elem(prhs[3],ispan);
+    h = (REAL) (mxGetPr(prhs[2])[ispan]/nsteps);
+    alpha = (REAL) robomex_elem(prhs[4],ispan);
+    gamma = (REAL) robomex_elem(prhs[6],ispan);
+    gain = (REAL) robomex_elem(prhs[7],ispan);
+    leff = (alpha > 0) ? (1-exp(-alpha*h))/alpha : h;
+    nlphase = xi*c*gamma*leff;
+
+    /* The linear operator is recomputed only when the span differs from
+     * the previous one */
+    sameop = (h == hprev) && (alpha == alphaprev) && (mxGetN(prhs[5]) == 1);
+    if (!sameop)
+      compute_hspan(hs,w,prhs[5],ispan,h,alpha,nt);
+    hprev = h;
+    alphaprev = alpha;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic) if(ngroups > 1)
+#endif
+    for (ig = 0; ig < ngroups; ig++) {
+      int jj;
+      REAL scale = 1/sqrt(gain);
+      for (jj = 0; jj < nt*groups[ig].ncols; jj++) {
+        groups[ig].u[jj][0] *= scale;
+        groups[ig].u[jj][1] *= scale;
+      }
+      dbp_span(&groups[ig],hs,hl,pf,pb,pr2c,pc2r,nsteps,nlphase,nt);
+    }
+  }
+
+  /* allocate space for returned matrix */
+  plhs[0] = mxCreateDoubleMatrix(nt,ncols,mxCOMPLEX);
+  for (ig = 0; ig < ngroups; ig++) {
+    for (kk = 0; kk < groups[ig].ncols; kk++)
+      robomex_set_column(plhs[0], ig*groups[ig].ncols + kk, groups[ig].u + kk*nt, 1.0);
+    FFTW_FREE(groups[ig].u);
+    FFTW_FREE(groups[ig].p);
+  }
+
+  /* de-allocate memory */
+  mxFree(groups);
+  mxFree(w);
+  FFTW_FREE(hs);
+  if (hl)
+    mxFree(hl);
+}
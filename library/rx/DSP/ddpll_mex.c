@@ -0,0 +1,289 @@
+/*  File:           ddpll_mex.c
+ *  Description:    Second order type II decision-directed PLL.  Native
+ *                  engine of DDPLL_v1, compiled as a MATLAB MEX
+ *                  function (see compileMex).
+ *
+ *  For each symbol n of a component
+ *
+ *    y_n     = x_n*exp(-j*phi_n)
+ *    c_n     = constellation point closest to y_n
+ *    u_d     = imag(y_n*conj(c_n))
+ *    u_f     = a1b(1)*u_f + a1b(2)*u_d(n-1) + a1b(3)*u_d
+ *    phi_n+1 = phi_n + Kv*u_f
+ *
+ *  which is the loop of DDPLL_v1.pll, evaluated in the same order so
+ *  that the results are the same.
+ *
+ *  The hard decision uses a decision grid: the bounding box of the
+ *  constellation is divided in cells and each cell stores the points
+ *  that can be the closest to a sample falling in it (every point whose
+ *  distance to the cell is not larger than the smallest farthest
+ *  distance).  A sample inside the grid is compared with the few
+ *  candidates of its cell only, in the original order, so that the
+ *  decision (and the tie breaking) is the one of the exhaustive search,
+ *  which is used outside the grid.
+ *
+ *  The components are independent and are processed in parallel.
+ */
+
+/*
+ * USAGE:
+ * [E_hat,phi] = ddpll_mex(Ein,a1b,Kv,ref,phi0);
+ * [E_hat,phi] = ddpll_mex(Ein,a1b,Kv,ref,phi0,nthreads);
+ *
+ * INPUT
+ * Ein       Input field, L-by-N (one component per column)
+ * a1b       Loop filter coefficients, 1-by-3
+ * Kv        Loop gain, scalar or 1-by-N
+ * ref       Reference constellation points
+ * phi0      Initial phase [rad]
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * E_hat     Phase corrected field, L-by-N
+ * phi       Phase estimate of each symbol, L-by-N
+ */
+
+#include "robomex.h"
+
+#define GRID_MAX 128     /* maximum number of cells per dimension */
+
+typedef struct {
+  int M;             /* number of constellation points */
+  const double *cr, *ci;  /* constellation points */
+  int G;             /* cells per dimension (0: no grid) */
+  double x0, y0, w;  /* lower corner and width of the cells */
+  int* first;        /* candidates of cell c: cand[first[c] ... first[c+1]-1] */
+  int* cand;
+} decision_grid;
+
+void grid_build(decision_grid*,const double*,const double*,int);
+void grid_free(decision_grid*);
+int grid_decide(const decision_grid*,double,double);
+void ddpll_run(const decision_grid*,COMPLEX*,double*,double*,double*,
+               int,const double*,double,double);
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+/* Squared distance between the point (x,y) and the nearest (far = 0) or
+ * farthest (far = 1) point of the cell [a,a+w]x[b,b+w] */
+static double cell_dist2(double x,double y,double a,double b,double w,int far)
+{
+  double dx, dy;
+
+  if (far) {
+    dx = fabs(x - a) > fabs(x - a - w) ? x - a : x - a - w;
+    dy = fabs(y - b) > fabs(y - b - w) ? y - b : y - b - w;
+  } else {
+    dx = x < a ? a - x : (x > a + w ? x - a - w : 0);
+    dy = y < b ? b - y : (y > b + w ? y - b - w : 0);
+  }
+  return dx*dx + dy*dy;
+}
+
+
+/* Builds the decision grid of the constellation (cr,ci) */
+void grid_build(decision_grid* g,const double* cr,const double* ci,int M)
+{
+  int G, c, k, ix, iy, ncand;
+  double xmin, xmax, ymin, ymax, ext, a, b, thr, d;
+
+  g->M = M;
+  g->cr = cr;
+  g->ci = ci;
+  g->G = 0;
+  g->first = g->cand = NULL;
+  if (M < 4)
+    return;           /* not worth it */
+
+  xmin = xmax = cr[0];
+  ymin = ymax = ci[0];
+  for (k = 1; k < M; k++) {
+    if (cr[k] < xmin) xmin = cr[k];
+    if (cr[k] > xmax) xmax = cr[k];
+    if (ci[k] < ymin) ymin = ci[k];
+    if (ci[k] > ymax) ymax = ci[k];
+  }
+  /* square box around the constellation with a margin for the noise */
+  ext = (xmax - xmin > ymax - ymin ? xmax - xmin : ymax - ymin)*1.5;
+  if (!(ext > 0))
+    return;
+  G = 2*(int) ceil(sqrt((double) M)) + 2;
+  if (G > GRID_MAX)
+    G = GRID_MAX;
+  g->G = G;
+  g->w = ext/G;
+  g->x0 = (xmin + xmax - ext)/2;
+  g->y0 = (ymin + ymax - ext)/2;
+
+  /* two passes: count, then store the candidates */
+  g->first = (int*) mxMalloc(sizeof(int)*(G*G + 1));
+  g->cand = NULL;
+  while (1) {
+    ncand = 0;
+    for (iy = 0; iy < G; iy++)
+      for (ix = 0; ix < G; ix++) {
+        c = iy*G + ix;
+        a = g->x0 + ix*g->w;
+        b = g->y0 + iy*g->w;
+        thr = cell_dist2(cr[0],ci[0],a,b,g->w,1);
+        for (k = 1; k < M; k++) {
+          d = cell_dist2(cr[k],ci[k],a,b,g->w,1);
+          if (d < thr)
+            thr = d;
+        }
+        thr = thr*(1 + 1e-9) + 1e-300;   /* rounding safety */
+        g->first[c] = ncand;
+        for (k = 0; k < M; k++)
+          if (cell_dist2(cr[k],ci[k],a,b,g->w,0) <= thr) {
+            if (g->cand)
+              g->cand[ncand] = k;
+            ncand++;
+          }
+      }
+    g->first[G*G] = ncand;
+    if (g->cand)
+      break;
+    g->cand = (int*) mxMalloc(sizeof(int)*ncand);
+  }
+}
+
+
+void grid_free(decision_grid* g)
+{
+  if (g->first)
+    mxFree(g->first);
+  if (g->cand)
+    mxFree(g->cand);
+}
+
+
+/* Index of the constellation point closest to (x,y), the lowest index
+ * on ties (like min(abs(ref - y))) */
+int grid_decide(const decision_grid* g,double x,double y)
+{
+  int k, kk, k0, k1, ix, iy, best = 0;
+  double d, dbest;
+
+  if (g->G > 0 && x >= g->x0 && y >= g->y0) {
+    ix = (int) ((x - g->x0)/g->w);
+    iy = (int) ((y - g->y0)/g->w);
+    if (ix < g->G && iy < g->G) {
+      k0 = g->first[iy*g->G + ix];
+      k1 = g->first[iy*g->G + ix + 1];
+      best = g->cand[k0];
+      dbest = hypot(x - g->cr[best],y - g->ci[best]);
+      for (kk = k0 + 1; kk < k1; kk++) {
+        k = g->cand[kk];
+        d = hypot(x - g->cr[k],y - g->ci[k]);
+        if (d < dbest) {
+          dbest = d;
+          best = k;
+        }
+      }
+      return best;
+    }
+  }
+
+  /* exhaustive search */
+  dbest = hypot(x - g->cr[0],y - g->ci[0]);
+  for (k = 1; k < g->M; k++) {
+    d = hypot(x - g->cr[k],y - g->ci[k]);
+    if (d < dbest) {
+      dbest = d;
+      best = k;
+    }
+  }
+  return best;
+}
+
+
+/* Runs the PLL on the L samples of x */
+void ddpll_run(const decision_grid* g,COMPLEX* x,double* yr,double* yi,
+               double* phi,int L,const double* a1b,double Kv,double phi0)
+{
+  int n, k;
+  double ph = phi0, c, s, u_d = 0, u_d1, u_f = 0;
+
+  for (n = 0; n < L; n++) {
+    u_d1 = u_d;
+    phi[n] = ph;
+    c = cos(ph);
+    s = -sin(ph);
+    yr[n] = x[n][0]*c - x[n][1]*s;
+    yi[n] = x[n][0]*s + x[n][1]*c;
+    k = grid_decide(g,yr[n],yi[n]);
+    u_d = yi[n]*g->cr[k] - yr[n]*g->ci[k];
+    u_f = a1b[0]*u_f + a1b[1]*u_d1 + a1b[2]*u_d;
+    ph = ph + Kv*u_f;
+  }
+}
+
+
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  int L;             /* number of symbols */
+  int N;             /* number of components */
+  int M;             /* number of constellation points */
+  int nthreads;      /* number of threads */
+  decision_grid g;
+  COMPLEX* x;
+  double *cr, *ci, *kv, *yr, *yi, *phi;
+  double a1b[3], phi0;
+  int ii;
+
+  if (nrhs < 5)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 2)
+    mexErrMsgTxt("Too many output arguments.");
+
+  /* parse input arguments */
+  L = (int) mxGetM(prhs[0]);
+  N = (int) mxGetN(prhs[0]);
+  M = (int) mxGetNumberOfElements(prhs[3]);
+  if (mxGetNumberOfElements(prhs[1]) != 3)
+    mexErrMsgTxt("The loop filter must have 3 coefficients.");
+  if (M == 0)
+    mexErrMsgTxt("Empty reference constellation.");
+  for (ii = 0; ii < 3; ii++)
+    a1b[ii] = mxGetPr(prhs[1])[ii];
+  phi0 = mxGetScalar(prhs[4]);
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,5,0));
+  if (nthreads > N)
+    nthreads = N > 0 ? N : 1;
+
+  cr = (double*) mxMalloc(sizeof(double)*M);
+  ci = (double*) mxMalloc(sizeof(double)*M);
+  for (ii = 0; ii < M; ii++) {
+    cr[ii] = mxGetPr(prhs[3])[ii];
+    ci[ii] = mxIsComplex(prhs[3]) ? mxGetPi(prhs[3])[ii] : 0;
+  }
+  grid_build(&g,cr,ci,M);
+  kv = (double*) mxMalloc(sizeof(double)*(N > 0 ? N : 1));
+  for (ii = 0; ii < N; ii++)
+    kv[ii] = robomex_elem(prhs[2],ii);
+
+  x = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*L*(N > 0 ? N : 1));
+  for (ii = 0; ii < N; ii++)
+    robomex_get_column(x + (size_t) ii*L,prhs[0],ii);
+
+  plhs[0] = mxCreateDoubleMatrix(L,N,mxCOMPLEX);
+  yr = mxGetPr(plhs[0]);
+  yi = mxGetPi(plhs[0]);
+  plhs[1] = mxCreateDoubleMatrix(L,N,mxREAL);
+  phi = mxGetPr(plhs[1]);
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+  for (ii = 0; ii < N; ii++)
+    ddpll_run(&g,x + (size_t) ii*L,yr + (size_t) ii*L,yi + (size_t) ii*L,
+              phi + (size_t) ii*L,L,a1b,kv[ii],phi0);
+
+  FFTW_FREE(x);
+  grid_free(&g);
+  mxFree(cr);
+  mxFree(ci);
+  mxFree(kv);
+}
@@ -0,0 +1,377 @@
+/*  File:           rde_mex.c
+ *  Description:    2x2 butterfly FIR equalizer with blind (CMA/MMA,
+ *                  radius directed) and data-aided tap adaptation.
+ *                  Native engine of AdaptiveEqualizer_MMA_RDE_v1,
+ *                  compiled as a MATLAB MEX function (see compileMex).
+ *
+ *  For each output symbol n the equalizer takes the window
+ *  x = E((n-1)*Nss + (1:taps),:) and computes, for p = x,y
+ *
+ *    y_p = sum_k h_p1[k]*x_1[k] + h_p2[k]*x_2[k]
+ *    e_p = R2_p - |y_p|^2
+ *    h_pq = h_pq + mu_pq*e_p*y_p*conj(x_q)
+ *
+ *  R2_p is the target power given by the training sequence (data-aided)
+ *  or the squared radius closest to |y_p| (blind).  The radius list is
+ *  sorted, so the closest one is found by bisection.  Up to symbol
+ *  radiusFrom the radius is kept at its initial value (CMA
+ *  pre-convergence).
+ *
+ *  The two outputs adapt independently and are processed in parallel.
+ *  They only interact through the tap orthogonalization after symbol
+ *  orthoAt (h_xy = -conj(h_yx), h_yy = conj(h_xx)) and the adaptive
+ *  step size, which are applied between the two parallel sections or
+ *  symbol by symbol, respectively.
+ */
+
+/*
+ * USAGE:
+ * Y = rde_mex(E,H,[],Nss,L);
+ * [Y,H,errsq,mu] = rde_mex(E,H,mu,Nss,L,ref,ridx);
+ * [Y,H,errsq,mu] = rde_mex(E,H,mu,Nss,L,ref,ridx,dataAided,radiusFrom,orthoAt,adaptiveMu);
+ * [Y,H,errsq,mu,ENss] = rde_mex(...);
+ *
+ * INPUT
+ * E          Input field, N-by-2
+ * H          Taps [hxx hxy hyx hyy], taps-by-4
+ * mu         Step sizes, 2-by-2: mu(1) hxx, mu(2) hyx, mu(3) hxy,
+ *              mu(4) hyy.  Empty: filter only, no adaptation
+ * Nss        Input samples per output symbol
+ * L          Number of output symbols
+ * ref        Blind: radii sorted in ascending order.  Data-aided:
+ *              target powers |y|^2, L-by-2
+ * ridx       Initial radius index of each output (1-based), 1-by-2
+ * dataAided  ref holds target powers (default 0)
+ * radiusFrom Radius selection for symbols n > radiusFrom (default 0)
+ * orthoAt    Orthogonalize the taps after symbol orthoAt (default 0,
+ *              i.e. never)
+ * adaptiveMu Adapt the step size when the error changes sign
+ *              (default 0)
+ *
+ * OUTPUT
+ * Y          Equalized output, L-by-2
+ * H          Updated taps
+ * errsq      Error R2 - |y|^2 of each symbol, L-by-2
+ * mu         Updated step sizes
+ * ENss       Per-tap output contributions accumulated at the input
+ *              sample positions, N-by-2
+ */
+
+#include "robomex.h"
+
+typedef struct {
+  int ntaps;         /* number of taps */
+  int nss;           /* input samples per output symbol */
+  int N;             /* number of input samples */
+  int L;             /* number of output symbols */
+  REAL *xr[2], *xi[2];  /* input polarizations, split */
+  REAL *hr[4], *hi[4];  /* taps hxx hxy hyx hyy, split */
+  REAL mu[4];        /* step sizes, MATLAB order */
+  int adapt;         /* != 0 to update the taps */
+  int dataaided;     /* != 0 if ref holds target powers */
+  const double* ref; /* radii or target powers */
+  int nref;          /* number of radii */
+  int mref;          /* rows of the target powers */
+  double radiusfrom; /* radius selection for symbols n > radiusfrom */
+  int ridx[2];       /* current radius index of each output (0-based) */
+  double *yr, *yi;   /* output, L-by-2 */
+  double* err;       /* error, L-by-2 */
+  double *enr, *eni; /* per-tap contributions, N-by-2 (or NULL) */
+} rde_state;
+
+int nearest_radius(const double*,int,REAL);
+REAL rde_symbol(rde_state*,int,int);
+void rde_run(rde_state*,int,int,int);
+void rde_orthogonalize(rde_state*);
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+/* Index of the radius closest to a in the sorted list r (the lowest
+ * index on ties, like min(ipdm(r,a))) */
+int nearest_radius(const double* r,int nr,REAL a)
+{
+  int lo = 0, hi = nr, mid;
+
+  /* first radius >= a */
+  while (lo < hi) {
+    mid = (lo + hi)/2;
+    if (r[mid] < a)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == nr)
+    return nr - 1;
+  if (lo > 0 && a - r[lo-1] <= r[lo] - a)
+    return lo - 1;
+  return lo;
+}
+
+
+/* Equalizes and adapts output p at symbol n, returns the error */
+REAL rde_symbol(rde_state* s,int p,int n)
+{
+  int k, off = n*s->nss, K = s->ntaps;
+  const REAL *x1r = s->xr[0] + off, *x1i = s->xi[0] + off;
+  const REAL *x2r = s->xr[1] + off, *x2i = s->xi[1] + off;
+  REAL *h1r = s->hr[2*p], *h1i = s->hi[2*p];
+  REAL *h2r = s->hr[2*p+1], *h2i = s->hi[2*p+1];
+  REAL tr, ti, yr = 0, yi = 0, a, e, r2, cr, ci;
+  REAL ar[4] = {0, 0, 0, 0}, ai[4] = {0, 0, 0, 0};
+  double *enr, *eni;
+
+  if (s->enr) {
+    /* y = sum of the per-tap contributions, also accumulated at the
+     * input sample positions */
+    enr = s->enr + p*s->N + off;
+    eni = s->eni + p*s->N + off;
+    for (k = 0; k < K; k++) {
+      tr = h1r[k]*x1r[k] - h1i[k]*x1i[k] + h2r[k]*x2r[k] - h2i[k]*x2i[k];
+      ti = h1r[k]*x1i[k] + h1i[k]*x1r[k] + h2r[k]*x2i[k] + h2i[k]*x2r[k];
+      enr[k] += tr;
+      eni[k] += ti;
+      yr += tr;
+      yi += ti;
+    }
+  } else {
+    /* complex dot product, four independent partial sums */
+    for (k = 0; k + 3 < K; k += 4) {
+      ar[0] += h1r[k]*x1r[k] - h1i[k]*x1i[k] + h2r[k]*x2r[k] - h2i[k]*x2i[k];
+      ai[0] += h1r[k]*x1i[k] + h1i[k]*x1r[k] + h2r[k]*x2i[k] + h2i[k]*x2r[k];
+      ar[1] += h1r[k+1]*x1r[k+1] - h1i[k+1]*x1i[k+1] + h2r[k+1]*x2r[k+1] - h2i[k+1]*x2i[k+1];
+      ai[1] += h1r[k+1]*x1i[k+1] + h1i[k+1]*x1r[k+1] + h2r[k+1]*x2i[k+1] + h2i[k+1]*x2r[k+1];
+      ar[2] += h1r[k+2]*x1r[k+2] - h1i[k+2]*x1i[k+2] + h2r[k+2]*x2r[k+2] - h2i[k+2]*x2i[k+2];
+      ai[2] += h1r[k+2]*x1i[k+2] + h1i[k+2]*x1r[k+2] + h2r[k+2]*x2i[k+2] + h2i[k+2]*x2r[k+2];
+      ar[3] += h1r[k+3]*x1r[k+3] - h1i[k+3]*x1i[k+3] + h2r[k+3]*x2r[k+3] - h2i[k+3]*x2i[k+3];
+      ai[3] += h1r[k+3]*x1i[k+3] + h1i[k+3]*x1r[k+3] + h2r[k+3]*x2i[k+3] + h2i[k+3]*x2r[k+3];
+    }
+    for (; k < K; k++) {
+      ar[0] += h1r[k]*x1r[k] - h1i[k]*x1i[k] + h2r[k]*x2r[k] - h2i[k]*x2i[k];
+      ai[0] += h1r[k]*x1i[k] + h1i[k]*x1r[k] + h2r[k]*x2i[k] + h2i[k]*x2r[k];
+    }
+    yr = (ar[0] + ar[1]) + (ar[2] + ar[3]);
+    yi = (ai[0] + ai[1]) + (ai[2] + ai[3]);
+  }
+  s->yr[p*s->L + n] = yr;
+  s->yi[p*s->L + n] = yi;
+
+  if (!s->adapt)
+    return 0;
+
+  /* error according to the CMA/MMA rules or the training sequence */
+  a = (REAL) sqrt(yr*yr + yi*yi);
+  if (s->dataaided) {
+    r2 = (REAL) s->ref[p*s->mref + n];
+  } else {
+    if (n + 1 > s->radiusfrom)
+      s->ridx[p] = nearest_radius(s->ref,s->nref,a);
+    r2 = (REAL) (s->ref[s->ridx[p]]*s->ref[s->ridx[p]]);
+  }
+  e = r2 - a*a;
+  s->err[p*s->L + n] = e;
+
+  /* h_p1 += mu_p1*e*y*conj(x_1),  h_p2 += mu_p2*e*y*conj(x_2) */
+  cr = s->mu[p]*e*yr;
+  ci = s->mu[p]*e*yi;
+  for (k = 0; k < K; k++) {
+    h1r[k] += cr*x1r[k] + ci*x1i[k];
+    h1i[k] += ci*x1r[k] - cr*x1i[k];
+  }
+  cr = s->mu[p+2]*e*yr;
+  ci = s->mu[p+2]*e*yi;
+  for (k = 0; k < K; k++) {
+    h2r[k] += cr*x2r[k] + ci*x2i[k];
+    h2i[k] += ci*x2r[k] - cr*x2i[k];
+  }
+  return e;
+}
+
+
+/* Processes symbols n0 ... n1-1 of output p */
+void rde_run(rde_state* s,int p,int n0,int n1)
+{
+  int n;
+  for (n = n0; n < n1; n++)
+    rde_symbol(s,p,n);
+}
+
+
+/* Sets the Y polarization orthogonal to X to avoid converging to the
+ * same polarization (CMA singularity):
+ * hxy = -conj(hyx);  hyy = conj(hxx); */
+void rde_orthogonalize(rde_state* s)
+{
+  int k;
+  for (k = 0; k < s->ntaps; k++) {
+    s->hr[1][k] = -s->hr[2][k];
+    s->hi[1][k] = s->hi[2][k];
+    s->hr[3][k] = s->hr[0][k];
+    s->hi[3][k] = -s->hi[0][k];
+  }
+}
+
+
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  rde_state s;
+  COMPLEX* tmp;
+  mxArray* mxErr;
+  double *pr, *pi_, *pmu;
+  int ii, k, p, n, orthoat, adaptivemu, nseg, nthreads;
+  int seg[3];
+  REAL e[2], eprev[2];
+
+  if (nrhs < 5)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 5)
+    mexErrMsgTxt("Too many output arguments.");
+
+  /* parse input arguments */
+  s.N = (int) mxGetM(prhs[0]);
+  s.ntaps = (int) mxGetM(prhs[1]);
+  s.nss = (int) mxGetScalar(prhs[3]);
+  s.L = (int) mxGetScalar(prhs[4]);
+  s.adapt = !mxIsEmpty(prhs[2]);
+  if (mxGetN(prhs[0]) != 2 || mxGetN(prhs[1]) != 4)
+    mexErrMsgTxt("The input must be N-by-2 and the taps taps-by-4.");
+  if (s.nss < 1 || s.L < 0 || (s.L > 0 && (s.L-1)*s.nss + s.ntaps > s.N))
+    mexErrMsgTxt("The number of samples to equalize can not be larger than signal size.");
+  if (s.adapt && (nrhs < 7 || mxGetNumberOfElements(prhs[2]) != 4))
+    mexErrMsgTxt("Adaptation requires mu (2-by-2), ref and ridx.");
+
+  s.dataaided = (int) robomex_optional(nrhs,prhs,7,0);
+  s.radiusfrom = robomex_optional(nrhs,prhs,8,0);
+  orthoat = (int) robomex_optional(nrhs,prhs,9,0);
+  adaptivemu = (int) robomex_optional(nrhs,prhs,10,0);
+
+  if (s.adapt) {
+    for (ii = 0; ii < 4; ii++)
+      s.mu[ii] = (REAL) mxGetPr(prhs[2])[ii];
+    s.ref = mxGetPr(prhs[5]);
+    s.nref = (int) mxGetNumberOfElements(prhs[5]);
+    s.mref = (int) mxGetM(prhs[5]);
+    if (s.dataaided) {
+      if (s.mref < s.L || mxGetN(prhs[5]) < 2)
+        mexErrMsgTxt("The training sequence is shorter than the number of symbols.");
+    } else {
+      if (s.nref == 0)
+        mexErrMsgTxt("Empty radius list.");
+      for (p = 0; p < 2; p++) {
+        s.ridx[p] = (int) robomex_elem(prhs[6],p) - 1;
+        if (s.ridx[p] < 0 || s.ridx[p] >= s.nref)
+          mexErrMsgTxt("Radius index out of range.");
+      }
+    }
+  }
+
+  /* split copies of the input and the taps */
+  tmp = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*(s.N > s.ntaps ? s.N : s.ntaps));
+  for (p = 0; p < 2; p++) {
+    s.xr[p] = (REAL*) robomex_malloc(sizeof(REAL)*s.N);
+    s.xi[p] = (REAL*) robomex_malloc(sizeof(REAL)*s.N);
+    robomex_get_column(tmp,prhs[0],p);
+    for (ii = 0; ii < s.N; ii++) {
+      s.xr[p][ii] = tmp[ii][0];
+      s.xi[p][ii] = tmp[ii][1];
+    }
+  }
+  for (k = 0; k < 4; k++) {
+    s.hr[k] = (REAL*) robomex_malloc(sizeof(REAL)*s.ntaps);
+    s.hi[k] = (REAL*) robomex_malloc(sizeof(REAL)*s.ntaps);
+    pr = mxGetPr(prhs[1]) + k*s.ntaps;
+    pi_ = mxIsComplex(prhs[1]) ? mxGetPi(prhs[1]) + k*s.ntaps : NULL;
+    for (ii = 0; ii < s.ntaps; ii++) {
+      s.hr[k][ii] = (REAL) pr[ii];
+      s.hi[k][ii] = pi_ ? (REAL) pi_[ii] : 0;
+    }
+  }
+  FFTW_FREE(tmp);
+
+  plhs[0] = mxCreateDoubleMatrix(s.L,2,mxCOMPLEX);
+  s.yr = mxGetPr(plhs[0]);
+  s.yi = mxGetPi(plhs[0]);
+  mxErr = mxCreateDoubleMatrix(s.L,2,mxREAL);
+  s.err = mxGetPr(mxErr);
+  if (nlhs > 4) {
+    plhs[4] = mxCreateDoubleMatrix(s.N,2,mxCOMPLEX);
+    s.enr = mxGetPr(plhs[4]);
+    s.eni = mxGetPi(plhs[4]);
+  } else {
+    s.enr = s.eni = NULL;
+  }
+
+  if (!adaptivemu || !s.adapt) {
+    /* independent outputs: both polarizations in parallel, split at
+     * the orthogonalization */
+    nseg = 0;
+    seg[nseg++] = 0;
+    if (s.adapt && orthoat > 0 && orthoat < s.L)
+      seg[nseg++] = orthoat;
+    seg[nseg] = s.L;
+    nthreads = robomex_nthreads(0);
+    if (nthreads > 2)
+      nthreads = 2;
+    for (ii = 0; ii < nseg; ii++) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads)
+#endif
+      for (p = 0; p < 2; p++)
+        rde_run(&s,p,seg[ii],seg[ii+1]);
+      if (s.adapt && orthoat > 0 && seg[ii+1] == orthoat)
+        rde_orthogonalize(&s);
+    }
+  } else {
+    /* adaptive step size: the outputs are coupled symbol by symbol */
+    eprev[0] = eprev[1] = 0;
+    for (n = 0; n < s.L; n++) {
+      e[0] = rde_symbol(&s,0,n);
+      e[1] = rde_symbol(&s,1,n);
+      if (n == 0) {
+        s.mu[0] = s.mu[0]/(1 + s.mu[0]*e[0]*e[0]);
+        s.mu[1] = s.mu[1]/(1 + s.mu[1]*e[1]*e[1]);
+      } else if ((e[0] > 0) - (e[0] < 0) != (eprev[0] > 0) - (eprev[0] < 0)) {
+        s.mu[0] = s.mu[0]/(1 + s.mu[0]*e[0]*e[0]);
+        if ((e[1] > 0) - (e[1] < 0) != (eprev[1] > 0) - (eprev[1] < 0))
+          s.mu[1] = s.mu[1]/(1 + s.mu[1]*e[1]*e[1]);
+      }
+      s.mu[2] = s.mu[0];
+      s.mu[3] = s.mu[1];
+      eprev[0] = e[0];
+      eprev[1] = e[1];
+      if (n + 1 == orthoat)
+        rde_orthogonalize(&s);
+    }
+  }
+
+  /* updated taps and step sizes */
+  if (nlhs > 1) {
+    plhs[1] = mxCreateDoubleMatrix(s.ntaps,4,mxCOMPLEX);
+    pr = mxGetPr(plhs[1]);
+    pi_ = mxGetPi(plhs[1]);
+    for (k = 0; k < 4; k++)
+      for (ii = 0; ii < s.ntaps; ii++) {
+        pr[k*s.ntaps + ii] = s.hr[k][ii];
+        pi_[k*s.ntaps + ii] = s.hi[k][ii];
+      }
+  }
+  if (nlhs > 2)
+    plhs[2] = mxErr;
+  else
+    mxDestroyArray(mxErr);
+  if (nlhs > 3) {
+    plhs[3] = mxCreateDoubleMatrix(s.adapt ? 2 : 0,s.adapt ? 2 : 0,mxREAL);
+    pmu = mxGetPr(plhs[3]);
+    for (ii = 0; s.adapt && ii < 4; ii++)
+      pmu[ii] = s.mu[ii];
+  }
+
+  for (p = 0; p < 2; p++) {
+    FFTW_FREE(s.xr[p]);
+    FFTW_FREE(s.xi[p]);
+  }
+  for (k = 0; k < 4; k++) {
+    FFTW_FREE(s.hr[k]);
+    FFTW_FREE(s.hi[k]);
+  }
+}
@@ -0,0 +1,215 @@
+/*  File:           resample_mex.c
+ *  Description:    Fractional resampling by cubic spline interpolation.
+ *                  Native engine of Resample_v1, compiled as a MATLAB
+ *                  MEX function (see compileMex).
+ *
+ *  The signal is interpolated at the uniformly spaced positions
+ *
+ *    t_k = t0 + k*dt,  k = 0..n-1  (in samples, 0 is the first sample)
+ *
+ *  with a cubic spline.  The spline is computed as in
+ *
+ *    M. Unser, "Splines: a perfect fit for signal and image processing,"
+ *    IEEE Signal Process. Mag., vol. 16, no. 6, pp. 22-38, 1999.
+ *
+ *  i.e. the B-spline coefficients are obtained with a causal and an
+ *  anticausal first order recursive filter (mirror boundaries) and the
+ *  interpolant is evaluated with a Farrow structure: the four weights of
+ *  the coefficients around t_k are cubic polynomials of the fractional
+ *  position.  Away from the edges the result is the one of
+ *  interp1(...,'spline'); positions outside [0, M-1] give 0.
+ *
+ *  If the step is a ratio of integers dt = p/q (polyphase mode), the
+ *  positions are tracked with integers and the weights of the q phases
+ *  are tabulated once, so that there is no drift over long signals.
+ *  The output samples are computed in parallel.
+ */
+
+/*
+ * USAGE:
+ * Y = resample_mex(X,t0,dt,n);
+ * Y = resample_mex(X,t0,dt,n,nthreads);
+ *
+ * INPUT
+ * X         Input signal, M-by-N (one signal per column, real or complex)
+ * t0        Position of the first output sample [samples]
+ * dt        Step between output samples [samples], or [p q] for a step
+ *             of p/q (polyphase mode)
+ * n         Number of output samples
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * Y         Resampled signal, n-by-N
+ */
+
+#include "robomex.h"
+
+#define POLE (-0.26794919243112270)   /* sqrt(3)-2 */
+
+void spline_coefficients(double*,int);
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+/* Farrow weights of the coefficients c(i-1), c(i), c(i+1), c(i+2) at
+ * the position i+mu */
+static void farrow_weights(double mu,double* w)
+{
+  double mu2 = mu*mu, mu3 = mu2*mu;
+
+  w[0] = (1 - 3*mu + 3*mu2 - mu3)/6;
+  w[1] = (4 - 6*mu2 + 3*mu3)/6;
+  w[2] = (1 + 3*mu + 3*mu2 - 3*mu3)/6;
+  w[3] = mu3/6;
+}
+
+
+/* Index i mirrored into 0..M-1 */
+static int mirror(int i,int M)
+{
+  if (M == 1)
+    return 0;
+  while (i < 0 || i >= M)
+    i = i < 0 ? -i : 2*(M - 1) - i;
+  return i;
+}
+
+
+/* Replaces the M samples of c with their cubic B-spline coefficients */
+void spline_coefficients(double* c,int M)
+{
+  double z = POLE, zk, sum;
+  int k, horizon;
+
+  if (M < 2)
+    return;
+  for (k = 0; k < M; k++)
+    c[k] *= (1 - z)*(1 - 1/z);
+
+  /* causal initialization, truncated where z^k is negligible */
+  horizon = (int) ceil(log(1e-16)/log(fabs(z)));
+  if (horizon > M)
+    horizon = M;
+  sum = c[0];
+  zk = z;
+  for (k = 1; k < horizon; k++) {
+    sum += zk*c[k];
+    zk *= z;
+  }
+  c[0] = sum;
+  for (k = 1; k < M; k++)
+    c[k] += z*c[k - 1];
+
+  /* anticausal */
+  c[M - 1] = (z/(z*z - 1))*(z*c[M - 2] + c[M - 1]);
+  for (k = M - 2; k >= 0; k--)
+    c[k] = z*(c[k + 1] - c[k]);
+}
+
+
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  int M;             /* input samples */
+  int N;             /* number of columns */
+  int n;             /* output samples */
+  int nthreads;      /* number of threads */
+  int cplx;          /* complex input */
+  int polyphase;     /* step p/q */
+  double t0, dt = 0, p = 0, q = 1;
+  double *c, *w = NULL, *y;
+  int i0 = 0, col, part, k, ph;
+  double mu0 = 0;
+
+  if (nrhs < 4)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 1)
+    mexErrMsgTxt("Too many output arguments.");
+  if (mxIsSparse(prhs[0]) || !mxIsDouble(prhs[0]))
+    mexErrMsgTxt("The signal must be a full double array.");
+
+  /* parse input arguments */
+  M = (int) mxGetM(prhs[0]);
+  N = (int) mxGetN(prhs[0]);
+  cplx = mxIsComplex(prhs[0]);
+  t0 = mxGetScalar(prhs[1]);
+  polyphase = mxGetNumberOfElements(prhs[2]) == 2;
+  if (polyphase) {
+    p = mxGetPr(prhs[2])[0];
+    q = mxGetPr(prhs[2])[1];
+    if (p <= 0 || q < 1 || p != floor(p) || q != floor(q))
+      mexErrMsgTxt("The polyphase step must be [p q] with positive integers.");
+  } else {
+    dt = mxGetScalar(prhs[2]);
+    if (!(dt > 0))
+      mexErrMsgTxt("The step must be positive.");
+  }
+  n = (int) mxGetScalar(prhs[3]);
+  if (n < 0)
+    n = 0;
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,4,0));
+
+  plhs[0] = mxCreateDoubleMatrix(n,N,cplx ? mxCOMPLEX : mxREAL);
+  if (M == 0 || n == 0)
+    return;
+
+  /* polyphase: weights of the q phases, position t0 + k*p/q =
+   * i0 + floor(k*p/q) + (mu0 + mod(k*p,q)/q) */
+  if (polyphase) {
+    i0 = (int) floor(t0);
+    mu0 = t0 - i0;
+    w = (double*) mxMalloc(sizeof(double)*4*(size_t) q);
+    for (ph = 0; ph < (int) q; ph++) {
+      double mu = mu0 + ph/q;
+      farrow_weights(mu >= 1 ? mu - 1 : mu,w + 4*ph);
+    }
+  }
+
+  c = (double*) mxMalloc(sizeof(double)*M);
+  for (col = 0; col < N; col++)
+    for (part = 0; part < 1 + cplx; part++) {
+      memcpy(c,(part ? mxGetPi(prhs[0]) : mxGetPr(prhs[0])) + (size_t) col*M,
+             sizeof(double)*M);
+      spline_coefficients(c,M);
+      y = (part ? mxGetPi(plhs[0]) : mxGetPr(plhs[0])) + (size_t) col*n;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+#endif
+      for (k = 0; k < n; k++) {
+        double pos, mu, num, fl, wk[4];
+        const double* wp;
+        int i, m, r;
+
+        if (polyphase) {
+          num = k*p;
+          fl = floor(num/q);
+          r = (int) (num - fl*q);
+          mu = mu0 + r/q;
+          i = i0 + (int) fl + (mu >= 1);
+          mu = mu >= 1 ? mu - 1 : mu;
+          wp = w + 4*r;
+        } else {
+          pos = t0 + k*dt;
+          i = (int) floor(pos);
+          mu = pos - i;
+          farrow_weights(mu,wk);
+          wp = wk;
+        }
+        if (i < 0 || i > M - 1 || (i == M - 1 && mu > 0)) {
+          y[k] = 0;
+          continue;
+        }
+        if (i > 0 && i < M - 2) {
+          y[k] = wp[0]*c[i - 1] + wp[1]*c[i] + wp[2]*c[i + 1] + wp[3]*c[i + 2];
+        } else {
+          y[k] = 0;
+          for (m = 0; m < 4; m++)
+            y[k] += wp[m]*c[mirror(i - 1 + m,M)];
+        }
+      }
+    }
+
+  mxFree(c);
+  if (w)
+    mxFree(w);
+}
@@ -0,0 +1,164 @@
+/*  File:           timing_mex.c
+ *  Description:    Timing metrics of all the sampling phases of a
+ *                  signal in a single pass.  Native engine of
+ *                  Decimate_v1, compiled as a MATLAB MEX function (see
+ *                  compileMex).
+ *
+ *  For each phase p = 1..Nss (sample p of every symbol) the kernel
+ *  computes the criteria of the Decimate_v1 methods:
+ *
+ *    variance        var(x(p:Nss:end)) over the first nvar symbols
+ *    gardner         mean(real((x(n)-x(n+Nss)).*conj(x(n+Nss/2))))
+ *    gardner4nyquist mean(real((|x(n)|^2-|x(n+Nss)|^2).*|x(n+Nss/2)|^2))
+ *    SLN             mean(angle(sum_m |x(n+m*Nss/4)|^2*exp(-j*pi/2*m)))
+ *
+ *  where the last three are averaged over the frames of 2*Nss+1 samples
+ *  overlapping by one sample (n = p + k*2*Nss, zero padded at the end)
+ *  that Decimate_v1 builds with buffer.  SLN is the Oerder-Meyr square
+ *  law estimator.  The frames are split among the threads, each one
+ *  keeping its own accumulators, so the memory does not depend on the
+ *  signal length and the input is read in place.
+ */
+
+/*
+ * USAGE:
+ * M = timing_mex(x,Nss);
+ * M = timing_mex(x,Nss,nvar);
+ * M = timing_mex(x,Nss,nvar,nthreads);
+ *
+ * INPUT
+ * x         Signal, vector (real or complex)
+ * Nss       Number of samples per symbol
+ * nvar      Number of symbols for the variance (default 1e5)
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * M         Nss-by-4 [variance gardner gardner4nyquist SLN]. NaN where
+ *           the criterion is not defined (gardner: Nss odd, SLN: Nss
+ *           not a multiple of 4)
+ */
+
+#include "robomex.h"
+
+#define NACC 3           /* accumulators per phase and thread */
+
+void timing_frames(const double*,const double*,int,int,int,int,double*);
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+/* Sample i of (xr,xi), zero beyond N (padding of the last frame) */
+#define SAMPLE_R(i) ((i) < (size_t) N ? xr[i] : 0.0)
+#define SAMPLE_I(i) ((i) < (size_t) N && xi ? xi[i] : 0.0)
+
+
+/* Accumulates the frame criteria of frames k0..k1-1 in acc (NACC*Nss,
+ * per phase: gardner, nyquist, SLN) */
+void timing_frames(const double* xr,const double* xi,int N,int Nss,
+                   int k0,int k1,double* acc)
+{
+  int k, p, m;
+  size_t n;
+  double ar, ai, br, bi, cr, ci, a2, b2, c2, re, im, q[4];
+
+  for (k = k0; k < k1; k++)
+    for (p = 0; p < Nss; p++) {
+      n = (size_t) k*2*Nss + p;
+      if (Nss % 2 == 0) {
+        ar = SAMPLE_R(n);
+        ai = SAMPLE_I(n);
+        br = SAMPLE_R(n + Nss);
+        bi = SAMPLE_I(n + Nss);
+        cr = SAMPLE_R(n + Nss/2);
+        ci = SAMPLE_I(n + Nss/2);
+        a2 = ar*ar + ai*ai;
+        b2 = br*br + bi*bi;
+        c2 = cr*cr + ci*ci;
+        acc[p*NACC] += (ar - br)*cr + (ai - bi)*ci;
+        acc[p*NACC + 1] += (a2 - b2)*c2;
+      }
+      if (Nss % 4 == 0) {
+        for (m = 0; m < 4; m++) {
+          re = SAMPLE_R(n + m*Nss/4);
+          im = SAMPLE_I(n + m*Nss/4);
+          q[m] = re*re + im*im;
+        }
+        acc[p*NACC + 2] += atan2(q[3] - q[1],q[0] - q[2]);
+      }
+    }
+}
+
+
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  int N;             /* samples used (whole symbols) */
+  int Nss;           /* samples per symbol */
+  int nsym;          /* symbols */
+  int nvar;          /* symbols for the variance */
+  int K;             /* frames of 2*Nss+1 samples */
+  int nthreads;      /* number of threads */
+  const double *xr, *xi;
+  double *acc, *M, s1r, s1i, s2, dr, di;
+  int p, s, t;
+
+  if (nrhs < 2)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 1)
+    mexErrMsgTxt("Too many output arguments.");
+  if (mxIsSparse(prhs[0]) || !mxIsDouble(prhs[0]))
+    mexErrMsgTxt("The signal must be a full double array.");
+
+  /* parse input arguments */
+  Nss = (int) mxGetScalar(prhs[1]);
+  if (Nss < 1)
+    mexErrMsgTxt("The number of samples per symbol must be positive.");
+  nsym = (int) (mxGetNumberOfElements(prhs[0])/Nss);
+  N = nsym*Nss;
+  nvar = (int) robomex_optional(nrhs,prhs,2,1e5);
+  if (nvar > nsym)
+    nvar = nsym;
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,3,0));
+  xr = mxGetPr(prhs[0]);
+  xi = mxIsComplex(prhs[0]) ? mxGetPi(prhs[0]) : NULL;
+  K = N > 1 ? (N - 2)/(2*Nss) + 1 : 1;   /* ceil((N-1)/(2*Nss)) */
+  if (nthreads > K)
+    nthreads = K;
+
+  plhs[0] = mxCreateDoubleMatrix(Nss,4,mxREAL);
+  M = mxGetPr(plhs[0]);
+
+  /* frame criteria, one contiguous range of frames per thread */
+  acc = (double*) mxCalloc((size_t) NACC*Nss*nthreads,sizeof(double));
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthreads)
+  {
+    int it = omp_get_thread_num();
+    timing_frames(xr,xi,N,Nss,(int) ((double) K*it/nthreads),
+                  (int) ((double) K*(it + 1)/nthreads),acc + (size_t) it*NACC*Nss);
+  }
+#else
+  timing_frames(xr,xi,N,Nss,0,K,acc);
+#endif
+  for (t = 1; t < nthreads; t++)
+    for (p = 0; p < NACC*Nss; p++)
+      acc[p] += acc[(size_t) t*NACC*Nss + p];
+
+  for (p = 0; p < Nss; p++) {
+    /* variance, shifted by the first sample for accuracy */
+    s1r = s1i = s2 = 0;
+    for (s = 0; s < nvar; s++) {
+      dr = xr[(size_t) s*Nss + p] - xr[p];
+      di = xi ? xi[(size_t) s*Nss + p] - xi[p] : 0;
+      s1r += dr;
+      s1i += di;
+      s2 += dr*dr + di*di;
+    }
+    M[p] = nvar > 1 ? (s2 - (s1r*s1r + s1i*s1i)/nvar)/(nvar - 1) :
+      (nvar == 1 ? 0 : mxGetNaN());
+    M[Nss + p] = Nss % 2 == 0 ? acc[p*NACC]/K : mxGetNaN();
+    M[2*Nss + p] = Nss % 2 == 0 ? acc[p*NACC + 1]/K : mxGetNaN();
+    M[3*Nss + p] = Nss % 4 == 0 ? acc[p*NACC + 2]/K : mxGetNaN();
+  }
+
+  mxFree(acc);
+}
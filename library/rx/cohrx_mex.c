@@ -0,0 +1,220 @@
+/*  File:           cohrx_mex.c
+ *  Description:    Fused coherent detection (optical hybrid, balanced
+ *                  pairs, low-pass filter).  Native engine of
+ *                  CoherentDetector_v1, compiled as a MATLAB MEX function
+ *                  (see compileMex).
+ *
+ *  For each mode, with the beat b(n) = s(n)*conj(lo(n))*exp(j*2*pi*dnu*n)
+ *  of the signal and the LO, the four outputs of the 90 degree hybrid,
+ *  (s + c*lo)/4 with c = 1, -1, phase, -phase, are detected by two
+ *  balanced pairs of responsivity R and mixing ratio Rmix (finite CMRR):
+ *
+ *    I = R*(real(b)/4 + Rmix*(|s|^2 + |lo|^2)/8) + sigmaI*nI
+ *    Q = R*(real(conj(phase)*b)/4 + Rmix*(|s|^2 + |lo|^2)/8) + sigmaQ*nQ
+ *
+ *  nI and nQ are columns 2k and 2k+1 (mode k, 0-based) of the real
+ *  Philox stream of philoxRandn.  I and Q are then filtered by the IIR
+ *  filter (b,a) (as filter, direct form II transposed) and the first
+ *  skip samples are dropped.  Each output column is computed in a
+ *  single pass over the signal and the LO (the photocurrents of the
+ *  hybrid outputs are never stored); the 2*N columns are distributed
+ *  over the threads.  The second output holds the statistics needed
+ *  for the power bookkeeping of CoherentDetector_v1.
+ */
+
+/*
+ * USAGE:
+ * [Y,stats] = cohrx_mex(S,LO,dnu,phase,R,Rmix,sigma,b,a,skip,seed,stream);
+ * [Y,stats] = cohrx_mex(S,LO,dnu,phase,R,Rmix,sigma,b,a,skip,seed,stream,nthreads);
+ *
+ * INPUT
+ * S         Signal, L-by-N complex
+ * LO        Local oscillator, L-by-N complex
+ * dnu       Frequency of the signal relative to the LO [cycles/sample]
+ * phase     Hybrid phase exp(1j*phase_angle), N elements (complex)
+ * R         Responsivity, N elements
+ * Rmix      Mixing ratio of the balanced pairs, N elements
+ * sigma     Standard deviation of the noise currents, 2-by-N (rows: I
+ *             and Q pair of each mode)
+ * b, a      Low-pass filter coefficients (a(1) ~= 0), at most MAXORDER+1
+ * skip      Number of samples dropped at the beginning of the output
+ * seed      Noise seed (integer, 0..2^32-1)
+ * stream    Noise stream [id subid] (integers, 0..2^32-1)
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * Y         I + 1j*Q, (L-skip)-by-N
+ * stats     8-by-N, for each mode: mean(|s|^2), mean(|lo|^2), real and
+ *             imaginary parts of mean(b), mean of the squared I and Q
+ *             currents before the noise, mean of the squared outputs
+ *             I and Q
+ */
+
+#include "robomex.h"
+#include "philox.h"
+
+#define MAXORDER 16          /* highest order of the low-pass filter */
+#define REANCHOR 1024        /* samples between exact phasors */
+
+void detect_column(const mxArray*,const mxArray*,int,int,double,double,
+                   double,double,double,double,const double*,const double*,
+                   int,int,const uint32_T*,uint32_T,double*,double*);
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+/* Filtered current of mode k, quadrature q (0: I, 1: Q), written to y
+ * from sample skip on.  st receives the statistics of the column (the
+ * first four only for q == 0). */
+void detect_column(const mxArray* S,const mxArray* LO,int k,int q,
+                   double dnu,double cr,double ci,double R,double Rmix,
+                   double sigma,const double* b,const double* a,int nz,
+                   int skip,const uint32_T* key,uint32_T sub,double* y,
+                   double* st)
+{
+  int L = (int) mxGetM(S), n, n1, i;
+  double *sr = mxGetPr(S) + (size_t) k*L, *si = mxGetPi(S);
+  double *lr = mxGetPr(LO) + (size_t) k*L, *li = mxGetPi(LO);
+  double z[MAXORDER], g[2];
+  double pr,pi_,rr,ri,re,br,bi,ps,pl,x,v;
+  double sumS = 0, sumL = 0, sumBr = 0, sumBi = 0, sumX = 0, sumY = 0;
+  uint32_T col = (uint32_T) (2*k + q);
+
+  if (si)
+    si += (size_t) k*L;
+  if (li)
+    li += (size_t) k*L;
+  for (i = 0; i < nz; i++)
+    z[i] = 0;
+
+  rr = cos(2*ROBOMEX_PI*dnu);
+  ri = sin(2*ROBOMEX_PI*dnu);
+  for (n = 0; n < L; n = n1) {
+    double arg = 2*ROBOMEX_PI*fmod(dnu*(double) n,1.0);
+    n1 = n + REANCHOR < L ? n + REANCHOR : L;
+    pr = cos(arg);
+    pi_ = sin(arg);
+    for (; n < n1; n++) {
+      double s_r = sr[n], s_i = si ? si[n] : 0;
+      double l_r = lr[n], l_i = li ? li[n] : 0;
+
+      /* beat s*conj(lo)*exp(j*2*pi*dnu*n) */
+      re = s_r*l_r + s_i*l_i;
+      v = s_i*l_r - s_r*l_i;
+      br = re*pr - v*pi_;
+      bi = re*pi_ + v*pr;
+      ps = s_r*s_r + s_i*s_i;
+      pl = l_r*l_r + l_i*l_i;
+      if (q == 0) {
+        sumS += ps;
+        sumL += pl;
+        sumBr += br;
+        sumBi += bi;
+        x = R*(br/4 + Rmix*(ps + pl)/8);
+      } else
+        x = R*((cr*br + ci*bi)/4 + Rmix*(ps + pl)/8);
+      sumX += x*x;
+
+      /* noise current */
+      if (sigma > 0) {
+        if ((n & 1) == 0)
+          philox_gauss2((uint32_T) (n >> 1),col,key,sub,g);
+        x += sigma*g[n & 1];
+      }
+
+      /* low-pass filter */
+      v = b[0]*x + (nz ? z[0] : 0);
+      for (i = 0; i < nz - 1; i++)
+        z[i] = b[i+1]*x + z[i+1] - a[i+1]*v;
+      if (nz)
+        z[nz-1] = b[nz]*x - a[nz]*v;
+      if (n >= skip) {
+        y[n - skip] = v;
+        sumY += v*v;
+      }
+
+      re = pr*rr - pi_*ri;
+      pi_ = pr*ri + pi_*rr;
+      pr = re;
+    }
+  }
+
+  if (q == 0) {
+    st[0] = sumS/L;
+    st[1] = sumL/L;
+    st[2] = sumBr/L;
+    st[3] = sumBi/L;
+  }
+  st[4 + q] = sumX/L;
+  st[6 + q] = L > skip ? sumY/(L - skip) : 0;
+}
+
+
+/* This is the gateway function between MATLAB and COHRX_MEX.  It serves
+ * as the main(). */
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  int L;             /* samples */
+  int N;             /* modes */
+  int nb,na,nz,skip,nthreads,task,i;
+  double dnu,*cr,*ci,*R,*Rmix,*sigma,*st;
+  double b[MAXORDER + 1],a[MAXORDER + 1];
+  uint32_T key[2],sub;
+
+  if (nrhs < 12)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 2)
+    mexErrMsgTxt("Too many output arguments.");
+  for (i = 0; i < 9; i++)
+    if (!mxIsDouble(prhs[i]) || mxIsSparse(prhs[i]))
+      mexErrMsgTxt("The arguments must be full double arrays.");
+
+  /* parse input arguments */
+  L = (int) mxGetM(prhs[0]);
+  N = (int) mxGetN(prhs[0]);
+  if ((int) mxGetM(prhs[1]) != L || (int) mxGetN(prhs[1]) != N)
+    mexErrMsgTxt("The signal and the LO must have the same size.");
+  if ((int) mxGetNumberOfElements(prhs[3]) != N || (int) mxGetNumberOfElements(prhs[4]) != N
+      || (int) mxGetNumberOfElements(prhs[5]) != N)
+    mexErrMsgTxt("phase, R and Rmix must have one element per mode.");
+  if ((int) mxGetNumberOfElements(prhs[6]) != 2*N)
+    mexErrMsgTxt("sigma must have two elements (I and Q) per mode.");
+  dnu = mxGetScalar(prhs[2]);
+  cr = mxGetPr(prhs[3]);
+  ci = mxGetPi(prhs[3]);
+  R = mxGetPr(prhs[4]);
+  Rmix = mxGetPr(prhs[5]);
+  sigma = mxGetPr(prhs[6]);
+  nb = (int) mxGetNumberOfElements(prhs[7]);
+  na = (int) mxGetNumberOfElements(prhs[8]);
+  if (nb < 1 || na < 1 || nb > MAXORDER + 1 || na > MAXORDER + 1 || mxGetPr(prhs[8])[0] == 0)
+    mexErrMsgTxt("Invalid filter coefficients.");
+  nz = (nb > na ? nb : na) - 1;
+  for (i = 0; i <= nz; i++) {
+    b[i] = i < nb ? mxGetPr(prhs[7])[i]/mxGetPr(prhs[8])[0] : 0;
+    a[i] = i < na ? mxGetPr(prhs[8])[i]/mxGetPr(prhs[8])[0] : 0;
+  }
+  skip = (int) mxGetScalar(prhs[9]);
+  if (skip < 0 || skip > L)
+    mexErrMsgTxt("Invalid number of dropped samples.");
+  key[0] = (uint32_T) mxGetScalar(prhs[10]);
+  key[1] = (uint32_T) robomex_elem(prhs[11],0);
+  sub = mxGetNumberOfElements(prhs[11]) > 1 ? (uint32_T) robomex_elem(prhs[11],1) : 0;
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,12,0));
+  if (nthreads > 2*N)
+    nthreads = 2*N > 0 ? 2*N : 1;
+
+  plhs[0] = mxCreateDoubleMatrix(L - skip,N,mxCOMPLEX);
+  plhs[1] = mxCreateDoubleMatrix(8,N,mxREAL);
+  st = mxGetPr(plhs[1]);
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+  for (task = 0; task < 2*N; task++) {
+    int k = task/2, q = task % 2;
+    double* y = (q ? mxGetPi(plhs[0]) : mxGetPr(plhs[0])) + (size_t) k*(L - skip);
+    detect_column(prhs[0],prhs[1],k,q,dnu,cr[k],ci ? ci[k] : 0,R[k],Rmix[k],
+                  sigma[task],b,a,nz,skip,key,sub,y,st + 8*k);
+  }
+}
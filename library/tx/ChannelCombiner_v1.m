@@ -8,6 +8,19 @@
 %> signal. The outgoing carrier frequency is centered among the input
 %> signals.
 %>
+%> The channels can be upsampled by an integer factor (upsamplingRate) at
+%> the same time, so the transmitters can work at the rate of one channel.
+%> If the frequency offset of every channel is a whole number of FFT bins
+%> of the output (Fs/L), the spectrum of each channel is placed at its
+%> offset in the spectrum of the output, which upsamples and shifts in
+%> one FFT step. Otherwise each channel is upsampled by zero padding its
+%> spectrum, then shifted in time. The native engine (wdmcombine_mex) is
+%> used if compiled (see compileMex), otherwise the equivalent MATLAB
+%> implementation.
+%>
+%> The SNR of each column is that of the sum of the input powers (PCol),
+%> and its power is measured on the combined signal.
+%>
 %> @author Rasmus Jones
 %>
 %> @version 1
@@ -18,10 +31,51 @@ classdef ChannelCombiner_v1 < unit
         nInputs = 1;
         %> Number of outputs
         nOutputs = 1;
+        %> Integer upsampling factor of the channels
+        upsamplingRate = 1;
+        %> Number of threads of the native engine. 0: all processors
+        nThreads = 0;
+        %> Use the native engine if available
+        mexEnabled = true;
     end
     
     methods (Static)
         
+        %> @brief MATLAB implementation of the combination (same algorithm as wdmcombine_mex)
+        %>
+        %> @param X     Channels, the N columns of channel 1, then of channel 2, ...
+        %> @param nu    Frequency offset of each channel [cycles per output sample]
+        %> @param N     Number of columns per channel
+        %> @param up    Integer upsampling factor
+        %>
+        %> @retval E    Combined field, up*L-by-N
+        function E = combineChannels(X, nu, N, up)
+            [L, nCols] = size(X);
+            Lout = up*L;
+            k = nu*Lout;
+            s = [(0:ceil(L/2)-1), (-floor(L/2):-1)]';
+            if all(abs(k-round(k)) <= 1e-6)
+                % Spectrum placement
+                F = fft(X);
+                Y = zeros(Lout, N);
+                for c = 1:nCols/N
+                    idx = mod(s+round(k(c)), Lout)+1;
+                    Y(idx,:) = Y(idx,:) + F(:,(c-1)*N+(1:N));
+                end
+                E = ifft(Y)*up;
+                return
+            end
+            if up > 1
+                Y = zeros(Lout, nCols);
+                Y(mod(s, Lout)+1,:) = fft(X);
+                X = ifft(Y)*up;
+            end
+            n = (0:Lout-1)';
+            E = zeros(Lout, N);
+            for c = 1:nCols/N
+                E = E + bsxfun(@times, X(:,(c-1)*N+(1:N)), exp(2j*pi*mod(nu(c)*n, 1)));
+            end
+        end
     end
     
     methods
@@ -32,13 +86,16 @@ classdef ChannelCombiner_v1 < unit
         %>
         %> @param param.nInputs          Number of inputs.
         %> @param param.nOutputs         Number of outsputs.
+        %> @param param.upsamplingRate   Integer upsampling factor. [Default: 1]
+        %> @param param.nThreads         Number of threads (native engine). 0 uses all processors. [Default: 0]
+        %> @param param.mexEnabled       Use the native engine if compiled. [Default: true]
         %>
         %> @retval obj      An instance of the class ChannelCombiner_v1
         function obj = ChannelCombiner_v1(param)
             obj.setparams(param);
         end
         
-        %> @brief Brief description of what the traverse function does
+        %> @brief Shifts the signals to their carrier frequency and adds them
         %>
         %> @param in    The signal_interface of the input signals of different wavelength
         %>
@@ -58,19 +115,39 @@ classdef ChannelCombiner_v1 < unit
                 if Fs ~= varargin{ii}.Fs;
                     robolog('Sample frequency of all channels have to coincide.', 'ERR')
                 end
+                if varargin{1}.N ~= varargin{ii}.N || varargin{1}.L ~= varargin{ii}.L
+                    robolog('Sampling rate, and signal sizes of both signals must be equal.','ERR');
+                end
+                if varargin{1}.Rs ~= varargin{ii}.Rs
+                    robolog('Assuming symbol rate of the first signal (%sBd).', 'WRN', formatPrefixSI(varargin{1}.Rs,'%1.1f'));
+                end
+            end
+            if obj.upsamplingRate < 1 || ~iswhole(obj.upsamplingRate)
+                robolog('The upsampling rate must be a positive integer.', 'ERR')
             end
-            [~,ii]=max(Fc);
             % TODO check with obw
 
-            out=varargin{1};
+            %Center signal at center frequency
+            FcOut = (max(Fc)+min(Fc))/2;
+            FsOut = obj.upsamplingRate*Fs;
+            nu = (Fc-FcOut)/FsOut;
+            X = cell2mat(cellfun(@getScaled, varargin, 'UniformOutput', false));
+            if obj.mexEnabled && hasMex('wdmcombine_mex')
+                E = wdmcombine_mex(X, nu, varargin{1}.N, obj.upsamplingRate, obj.nThreads);
+            else
+                E = obj.combineChannels(X, nu, varargin{1}.N, obj.upsamplingRate);
+            end
+
+            % Power tracking: SNR of the sum of the inputs, measured power
+            PCol = varargin{1}.PCol;
             for ii=2:N
-                out = out + varargin{ii};
-                Fc(ii) = varargin{ii}.Fc;
+                PCol = PCol+varargin{ii}.PCol;
             end
-            %Center signal at center frequency
-            df = out.Fc-(max(Fc)+min(Fc))/2;
-            out = fun1(out, @(x)x.*exp(2i*pi*df/out.Fs*(0:out.L-1)'));
-            out = out.set('Fc',(max(Fc)+min(Fc))/2);
+            avpower = pwr.meanpwr(E);
+            for jj=1:numel(PCol)
+                PCol(jj) = pwr(PCol(jj).SNR, {avpower(jj), 'W'});
+            end
+            out = signal_interface(E, struct('Fs', FsOut, 'Rs', varargin{1}.Rs, 'Fc', FcOut, 'PCol', PCol));
         end
     end
 end
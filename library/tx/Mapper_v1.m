@@ -5,7 +5,8 @@
 %> @brief Mapper module
 %>
 %> This model maps an input binary signal in a modulation format
-%> constellation.
+%> constellation. The method demap computes the max-log LLRs of received
+%> symbols for the same constellations and Gray labels (see sd_maxlog).
 %>
 %>
 %> @author Julio Diniz
@@ -30,6 +31,10 @@ classdef Mapper_v1 < unit
         nInputs = 1;
         %> Number of outputs
         nOutputs = 1;
+        %> Use the native demapper if compiled
+        mexEnabled = true;
+        %> Number of threads of the native demapper, 0 for all processors
+        nThreads = 0;
     end
     
     methods
@@ -50,9 +55,11 @@ classdef Mapper_v1 < unit
         %>                             will be generated based on the i-th element of the modulationFormat and M arrays.
         %>                             If it's not empty the number of elements in the constellation must match the 
         %>                             corresponding element of the vector M.
+        %> @param param.mexEnabled     Use the native demapper if compiled. [Default: true]
+        %> @param param.nThreads       Number of threads of the native demapper. [Default: 0 (all)]
         function obj = Mapper_v1(param)
             requiredParams = {'M','modulationFormat'};
-            quietParams = {'constellation'};
+            quietParams = {'constellation','mexEnabled','nThreads'};
             if ~isfield(param, 'N') && isfield(param, 'M')
                 param.N = length(param.M);
             end
@@ -141,6 +148,37 @@ classdef Mapper_v1 < unit
             % Save results
             obj.results.txSymbolsIndices = indices;
         end
+        
+        %> @brief Max-log soft demapping of received symbols
+        %>
+        %> Computes the LLRs log(P(0)/P(1)) of the bits mapped by traverse, for the
+        %> same constellations and Gray labels (see sd_maxlog).
+        %>
+        %> @param symbolsSig signal_interface (or matrix) with N columns of received symbols,
+        %>                   scaled as the constellations
+        %> @param N0         Noise power, scalar or one value per mode
+        %>
+        %> @retval llr LLRs, matrix of size nSymbols x sum(log2(M)), with the layout of the
+        %>             input bits of traverse
+        function llr = demap(obj, symbolsSig, N0)
+            if isa(symbolsSig, 'signal_interface')
+                X = symbolsSig.getRaw();
+            else
+                X = symbolsSig;
+            end
+            if isscalar(N0)
+                N0 = N0*ones(1,obj.N);
+            end
+            llr = zeros(size(X,1), sum(log2(obj.M)));
+            last_in = 0;
+            for ii = 1:obj.N
+                K = log2(obj.M(ii));
+                labels = obj.grayLabels(obj.constellation{ii}, obj.modulationFormat{ii});
+                L = sd_maxlog(X(:,ii), obj.constellation{ii}, labels, N0(ii), obj.mexEnabled, obj.nThreads);
+                llr(:,last_in+1:last_in+K) = flipud(L).'; % MSB on the left, as the bits
+                last_in = last_in + K;
+            end
+        end
     end
     
     
@@ -158,6 +196,41 @@ classdef Mapper_v1 < unit
         %> @retval symbols Constellation symbols corresponding to the input bits
         %> @retval indexOut Indices of the INPUT constellation corresponding to the input bits (symbols = constellation(index))
         function [symbols, indexOut] = grayMap(constellation, modulationType, bits)
+            [constSorted, scidx, map] = Mapper_v1.graySort(constellation, modulationType);
+            
+            K = size(bits,2);
+            bitsDec = 1 + double(bits)*2.^(K-1:-1:0).'; % Convert bits to decimals + 1
+            index = map(bitsDec); % Indices of the SORTED constellation corresponding to the input bits
+            symbols = constSorted(index); % Output symbols
+            symbols = symbols(:);
+            indexOut = scidx(index); % Indices of the INPUT constellation corresponding to the input bits
+        end
+        
+        %> @brief Gray labels of the points of a constellation
+        %>
+        %> Label of each point of the input constellation, i.e. the bits mapped to it by
+        %> grayMap (MSB on the left) as an integer. To be used with the demappers of
+        %> constutils (sd_maxlog).
+        %>
+        %> @param constellation Constellation. Set of complex symbols.
+        %> @param modulationType Modulation type. [Possible values: 'PSK', 'ASK', 'QAM', 'USR']
+        %>
+        %> @retval labels Labels, integers 0..M-1, one per point of the input constellation
+        function labels = grayLabels(constellation, modulationType)
+            [~, scidx, map] = Mapper_v1.graySort(constellation, modulationType);
+            labels = zeros(numel(constellation),1);
+            labels(scidx(map)) = 0:numel(constellation)-1;
+        end
+        
+        %> @brief Gray map of a constellation
+        %>
+        %> @param constellation Constellation. Set of complex symbols.
+        %> @param modulationType Modulation type. [Possible values: 'PSK', 'ASK', 'QAM', 'USR']
+        %>
+        %> @retval constSorted Sorted constellation
+        %> @retval scidx Map between input and sorted constellation (constSorted = constellation(scidx))
+        %> @retval map Index of the sorted constellation of each bit pattern (value+1)
+        function [constSorted, scidx, map] = graySort(constellation, modulationType)
             M = numel(constellation);
             
             % Generate a map
@@ -178,6 +251,7 @@ classdef Mapper_v1 < unit
                     [constSorted, scidx] = Mapper_v1.sortConstellationQAM(constellation);
                 else
                     constSorted = constellation; % No sorting defined for non-squared QAM to perform proper gray mapping
+                    scidx = 1:M;
                     robolog('No squared QAM constellation. Not gray mapped.', 'WRN');
                 end
             else
@@ -185,12 +259,6 @@ classdef Mapper_v1 < unit
                 scidx = 1:M;
                 robolog('This constellation doesn''t support gray mapping. Performed random mapping.');
             end
-            
-            bitsDec = 1 + bi2de(fliplr(bits)); % Convert bits to decimals + 1
-            index = map(bitsDec); % Indices of the SORTED constellation corresponding to the input bits
-            symbols = constSorted(index); % Output symbols
-            symbols = symbols(:);
-            indexOut = scidx(index); % Indices of the INPUT constellation corresponding to the input bits
         end
         
         %> @brief Sort the symbols of a PSK constellation in order to allow gray mapping
@@ -15,6 +15,11 @@
 %> * PRBS23 = x^23 + x^18 + 1
 %> * PRBS31 = x^31 + x^28 + 1
 %>
+%> Each output starts at a random position of the sequence, generated
+%> directly by prbsWindow (jump-ahead), so the orders of
+%> OrthogonalCodeGenerator_v1.PNgenpoly up to 31 are supported without
+%> generating the whole period.
+%>
 %> @author Miguel Iglesias
 %>
 %> @version 1
@@ -40,6 +45,10 @@ classdef PPG_v1 < unit
         level1 = 1;
         %> Amplitude of low level
         level0 = 0;
+        %> Use the native PRBS generator if compiled
+        mexEnabled = true;
+        %> Number of threads of the native generator, 0 for all processors
+        nThreads = 0;
     end
     
     methods
@@ -54,6 +63,8 @@ classdef PPG_v1 < unit
         %>                              level0/1
         %> @param param.level0          Amplitude of high level. [Default: 1].
         %> @param param.level1          Amplitude of low level. [Default: 0].        
+        %> @param param.mexEnabled      Use the native PRBS generator if compiled. [Default: true].
+        %> @param param.nThreads        Number of threads of the native generator. [Default: 0 (all)].
         %>
         %> @retval obj      An instance of the class PPG_v1
         function obj = PPG_v1(param)
@@ -85,26 +96,13 @@ classdef PPG_v1 < unit
             % This outputs as many signal_interfaces as nOutputs.
             varargout = cell(1, obj.nOutputs);
             Poly = OrthogonalCodeGenerator_v1.PNgenpoly(obj.order);
-            Poly = sort(obj.order-Poly, 'descend');     %for compatibility with gen_prbs
-            InitState(Poly+1) = 1;
+            period = 2^obj.order-1;
             for i=1:obj.nOutputs
-                % Generate prbs
-                %FASTER, but requires communication system toolbox
-                try
-                    prbs = comm.PNSequence('Polynomial',Poly,'InitialConditions', InitState(1:obj.order), ...
-                        'SamplesPerFrame', obj.total_length);
-                    data=step(prbs);
-                    %re-set for next branch
-                    InitState = data((i+5)*obj.order:(i+6)*obj.order);
-                catch
-                    prbs = gen_prbs(obj.order);
-                    % Apply random delay to each prbs output
-                    prbs = circshift(prbs,round(randn*(2^obj.order-1)));
-                    % Make it long
-                    N=ceil(obj.total_length/(2^obj.order-1));
-                    data=repmat(prbs, N, 1);
-                    data=+data(1:obj.total_length, :);
-                end
+                % Generate prbs (same sequence as gen_prbs) with a random delay
+                % for each output: the window starts at that position and wraps
+                % around the period
+                start = mod(-round(randn*period), period);
+                data = +prbsWindow(Poly, 1, start, obj.total_length, obj.mexEnabled, obj.nThreads);
 
                 % Adjust levels
                 data(data==1) = obj.level1;
@@ -16,6 +16,9 @@
 %> * (Order=23) = x^23 + x^18 + 1
 %> * (Order=31) = x^31 + x^28 + 1
 %>
+%> The PRBS are generated by prbsWindow: a long pattern, or the part of the
+%> sequence starting at bit "offset", is generated without the bits before it.
+%>
 %> 2. If you define the Pattern type as Random, the sequence will be
 %> generated randomly using randi() function.
 %>
@@ -74,6 +77,12 @@ classdef PatternGenerator_v1 < unit
         typePattern = 'PRBS';
         %> Probability of zeros ('0')
         probZero = 0.5;
+        %> First bit of the PRBS window (bits skipped from the seed)
+        offset = 0;
+        %> Use the native PRBS generator if compiled
+        mexEnabled = true;
+        %> Number of threads of the native generator, 0 for all processors
+        nThreads = 0;
     end
     
     properties (Constant)
@@ -91,11 +100,14 @@ classdef PatternGenerator_v1 < unit
         %> @param param.PRBSOrder   PRBSOrder   - Polynomial order if typePattern set to "PRBS" (7, 15, 23, 31).
         %> @param param.seed        Seed        - Seeds for "PRBS" signal. Should be a vector. Cannot be zero.
         %> @param param.probZero    ProbZero    - Probability of zeros if typePattern set to "Random".
+        %> @param param.offset      Offset      - First bit of the PRBS window. [Default: 0]
+        %> @param param.mexEnabled  MexEnabled  - Use the native PRBS generator if compiled. [Default: true]
+        %> @param param.nThreads    NThreads    - Number of threads of the native generator. [Default: 0 (all)]
         %>
         %> @retval obj      An instance of the class PatternGenerator_v1
         function obj = PatternGenerator_v1(param)
             %> Setting parameters to object
-            obj.setparams(param,{'M'},{'N','lengthSequence', 'PRBSOrder','seed','typePattern','probZero','allowedPRBSOrders'})
+            obj.setparams(param,{'M'},{'N','lengthSequence', 'PRBSOrder','seed','typePattern','probZero','allowedPRBSOrders','offset','mexEnabled','nThreads'})
             
             if length(obj.M) ~= obj.N
                 if length(obj.M) == 1
@@ -149,7 +161,7 @@ classdef PatternGenerator_v1 < unit
         
         function out = traverse(obj)
             if strcmp(obj.typePattern, 'PRBS')
-                data = obj.gen_prbs_v1(obj.PRBSOrder, obj.seed, obj.lengthSequence); % Generate prbs
+                data = obj.gen_prbs_v1(obj.PRBSOrder, obj.seed, obj.lengthSequence, obj.offset, obj.mexEnabled, obj.nThreads); % Generate prbs
             else
                 data = obj.gen_random_pattern_v1(obj.probZero, sum(log2(obj.M)), obj.lengthSequence);     % Generate Bernoulli Random data pattern
             end
@@ -158,7 +170,23 @@ classdef PatternGenerator_v1 < unit
     end
     
     methods (Static)
-        function out = gen_prbs_v1(order, seed, lengthSequence)             % PRBS Generation
+        %> @brief PRBS generation
+        %>
+        %> Column jj is the PRBS whose first order bits are de2bi(seed(jj), order),
+        %> from bit offset on.
+        %>
+        %> @param order             PRBS order (7, 15, 23, 31)
+        %> @param seed              Seeds, one column per seed
+        %> @param lengthSequence    Number of bits
+        %> @param offset            First bit [Default: 0]
+        %> @param useMex            Use the native generator if compiled [Default: true]
+        %> @param nThreads          Number of threads of the native generator [Default: 0]
+        %>
+        %> @retval out              lengthSequence-by-length(seed) bits
+        function out = gen_prbs_v1(order, seed, lengthSequence, offset, useMex, nThreads)
+            if nargin<4, offset = 0; end
+            if nargin<5, useMex = true; end
+            if nargin<6, nThreads = 0; end
             switch order
                 case 7
                     polynomial = [7 6];
@@ -169,13 +197,7 @@ classdef PatternGenerator_v1 < unit
                 case 31
                     polynomial = [31 28];
             end
-            out = zeros(lengthSequence, length(seed));
-            for jj = 1:length(seed)
-                out(1:order,jj) = de2bi(seed(jj), order)';
-                for ii = (order+1):lengthSequence
-                    out(ii,jj) = xor(out(ii-polynomial(1),jj),out(ii-polynomial(2),jj));
-                end
-            end
+            out = double(prbsWindow(polynomial, seed, offset, lengthSequence, useMex, nThreads));
         end
         
         function out = gen_random_pattern_v1(probability,lines,lengthSequence)
@@ -17,6 +17,11 @@
 %>   'rz50' - Return to Zero with 1/2 duty cycle.
 %>   'rz66' - Return to Zero with 2/3 duty cycle.
 %>
+%>   The native engine (pulseshape_mex) is used if compiled (see
+%>   compileMex): a polyphase interpolator that skips the zeros inserted
+%>   by the upsampling, or an FFT filter for long pulses, on all the
+%>   columns in parallel. The result is the one of ps.
+%>
 %> __Example__
 %> @code
 %>   param.ps.samplesPerSymbol = 8;
@@ -70,6 +75,10 @@ classdef PulseShaper_v1 < unit
         filterSymbolLength = 202;
         %> Rolloff for Raised Cosine or Root Raised Cosine filters
         rollOff;
+        %> Number of threads of the native engine. 0: all processors
+        nThreads = 0;
+        %> Use the native engine if available
+        mexEnabled = true;
     end
     properties (Access = private)
         %> Filter Coefficients
@@ -84,10 +93,12 @@ classdef PulseShaper_v1 < unit
         %> @param param.filterSymbolLength FilterSymbolLength - You should define a symbol length for 'rc' or 'rrc' filters. The default value is 202.
         %> @param param.rollOff            RollOff - The Roll-Off factor. You should define this value if you are using 'rc' or 'rrc' shapings. Usually, this number varies from 0 to 1.
         %> @param param.symbolRate         SymbolRate - You are able to define a symbol rate for your signal here. The output sample frequency will be define as symbolRate*samplesPerSymbol.
+        %> @param param.nThreads           Number of threads (native engine). 0 uses all processors. [Default: 0]
+        %> @param param.mexEnabled         Use the native engine if compiled. [Default: true]
         %>
         %> @retval obj      An instance of the class PulseShaper_v1.
         function obj = PulseShaper_v1(param)
-            obj.setparams(param,{'pulseShape','samplesPerSymbol'},{'symbolRate','filterSymbolLength'})
+            obj.setparams(param,{'pulseShape','samplesPerSymbol'},{'symbolRate','filterSymbolLength','mexEnabled','nThreads'})
 
             if (mod(min(obj.samplesPerSymbol),1) ~= 0) || (obj.samplesPerSymbol == 0) || (length(obj.samplesPerSymbol) ~= 1)
                 robolog('The property "samplesPerSymbol" should be an interger greater than zero.', 'ERR')
@@ -124,7 +135,13 @@ classdef PulseShaper_v1 < unit
         
         function out = traverse(obj, in)
             %> @brief Class traverse function.
-            out = in.fun1(@(x) obj.ps(x, obj.samplesPerSymbol, obj.filterCoeffs));
+            if obj.mexEnabled && hasMex('pulseshape_mex')
+                % Same wrap-around padding (10 samples) and alignment ('same') as ps
+                out = in.funCols(@(X) pulseshape_mex(double(X), obj.filterCoeffs, obj.samplesPerSymbol, ...
+                    floor(numel(obj.filterCoeffs)/2), 10, 0, obj.nThreads));
+            else
+                out = in.fun1(@(x) obj.ps(x, obj.samplesPerSymbol, obj.filterCoeffs));
+            end
             out = set(out, 'Rs', obj.symbolRate, 'Fs', obj.samplesPerSymbol*obj.symbolRate);
         end
     end
@@ -0,0 +1,282 @@
+/*  File:           pulseshape_mex.c
+ *  Description:    Polyphase pulse shaping (upsampling and filtering).
+ *                  Native engine of PulseShaper_v1, compiled as a MATLAB
+ *                  MEX function (see compileMex).
+ *
+ *  Computes, for each column x of X (one symbol per sample),
+ *
+ *    u = upsample(x,sps);  u = [u; u(1:nwrap)];
+ *    y = conv(u,h);  Y = y(delay + (1:sps*M));
+ *
+ *  without the multiplications by the zeros inserted by the upsampling:
+ *  output sample i only depends on the taps h(r + k*sps), r = mod(i +
+ *  delay,sps), i.e. on one of the sps phases of the filter (polyphase
+ *  interpolator).  For each phase and each block of BLOCK symbols the
+ *  taps are applied one at a time to the whole block, a loop over
+ *  contiguous samples that the compiler vectorizes (SIMD).  When the
+ *  phases are longer than FFTTAPS taps, the filter is applied by FFT
+ *  (overlap-save at the output rate) instead.  The blocks of all the
+ *  columns are distributed over the threads.
+ */
+
+/*
+ * USAGE:
+ * Y = pulseshape_mex(X,h,sps,delay,nwrap);
+ * Y = pulseshape_mex(X,h,sps,delay,nwrap,method);
+ * Y = pulseshape_mex(X,h,sps,delay,nwrap,method,nthreads);
+ * pulseshape_mex -option
+ *
+ * INPUT
+ * X         Symbols, M-by-N (one signal per column, real or complex)
+ * h         Filter taps (real), K elements
+ * sps       Samples per symbol (upsampling factor)
+ * delay     Index of the first output sample in the full convolution
+ *             (0-based), e.g. floor(K/2) for conv(...,'same')
+ * nwrap     Number of upsampled samples of the beginning of the signal
+ *             appended at its end
+ * method    0: polyphase if the phases have at most FFTTAPS taps, FFT
+ *             otherwise; 1: polyphase; 2: FFT (default 0)
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * Y         Shaped signal, (sps*M)-by-N, complex (zero imaginary part
+ *             if X is real)
+ *
+ * OPTIONS (i.e. pulseshape_mex -estimate): see plancache.h
+ */
+
+#include "robomex.h"
+#include "plancache.h"
+
+#define BLOCK 4096           /* symbols per block (polyphase) */
+#define FFTTAPS 64           /* longest phase of the polyphase path */
+
+void extend_symbols(const mxArray*,int,int,int,int,int,REAL*,REAL*);
+void polyphase_block(const REAL*,const REAL*,const double*,int,int,int,
+                     int,int,int,int,REAL*,double*,double*);
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+/* floor(a/b) for b > 0 */
+static int floor_div(int a,int b)
+{
+  return a >= 0 ? a/b : -((-a + b - 1)/b);
+}
+
+
+/* Symbols q = qlo ... qlo+nq-1 of column col of the upsampled and
+ * wrapped signal: x(q) for 0 <= q < M, x(q-M) for the nwrap samples
+ * appended at the end, 0 elsewhere */
+void extend_symbols(const mxArray* X,int col,int sps,int nwrap,int qlo,
+                    int nq,REAL* sr,REAL* si)
+{
+  int M = (int) mxGetM(X), q, p;
+  double *xr = mxGetPr(X) + (size_t) col*M, *xi = mxGetPi(X);
+
+  if (xi)
+    xi += (size_t) col*M;
+  for (q = qlo; q < qlo + nq; q++) {
+    if (q >= 0 && q < M)
+      p = q;
+    else if (q >= M && q - M < M && (q - M)*sps < nwrap)
+      p = q - M;
+    else
+      p = -1;
+    sr[q - qlo] = p < 0 ? 0 : (REAL) xr[p];
+    si[q - qlo] = p < 0 || !xi ? 0 : (REAL) xi[p];
+  }
+}
+
+
+/* Output samples of the symbols qa ... qa+n-1 (i = q*sps + r - delay),
+ * all the phases r */
+void polyphase_block(const REAL* sr,const REAL* si,const double* h,int K,
+                     int sps,int delay,int qlo,int qa,int n,int L,
+                     REAL* acc,double* yr,double* yi)
+{
+  REAL *ar = acc,*ai = acc + BLOCK,c;
+  const REAL *pr,*pi_;
+  int r,j,t,i;
+
+  for (r = 0; r < sps; r++) {
+    for (t = 0; t < n; t++)
+      ar[t] = ai[t] = 0;
+    for (j = 0; r + j*sps < K; j++) {
+      c = (REAL) h[r + j*sps];
+      pr = sr + (qa - j - qlo);
+      pi_ = si + (qa - j - qlo);
+      for (t = 0; t < n; t++) {
+        ar[t] += c*pr[t];
+        ai[t] += c*pi_[t];
+      }
+    }
+    for (t = 0; t < n; t++) {
+      i = (qa + t)*sps + r - delay;
+      if (i >= 0 && i < L) {
+        yr[i] = (double) ar[t];
+        yi[i] = (double) ai[t];
+      }
+    }
+  }
+}
+
+
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  int M;             /* number of symbols */
+  int N;             /* number of columns */
+  int K;             /* number of taps */
+  int L;             /* output samples */
+  int sps,delay,nwrap,method,nthreads;
+  int cplx;          /* complex symbols */
+  int qlo,nq,ntasks,nblocks,task;
+  int nfft = 0,S = 0;
+  double *h;
+  REAL *sym,*buf;
+  COMPLEX *hf = NULL,*fbuf = NULL;
+  PLAN pf = NULL,pb = NULL;
+
+  if (plancache_option(nrhs,prhs))
+    return;
+
+  if (nrhs < 5)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 1)
+    mexErrMsgTxt("Too many output arguments.");
+  if (!mxIsDouble(prhs[0]) || mxIsSparse(prhs[0]))
+    mexErrMsgTxt("The symbols must be a full double array.");
+  if (!mxIsDouble(prhs[1]) || mxIsComplex(prhs[1]))
+    mexErrMsgTxt("The taps must be a real double array.");
+
+  plancache_begin();
+
+  /* parse input arguments */
+  M = (int) mxGetM(prhs[0]);
+  N = (int) mxGetN(prhs[0]);
+  h = mxGetPr(prhs[1]);
+  K = (int) mxGetNumberOfElements(prhs[1]);
+  sps = (int) mxGetScalar(prhs[2]);
+  delay = (int) mxGetScalar(prhs[3]);
+  nwrap = (int) mxGetScalar(prhs[4]);
+  method = (int) robomex_optional(nrhs,prhs,5,0);
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,6,0));
+  cplx = mxIsComplex(prhs[0]);
+  if (sps < 1 || K < 1 || delay < 0 || nwrap < 0)
+    mexErrMsgTxt("Invalid samples per symbol, taps, delay or wrap length.");
+  if (method == 0)
+    method = (K + sps - 1)/sps > FFTTAPS ? 2 : 1;
+  L = sps*M;
+
+  plhs[0] = mxCreateDoubleMatrix(L,N,mxCOMPLEX);
+  if (L == 0 || N == 0)
+    return;
+
+  /* symbols needed by the outputs, with the ones before the first and
+   * after the last block of the polyphase path */
+  qlo = floor_div(delay - K + 1 - sps,sps);
+  nq = floor_div(delay + L - 1,sps) + BLOCK + 1 - qlo;
+  sym = (REAL*) robomex_malloc(sizeof(REAL)*2*(size_t) nq*N);
+  for (task = 0; task < N; task++)
+    extend_symbols(prhs[0],task,sps,nwrap,qlo,nq,sym + 2*(size_t) task*nq,
+                   sym + (2*(size_t) task + 1)*nq);
+
+  if (method == 1) {
+    int qfirst = floor_div(delay,sps), qlast = floor_div(delay + L - 1,sps);
+    nblocks = (qlast - qfirst)/BLOCK + 1;
+    ntasks = nblocks*N;
+    if (nthreads > ntasks)
+      nthreads = ntasks;
+    buf = (REAL*) robomex_malloc(sizeof(REAL)*2*BLOCK*nthreads);
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+    for (task = 0; task < ntasks; task++) {
+      int col = task/nblocks, b = task % nblocks;
+      int qa = qfirst + b*BLOCK;
+      int n = qlast + 1 - qa < BLOCK ? qlast + 1 - qa : BLOCK;
+      REAL* acc;
+#ifdef _OPENMP
+      acc = buf + (size_t) omp_get_thread_num()*2*BLOCK;
+#else
+      acc = buf;
+#endif
+      polyphase_block(sym + 2*(size_t) col*nq,sym + (2*(size_t) col + 1)*nq,h,K,
+                      sps,delay,qlo,qa,n,L,acc,
+                      mxGetPr(plhs[0]) + (size_t) col*L,mxGetPi(plhs[0]) + (size_t) col*L);
+    }
+    FFTW_FREE(buf);
+  } else {
+    int ii;
+
+    /* overlap-save at the output rate: blocks of nfft samples giving
+     * S = nfft - K + 1 outputs each */
+    for (nfft = 256; nfft < 4*K; nfft *= 2)
+      ;
+    S = nfft - K + 1;
+    nblocks = (L + S - 1)/S;
+    ntasks = nblocks*N;
+    if (nthreads > ntasks)
+      nthreads = ntasks;
+
+    /* fftw3 plans (from the session cache) */
+    pf = plancache_get(PLANCACHE_FORWARD, nfft, 1, 1);
+    pb = plancache_get(PLANCACHE_BACKWARD, nfft, 1, 1);
+
+    hf = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*nfft);
+    for (ii = 0; ii < nfft; ii++) {
+      hf[ii][0] = ii < K ? (REAL) (h[ii]/nfft) : 0;
+      hf[ii][1] = 0;
+    }
+    EXECUTE_DFT(pf,hf,hf);
+    fbuf = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*nfft*nthreads);
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+#endif
+    for (task = 0; task < ntasks; task++) {
+      int col = task/nblocks, b = task % nblocks;
+      int n0 = delay + b*S, t, m, nout;
+      const REAL *sr = sym + 2*(size_t) col*nq,*si = sym + (2*(size_t) col + 1)*nq;
+      double *yr = mxGetPr(plhs[0]) + (size_t) col*L,*yi = mxGetPi(plhs[0]) + (size_t) col*L;
+      COMPLEX* u;
+      REAL re;
+#ifdef _OPENMP
+      u = fbuf + (size_t) omp_get_thread_num()*nfft;
+#else
+      u = fbuf;
+#endif
+      /* upsampled input n0-K+1 ... n0+S-1 */
+      memset(u,0,sizeof(COMPLEX)*nfft);
+      m = n0 - K + 1;
+      t = ((m % sps) + sps) % sps;
+      if (t)
+        t = sps - t;
+      for (; t < nfft; t += sps) {
+        int q = floor_div(m + t,sps) - qlo;
+        if (q >= 0 && q < nq) {
+          u[t][0] = sr[q];
+          u[t][1] = si[q];
+        }
+      }
+      EXECUTE_DFT(pf,u,u);
+      for (t = 0; t < nfft; t++) {
+        re = u[t][0]*hf[t][0] - u[t][1]*hf[t][1];
+        u[t][1] = u[t][0]*hf[t][1] + u[t][1]*hf[t][0];
+        u[t][0] = re;
+      }
+      EXECUTE_DFT(pb,u,u);
+      nout = (b + 1)*S <= L ? S : L - b*S;
+      /* the imaginary part of real symbols is round-off only */
+      for (t = 0; t < nout; t++) {
+        yr[b*S + t] = (double) u[K - 1 + t][0];
+        yi[b*S + t] = cplx ? (double) u[K - 1 + t][1] : 0;
+      }
+    }
+    FFTW_FREE(hf);
+    FFTW_FREE(fbuf);
+  }
+
+  FFTW_FREE(sym);
+}
@@ -0,0 +1,280 @@
+/*  File:           wdmcombine_mex.c
+ *  Description:    Combination of WDM channels into one field.  Native
+ *                  engine of ChannelCombiner_v1, compiled as a MATLAB MEX
+ *                  function (see compileMex).
+ *
+ *  Each channel (N columns) is shifted by its frequency offset, upsampled
+ *  by the integer factor up, and the channels are summed:
+ *
+ *    E(n) = sum_c X_c(n)*exp(j*2*pi*nu_c*n),  n = 0 ... up*L-1
+ *
+ *  where X_c is upsampled by zero padding its spectrum.  If every offset
+ *  is a whole number of bins of the output (nu_c*up*L integer), the
+ *  spectrum of each channel is placed directly at its offset in the
+ *  spectrum of the output: one FFT per channel (in parallel, one channel
+ *  per thread) and one inverse FFT, the upsampling and the shift being a
+ *  single placement.  Otherwise the channels are upsampled in the same
+ *  way (if up > 1) and rotated in time by a phasor updated recursively,
+ *  re-anchored every REANCHOR samples to bound the rounding drift; the
+ *  output is then computed by blocks of samples in parallel, all the
+ *  channels of a block in the same thread, so the result does not depend
+ *  on the number of threads.
+ */
+
+/*
+ * USAGE:
+ * E = wdmcombine_mex(X,nu,N);
+ * E = wdmcombine_mex(X,nu,N,up);
+ * E = wdmcombine_mex(X,nu,N,up,nthreads);
+ * wdmcombine_mex -option
+ *
+ * INPUT
+ * X         Channels, L-by-(N*C), the N columns of channel 1, then of
+ *             channel 2, ...
+ * nu        Frequency offset of each channel in cycles per output
+ *             sample (df/Fs of the output), 1-by-C
+ * N         Number of columns per channel
+ * up        Upsampling factor, integer (default 1)
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * E         Combined field, (up*L)-by-N
+ *
+ * OPTIONS (i.e. wdmcombine_mex -estimate): see plancache.h
+ */
+
+#include "robomex.h"
+#include "plancache.h"
+
+#define REANCHOR 1024        /* samples between exact phasors */
+#define MINCHUNK 16384       /* minimum samples per thread */
+#define BINTOL 1e-6          /* tolerance on a whole number of bins */
+
+void place_spectrum(COMPLEX*,COMPLEX*,int,int,int);
+void rotate_add(COMPLEX*,COMPLEX*,double,REAL,int,int,int,int);
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+/* Signed frequency index of bin jj of an n-point DFT */
+static int signed_bin(int jj,int n)
+{
+  return jj <= (n-1)/2 ? jj : jj - n;
+}
+
+
+/* Zero-pad the spectrum of ncols columns of length l to length lout
+ * (lout >= l), each bin keeping its signed frequency */
+void place_spectrum(COMPLEX* dst,COMPLEX* src,int l,int lout,int ncols)
+{
+  int jj,kk,t;
+
+  for (kk = 0; kk < ncols; kk++) {
+    memset(dst + kk*lout, 0, sizeof(COMPLEX)*lout);
+    for (jj = 0; jj < l; jj++) {
+      t = signed_bin(jj,l);
+      t = t < 0 ? t + lout : t;
+      dst[kk*lout + t][0] = src[kk*l + jj][0];
+      dst[kk*lout + t][1] = src[kk*l + jj][1];
+    }
+  }
+}
+
+
+/* out += scale*x.*exp(j*2*pi*nu*n) for samples a..b-1 of the ncols
+ * columns of length lout of x and out.  The phasor is exact at the
+ * multiples of REANCHOR, and the columns are processed one at a time
+ * in each segment between them (the columns are lout apart, often a
+ * power of two, which would thrash the cache). */
+void rotate_add(COMPLEX* out,COMPLEX* x,double nu,REAL scale,
+                int ncols,int lout,int a,int b)
+{
+  int n,n0,n1,kk;
+  REAL pr,pi_,ar,ai,rr,ri,re;
+  COMPLEX *xs,*os;
+
+  rr = (REAL) cos(2*ROBOMEX_PI*nu);
+  ri = (REAL) sin(2*ROBOMEX_PI*nu);
+  for (n0 = a; n0 < b; n0 = n1) {
+    double arg = 2*ROBOMEX_PI*fmod(nu*(double) n0,1.0);
+    n1 = (n0/REANCHOR + 1)*REANCHOR;
+    if (n1 > b)
+      n1 = b;
+    ar = (REAL) (scale*cos(arg));
+    ai = (REAL) (scale*sin(arg));
+    for (kk = 0; kk < ncols; kk++) {
+      xs = x + kk*lout;
+      os = out + kk*lout;
+      pr = ar;
+      pi_ = ai;
+      for (n = n0; n < n1; n++) {
+        os[n][0] += pr*xs[n][0] - pi_*xs[n][1];
+        os[n][1] += pr*xs[n][1] + pi_*xs[n][0];
+        re = pr*rr - pi_*ri;
+        pi_ = pr*ri + pi_*rr;
+        pr = re;
+      }
+    }
+  }
+}
+
+
+/* This is the gateway function between MATLAB and WDMCOMBINE_MEX.  It
+ * serves as the main(). */
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  int l,lout,ncols,nchan,up,nthreads,integer_bins;
+  double *nu;
+  int *kbin;
+  COMPLEX **chan,**spec = NULL,*out;
+  PLAN pf,pb = NULL;
+  int c,kk,nchunks;
+  REAL scale;
+
+  if (plancache_option(nrhs,prhs))
+    return;
+
+  if (nrhs < 3)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 1)
+    mexErrMsgTxt("Too many output arguments.");
+
+  plancache_begin();
+
+  /* parse input arguments */
+  if (!(mxIsDouble(prhs[0]) || mxIsSingle(prhs[0])) || !mxIsDouble(prhs[1]))
+    mexErrMsgTxt("The channels and the offsets must be floating point arrays.");
+  l = (int) mxGetM(prhs[0]);
+  ncols = (int) mxGetScalar(prhs[2]);
+  nchan = (int) mxGetNumberOfElements(prhs[1]);
+  if (ncols < 1 || nchan < 1 || (int) mxGetN(prhs[0]) != ncols*nchan)
+    mexErrMsgTxt("X must have N columns per channel.");
+  up = (int) robomex_optional(nrhs,prhs,3,1);
+  if (up < 1)
+    mexErrMsgTxt("The upsampling factor must be a positive integer.");
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,4,0));
+  lout = up*l;
+  nu = mxGetPr(prhs[1]);
+
+  /* Shifts in bins of the output, if all are whole */
+  kbin = (int*) mxMalloc(sizeof(int)*nchan);
+  integer_bins = 1;
+  for (c = 0; c < nchan; c++) {
+    double k = nu[c]*lout;
+    kbin[c] = (int) floor(k + 0.5);
+    if (fabs(k - kbin[c]) > BINTOL)
+      integer_bins = 0;
+    kbin[c] = ((kbin[c] % lout) + lout) % lout;
+  }
+
+  /* allocate memory */
+  chan = (COMPLEX**) mxMalloc(sizeof(COMPLEX*)*nchan);
+  for (c = 0; c < nchan; c++)
+    chan[c] = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*(integer_bins ? l : lout)*ncols);
+  if (!integer_bins && up > 1) {
+    spec = (COMPLEX**) mxMalloc(sizeof(COMPLEX*)*nchan);
+    for (c = 0; c < nchan; c++)
+      spec[c] = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*l*ncols);
+  }
+  out = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*lout*ncols);
+
+  /* fftw3 plans (from the session cache) */
+  pf = plancache_get(PLANCACHE_FORWARD, l, ncols, 1);
+  if (integer_bins || up > 1)
+    pb = plancache_get(PLANCACHE_BACKWARD, lout, ncols, 1);
+
+  if (integer_bins) {
+    /* Spectrum of each channel */
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+    for (c = 0; c < nchan; c++) {
+      int jj;
+      for (jj = 0; jj < ncols; jj++)
+        robomex_get_column(chan[c] + jj*l, prhs[0], c*ncols + jj);
+      EXECUTE_DFT(pf,chan[c],chan[c]);
+    }
+
+    /* Output spectrum: each bin sums the channels covering it */
+    nchunks = (lout + MINCHUNK - 1)/MINCHUNK;
+    if (nchunks > nthreads)
+      nchunks = nthreads;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nchunks) schedule(static)
+#endif
+    for (kk = 0; kk < nchunks; kk++) {
+      int a = (int) ((double) lout*kk/nchunks);
+      int b = (int) ((double) lout*(kk + 1)/nchunks);
+      int t,s,jj,cc,col;
+      for (col = 0; col < ncols; col++)
+        memset(out + col*lout + a, 0, sizeof(COMPLEX)*(b - a));
+      for (cc = 0; cc < nchan; cc++)
+        for (t = a; t < b; t++) {
+          s = signed_bin((t - kbin[cc] + lout) % lout,lout);
+          if (s < -(l/2) || s > (l-1)/2)
+            continue;
+          jj = s < 0 ? s + l : s;
+          for (col = 0; col < ncols; col++) {
+            out[col*lout + t][0] += chan[cc][col*l + jj][0];
+            out[col*lout + t][1] += chan[cc][col*l + jj][1];
+          }
+        }
+    }
+    EXECUTE_DFT(pb,out,out);
+    scale = (REAL) (1.0/l);
+  } else {
+    /* Upsampled channels */
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(dynamic)
+#endif
+    for (c = 0; c < nchan; c++) {
+      int jj;
+      if (up > 1) {
+        for (jj = 0; jj < ncols; jj++)
+          robomex_get_column(spec[c] + jj*l, prhs[0], c*ncols + jj);
+        EXECUTE_DFT(pf,spec[c],spec[c]);
+        place_spectrum(chan[c],spec[c],l,lout,ncols);
+        EXECUTE_DFT(pb,chan[c],chan[c]);
+      } else
+        for (jj = 0; jj < ncols; jj++)
+          robomex_get_column(chan[c] + jj*l, prhs[0], c*ncols + jj);
+    }
+
+    /* Rotation and sum, by blocks of samples */
+    scale = (REAL) (up > 1 ? 1.0/l : 1.0);
+    nchunks = (lout + MINCHUNK - 1)/MINCHUNK;
+    if (nchunks > nthreads)
+      nchunks = nthreads;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nchunks) schedule(static)
+#endif
+    for (kk = 0; kk < nchunks; kk++) {
+      /* blocks aligned on the exact phasors: same result for any nthreads */
+      int a = (int) ((double) lout*kk/nchunks)/REANCHOR*REANCHOR;
+      int b = kk == nchunks - 1 ? lout : (int) ((double) lout*(kk + 1)/nchunks)/REANCHOR*REANCHOR;
+      int cc,col;
+      for (col = 0; col < ncols; col++)
+        memset(out + col*lout + a, 0, sizeof(COMPLEX)*(b - a));
+      for (cc = 0; cc < nchan; cc++)
+        rotate_add(out,chan[cc],nu[cc],scale,ncols,lout,a,b);
+    }
+    scale = 1;
+  }
+
+  /* allocate space for returned matrix */
+  plhs[0] = mxCreateDoubleMatrix(lout,ncols,mxCOMPLEX);
+  for (kk = 0; kk < ncols; kk++)
+    robomex_set_column(plhs[0], kk, out + kk*lout, scale);
+
+  /* de-allocate memory */
+  for (c = 0; c < nchan; c++) {
+    FFTW_FREE(chan[c]);
+    if (spec)
+      FFTW_FREE(spec[c]);
+  }
+  mxFree(chan);
+  if (spec)
+    mxFree(spec);
+  mxFree(kbin);
+  FFTW_FREE(out);
+}
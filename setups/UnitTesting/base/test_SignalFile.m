@@ -0,0 +1,38 @@
+%test signal files
+clearall
+
+L = 1e5;
+x = (randn(L, 2)+1i*randn(L, 2))/sqrt(2);
+x(:,2) = 0.5*x(:,2);
+sigparams = struct('Fs', 80e9, 'Rs', 28e9, 'Fc', const.c/1550e-9, 'PCol', [pwr(20, 0); pwr(20, -3)]);
+sig = signal_interface(x, sigparams);
+
+%save, map, compare
+filename = [tempname '.rsig'];
+sigfile.save(filename, sig, 'double', 3e4);
+sigm = signal_interface(sigfile(filename));
+assert(isMapped(sigm) && sigm.L == L && sigm.N == 2)
+assert(sigm.Fs == sig.Fs && sigm.Rs == sig.Rs && sigm.Fc == sig.Fc)
+assert(max(abs(sigm.get(:)-sig.get(:))) < 1e-12)
+assert(abs(sigm.PCol(2).Ptot('dBm')+3) < 1e-9)
+
+%lazy indexing gives the same samples as in memory
+rows = 1234:5678;
+assert(max(max(abs(sigm(rows, :)-sig(rows, :)))) < 1e-12)
+assert(max(abs(sigm(rows, 2)-sig(rows, 2))) < 1e-12)
+
+%chunked append and read
+f = sigfile.create([tempname '.rsig'], struct('Fs', 1), 2, true, 'single');
+for k=1:4
+    append(f, x((k-1)*L/4+1:k*L/4, :));
+end
+y = zeros(0, 2);
+for k=1:nChunks(f, 7e3)
+    y = [y; chunk(f, k, 7e3)]; %#ok<AGROW>
+end
+assert(isequal(size(y), [L 2]) && max(abs(y(:)-x(:))) < 1e-6)
+assert(max(abs(f.Praw-pwr.meanpwr(x))) < 1e-6)
+
+filename2 = f.filename;
+clear sigm f
+delete(filename, filename2)
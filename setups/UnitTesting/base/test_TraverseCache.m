@@ -0,0 +1,71 @@
+%test the traverse cache: miss, hit, miss after a parameter change, eviction
+clearvars -except testFiles nn
+close all
+
+%% Cache in an empty folder (the preferences are restored at the end)
+folder = tempname;
+hadFolder = ispref('robochameleon', 'traverseCache');
+if hadFolder, oldFolder = getpref('robochameleon', 'traverseCache'); end
+hadSize = ispref('robochameleon', 'traverseCacheSize');
+if hadSize, oldSize = getpref('robochameleon', 'traverseCacheSize'); end
+setpref('robochameleon', 'traverseCache', folder);
+setpref('robochameleon', 'traverseCacheSize', 1e9);
+
+sigIn = createDummySignal_v1();
+polmux = PolMux_v1(struct('delay', 100, 'mode', 'samples', 'draw', false));
+polmux.cacheTraverse = true;
+delay = polmux.internalUnits{cellfun(@(u) isa(u, 'Delay_v1'), polmux.internalUnits)};
+
+%% Miss: the module is traversed and its outputs stored
+polmux.writeInputBuffer(sigIn, 1);
+key1 = traverseCache.key(polmux);
+[hit, ~] = traverseCache.fetch(polmux, key1);
+assert(~hit, 'traverseCache: hit in an empty cache');
+out1 = polmux.processInputs();
+assert(exist(fullfile(folder, [key1 '.mat']), 'file') == 2, 'traverseCache: outputs not stored');
+
+%% Hit: same outputs, public state of the internal units restored
+results = cellfun(@(u) u.results, polmux.internalUnits, 'UniformOutput', false);
+for i=1:numel(polmux.internalUnits)
+    polmux.internalUnits{i}.results = 'stale';
+end
+polmux.writeInputBuffer(sigIn, 1);
+assert(strcmp(traverseCache.key(polmux), key1), 'traverseCache: key depends on the results');
+out2 = polmux.processInputs();
+assert(isequal(out2{1}.get, out1{1}.get), 'traverseCache: outputs of a hit differ');
+assert(isequal(cellfun(@(u) u.results, polmux.internalUnits, 'UniformOutput', false), results), ...
+    'traverseCache: state of the internal units not restored on a hit');
+
+%% Miss after a parameter change of an internal unit
+delay.delay = 200;
+polmux.writeInputBuffer(sigIn, 1);
+key2 = traverseCache.key(polmux);
+assert(~strcmp(key2, key1), 'traverseCache: key does not depend on the internal units');
+[hit, ~] = traverseCache.fetch(polmux, key2);
+assert(~hit, 'traverseCache: hit after a parameter change');
+out3 = polmux.processInputs();
+assert(~isequal(out3{1}.get, out1{1}.get), 'traverseCache: stale outputs after a parameter change');
+
+%% Eviction: the least recently used entry goes first
+entry1 = dir(fullfile(folder, [key1 '.mat']));
+java.io.File(fullfile(folder, [key1 '.mat'])).setLastModified(java.lang.System.currentTimeMillis()-60e3);
+setpref('robochameleon', 'traverseCacheSize', 1.5*entry1.bytes);
+traverseCache.evict();
+assert(exist(fullfile(folder, [key1 '.mat']), 'file') ~= 2, 'traverseCache: least recently used entry not evicted');
+assert(exist(fullfile(folder, [key2 '.mat']), 'file') == 2, 'traverseCache: most recent entry evicted');
+setpref('robochameleon', 'traverseCacheSize', 0);
+traverseCache.evict();
+assert(isempty(dir(fullfile(folder, '*.mat'))), 'traverseCache: entries above the size limit');
+
+%% Clean up
+rmdir(folder, 's');
+if hadFolder
+    setpref('robochameleon', 'traverseCache', oldFolder);
+else
+    rmpref('robochameleon', 'traverseCache');
+end
+if hadSize
+    setpref('robochameleon', 'traverseCacheSize', oldSize);
+else
+    rmpref('robochameleon', 'traverseCacheSize');
+end
@@ -0,0 +1,48 @@
+clearvars -except testFiles nn
+close all
+
+if isempty(ver('distcomp'))
+    robolog('Parallel Computing Toolbox not available, parallel traverse not tested', 'WRN');
+    return
+end
+
+%% Branched module without random numbers: parallel = sequential
+sigIn = createDummySignal_v1();
+polmux = PolMux_v1(struct('delay', 100, 'mode', 'samples', 'draw', false));
+
+polmux.maxInFlight = 0;
+outSequential = polmux.traverse(sigIn);
+polmux.maxInFlight = 2;
+outParallel = polmux.traverse(sigIn);
+assert(isequal(outParallel.get, outSequential.get), 'module: parallel and sequential traverses differ');
+assert(isequal(outParallel.PCol, outSequential.PCol), 'module: parallel and sequential powers differ');
+
+
+%% Branched module with random numbers: a parallel run is reproduced by rng
+carrier_freqs           = [-1 1 0]*100e9 + 193.4e12;
+param.nChannels         = length(carrier_freqs);
+param.lambda            = 1e9*const.c./carrier_freqs;
+param.modulationFormat  = 'QAM';
+param.M                 = 4;
+param.pulseShape        = 'rrc';
+param.rollOff           = 0.2;
+param.N                 = 2;
+param.samplesPerSymbol  = 16;
+param.Power             = repmat({pwr(inf, 0)}, 1, param.nChannels);
+param.linewidth         = 100e3;
+param.Fs                = 80e9;
+param.Lnoise            = 2^10;
+
+% the channels are modules: their units are run in parallel through the preference
+hadPref = ispref('robochameleon', 'maxInFlight');
+if hadPref, oldPref = getpref('robochameleon', 'maxInFlight'); end
+setpref('robochameleon', 'maxInFlight', 2);
+wdmt = SimpleWDMTransmitter_v1(param);
+rng(1); out1 = wdmt.traverse();
+rng(1); out2 = wdmt.traverse();
+if hadPref
+    setpref('robochameleon', 'maxInFlight', oldPref);
+else
+    rmpref('robochameleon', 'maxInFlight');
+end
+assert(isequal(out1.get, out2.get), 'module: parallel traverse not reproduced by rng');
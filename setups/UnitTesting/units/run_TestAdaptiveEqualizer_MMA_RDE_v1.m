@@ -0,0 +1,60 @@
+clearvars -except testFiles nn
+close all
+
+%% Parameters
+param.eq.iter           = 2;
+param.eq.taps           = 15;
+param.eq.mu             = 1e-3;
+param.eq.type           = 'mma';
+param.eq.h_ortho        = true;
+param.eq.cma_preconv    = 2000;
+param.eq.equalizer_conv = 8000;
+param.eq.constellation  = constref('QAM',16);
+param.eq.draw           = false;
+param.eq.operation      = 'equalization';
+
+%% Create objects
+eq = AdaptiveEqualizer_MMA_RDE_v1(param.eq);
+param.eq.mexEnabled = false;
+eqMatlab = AdaptiveEqualizer_MMA_RDE_v1(param.eq);
+param.eq.blockSize = 1;
+eqBlock1 = AdaptiveEqualizer_MMA_RDE_v1(param.eq);
+param.eq.blockSize = 8;
+eqBlock = AdaptiveEqualizer_MMA_RDE_v1(param.eq);
+
+%% Create Dummy input
+param.sig.Fs = 64e9;
+param.sig.Fc = 193.1e12;
+param.sig.Rs = 32e9;
+param.sig.PCol = [pwr(20,{0,'dBm'}), pwr(20,{0,'dBm'})];
+C = param.eq.constellation;
+Ein = upsample(C(randi(numel(C), 2^14, 2)), 2);
+Ein = filter([0.2 1 0.2], 1, Ein);
+theta = pi/5;
+Ein = Ein*[cos(theta) sin(theta); -sin(theta) cos(theta)];
+sigIn = signal_interface(Ein, param.sig);
+
+%% Traverse
+[sigOut, sigOutNss] = eq.traverse(sigIn);
+[sigOutMatlab, sigOutNssMatlab] = eqMatlab.traverse(sigIn);
+sigOutBlock1 = eqBlock1.traverse(sigIn);
+sigOutBlock = eqBlock.traverse(sigIn);
+
+%% Compare
+errOut = norm(sigOut.get-sigOutMatlab.get)/norm(sigOutMatlab.get);
+errTaps = norm([eq.hxx eq.hxy eq.hyx eq.hyy]-[eqMatlab.hxx eqMatlab.hxy eqMatlab.hyx eqMatlab.hyy]);
+robolog('Native vs MATLAB equalizer output difference: %g', 'NFO0', errOut);
+robolog('Native vs MATLAB taps difference: %g', 'NFO0', errTaps);
+assert(errOut < 1e-9, 'AdaptiveEqualizer_MMA_RDE_v1: native and MATLAB outputs differ');
+assert(errTaps < 1e-9, 'AdaptiveEqualizer_MMA_RDE_v1: native and MATLAB taps differ');
+
+%one symbol per block is the symbol-by-symbol algorithm
+errBlock1 = norm(sigOutBlock1.get-sigOutMatlab.get)/norm(sigOutMatlab.get);
+robolog('Symbol-by-symbol vs block LMS (1 symbol) difference: %g', 'NFO0', errBlock1);
+assert(errBlock1 < 1e-9, 'AdaptiveEqualizer_MMA_RDE_v1: block LMS with blockSize = 1 differs');
+mse = mean(mean(eqMatlab.results.errsq(1:end-1,:).^2));
+mseBlock = mean(mean(eqBlock.results.errsq(1:end-1,:).^2));
+robolog('Symbol-by-symbol vs block LMS MSE: %g / %g', 'NFO0', mse, mseBlock);
+assert(mseBlock < 1.5*mse, 'AdaptiveEqualizer_MMA_RDE_v1: block LMS does not converge');
+
+figure(1), plot(sigOut.get(:,1), '.')
@@ -0,0 +1,48 @@
+clearvars -except testFiles nn
+close all
+
+
+%Constructors
+param.det = struct('R', [1 0.9], 'CMRR', [inf 30], 'f3dB', 32e9, 'modeAdditionEnabled', false);
+Hybrid = OpticalHybrid_v1(1);
+BPD = BalancedPair_v1(param.det);
+Detector = CoherentDetector_v1(setfield(rmfield(param.det, 'modeAdditionEnabled'), 'seed', 1));
+DetectorMatlab = CoherentDetector_v1(setfield(rmfield(param.det, 'modeAdditionEnabled'), 'seed', 1));
+DetectorMatlab.mexEnabled = false;
+
+
+%generate field
+param.laser = struct('Power', pwr(150, {15, 'dBm'}), 'linewidth', 100e3, ...
+    'Fs',28e9*16, 'Fc', const.c/1550e-9, ...
+    'Lnoise', 2^15, 'cacheEnabled', 0);
+
+laser1 = Laser_v1(param.laser);
+l1output = laser1.traverse();
+l1mm = set(l1output, [get(l1output) get(l1output)]);
+l2mm = set(l1mm, 'Fc', laser1.Fc + 1e9);
+
+
+%% Unit chain: hybrid, balanced pairs, complex interleaving
+[s1, s2, s3, s4] = Hybrid.traverse(l1mm, l2mm);
+chain = BPD.traverse(s1, s2) + BPD.traverse(s3, s4)*1i;
+
+%% Fused detector
+fused = Detector.traverse(l1mm, l2mm);
+fusedMatlab = DetectorMatlab.traverse(l1mm, l2mm);
+
+errNative = norm(fused.get-fusedMatlab.get)/norm(fusedMatlab.get);
+robolog('Native vs MATLAB difference: %g', 'NFO0', errNative);
+assert(errNative < 1e-9, 'CoherentDetector_v1: native and MATLAB detection differ');
+
+Pfused = [fused.PCol.P_dBW]+30;
+Pchain = [chain.PCol.P_dBW]+30;
+robolog('Fused vs unit chain output power [dBm]: %s vs %s', 'NFO0', mat2str(Pfused, 4), mat2str(Pchain, 4));
+assert(all(abs(Pfused-Pchain) < 0.1), 'CoherentDetector_v1: output power differs from the unit chain');
+SNRfused = [fused.PCol.SNR_dB];
+SNRchain = [chain.PCol.SNR_dB];
+robolog('Fused vs unit chain SNR [dB]: %s vs %s', 'NFO0', mat2str(SNRfused, 4), mat2str(SNRchain, 4));
+assert(all(abs(SNRfused-SNRchain) < 0.5), 'CoherentDetector_v1: SNR differs from the unit chain');
+
+preim(chain)
+hold on
+preim(fused)
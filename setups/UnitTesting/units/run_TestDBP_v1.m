@@ -0,0 +1,47 @@
+clearvars -except testFiles nn
+close all
+
+%% Parameters
+param.link.nSpans       = 3;
+param.link.L            = 80;
+param.link.alphaa       = 0.2;
+param.link.alphab       = 0.2;
+param.link.D            = 17;
+param.link.S            = 0;
+param.link.gamma        = 1.2;
+param.link.stepSize     = 1;
+param.link.EDFAGain     = 16;
+param.link.EDFANF       = 5;
+
+param.dbp               = param.link;
+param.dbp.stepsPerSpan  = 10;
+
+%% Create objects
+link = NonlinearChannel_v1(param.link);
+dbp = DBP_v1(param.dbp);
+
+%% Create Dummy input
+param.sig.Fs = 64e9;
+param.sig.Fc = 193.1e12;
+param.sig.Rs = 32e9;
+param.sig.PCol = [pwr(inf,{7,'dBm'}), pwr(inf,{7,'dBm'})];
+Ein = upsample(sign(randn(2^13,2)) + 1j*sign(randn(2^13,2)), 2);
+Ein = filter(ones(2,1), 1, Ein);
+sigIn = signal_interface(Ein, param.sig);
+
+%% Traverse
+sigLink = link.traverse(sigIn);
+sigOut = dbp.traverse(sigLink);
+
+dbp.mexEnabled = false;
+sigOutMatlab = dbp.traverse(sigLink);
+
+%% Compare
+E0 = sigIn.get;
+err = @(E) norm(E(:)-E0(:))/norm(E0(:));
+robolog('Relative error after DBP: %g', 'NFO0', err(sigOut.get));
+errNative = norm(sigOut.get-sigOutMatlab.get)/norm(sigOutMatlab.get);
+robolog('Native vs MATLAB DBP difference: %g', 'NFO0', errNative);
+assert(errNative < 1e-9, 'DBP_v1: native and MATLAB back-propagation differ');
+
+figure(1), plot(sigOut.get(2:2:end,1), '.')
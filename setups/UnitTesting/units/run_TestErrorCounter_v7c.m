@@ -0,0 +1,43 @@
+clearvars -except testFiles nn
+close all
+
+
+%Reference: one period of random 16-QAM symbols, Gray mapped
+M = 16;
+P = 2^12-1;
+rng(1);
+ref = uint16(randi(M, P, 1));
+[c, Pc] = constref('QAM', M);
+c = c/sqrt(Pc);
+map = constmap('QAM', M, 'gray');
+
+%Received: 3 periods starting at delay 1000, with noise
+delay = 1000;
+tx = ref(mod(delay-1+(0:3*P-1), P)+1);
+rx = c(map(tx));
+rx = rx(:) + 0.12*(randn(size(rx(:)))+1j*randn(size(rx(:))))/sqrt(2);
+
+
+%% Counter: native vs MATLAB, symbols mode, several blocks (tracked alignment)
+param = struct('L', 2^11, 'M', M, 'coding', 'gray', 'mexEnabled', true);
+[berMex, ~, ~, ~, ~, errMex] = error_counter_v7c(rx, ref, param);
+param.mexEnabled = false;
+[berMatlab, ~, ~, ~, ~, errMatlab] = error_counter_v7c(rx, ref, param);
+robolog('BER native: %g, MATLAB: %g', 'NFO0', berMex, berMatlab);
+assert(isequal(errMex, errMatlab), 'bitcount_mex: bit errors differ from the MATLAB counter');
+
+
+%% Kernel: delay search vs predicted delay
+[~, demap] = constmap('QAM', M, 'gray');
+labels = demap(hd_euclid(rx(1:2^11), c), :)-1;
+[err, d, ~, tracked] = bitcount_mex(ref-1, log2(M), labels, 1);
+[~, best] = min(err);
+assert(~tracked && d(best) == delay, 'bitcount_mex: wrong delay');
+[errHint, dHint, ~, tracked] = bitcount_mex(ref-1, log2(M), labels, 1, delay);
+assert(tracked && dHint(best) == delay && errHint(best) == err(best), ...
+    'bitcount_mex: wrong count at the predicted delay');
+%only the aligned rotation is counted at its best delay: the other ones
+%are upper bounds of the search
+assert(all(errHint >= err), 'bitcount_mex: count below the minimum over the delays');
+[~, ~, ~, tracked] = bitcount_mex(ref-1, log2(M), labels, 1, delay+7);
+assert(~tracked, 'bitcount_mex: misaligned prediction accepted');
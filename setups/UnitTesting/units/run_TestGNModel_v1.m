@@ -0,0 +1,57 @@
+clearvars -except testFiles nn
+close all
+
+%% Single channel, single span, gain = span loss: the NLI at the receiver is the NLI at the launch point
+param.gn.nSpans         = 1;
+param.gn.L              = 100;
+param.gn.alphaa         = 0.2;
+param.gn.gamma          = 1.3;
+param.gn.EDFAGain       = 20;
+param.gn.EDFANF         = 5;
+param.gn.nChannels      = 1;
+param.gn.symbolRate     = 32e9;
+
+Rs = param.gn.symbolRate;
+P = 1e-3;
+alphalin = param.gn.alphaa/(10*log10(exp(1)));
+Leff = (1-exp(-alphalin*param.gn.L))/alphalin;
+
+%% No dispersion: eta = gamma*Leff, and the rectangular spectrum gives
+% PNLI = 16/27*gamma^2*Leff^2*(P/Rs)^3*(3/4*Rs^2)*Rs = 4/9*gamma^2*Leff^2*P^3
+gn = GNModel_v1(setfield(setfield(param.gn, 'D', 0), 'frequencyResolution', Rs/256));
+[~, ~, PNLI] = gn.estimate(0);
+PNLIRef = 4/9*param.gn.gamma^2*Leff^2*P^3;
+robolog('GN model without dispersion: NLI %g W, closed form %g W', 'NFO0', PNLI, PNLIRef);
+assert(abs(PNLI/PNLIRef-1) < 0.02, 'GNModel_v1: NLI without dispersion differs from the closed form');
+
+%% Dispersion: asinh approximation of the single-channel GN model (Poggiolini eq. 15)
+gn = GNModel_v1(setfield(setfield(param.gn, 'D', 17), 'frequencyResolution', Rs/64));
+[~, ~, PNLI] = gn.estimate(0);
+cKms = const.c*1e-3;
+beta2 = 17*(cKms/193.1e12)^2/(2*pi*cKms);
+La = 1/alphalin;
+PNLIRef = 8/27*param.gn.gamma^2*(P/Rs)^3*Leff^2*asinh(pi^2/2*beta2*La*Rs^2)/(pi*beta2*La)*Rs;
+robolog('GN model with dispersion: NLI %g W, asinh approximation %g W', 'NFO0', PNLI, PNLIRef);
+assert(abs(PNLI/PNLIRef-1) < 0.1, 'GNModel_v1: NLI with dispersion differs from the asinh approximation');
+
+%% Native vs MATLAB: WDM, heterogeneous spans, dispersion slope
+param.wdm.nSpans        = 3;
+param.wdm.L             = [80 80 60];
+param.wdm.alphaa        = [0.2 0.2 0.18];
+param.wdm.D             = [17 17 4];
+param.wdm.S             = 0.06;
+param.wdm.gamma         = [1.3 1.3 1.5];
+param.wdm.EDFAGain      = [16 16 12];
+param.wdm.nChannels     = 3;
+param.wdm.channelSpacing = 50e9;
+param.wdm.symbolRate    = 32e9;
+
+gn = GNModel_v1(param.wdm);
+[SNR, PASE, PNLI] = gn.estimate([0 3 0]);
+gn.mexEnabled = false;
+[SNRMatlab, PASEMatlab, PNLIMatlab] = gn.estimate([0 3 0]);
+errNative = max(abs(PNLI-PNLIMatlab)./PNLIMatlab);
+robolog('Native vs MATLAB NLI difference: %g', 'NFO0', errNative);
+assert(errNative < 1e-9, 'GNModel_v1: native and MATLAB NLI differ');
+assert(isequal(PASE, PASEMatlab) && max(abs(SNR-SNRMatlab)) < 1e-9, 'GNModel_v1: native and MATLAB SNR differ');
+assert(PNLI(2) > PNLI(1) && abs(PNLI(1)/PNLI(3)-1) < 1e-3, 'GNModel_v1: NLI does not follow the channel powers');
@@ -0,0 +1,60 @@
+clearvars -except testFiles nn
+close all
+
+%% Parameters
+param.ch.L          = 80;
+param.ch.D          = 17;
+param.ch.S          = 0.06;
+param.ch.loss       = 0.2;
+param.ch.U          = LinChBulk_v1.random_unitary(2);
+param.ch.P          = LinChBulk_v1.random_unitary(2);
+param.ch.tau        = [-10e-12 10e-12];
+
+param.mix           = rmfield(param.ch, {'tau', 'P'});
+
+%% Create objects
+ch = LinChBulk_v1(param.ch);
+chMatlab = LinChBulk_v1(setfield(param.ch, 'mexEnabled', false));
+mix = LinChBulk_v1(param.mix);
+mixMatlab = LinChBulk_v1(setfield(param.mix, 'mexEnabled', false));
+
+%% Create Dummy input
+param.sig.Fs = 64e9;
+param.sig.Fc = 193.1e12;
+param.sig.Rs = 16e9;
+param.sig.PCol = [pwr(20,{0,'dBm'}), pwr(20,{0,'dBm'})];
+Ein = resample(sign(randn(2^12,2)) + 1j*sign(randn(2^12,2)), 4, 1);
+sigIn = signal_interface(Ein, param.sig);
+
+%% Traverse
+sigOut = ch.traverse(sigIn);
+sigOutMatlab = chMatlab.traverse(sigIn);
+sigMix = mix.traverse(sigIn);
+sigMixMatlab = mixMatlab.traverse(sigIn);
+
+%% Compare
+lossLin = 10^(-param.ch.L*param.ch.loss/20);
+sigCD = ch.cd_loading(sigIn);
+rel = @(E, Eref) norm(E-Eref)/norm(Eref);
+
+%PMD: dispersion, delays of the principal modes (B = P.'), mixing (C = U*P)
+errNative = rel(sigOut.get, sigOutMatlab.get);
+robolog('Native vs MATLAB difference (PMD): %g', 'NFO0', errNative);
+assert(errNative < 1e-12, 'LinChBulk_v1: native and MATLAB PMD operators differ');
+Nfft = sigIn.L;
+omega = 2*pi*[(0:Nfft/2-1),(-Nfft/2:-1)]'/(Nfft/sigIn.Fs);
+S = bsxfun(@times, fft(sigCD.get)*param.ch.P.', exp(-1j*omega*param.ch.tau));
+Eref = ifft(S)*(param.ch.U*param.ch.P)*lossLin;
+errFused = rel(sigOut.get, Eref);
+robolog('Fused vs separate dispersion and PMD difference: %g', 'NFO0', errFused);
+assert(errFused < 1e-12, 'LinChBulk_v1: fused PMD operator differs from the separate steps');
+
+%no PMD: dispersion and mixing
+errNative = rel(sigMix.get, sigMixMatlab.get);
+robolog('Native vs MATLAB difference (mixing): %g', 'NFO0', errNative);
+assert(errNative < 1e-12, 'LinChBulk_v1: native and MATLAB mixing operators differ');
+sigRef = sigCD*(param.mix.U*lossLin);
+errFused = rel(sigMix.get, sigRef.get);
+robolog('Fused vs separate dispersion and mixing difference: %g', 'NFO0', errFused);
+assert(errFused < 1e-12, 'LinChBulk_v1: fused mixing operator differs from the separate steps');
+assert(all(abs([sigMix.PCol.P_dBW]-[sigRef.PCol.P_dBW]) < 1e-9), 'LinChBulk_v1: fused mixing power differs');
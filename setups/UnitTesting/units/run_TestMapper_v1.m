@@ -23,4 +23,9 @@ out2    = mp.traverse(out);
 
 %%
 figure(1)
-plot(real(out2(:)),imag(out2(:)),'s')
\ No newline at end of file
+plot(real(out2(:)),imag(out2(:)),'s')
+%% Max-log demapping: the signs of the LLRs of the noiseless symbols give the bits back
+llr = mp.demap(out2, 0.1);
+nErr = nnz((llr < 0) ~= logical(out.getRaw()));
+robolog('Demapper bit errors: %d', 'NFO0', nErr);
+assert(nErr == 0, 'Mapper_v1: max-log demapper does not give the bits back');
@@ -16,3 +16,18 @@ for nn=1:log2(param.M)
     fprintf('Column #%d: \n Ones: %d - Zeros: %d \n',...
             nn,zerosAndOnes(1,nn),zerosAndOnes(2,nn))
 end
+
+%PRBS window: the bits from an offset are the ones of the full sequence
+param.PRBSOrder = 31;
+param.seed = [1 2 3 4];
+param.lengthSequence = 2000;
+full = get(PatternGenerator_v1(param).traverse());
+param.offset = 1500;
+param.lengthSequence = 500;
+part = get(PatternGenerator_v1(param).traverse());
+param.mexEnabled = false;
+partMatlab = get(PatternGenerator_v1(param).traverse());
+robolog('PRBS window errors: %d (native vs MATLAB generator: %d)', 'NFO0', ...
+    nnz(full(1501:end,:) ~= part), nnz(part ~= partMatlab));
+assert(isequal(part, full(1501:end,:)), 'PatternGenerator_v1: PRBS window differs from the full sequence');
+assert(isequal(part, partMatlab), 'PatternGenerator_v1: native and MATLAB PRBS generators differ');
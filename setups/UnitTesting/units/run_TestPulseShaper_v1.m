@@ -25,4 +25,33 @@ out     = sg.traverse();
 out2    = ps.traverse(out);
 
 %%
-pconst(out2)
\ No newline at end of file
+pconst(out2)
+
+%% Native vs MATLAB
+ps.mexEnabled = false;
+out3    = ps.traverse(out);
+errNative = norm(out2.get-out3.get)/norm(out3.get);
+robolog('Native vs MATLAB pulse shaping difference: %g', 'NFO0', errNative);
+assert(errNative < 1e-12, 'PulseShaper_v1: native and MATLAB pulse shaping differ');
+
+%% pulseshape_mex against ps: odd and even filter lengths (delay floor(K/2)), both methods
+if hasMex('pulseshape_mex')
+    x = randn(1000, 1) + 1j*randn(1000, 1);
+    xr = randn(1000, 1);
+    for pulseShape = {'rrc', 'nrz'}
+        shaper = PulseShaper_v1(setfield(ps_param, 'pulseShape', pulseShape{1}));
+        h = shaper.filterCoeffs;
+        sps = shaper.samplesPerSymbol;
+        for method = 1:2
+            y = pulseshape_mex(x, h, sps, floor(numel(h)/2), 10, method);
+            yRef = PulseShaper_v1.ps(x, sps, h);
+            assert(norm(y-yRef)/norm(yRef) < 1e-12, ...
+                'pulseshape_mex: %s, method %d differs from ps', pulseShape{1}, method);
+            %real input: complex output with a zero imaginary part
+            y = pulseshape_mex(xr, h, sps, floor(numel(h)/2), 10, method);
+            yRef = PulseShaper_v1.ps(xr, sps, h);
+            assert(norm(real(y)-yRef)/norm(yRef) < 1e-12 && ~any(imag(y)), ...
+                'pulseshape_mex: %s, method %d differs from ps for a real input', pulseShape{1}, method);
+        end
+    end
+end
@@ -0,0 +1,56 @@
+%> @file dataHash.m
+%> @brief Hash of a MATLAB value
+%>
+%> @ingroup roboUtils
+%>
+%> Returns a 64-bit hash (16 hexadecimal characters) identifying a value:
+%> equal values give equal hashes, and different values different hashes
+%> with overwhelming probability. The class and the size of arrays are part
+%> of the hash. Numeric, logical and char arrays are hashed directly from
+%> their samples by the native engine (hash_mex, see compileMex), in
+%> parallel; other values (structs, cells, objects) are serialized first.
+%> Without the native engine an MD5 digest is used instead, which gives
+%> other hashes: do not compare hashes computed with and without it.
+%>
+%> __Example__
+%> @code
+%>   h = dataHash(sig.getRaw);
+%> @endcode
+%>
+%> @param x         Value to hash
+%> @param useMex    Use the native engine if compiled [Default: true]
+%> @param nThreads  Number of threads of the native engine, 0 for all processors [Default: 0]
+%>
+%> @retval h        Hash, 16 hexadecimal characters
+%>
+%> @see traverseCache
+%>
+%> @version 1
+function h = dataHash(x, useMex, nThreads)
+
+if nargin<2, useMex = true; end
+if nargin<3, nThreads = 0; end
+
+if (isnumeric(x) || islogical(x) || ischar(x)) && ~issparse(x)
+    head = [uint8(class(x)) typecast(double(size(x)), 'uint8') uint8(isreal(x))];
+else
+    head = uint8(class(x));
+    x = getByteStreamFromArray(x);
+end
+
+if useMex && hasMex('hash_mex')
+    h = hash_mex([head uint8(hash_mex(x, 0, nThreads))], 1, 1);
+    return
+end
+
+md = java.security.MessageDigest.getInstance('MD5');
+md.update(typecast(head, 'int8'));
+if islogical(x) || ischar(x)
+    x = uint16(x);
+end
+md.update(typecast(real(x(:)).', 'int8'));
+if ~isreal(x)
+    md.update(typecast(imag(x(:)).', 'int8'));
+end
+d = typecast(md.digest(), 'uint8');
+h = sprintf('%02x', d(1:8));
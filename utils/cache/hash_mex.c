@@ -0,0 +1,196 @@
+/*  File:           hash_mex.c
+ *  Description:    Fast 64-bit hash of the data of a numeric array.
+ *                  Native engine of dataHash, compiled as a MATLAB MEX
+ *                  function (see compileMex).
+ *
+ *  Reference:
+ *    Y. Collet, "xxHash - Extremely fast hash algorithm",
+ *    https://github.com/Cyan4973/xxHash (XXH64).
+ *
+ *  The bytes of the real part (and of the imaginary part, hashed as a
+ *  second stream) are cut in blocks of BLOCK bytes.  Each block is
+ *  hashed with XXH64 (four independent 64-bit lanes over 32 bytes, which
+ *  the compiler keeps in registers) seeded with the seed and its index,
+ *  the blocks in parallel, and the block hashes are merged in order.  The
+ *  hash therefore does not depend on the number of threads.  It is not a
+ *  cryptographic hash: it identifies data, e.g. the inputs of a cached
+ *  traverse (see traverseCache).
+ */
+
+/*
+ * USAGE:
+ * h = hash_mex(X);
+ * h = hash_mex(X,seed);
+ * h = hash_mex(X,seed,nthreads);
+ *
+ * INPUT
+ * X         Numeric, logical or char array (real or complex)
+ * seed      Seed (integer, 0..2^32-1, default 0)
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * h         Hash, 16 hexadecimal characters
+ */
+
+#include "robomex.h"
+
+#define BLOCK 65536          /* bytes per block */
+
+#define P1 (((uint64_T) 0x9E3779B1U << 32) | 0x85EBCA87U)
+#define P2 (((uint64_T) 0xC2B2AE3DU << 32) | 0x27D4EB4FU)
+#define P3 (((uint64_T) 0x165667B1U << 32) | 0x9E3779F9U)
+#define P4 (((uint64_T) 0x85EBCA77U << 32) | 0xC2B2AE63U)
+#define P5 (((uint64_T) 0x27D4EB2FU << 32) | 0x165667C5U)
+
+#define ROTL(x,r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+uint64_T xxh64(const unsigned char*,size_t,uint64_T);
+uint64_T hash_stream(const unsigned char*,size_t,uint64_T,int);
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+static uint64_T read64(const unsigned char* p)
+{
+  uint64_T w;
+  memcpy(&w,p,8);
+  return w;
+}
+
+
+static uint64_T read32(const unsigned char* p)
+{
+  uint32_T w;
+  memcpy(&w,p,4);
+  return w;
+}
+
+
+static uint64_T xxh_round(uint64_T acc,uint64_T w)
+{
+  acc += w*P2;
+  acc = ROTL(acc,31);
+  return acc*P1;
+}
+
+
+static uint64_T xxh_merge(uint64_T h,uint64_T v)
+{
+  h ^= xxh_round(0,v);
+  return h*P1 + P4;
+}
+
+
+static uint64_T xxh_avalanche(uint64_T h)
+{
+  h ^= h >> 33;
+  h *= P2;
+  h ^= h >> 29;
+  h *= P3;
+  h ^= h >> 32;
+  return h;
+}
+
+
+/* XXH64 of n bytes */
+uint64_T xxh64(const unsigned char* p,size_t n,uint64_T seed)
+{
+  const unsigned char* end = p + n;
+  uint64_T h;
+
+  if (n >= 32) {
+    uint64_T v1 = seed + P1 + P2, v2 = seed + P2, v3 = seed, v4 = seed - P1;
+    const unsigned char* last = end - 32;
+    do {
+      v1 = xxh_round(v1,read64(p));
+      v2 = xxh_round(v2,read64(p + 8));
+      v3 = xxh_round(v3,read64(p + 16));
+      v4 = xxh_round(v4,read64(p + 24));
+      p += 32;
+    } while (p <= last);
+    h = ROTL(v1,1) + ROTL(v2,7) + ROTL(v3,12) + ROTL(v4,18);
+    h = xxh_merge(h,v1);
+    h = xxh_merge(h,v2);
+    h = xxh_merge(h,v3);
+    h = xxh_merge(h,v4);
+  } else
+    h = seed + P5;
+  h += (uint64_T) n;
+
+  for (; p + 8 <= end; p += 8) {
+    h ^= xxh_round(0,read64(p));
+    h = ROTL(h,27)*P1 + P4;
+  }
+  if (p + 4 <= end) {
+    h ^= read32(p)*P1;
+    h = ROTL(h,23)*P2 + P3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    h ^= (*p)*P5;
+    h = ROTL(h,11)*P1;
+  }
+  return xxh_avalanche(h);
+}
+
+
+/* Hash of n bytes: blocks hashed in parallel, merged in order */
+uint64_T hash_stream(const unsigned char* p,size_t n,uint64_T seed,int nthreads)
+{
+  size_t nblocks = (n + BLOCK - 1)/BLOCK, b;
+  uint64_T* bh;
+  uint64_T h = seed + P5;
+  long bb;
+
+  if (nblocks <= 1)
+    return xxh64(p,n,seed);
+
+  bh = (uint64_T*) robomex_malloc(sizeof(uint64_T)*nblocks);
+  if ((size_t) nthreads > nblocks)
+    nthreads = (int) nblocks;
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+#endif
+  for (bb = 0; bb < (long) nblocks; bb++) {
+    size_t a = (size_t) bb*BLOCK;
+    bh[bb] = xxh64(p + a,n - a < BLOCK ? n - a : BLOCK,seed + (uint64_T) bb);
+  }
+
+  for (b = 0; b < nblocks; b++)
+    h = ROTL(h ^ xxh_round(0,bh[b]),27)*P1 + P4;
+  h += (uint64_T) n;
+  FFTW_FREE(bh);
+  return xxh_avalanche(h);
+}
+
+
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  size_t nbytes;
+  uint64_T seed, h;
+  int nthreads, k;
+  char hex[17];
+  const char* digits = "0123456789abcdef";
+
+  if (nrhs < 1)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 1)
+    mexErrMsgTxt("Too many output arguments.");
+  if (!(mxIsNumeric(prhs[0]) || mxIsLogical(prhs[0]) || mxIsChar(prhs[0])) || mxIsSparse(prhs[0]))
+    mexErrMsgTxt("The data must be a full numeric, logical or char array.");
+
+  seed = (uint64_T) robomex_optional(nrhs,prhs,1,0);
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,2,0));
+  nbytes = mxGetNumberOfElements(prhs[0])*mxGetElementSize(prhs[0]);
+
+  h = hash_stream((const unsigned char*) mxGetData(prhs[0]),nbytes,seed,nthreads);
+  if (mxIsComplex(prhs[0])) {
+    uint64_T hi = hash_stream((const unsigned char*) mxGetImagData(prhs[0]),nbytes,seed ^ P3,nthreads);
+    h = xxh_avalanche(ROTL(h,29) ^ (hi*P1));
+  }
+
+  for (k = 0; k < 16; k++)
+    hex[k] = digits[(h >> (60 - 4*k)) & 15];
+  hex[16] = '\0';
+  plhs[0] = mxCreateString(hex);
+}
@@ -0,0 +1,243 @@
+%>@file traverseCache.m
+%>@brief Traverse cache class definition
+%>
+%>@class traverseCache
+%>@brief On-disk cache of the outputs of unit traversals
+%>
+%> @ingroup roboUtils
+%>
+%> Parameter sweeps often traverse the same upstream units (transmitter,
+%> channel) with the same parameters and signals many times, varying only
+%> the receiver. When the cache folder is set and a unit has cacheTraverse
+%> enabled, traverseNode looks up the outputs of the unit in the cache
+%> before traversing it, and skips the traverse if they are found.
+%>
+%> The outputs are identified by a hash (dataHash) of:
+%>  - the class of the unit and its public properties (its parameters),
+%>    except results, label, draw and the graph connections; for a module,
+%>    the parameters of all its internal units;
+%>  - the input signals (waveform, Fs, Rs, Fc and power per column);
+%>  - the state of the global random number generator.
+%> On a hit the public properties of the unit (e.g. results) and the state
+%> of the random number generator after the traverse are restored as well,
+%> so the rest of the simulation is the same as without the cache. For a
+%> module, the public properties of its internal units are restored too.
+%> Properties that are not public (private or protected state) are not
+%> cached: units keeping such state between traverses should not be cached.
+%> Units drawing random numbers only hit the cache when the generator is
+%> reseeded, e.g. rng(seed) at each point of a sweep.
+%>
+%> The entries are MAT files named after their hash. When the total size
+%> of the folder exceeds the limit, the least recently used entries are
+%> deleted.
+%>
+%> __Example__
+%> @code
+%>   setpref('robochameleon', 'traverseCache', fullfile(tempdir, 'robocache'));
+%>   setpref('robochameleon', 'traverseCacheSize', 20e9); % bytes
+%>   channel.cacheTraverse = true;
+%>   for rxParam = sweep
+%>       rng(1);
+%>       ... % the channel is traversed once
+%>   end
+%>   traverseCache.flush();
+%> @endcode
+%>
+%> @see unit::cacheTraverse, dataHash
+%>
+%> @version 1
+classdef traverseCache
+
+    properties (Constant,Hidden=true)
+        %> Properties describing the graph or the display, not the traverse
+        IGNORED = {'label', 'draw', 'inputBuffer', 'nextNodes', 'destInputs', 'ID', 'clientTraverse', ...
+            'cacheTraverse', 'maxInFlight', 'internalUnits', 'traversingOrder', 'biograph_struct'};
+        %> Default size limit of the cache folder (bytes)
+        DEFAULT_SIZE = 10e9;
+    end
+
+    methods (Static)
+
+        %> @brief Folder of the cache, empty if disabled
+        function folder = folder()
+            folder = '';
+            if ispref('robochameleon', 'traverseCache')
+                folder = getpref('robochameleon', 'traverseCache');
+            end
+        end
+
+        %> @brief Hash identifying the traverse of a unit on its input buffer
+        %>
+        %> @param u unit with its inputs in the input buffer
+        %> @retval key hash
+        function key = key(u)
+            h = {traverseCache.paramHash(u)};
+            for i=1:numel(u.inputBuffer)
+                s = u.inputBuffer{i};
+                PCol = zeros(2, s.N);
+                for jj=1:s.N
+                    PCol(:,jj) = [s.PCol(jj).Ptot('W'); s.PCol(jj).SNR('dB')];
+                end
+                h{end+1} = dataHash(getRaw(s)); %#ok<AGROW>
+                h{end+1} = dataHash([s.Fs s.Rs s.Fc PCol(:).']); %#ok<AGROW>
+            end
+            state = rng;
+            h{end+1} = dataHash({state.Type, state.Seed, state.State});
+            key = dataHash([h{:}]);
+        end
+
+        %> @brief Look up the outputs of a traverse
+        %>
+        %> On a hit the public properties of the unit (and of the internal
+        %> units of a module) and the state of the random number generator
+        %> are restored.
+        %>
+        %> @param u   unit
+        %> @param key hash returned by key
+        %> @retval hit true if the outputs were found
+        %> @retval outputs cell array of output signals
+        function [hit, outputs] = fetch(u, key)
+            outputs = {};
+            file = fullfile(traverseCache.folder(), [key '.mat']);
+            hit = exist(file, 'file') == 2;
+            if ~hit
+                return
+            end
+            try
+                entry = load(file);
+            catch e
+                robolog('Cannot read the cache entry %s: %s', 'WRN', file, e.message);
+                hit = false;
+                return
+            end
+            outputs = entry.outputs;
+            if ~isfield(entry, 'internal')
+                entry.internal = {};
+            end
+            traverseCache.restoreState(u, struct('state', entry.state, 'internal', {entry.internal}));
+            rng(entry.rngState);
+            % Most recently used
+            java.io.File(file).setLastModified(java.lang.System.currentTimeMillis());
+            robolog('Outputs of %s read from the cache.', 'NFO0', u.label);
+        end
+
+        %> @brief Store the outputs of a traverse
+        %>
+        %> @param u       unit after traverse
+        %> @param key     hash returned by key before the traverse
+        %> @param outputs cell array of output signals
+        function store(u, key, outputs)
+            folder = traverseCache.folder();
+            if ~exist(folder, 'dir')
+                mkdir(folder);
+            end
+            s = traverseCache.unitState(u);
+            state = s.state; %#ok<NASGU>
+            internal = s.internal; %#ok<NASGU>
+            rngState = rng; %#ok<NASGU>
+            file = fullfile(folder, [key '.mat']);
+            tmp = [tempname(folder) '.mat'];
+            info = whos('outputs', 'state', 'internal');
+            if sum([info.bytes]) < 2^31
+                save(tmp, 'outputs', 'state', 'internal', 'rngState');
+            else
+                save(tmp, 'outputs', 'state', 'internal', 'rngState', '-v7.3');
+            end
+            movefile(tmp, file, 'f');
+            traverseCache.evict();
+        end
+
+        %> @brief Delete the least recently used entries above the size limit
+        function evict()
+            limit = traverseCache.DEFAULT_SIZE;
+            if ispref('robochameleon', 'traverseCacheSize')
+                limit = getpref('robochameleon', 'traverseCacheSize');
+            end
+            entries = dir(fullfile(traverseCache.folder(), '*.mat'));
+            [~, order] = sort([entries.datenum], 'descend');
+            entries = entries(order);
+            used = cumsum([entries.bytes]);
+            for i=find(used > limit)
+                delete(fullfile(traverseCache.folder(), entries(i).name));
+            end
+        end
+
+        %> @brief Delete all the entries of the cache
+        function flush()
+            folder = traverseCache.folder();
+            if ~isempty(folder) && exist(folder, 'dir')
+                delete(fullfile(folder, '*.mat'));
+            end
+        end
+
+    end
+
+    methods (Static,Access=private)
+
+        %> @brief Hash of the class and the parameters of a unit
+        function h = paramHash(u)
+            param = traverseCache.publicProperties(u, false);
+            h = {class(u), dataHash(param)};
+            if isa(u, 'module')
+                for i=1:numel(u.internalUnits)
+                    h{end+1} = traverseCache.paramHash(u.internalUnits{i}); %#ok<AGROW>
+                end
+            end
+            h = dataHash([h{:}]);
+        end
+
+        %> @brief Public, settable properties of a unit (restored on a hit)
+        %>
+        %> @param u unit
+        %> @retval s struct with fields state (properties of u) and internal
+        %>         (cell array, the same for each internal unit of a module)
+        function s = unitState(u)
+            s = struct('state', traverseCache.publicProperties(u, true), 'internal', {{}});
+            if isa(u, 'module')
+                for i=1:numel(u.internalUnits)
+                    s.internal{i} = traverseCache.unitState(u.internalUnits{i});
+                end
+            end
+        end
+
+        %> @brief Restore the properties saved by unitState
+        function restoreState(u, s)
+            f = fieldnames(s.state);
+            for i=1:numel(f)
+                u.(f{i}) = s.state.(f{i});
+            end
+            if isa(u, 'module')
+                for i=1:min(numel(s.internal), numel(u.internalUnits))
+                    traverseCache.restoreState(u.internalUnits{i}, s.internal{i});
+                end
+            end
+        end
+
+        %> @brief Public properties of a unit in a struct
+        %>
+        %> @param u        unit
+        %> @param settable true for the settable properties, results
+        %>                 included; false for the parameters, i.e. all the
+        %>                 readable properties but results
+        function s = publicProperties(u, settable)
+            s = struct();
+            props = metaclass(u).PropertyList;
+            for j=1:numel(props)
+                p = props(j);
+                if p.Dependent || p.Constant || ~ischar(p.GetAccess) || ~strcmp(p.GetAccess, 'public') ...
+                        || any(strcmp(p.Name, traverseCache.IGNORED))
+                    continue
+                end
+                if settable && (~ischar(p.SetAccess) || ~strcmp(p.SetAccess, 'public'))
+                    continue
+                end
+                if ~settable && strcmp(p.Name, 'results')
+                    continue
+                end
+                s.(p.Name) = u.(p.Name);
+            end
+        end
+
+    end
+
+end
@@ -0,0 +1,43 @@
+%> @file distanceMatrix.m
+%> @brief Euclidean distance matrix between two sets of points
+%>
+%> @ingroup roboUtils
+%>
+%> Returns D(n,m) = norm(X(n,:) - Y(m,:)), the result of ipdm(X, Y) with
+%> the default options. Complex data are compared in the complex plane.
+%> The native engine (distmat_mex, see compileMex) fills the matrix in
+%> cache-sized blocks of rows in parallel. When only the nearest point is
+%> needed use nearestCentroid, which does not form the matrix.
+%>
+%> __Example__
+%> @code
+%>   D = distanceMatrix(rx(1:1000), constref('QAM', 16));
+%> @endcode
+%>
+%> @param X         Points, N-by-p (one-dimensional data must be a column)
+%> @param Y         Points, M-by-p [Default: X]
+%> @param useMex    Use the native engine if compiled [Default: true]
+%> @param nThreads  Number of threads of the native engine, 0 for all processors [Default: 0]
+%>
+%> @retval D        N-by-M distances
+%>
+%> @version 1
+function D = distanceMatrix(X, Y, useMex, nThreads)
+
+if nargin<2 || isempty(Y), Y = X; end
+if nargin<3, useMex = true; end
+if nargin<4, nThreads = 0; end
+if size(X,2) ~= size(Y,2)
+    robolog('The points must have the same number of columns.', 'ERR');
+end
+
+if useMex && hasMex('distmat_mex')
+    D = distmat_mex(double(X), double(Y), nThreads);
+    return
+end
+
+D = zeros(size(X,1), size(Y,1));
+for j=1:size(X,2)
+    D = D + abs(bsxfun(@minus, X(:,j), Y(:,j).')).^2;
+end
+D = sqrt(D);
@@ -0,0 +1,135 @@
+/*  File:           distmat_mex.c
+ *  Description:    Euclidean distance matrix between two sets of points.
+ *                  Native engine of distanceMatrix, compiled as a MATLAB
+ *                  MEX function (see compileMex).
+ *
+ *  The points are the rows of X (N-by-p) and Y (M-by-p), real or complex
+ *  (a complex column counts as two real dimensions).  The output is
+ *  filled in blocks of BLOCK rows: the coordinates of the block stay in
+ *  the cache while the loop over its contiguous rows, vectorized by the
+ *  compiler, is repeated for every point of Y.  The differences are
+ *  computed directly (not with |x|^2 + |y|^2 - 2*x*y), so small distances
+ *  are exact.  The blocks are processed in parallel.
+ */
+
+/*
+ * USAGE:
+ * D = distmat_mex(X,Y);
+ * D = distmat_mex(X,Y,nthreads);
+ *
+ * INPUT
+ * X         Points, N-by-p (real or complex)
+ * Y         Points, M-by-p (real or complex)
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * D         N-by-M distances, D(n,m) = norm(X(n,:) - Y(m,:))
+ */
+
+#include "robomex.h"
+
+#define BLOCK 512            /* rows per block */
+
+void distmat_block(const double**,const double*,size_t,int,int,size_t,
+                   size_t,double*);
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+/* Rows off..off+nb-1 of D (N-by-M); col are the D columns of X and
+ * y the points of Y, row-major (y[m*dim + j]) */
+void distmat_block(const double** col,const double* y,size_t N,int M,
+                   int dim,size_t off,size_t nb,double* D)
+{
+  const double* x;
+  double *d, yj, e;
+  size_t b;
+  int m, j;
+
+  for (m = 0; m < M; m++) {
+    d = D + (size_t) m*N + off;
+    for (b = 0; b < nb; b++)
+      d[b] = 0;
+    for (j = 0; j < dim; j++) {
+      x = col[j] + off;
+      yj = y[(size_t) m*dim + j];
+      for (b = 0; b < nb; b++) {
+        e = x[b] - yj;
+        d[b] += e*e;
+      }
+    }
+    for (b = 0; b < nb; b++)
+      d[b] = sqrt(d[b]);
+  }
+}
+
+
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  size_t N;          /* rows of X */
+  int M;             /* rows of Y */
+  int p, dim;        /* columns, real dimensions */
+  int cplx, nthreads, nblocks, blk, m, j;
+  const double** col;
+  double *zeros = NULL, *y, *yr, *yi;
+
+  if (nrhs < 2)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 1)
+    mexErrMsgTxt("Too many output arguments.");
+
+  /* parse input arguments */
+  if (!mxIsDouble(prhs[0]) || !mxIsDouble(prhs[1]) || mxIsSparse(prhs[0]) || mxIsSparse(prhs[1]))
+    mexErrMsgTxt("The points must be full double matrices.");
+  N = mxGetM(prhs[0]);
+  M = (int) mxGetM(prhs[1]);
+  p = (int) mxGetN(prhs[0]);
+  if ((int) mxGetN(prhs[1]) != p)
+    mexErrMsgTxt("The points must have the same number of columns.");
+  cplx = mxIsComplex(prhs[0]) || mxIsComplex(prhs[1]);
+  dim = cplx ? 2*p : p;
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,2,0));
+
+  plhs[0] = mxCreateDoubleMatrix(N,M,mxREAL);
+  if (N == 0 || M == 0)
+    return;
+
+  /* columns of X: real parts, then imaginary parts */
+  col = (const double**) robomex_malloc(sizeof(double*)*(dim > 0 ? dim : 1));
+  if (cplx && !mxIsComplex(prhs[0])) {
+    zeros = (double*) robomex_malloc(sizeof(double)*N);
+    memset(zeros,0,sizeof(double)*N);
+  }
+  for (j = 0; j < p; j++) {
+    col[j] = mxGetPr(prhs[0]) + (size_t) j*N;
+    if (cplx)
+      col[p + j] = zeros ? zeros : mxGetPi(prhs[0]) + (size_t) j*N;
+  }
+  /* points of Y, row-major */
+  y = (double*) robomex_malloc(sizeof(double)*M*(dim > 0 ? dim : 1));
+  yr = mxGetPr(prhs[1]);
+  yi = mxIsComplex(prhs[1]) ? mxGetPi(prhs[1]) : NULL;
+  for (m = 0; m < M; m++)
+    for (j = 0; j < p; j++) {
+      y[(size_t) m*dim + j] = yr[m + (size_t) j*M];
+      if (cplx)
+        y[(size_t) m*dim + p + j] = yi ? yi[m + (size_t) j*M] : 0;
+    }
+
+  nblocks = (int) ((N + BLOCK - 1)/BLOCK);
+  if (nthreads > nblocks)
+    nthreads = nblocks;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+#endif
+  for (blk = 0; blk < nblocks; blk++) {
+    size_t off = (size_t) blk*BLOCK;
+    distmat_block(col,y,N,M,dim,off,off + BLOCK < N ? BLOCK : N - off,mxGetPr(plhs[0]));
+  }
+
+  FFTW_FREE(y);
+  if (zeros)
+    FFTW_FREE(zeros);
+  FFTW_FREE((void*) col);
+}
@@ -0,0 +1,412 @@
+/*  File:           kmeans_mex.c
+ *  Description:    Nearest-centroid queries and k-means clustering (Lloyd
+ *                  and mini-batch).  Native engine of nearestCentroid and
+ *                  kmeans_v1, compiled as a MATLAB MEX function (see
+ *                  compileMex).
+ *
+ *  The points are the rows of X (N-by-p, real or complex: a complex
+ *  column counts as two real dimensions).  The distances of a block of
+ *  BLOCK points to the centroids are computed one centroid at a time, in
+ *  a loop over the contiguous coordinates of the block that the compiler
+ *  vectorizes, and only the running minimum is kept: the N-by-M distance
+ *  matrix is never formed.  The blocks are assigned in parallel.
+ *
+ *  Lloyd iterations (batches empty) move every centroid towards the mean
+ *  of its points,
+ *
+ *    delta(k) = gamma*(C(k) - mean(X(idx == k))),   C(k) = C(k) - delta(k)
+ *
+ *  (gamma = 1 is the standard algorithm, see kmeans_v1), and stop when
+ *  mean(|delta|) < tol (the test of kmeans_v1) or, for gamma = 1, when
+ *  no point changes its nearest centroid (the convergence test of
+ *  kmeans: the centroids are then the means of their points, up to
+ *  rounding).  The means are accumulated by a single thread in the order
+ *  of the points, so the result does not depend on the number of
+ *  threads.  Centroids without points are left in place, or with
+ *  emptyaction = 1 replaced as by kmeans(...,'emptyaction','singleton'):
+ *  the point farthest from its centroid is taken out of its cluster (if
+ *  that cluster keeps at least one point; otherwise the first point of
+ *  the first cluster with two or more) and becomes the centroid of the
+ *  empty cluster, and the centroid of the cluster it left is set to the
+ *  mean of its remaining points.
+ *
+ *  Mini-batch iterations (D. Sculley, "Web-scale k-means clustering,"
+ *  WWW 2010): column t of batches holds the indices of the points of
+ *  iteration t.  The batch is assigned with the current centroids, then
+ *  each point moves its centroid by 1/(number of points seen by it) of
+ *  the difference.  The batches are drawn by the caller, so that the
+ *  result follows the MATLAB random number generator.
+ */
+
+/*
+ * USAGE:
+ * [C,idx,dist] = kmeans_mex(X,C0);
+ * [C,idx,dist,iters,conv] = kmeans_mex(X,C0,maxiter,tol,gamma);
+ * [C,idx,dist,iters,conv] = kmeans_mex(X,C0,maxiter,tol,gamma,batches,nthreads);
+ * [C,idx,dist,iters,conv] = kmeans_mex(X,C0,maxiter,tol,gamma,batches,nthreads,emptyaction);
+ *
+ * INPUT
+ * X         Points, N-by-p (real or complex)
+ * C0        Initial centroids, M-by-p (real or complex)
+ * maxiter   Maximum number of iterations (default 0: nearest-centroid
+ *             query only)
+ * tol       Convergence tolerance on the mean displacement of the
+ *             centroids (default 0)
+ * gamma     Step of the Lloyd iterations (default 1)
+ * batches   Mini-batches, b-by-T indices (1..N) of the points of each
+ *             iteration, or empty for Lloyd iterations (default)
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ * emptyaction  Centroids without points in the Lloyd iterations: 0 left
+ *             in place, 1 singleton (default 0)
+ *
+ * OUTPUT
+ * C         Centroids, M-by-p (complex if X or C0 is complex)
+ * idx       Index (1..M) of the nearest centroid of each point, N-by-1
+ *             uint32 (with the final centroids)
+ * dist      Distance to the nearest centroid, N-by-1
+ * iters     Number of iterations done
+ * conv      True if the mean displacement fell below the tolerance
+ *             (mini-batch), or if it did or, for gamma = 1, no assignment
+ *             changed (Lloyd)
+ */
+
+#include "robomex.h"
+#include <float.h>
+
+#define BLOCK 256            /* points per distance block */
+#define MINCHUNK 16384       /* minimum points per thread */
+
+typedef struct {
+  int M, D;                  /* centroids, real dimensions */
+  double* c;                 /* centroids, M-by-D row-major (c[k*D + j]) */
+} centroids_t;
+
+void assign_block(const centroids_t*,const double**,size_t,size_t,
+                  unsigned int*,double*);
+void assign_points(const centroids_t*,const double**,size_t,
+                   unsigned int*,double*,int);
+int fill_empty(centroids_t*,const double**,size_t,unsigned int*,
+               unsigned int*,unsigned int*,double*);
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+/* Nearest centroid of the points off..off+nb-1 (nb <= BLOCK) of the
+ * columns col; the squared distance goes to d2 if not NULL */
+void assign_block(const centroids_t* t,const double** col,size_t off,
+                  size_t nb,unsigned int* idx,double* d2)
+{
+  double best[BLOCK], d[BLOCK];
+  unsigned int ib[BLOCK];
+  const double* x;
+  double cj, e;
+  size_t b;
+  int k, j;
+
+  for (b = 0; b < nb; b++) {
+    best[b] = DBL_MAX;
+    ib[b] = 0;
+  }
+  for (k = 0; k < t->M; k++) {
+    for (b = 0; b < nb; b++)
+      d[b] = 0;
+    for (j = 0; j < t->D; j++) {
+      x = col[j] + off;
+      cj = t->c[k*t->D + j];
+      for (b = 0; b < nb; b++) {
+        e = x[b] - cj;
+        d[b] += e*e;
+      }
+    }
+    for (b = 0; b < nb; b++)
+      if (d[b] < best[b]) {
+        best[b] = d[b];
+        ib[b] = (unsigned int) k;
+      }
+  }
+  for (b = 0; b < nb; b++)
+    idx[off + b] = ib[b];
+  if (d2)
+    for (b = 0; b < nb; b++)
+      d2[off + b] = best[b];
+}
+
+
+/* Nearest centroid (0-based) of the n points of the columns col, in
+ * parallel */
+void assign_points(const centroids_t* t,const double** col,size_t n,
+                   unsigned int* idx,double* d2,int nthreads)
+{
+  int nchunks = (int) ((n + MINCHUNK - 1)/MINCHUNK), ch;
+
+  if (nchunks > nthreads)
+    nchunks = nthreads;
+  if (nchunks < 1)
+    return;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nchunks) schedule(static)
+#endif
+  for (ch = 0; ch < nchunks; ch++) {
+    size_t a = (size_t) ((double) n*ch/nchunks);
+    size_t b = (size_t) ((double) n*(ch + 1)/nchunks);
+    size_t off;
+
+    for (off = a; off < b; off += BLOCK)
+      assign_block(t,col,off,off + BLOCK < b ? BLOCK : b - off,idx,d2);
+  }
+}
+
+
+/* Singleton empty action of the Lloyd iterations (see the header), for
+ * each centroid without points in index order.  sums holds the sums of
+ * the coordinates of the points of each centroid; idx and prev (the
+ * assignment the next one is compared to) are updated.  Returns the
+ * number of centroids that were replaced. */
+int fill_empty(centroids_t* t,const double** col,size_t N,unsigned int* idx,
+               unsigned int* prev,unsigned int* cnt,double* sums)
+{
+  int k, j, from, nfilled = 0;
+  size_t n, lonely;
+  double d, dmax, e, x;
+
+  for (k = 0; k < t->M; k++) {
+    if (cnt[k])
+      continue;
+    /* point farthest from its centroid */
+    lonely = 0;
+    dmax = -1;
+    for (n = 0; n < N; n++) {
+      d = 0;
+      for (j = 0; j < t->D; j++) {
+        e = col[j][n] - t->c[idx[n]*t->D + j];
+        d += e*e;
+      }
+      if (d > dmax) {
+        dmax = d;
+        lonely = n;
+      }
+    }
+    from = (int) idx[lonely];
+    if (cnt[from] < 2) {
+      for (from = 0; from < t->M && cnt[from] < 2; from++)
+        ;
+      if (from == t->M)
+        return nfilled;     /* no cluster can give a point */
+      for (lonely = 0; idx[lonely] != (unsigned int) from; lonely++)
+        ;
+    }
+    cnt[from]--;
+    cnt[k] = 1;
+    idx[lonely] = prev[lonely] = (unsigned int) k;
+    for (j = 0; j < t->D; j++) {
+      x = col[j][lonely];
+      t->c[k*t->D + j] = sums[k*t->D + j] = x;
+      sums[from*t->D + j] -= x;
+      t->c[from*t->D + j] = sums[from*t->D + j]/cnt[from];
+    }
+    nfilled++;
+  }
+  return nfilled;
+}
+
+
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  centroids_t t;
+  size_t N;          /* points */
+  int p;             /* columns of X */
+  int cplx;          /* complex data */
+  int maxiter, iters = 0, conv = 0, emptyaction, filled;
+  double tol, gamma, mv, e, delta;
+  int nthreads;
+  const double** col;
+  double *zeros = NULL, *cr, *ci, *dist, *sums, *buf;
+  unsigned int *idx, *prev, *ib, *cnt;
+  size_t n, i, b = 0, T = 0;
+  int k, j;
+
+  if (nrhs < 2)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 5)
+    mexErrMsgTxt("Too many output arguments.");
+
+  /* parse input arguments */
+  if (!mxIsDouble(prhs[0]) || !mxIsDouble(prhs[1]) || mxIsSparse(prhs[0]) || mxIsSparse(prhs[1]))
+    mexErrMsgTxt("The points and the centroids must be full double matrices.");
+  N = mxGetM(prhs[0]);
+  p = (int) mxGetN(prhs[0]);
+  t.M = (int) mxGetM(prhs[1]);
+  if (t.M < 1 || t.M > 0x7fffffff || (int) mxGetN(prhs[1]) != p)
+    mexErrMsgTxt("The centroids must be a nonempty matrix with the columns of the points.");
+  cplx = mxIsComplex(prhs[0]) || mxIsComplex(prhs[1]);
+  t.D = cplx ? 2*p : p;
+  maxiter = (int) robomex_optional(nrhs,prhs,2,0);
+  tol = robomex_optional(nrhs,prhs,3,0);
+  gamma = robomex_optional(nrhs,prhs,4,1);
+  if (nrhs > 5 && !mxIsEmpty(prhs[5])) {
+    if (!mxIsDouble(prhs[5]))
+      mexErrMsgTxt("The batches must be a double matrix of indices.");
+    b = mxGetM(prhs[5]);
+    T = mxGetN(prhs[5]);
+    for (i = 0; i < b*T; i++) {
+      double v = mxGetPr(prhs[5])[i];
+      if (v < 1 || v > (double) N || v != floor(v))
+        mexErrMsgTxt("The batch indices must be integers between 1 and the number of points.");
+    }
+    if ((size_t) maxiter > T)
+      maxiter = (int) T;
+  }
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,6,0));
+  emptyaction = (int) robomex_optional(nrhs,prhs,7,0);
+
+  /* columns of the points: real parts, then imaginary parts */
+  col = (const double**) robomex_malloc(sizeof(double*)*t.D);
+  if (cplx && !mxIsComplex(prhs[0])) {
+    zeros = (double*) robomex_malloc(sizeof(double)*(N > 0 ? N : 1));
+    memset(zeros,0,sizeof(double)*N);
+  }
+  for (j = 0; j < p; j++) {
+    col[j] = mxGetPr(prhs[0]) + (size_t) j*N;
+    if (cplx)
+      col[p + j] = zeros ? zeros : mxGetPi(prhs[0]) + (size_t) j*N;
+  }
+  t.c = (double*) robomex_malloc(sizeof(double)*t.M*t.D);
+  cr = mxGetPr(prhs[1]);
+  ci = mxIsComplex(prhs[1]) ? mxGetPi(prhs[1]) : NULL;
+  for (k = 0; k < t.M; k++)
+    for (j = 0; j < p; j++) {
+      t.c[k*t.D + j] = cr[k + (size_t) j*t.M];
+      if (cplx)
+        t.c[k*t.D + p + j] = ci ? ci[k + (size_t) j*t.M] : 0;
+    }
+
+  idx = (unsigned int*) robomex_malloc(sizeof(unsigned int)*(N > 0 ? N : 1));
+  cnt = (unsigned int*) robomex_malloc(sizeof(unsigned int)*t.M);
+  sums = (double*) robomex_malloc(sizeof(double)*t.M*t.D);
+
+  if (b == 0 && maxiter > 0 && N > 0) {
+    /* Lloyd iterations: maxiter updates, the assignment after the last
+     * one is still tested for changes */
+    prev = (unsigned int*) robomex_malloc(sizeof(unsigned int)*N);
+    for (iters = 0; ; ) {
+      assign_points(&t,col,N,idx,NULL,nthreads);
+      if (iters > 0 && gamma == 1 && !memcmp(idx,prev,sizeof(unsigned int)*N)) {
+        conv = 1;
+        break;
+      }
+      if (iters == maxiter)
+        break;
+      memcpy(prev,idx,sizeof(unsigned int)*N);
+      memset(cnt,0,sizeof(unsigned int)*t.M);
+      memset(sums,0,sizeof(double)*t.M*t.D);
+      for (n = 0; n < N; n++)
+        cnt[idx[n]]++;
+      for (j = 0; j < t.D; j++)
+        for (n = 0; n < N; n++)
+          sums[idx[n]*t.D + j] += col[j][n];
+      delta = 0;
+      for (k = 0; k < t.M; k++) {
+        if (!cnt[k])
+          continue;
+        e = 0;
+        for (j = 0; j < t.D; j++) {
+          mv = gamma*(t.c[k*t.D + j] - sums[k*t.D + j]/cnt[k]);
+          t.c[k*t.D + j] -= mv;
+          e += mv*mv;
+        }
+        delta += sqrt(e);
+      }
+      filled = emptyaction ? fill_empty(&t,col,N,idx,prev,cnt,sums) : 0;
+      iters++;
+      /* replaced centroids moved by more than the tolerance */
+      if (!filled && delta/t.M < tol) {
+        conv = 1;
+        break;
+      }
+    }
+    FFTW_FREE(prev);
+  } else if (b > 0) {
+    /* mini-batch iterations: points of the batch copied to buf */
+    const double** bcol = (const double**) robomex_malloc(sizeof(double*)*t.D);
+    const double* sel;
+
+    buf = (double*) robomex_malloc(sizeof(double)*b*t.D);
+    ib = (unsigned int*) robomex_malloc(sizeof(unsigned int)*b);
+    for (j = 0; j < t.D; j++)
+      bcol[j] = buf + (size_t) j*b;
+    memset(cnt,0,sizeof(unsigned int)*t.M);
+    for (iters = 0; iters < maxiter; ) {
+      sel = mxGetPr(prhs[5]) + (size_t) iters*b;
+      for (j = 0; j < t.D; j++)
+        for (i = 0; i < b; i++)
+          buf[(size_t) j*b + i] = col[j][(size_t) sel[i] - 1];
+      assign_points(&t,bcol,b,ib,NULL,nthreads);
+      /* displacement of each centroid in sums */
+      memcpy(sums,t.c,sizeof(double)*t.M*t.D);
+      for (i = 0; i < b; i++) {
+        k = (int) ib[i];
+        cnt[k]++;
+        for (j = 0; j < t.D; j++)
+          t.c[k*t.D + j] += (buf[(size_t) j*b + i] - t.c[k*t.D + j])/cnt[k];
+      }
+      delta = 0;
+      for (k = 0; k < t.M; k++) {
+        e = 0;
+        for (j = 0; j < t.D; j++) {
+          mv = t.c[k*t.D + j] - sums[k*t.D + j];
+          e += mv*mv;
+        }
+        delta += sqrt(e);
+      }
+      iters++;
+      if (delta/t.M < tol) {
+        conv = 1;
+        break;
+      }
+    }
+    FFTW_FREE(ib);
+    FFTW_FREE(buf);
+    FFTW_FREE((void*) bcol);
+  }
+
+  /* outputs */
+  plhs[0] = mxCreateDoubleMatrix(t.M,p,cplx ? mxCOMPLEX : mxREAL);
+  cr = mxGetPr(plhs[0]);
+  ci = cplx ? mxGetPi(plhs[0]) : NULL;
+  for (k = 0; k < t.M; k++)
+    for (j = 0; j < p; j++) {
+      cr[k + (size_t) j*t.M] = t.c[k*t.D + j];
+      if (cplx)
+        ci[k + (size_t) j*t.M] = t.c[k*t.D + p + j];
+    }
+  if (nlhs > 1) {
+    unsigned int* out;
+
+    plhs[1] = mxCreateNumericMatrix(N,1,mxUINT32_CLASS,mxREAL);
+    out = (unsigned int*) mxGetData(plhs[1]);
+    if (nlhs > 2) {
+      plhs[2] = mxCreateDoubleMatrix(N,1,mxREAL);
+      dist = mxGetPr(plhs[2]);
+    } else
+      dist = NULL;
+    assign_points(&t,col,N,out,dist,nthreads);
+    for (n = 0; n < N; n++)
+      out[n]++;
+    if (dist)
+      for (n = 0; n < N; n++)
+        dist[n] = sqrt(dist[n]);
+  }
+  if (nlhs > 3)
+    plhs[3] = mxCreateDoubleScalar(iters);
+  if (nlhs > 4)
+    plhs[4] = mxCreateLogicalScalar(conv);
+
+  FFTW_FREE(sums);
+  FFTW_FREE(cnt);
+  FFTW_FREE(idx);
+  FFTW_FREE(t.c);
+  if (zeros)
+    FFTW_FREE(zeros);
+  FFTW_FREE((void*) col);
+}
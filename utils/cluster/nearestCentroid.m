@@ -0,0 +1,56 @@
+%> @file nearestCentroid.m
+%> @brief Nearest centroid of each point
+%>
+%> @ingroup roboUtils
+%>
+%> For each point (row) of X returns the index of the nearest centroid
+%> (row) of C and its Euclidean distance, i.e. the minimum over each row of
+%> distanceMatrix(X, C), without forming the numel(X)-by-M matrix. Complex
+%> data are compared in the complex plane. The native engine (kmeans_mex,
+%> see compileMex) assigns blocks of points in parallel, the MATLAB
+%> implementation below a limited number of points at a time.
+%>
+%> __Example__
+%> @code
+%>   % Decisions on 1e7 received symbols
+%>   [idx, d] = nearestCentroid(rx(:), constref('QAM', 64));
+%> @endcode
+%>
+%> @param X         Points, N-by-p (one-dimensional data must be a column)
+%> @param C         Centroids, M-by-p
+%> @param useMex    Use the native engine if compiled [Default: true]
+%> @param nThreads  Number of threads of the native engine, 0 for all processors [Default: 0]
+%>
+%> @retval idx      Index of the nearest centroid, N-by-1 [uint32]
+%> @retval dist     Distance to the nearest centroid, N-by-1
+%>
+%> @version 1
+function [idx, dist] = nearestCentroid(X, C, useMex, nThreads)
+
+if nargin<3, useMex = true; end
+if nargin<4, nThreads = 0; end
+if isvector(C) && size(X,2) == 1
+    C = C(:);
+end
+if size(X,2) ~= size(C,2)
+    robolog('The points and the centroids must have the same number of columns.', 'ERR');
+end
+
+if useMex && hasMex('kmeans_mex')
+    [~, idx, dist] = kmeans_mex(double(X), double(C), 0, 0, 1, [], nThreads);
+    return
+end
+
+N = size(X,1);
+idx = zeros(N, 1, 'uint32');
+dist = zeros(N, 1);
+BLOCK = max(1, floor(2^20/size(C,1))); % Points per block, bounds the distance matrix
+for n0=0:BLOCK:N-1
+    n = n0+1:min(n0+BLOCK, N);
+    d = zeros(size(C,1), numel(n));
+    for j=1:size(X,2)
+        d = d + abs(bsxfun(@minus, X(n,j).', C(:,j))).^2;
+    end
+    [dmin, idx(n)] = min(d, [], 1);
+    dist(n) = sqrt(dmin);
+end
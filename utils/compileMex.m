@@ -6,6 +6,10 @@
 %> If you have initialized your project with the _robochameleon_ script, the root folder
 %> will be retrived automatically
 %>
+%> The native kernels share the headers in utils/mexutils. Kernels using FFTW are linked
+%> against it, and the ones using OpenMP are compiled with OpenMP support. The binaries are
+%> placed in library/mexbin.
+%>
 %> @param Robochameleon root folder (optional) Default: try to retrieve it automatically
 %>
 %> @author Simone Gaiarin
@@ -20,6 +24,8 @@ function compileMex(varargin)
         end 
     end            
     fileList = getAllFiles(roboRoot);
+    % Shared headers of the native kernels and output folder of the binaries
+    mexArgs = {['-I' fullfile(roboRoot, 'utils', 'mexutils')], '-outdir', fullfile(roboRoot, 'library', 'mexbin')};
     for i=1:length(fileList)
         [~,~,ext] = fileparts(fileList{i});
         if strcmp(ext, '.c') || strcmp(ext, '.cpp')
@@ -29,10 +35,32 @@ function compileMex(varargin)
             robolog('Compiling %s', cfile{:});
             %Perform the compilation. May fail if a compiler is missing, or external libraries are missing
             try
-                mex(fileList{i});
+                flags = mexFlags(fileList{i});
+                mex(mexArgs{:}, flags{:}, fileList{i});
             catch ME
                 robolog('Failed compiling %s\nError is:\n%s', 'WRN', cfile{:}, ME.message);                
             end
         end
     end
 end
+
+%> @brief Extra compiler/linker flags required by a MEX source file
+function flags = mexFlags(fileName)
+    src = fileread(fileName);
+    flags = {};
+    % FFTW in double precision; single precision only for kernels that use both
+    % at the same time (SINGLEPREC selects one of the two at compile time)
+    if ~isempty(strfind(src, 'fftw3.h')) || ~isempty(strfind(src, 'robomex.h'))
+        flags = [flags {'-lfftw3'}];
+        if ~isempty(strfind(src, 'fftwf_')) && isempty(strfind(src, 'SINGLEPREC'))
+            flags = [flags {'-lfftw3f'}];
+        end
+    end
+    if ~isempty(strfind(src, 'robomex.h')) || ~isempty(strfind(src, 'pragma omp'))
+        if ispc
+            flags = [flags {'COMPFLAGS=$COMPFLAGS /openmp'}];
+        elseif ~ismac % Apple clang has no OpenMP runtime: build single-threaded
+            flags = [flags {'CFLAGS=$CFLAGS -fopenmp', 'LDFLAGS=$LDFLAGS -fopenmp'}];
+        end
+    end
+end
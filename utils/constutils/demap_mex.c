@@ -0,0 +1,397 @@
+/*  File:           demap_mex.c
+ *  Description:    Hard decision and max-log soft demapping of symbols.
+ *                  Native engine of hd_euclid and sd_maxlog, compiled as
+ *                  a MATLAB MEX function (see compileMex).
+ *
+ *  For every received sample y the kernel returns the nearest point of
+ *  the constellation and, for each bit k of the point labels, the
+ *  max-log LLR
+ *
+ *    LLR(k) = (min_{c: bit k = 1} |y-c|^2 - min_{c: bit k = 0} |y-c|^2)/N0
+ *
+ *  i.e. log(P(bit = 0)/P(bit = 1)) for complex Gaussian noise of power N0.
+ *
+ *  Decision regions: if the constellation is an axis-aligned uniform
+ *  grid (square/rectangular QAM, PAM) the plane around it is divided in
+ *  cells, one per point plus PAD rings of outer cells.  For each cell
+ *  and each set of points (bit k = 0, bit k = 1, all points) only the
+ *  points that can be the nearest of the set for some y in the cell are
+ *  kept: if d0 is the distance from the center of the cell to the set and
+ *  h the half diagonal of the cell, the nearest point to y is within
+ *  d0 + 2*h of the center.  A sample is then demapped by locating its
+ *  cell with two roundings and searching a few candidates, so the cost
+ *  does not grow with M.  The tables of the last constellation are kept
+ *  between calls (until "clear mex").
+ *
+ *  Other constellations, and the samples beyond the outer cells, are
+ *  demapped by exhaustive search: the distances to all the points are
+ *  computed in a vectorizable loop, then the minimum of each set is
+ *  taken.  The samples are processed in parallel.
+ */
+
+/*
+ * USAGE:
+ * [symb,dist] = demap_mex(X,c);
+ * [symb,dist,llr] = demap_mex(X,c,labels,N0);
+ * [symb,dist,llr] = demap_mex(X,c,labels,N0,nthreads);
+ *
+ * INPUT
+ * X         Received samples (real or complex, any size)
+ * c         Constellation, M points (real or complex)
+ * labels    Label of each point, integers 0..2^K-1 (K = ceil(log2(M)))
+ * N0        Noise power (default 1)
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * symb      Index (1..M) of the nearest point, numel(X)-by-1 uint16
+ * dist      Distance to the nearest point, numel(X)-by-1
+ * llr       K-by-numel(X) max-log LLRs, row k+1 is bit k of the labels
+ */
+
+#include "robomex.h"
+#include <float.h>
+
+#define PAD 2                /* rings of outer cells */
+#define MINCHUNK 4096        /* minimum samples per thread */
+
+typedef struct {
+  int M, K, nsets;           /* points, bits, sets (2*K + 1) */
+  double *cr, *ci;           /* constellation */
+  int* label;
+  int grid;                  /* axis-aligned uniform grid */
+  double xi0, xq0, di, dq;   /* first level and spacing of each axis */
+  int ni, nq;                /* cells along each axis, with the pads */
+  int* off;                  /* candidates of set s in cell n: */
+  int* idx;                  /*   idx[off[n*nsets + s] .. off[n*nsets + s + 1]-1] */
+  int* all;                  /* exhaustive search: same layout, one cell */
+  int* alloff;
+} demap_t;
+
+static demap_t demap_cache = {0};
+
+void demap_build(demap_t*);
+void demap_samples(const demap_t*,const double*,const double*,size_t,size_t,
+                   double,unsigned short*,double*,double*,double*);
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+static void demap_free(void)
+{
+  demap_t* t = &demap_cache;
+
+  free(t->cr);
+  free(t->ci);
+  free(t->label);
+  free(t->off);
+  free(t->idx);
+  free(t->all);
+  free(t->alloff);
+  memset(t,0,sizeof(demap_t));
+}
+
+
+/* Nonzero if point p belongs to set s */
+static int in_set(const demap_t* t,int p,int s)
+{
+  if (s == 2*t->K)
+    return 1;
+  return ((t->label[p] >> (s/2)) & 1) == (s & 1);
+}
+
+
+/* Sorted distinct values of v (n), returns their number, or 0 if they
+ * are not uniformly spaced (first value and spacing in *v0, *dv) */
+static int uniform_levels(const double* v,int n,double* v0,double* dv)
+{
+  double* u = (double*) malloc(sizeof(double)*n);
+  double scale = 0, tol;
+  int i, j, m = 0;
+
+  if (n < 1)
+    return 0;
+  for (i = 0; i < n; i++) {
+    u[i] = v[i];
+    if (fabs(v[i]) > scale)
+      scale = fabs(v[i]);
+  }
+  tol = 1e-9*(scale > 0 ? scale : 1);
+  /* insertion sort, M is small */
+  for (i = 1; i < n; i++) {
+    double x = u[i];
+    for (j = i; j > 0 && u[j - 1] > x; j--)
+      u[j] = u[j - 1];
+    u[j] = x;
+  }
+  for (i = 0; i < n; i++)
+    if (m == 0 || u[i] - u[m - 1] > tol)
+      u[m++] = u[i];
+  *v0 = u[0];
+  *dv = m > 1 ? (u[m - 1] - u[0])/(m - 1) : 0;
+  for (i = 1; i < m; i++)
+    if (fabs(u[i] - u[0] - i*(*dv)) > tol)
+      m = 0;
+  free(u);
+  return m;
+}
+
+
+/* Squared distances from the center of cell n to all the points */
+static double* cell_distances(const demap_t* t,int n)
+{
+  double xc = t->xi0 + (n/t->nq - PAD)*t->di;
+  double yc = t->xq0 + (n%t->nq - PAD)*t->dq;
+  double* dd = (double*) malloc(sizeof(double)*t->M);
+  int p;
+
+  for (p = 0; p < t->M; p++)
+    dd[p] = (t->cr[p] - xc)*(t->cr[p] - xc) + (t->ci[p] - yc)*(t->ci[p] - yc);
+  return dd;
+}
+
+
+/* Builds the candidate lists of the constellation of t */
+void demap_build(demap_t* t)
+{
+  int mi, mq, n, ncells, s, p, cnt;
+  int* occupied;
+  double* r2;
+  double h;
+
+  /* exhaustive search lists */
+  t->alloff = (int*) malloc(sizeof(int)*(t->nsets + 1));
+  t->all = (int*) malloc(sizeof(int)*t->M*(t->K + 1));
+  t->alloff[0] = 0;
+  for (s = 0; s < t->nsets; s++) {
+    cnt = t->alloff[s];
+    for (p = 0; p < t->M; p++)
+      if (in_set(t,p,s))
+        t->all[cnt++] = p;
+    t->alloff[s + 1] = cnt;
+  }
+
+  /* grid: mi*mq distinct points on uniform levels */
+  t->grid = 0;
+  mi = uniform_levels(t->cr,t->M,&t->xi0,&t->di);
+  mq = uniform_levels(t->ci,t->M,&t->xq0,&t->dq);
+  if (t->M < 2 || mi == 0 || mq == 0 || mi*mq != t->M)
+    return;
+  occupied = (int*) calloc(t->M,sizeof(int));
+  for (p = 0; p < t->M; p++) {
+    int a = mi > 1 ? (int) floor((t->cr[p] - t->xi0)/t->di + 0.5) : 0;
+    int b = mq > 1 ? (int) floor((t->ci[p] - t->xq0)/t->dq + 0.5) : 0;
+    if (occupied[a*mq + b]++)
+      break;
+  }
+  free(occupied);
+  if (p < t->M)
+    return;
+  if (mi == 1)
+    t->di = t->dq;
+  if (mq == 1)
+    t->dq = t->di;
+  t->grid = 1;
+  t->ni = mi + 2*PAD;
+  t->nq = mq + 2*PAD;
+  ncells = t->ni*t->nq;
+  h = 0.5*sqrt(t->di*t->di + t->dq*t->dq);
+
+  /* radius of the candidates of each set around the center of each
+   * cell, and their number */
+  r2 = (double*) malloc(sizeof(double)*ncells*t->nsets);
+  t->off = (int*) malloc(sizeof(int)*(ncells*t->nsets + 1));
+#ifdef _OPENMP
+#pragma omp parallel for private(s)
+#endif
+  for (n = 0; n < ncells; n++) {
+    double* dd = cell_distances(t,n);
+    for (s = 0; s < t->nsets; s++) {
+      double dmin = DBL_MAX, r;
+      int j, c = 0;
+      for (j = t->alloff[s]; j < t->alloff[s + 1]; j++)
+        if (dd[t->all[j]] < dmin)
+          dmin = dd[t->all[j]];
+      r = sqrt(dmin) + 2*h;
+      r2[n*t->nsets + s] = r*r*(1 + 1e-12);
+      for (j = t->alloff[s]; j < t->alloff[s + 1]; j++)
+        c += dd[t->all[j]] <= r2[n*t->nsets + s];
+      t->off[n*t->nsets + s + 1] = c;
+    }
+    free(dd);
+  }
+  t->off[0] = 0;
+  for (n = 0; n < ncells*t->nsets; n++)
+    t->off[n + 1] += t->off[n];
+
+  t->idx = (int*) malloc(sizeof(int)*(t->off[ncells*t->nsets] + 1));
+#ifdef _OPENMP
+#pragma omp parallel for private(s)
+#endif
+  for (n = 0; n < ncells; n++) {
+    double* dd = cell_distances(t,n);
+    for (s = 0; s < t->nsets; s++) {
+      int j, c = t->off[n*t->nsets + s];
+      for (j = t->alloff[s]; j < t->alloff[s + 1]; j++)
+        if (dd[t->all[j]] <= r2[n*t->nsets + s])
+          t->idx[c++] = t->all[j];
+    }
+    free(dd);
+  }
+  free(r2);
+}
+
+
+/* Demaps samples k0..k1-1; dd is a buffer of M doubles */
+void demap_samples(const demap_t* t,const double* yr,const double* yi,
+                   size_t k0,size_t k1,double N0,unsigned short* symb,
+                   double* dist,double* llr,double* dd)
+{
+  double mset[2*16 + 1];
+  const double *cr = t->cr, *ci = t->ci;
+  const int *off, *idx;
+  size_t k;
+  int s, j, p, best, M = t->M, A = 2*t->K;
+
+  for (k = k0; k < k1; k++) {
+    double xr = yr[k], xi = yi ? yi[k] : 0, d;
+    int a = -1, b = -1;
+
+    if (t->grid) {
+      a = (int) floor((xr - t->xi0)/t->di + 0.5) + PAD;
+      b = (int) floor((xi - t->xq0)/t->dq + 0.5) + PAD;
+    }
+    best = 0;
+    if (a >= 0 && a < t->ni && b >= 0 && b < t->nq) {
+      /* decision region: few candidates per set */
+      off = t->off + (size_t) (a*t->nq + b)*t->nsets;
+      idx = t->idx;
+      for (s = llr ? 0 : A; s <= A; s++) {
+        mset[s] = DBL_MAX;
+        for (j = off[s]; j < off[s + 1]; j++) {
+          p = idx[j];
+          d = (xr - cr[p])*(xr - cr[p]) + (xi - ci[p])*(xi - ci[p]);
+          if (d < mset[s]) {
+            mset[s] = d;
+            if (s == A)
+              best = p;
+          }
+        }
+      }
+    } else {
+      /* exhaustive search */
+      for (p = 0; p < M; p++)
+        dd[p] = (xr - cr[p])*(xr - cr[p]) + (xi - ci[p])*(xi - ci[p]);
+      off = t->alloff;
+      idx = t->all;
+      for (s = llr ? 0 : A; s <= A; s++) {
+        mset[s] = DBL_MAX;
+        for (j = off[s]; j < off[s + 1]; j++)
+          if (dd[idx[j]] < mset[s]) {
+            mset[s] = dd[idx[j]];
+            if (s == A)
+              best = idx[j];
+          }
+      }
+    }
+    symb[k] = (unsigned short) (best + 1);
+    dist[k] = sqrt(mset[A]);
+    if (llr)
+      for (s = 0; s < t->K; s++)
+        llr[k*t->K + s] = (mset[2*s + 1] - mset[2*s])/N0;
+  }
+}
+
+
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  demap_t* t = &demap_cache;
+  size_t n;          /* samples */
+  int M;             /* points */
+  int K;             /* bits per label */
+  int nthreads;      /* number of threads */
+  int nchunks;       /* parts of the samples */
+  int wantllr, same, p, ch;
+  double N0, *cr, *ci, *lab, *llr = NULL, *ddbuf;
+  const double *yr, *yi;
+
+  if (nrhs < 2)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 3)
+    mexErrMsgTxt("Too many output arguments.");
+  if (!mxIsDouble(prhs[0]) || !mxIsDouble(prhs[1]) || mxIsSparse(prhs[0]))
+    mexErrMsgTxt("The samples and the constellation must be full double arrays.");
+  wantllr = nlhs > 2;
+  if (wantllr && (nrhs < 3 || mxIsEmpty(prhs[2])))
+    mexErrMsgTxt("The labels are required for the LLRs.");
+
+  /* parse input arguments */
+  n = mxGetNumberOfElements(prhs[0]);
+  yr = mxGetPr(prhs[0]);
+  yi = mxIsComplex(prhs[0]) ? mxGetPi(prhs[0]) : NULL;
+  M = (int) mxGetNumberOfElements(prhs[1]);
+  if (M < 1 || M > 65535)
+    mexErrMsgTxt("The constellation must have 1 to 65535 points.");
+  for (K = 0; (1 << K) < M; K++)
+    ;
+  cr = mxGetPr(prhs[1]);
+  ci = mxIsComplex(prhs[1]) ? mxGetPi(prhs[1]) : NULL;
+  lab = nrhs > 2 && !mxIsEmpty(prhs[2]) ? mxGetPr(prhs[2]) : NULL;
+  if (lab) {
+    if (!mxIsDouble(prhs[2]) || (int) mxGetNumberOfElements(prhs[2]) != M)
+      mexErrMsgTxt("There must be one label (double) per point.");
+    for (p = 0; p < M; p++)
+      if (lab[p] < 0 || lab[p] >= (1 << K) || lab[p] != floor(lab[p]))
+        mexErrMsgTxt("The labels must be integers between 0 and 2^ceil(log2(M))-1.");
+  }
+  N0 = robomex_optional(nrhs,prhs,3,1);
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,4,0));
+
+  /* tables of the constellation, rebuilt when it changes (the hard
+   * decisions do not depend on the labels) */
+  same = t->M == M && t->cr;
+  for (p = 0; p < M && same; p++)
+    same = t->cr[p] == cr[p] && t->ci[p] == (ci ? ci[p] : 0) &&
+      (!lab || t->label[p] == (int) lab[p]);
+  if (!same) {
+    if (!t->cr)
+      mexAtExit(demap_free);
+    demap_free();
+    t->M = M;
+    t->K = K;
+    t->nsets = 2*K + 1;
+    t->cr = (double*) malloc(sizeof(double)*M);
+    t->ci = (double*) malloc(sizeof(double)*M);
+    t->label = (int*) malloc(sizeof(int)*M);
+    for (p = 0; p < M; p++) {
+      t->cr[p] = cr[p];
+      t->ci[p] = ci ? ci[p] : 0;
+      t->label[p] = lab ? (int) lab[p] : p;
+    }
+    demap_build(t);
+  }
+
+  plhs[0] = mxCreateNumericMatrix(n,1,mxUINT16_CLASS,mxREAL);
+  plhs[1] = mxCreateDoubleMatrix(n,1,mxREAL);
+  if (wantllr) {
+    plhs[2] = mxCreateDoubleMatrix(K,n,mxREAL);
+    llr = mxGetPr(plhs[2]);
+  }
+  if (n == 0)
+    return;
+
+  nchunks = (int) ((n + MINCHUNK - 1)/MINCHUNK);
+  if (nchunks > nthreads)
+    nchunks = nthreads;
+  /* distances of each chunk, allocated outside the parallel region */
+  ddbuf = (double*) robomex_malloc(sizeof(double)*M*nchunks);
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nchunks) schedule(static)
+#endif
+  for (ch = 0; ch < nchunks; ch++)
+    demap_samples(t,yr,yi,(size_t) ((double) n*ch/nchunks),
+                  (size_t) ((double) n*(ch + 1)/nchunks),N0,
+                  (unsigned short*) mxGetData(plhs[0]),mxGetPr(plhs[1]),llr,
+                  ddbuf + (size_t) ch*M);
+  FFTW_FREE(ddbuf);
+}
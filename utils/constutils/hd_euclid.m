@@ -12,14 +12,28 @@
 %> out = double(hd_euclid(X, c));
 %> @endcode
 %>
+%> The native engine (demap_mex, see compileMex) uses precomputed decision
+%> regions for square/rectangular QAM and PAM, and an exhaustive search
+%> otherwise, without the M-by-numel(X) distance matrix.
+%>
 %> @param X Data to be decided, complex symbols
 %> @param c Constellation, complex symbols (vector)
+%> @param useMex Use the native engine if compiled [Default: true]
+%> @param nThreads Number of threads of the native engine, 0 for all processors [Default: 0]
 %>
 %> retval symb Demodulated symbols [unint16]
 %> retval dist Distance of the symbols form the closest point in the reference constellation
-function [symb,dist] = hd_euclid(X, c)
+function [symb,dist] = hd_euclid(X, c, useMex, nThreads)
 % Euclidean metric hard decision digital demodulation
 
+if nargin<3, useMex = true; end
+if nargin<4, nThreads = 0; end
+
+if useMex && hasMex('demap_mex')
+    [symb,dist] = demap_mex(double(X), double(c(:)), [], [], nThreads);
+    return
+end
+
 [dist,symb] = min(abs(bsxfun(@minus,X(:).',c(:))));
 symb = uint16(symb(:));
 dist = dist(:);
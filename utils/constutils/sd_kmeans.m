@@ -1,10 +1,13 @@
-function [symb, centroids]= sd_kmeans(X,c)
+function [symb, centroids]= sd_kmeans(X,c,useMex,nThreads)
 % K-means soft decision digital demodulation
 %
 % SYMB = DD_KMEANS(X,C)
+% SYMB = DD_KMEANS(X,C,USEMEX,NTHREADS)
 %
 %   X - input constellation points
 %   C - reference constellation
+%   USEMEX - use the native engine (kmeans_mex) if compiled [Default: true]
+%   NTHREADS - threads of the native engine, 0 for all processors [Default: 0]
 %   SYMB - demodulated symbols
 %   centroids - Cluster centers
 % Robert Borkowski, rbor@fotonik.dtu.dk
@@ -12,6 +15,22 @@ function [symb, centroids]= sd_kmeans(X,c)
 % Modified by Miguel Iglesias Olmedo, miguelio@kth.se
 % v3.0, 10 October 2015
 
+if nargin<3, useMex = true; end
+if nargin<4, nThreads = 0; end
+
+if useMex && hasMex('kmeans_mex')
+    % Same Lloyd iterations, without the distance matrix. Converged when no
+    % assignment changes (as kmeans), the tolerance on the displacement is 0.
+    % Empty clusters are replaced as with 'emptyaction','singleton'
+    [centroids, symb, ~, ~, converged] = kmeans_mex(double(X(:)), double(c(:)), 15, 0, 1, [], nThreads, 1);
+    if ~converged
+        symb = hd_euclid(X,c);
+        centroids = c;
+    end
+    symb = uint16(symb(:));
+    return
+end
+
 s = warning('error','stats:kmeans:FailedToConverge'); % Change error to warning
 try
     options = struct('MaxIter',15);
@@ -0,0 +1,66 @@
+%> @file sd_maxlog.m
+%> @brief Max-log soft demapper
+%>
+%> @version 1
+
+%> @brief Max-log LLR soft demapping
+%>
+%> For each received sample X(n) and each bit k of the labels of the
+%> constellation points, computes
+%> @code
+%> llr(k+1,n) = (min |X(n)-c(bit k = 1)|^2 - min |X(n)-c(bit k = 0)|^2)/N0
+%> @endcode
+%> i.e. log(P(0)/P(1)) for complex Gaussian noise of power N0. The hard
+%> decisions of hd_euclid are returned as well.
+%>
+%> With the native engine (demap_mex, see compileMex) square/rectangular
+%> QAM and PAM constellations are demapped with precomputed decision
+%> regions, with a cost that does not grow with M. Other constellations
+%> (e.g. from constref) are searched exhaustively.
+%>
+%> __Example__
+%> @code
+%> c = constref('QAM', 64);
+%> llr = sd_maxlog(rx, c, Mapper_v1.grayLabels(c, 'QAM'), N0);
+%> @endcode
+%>
+%> @param X         Received samples, complex (any size)
+%> @param c         Constellation, complex symbols (vector)
+%> @param labels    Label of each point of c, integers 0..2^ceil(log2(M))-1 [Default: 0:M-1]
+%> @param N0        Noise power [Default: 1]
+%> @param useMex    Use the native engine if compiled [Default: true]
+%> @param nThreads  Number of threads of the native engine, 0 for all processors [Default: 0]
+%>
+%> @retval llr      LLRs, ceil(log2(M))-by-numel(X), row k+1 is bit k (LSB first)
+%> @retval symb     Demodulated symbols (index of the nearest point) [uint16]
+%> @retval dist     Distance of the symbols from the closest point
+function [llr, symb, dist] = sd_maxlog(X, c, labels, N0, useMex, nThreads)
+
+M = numel(c);
+if nargin<3 || isempty(labels), labels = 0:M-1; end
+if nargin<4 || isempty(N0), N0 = 1; end
+if nargin<5, useMex = true; end
+if nargin<6, nThreads = 0; end
+
+if useMex && hasMex('demap_mex')
+    [symb, dist, llr] = demap_mex(double(X), double(c(:)), double(labels(:)), N0, nThreads);
+    return
+end
+
+K = ceil(log2(M));
+bits = logical(bitget(repmat(labels(:), 1, K), repmat(1:K, M, 1)));
+X = X(:).';
+llr = zeros(K, numel(X));
+symb = zeros(numel(X), 1, 'uint16');
+dist = zeros(numel(X), 1);
+BLOCK = max(1, floor(2^20/M)); % Samples per block, bounds the distance matrix
+for n0=0:BLOCK:numel(X)-1
+    idx = n0+1:min(n0+BLOCK, numel(X));
+    d = abs(bsxfun(@minus, X(idx), c(:))).^2;
+    [dmin, s] = min(d, [], 1);
+    symb(idx) = s;
+    dist(idx) = sqrt(dmin);
+    for k=1:K
+        llr(k,idx) = (min(d(bits(:,k),:), [], 1) - min(d(~bits(:,k),:), [], 1))/N0;
+    end
+end
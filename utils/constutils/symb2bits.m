@@ -26,9 +26,5 @@ elseif ~strcmpi(bitorder,'msb-first')
     error('Bit order can be set to ''lsb-first'' (default) or ''msb-first''.');
 end
 
-bits = false(log2M_,numel(symb));
-for i=max(2,symb_range.min):symb_range.max
-    idx = symb==i; % Find indices for all symbols i
-    bits(:,idx) = repmat(lut(:,i),1,nnz(idx)); % Take value from the LUT
-end
+bits = lut(:,double(symb(:).')); % Take the values from the LUT
 bits_ = bits(:);
@@ -0,0 +1,88 @@
+%> @file densityHistogram.m
+%> @brief Streaming density histogram of a constellation or an eye diagram
+%>
+%> @ingroup roboUtils
+%>
+%> Counts the samples of y in a fixed grid of bins:
+%>  - constellation (period = 0): the points are (real(y), imag(y));
+%>  - eye diagram (period > 0): the points are (time within the period in
+%>    samples, real(y)), e.g. period = 2*Nss for two eyes.
+%>
+%> The counts are added to H, so a long signal can be passed in chunks
+%> (with fixed limits, and for eye diagrams the offset of each chunk in the
+%> signal) and the histogram, ready for imagesc, keeps its size. The native
+%> engine (hist2_mex, see compileMex) counts in parallel.
+%>
+%> __Example__
+%> @code
+%>   [H, xc, yc] = densityHistogram(srx, [-1.5 1.5 -1.5 1.5]);
+%>   imagesc(xc, yc, log10(H)); axis xy
+%>   % Eye diagram of a signal with Nss samples per symbol, chunk by chunk
+%>   H = [];
+%>   for k=1:nChunks
+%>       H = densityHistogram(chunk{k}, [-1 1], [2*Nss 256], H, 2*Nss, (k-1)*chunkLength);
+%>   end
+%> @endcode
+%>
+%> @param y         Samples (any size)
+%> @param lim       Limits [xmin xmax ymin ymax], [ymin ymax] for an eye diagram [Default: from y]
+%> @param nbins     Number of bins [nx ny] [Default: [256 256], [ceil(period) 256] for an eye diagram]
+%> @param H         Histogram of the previous chunks, ny-by-nx [Default: []]
+%> @param period    Period of the eye diagram in samples, 0 for a constellation [Default: 0]
+%> @param offset    Index of the first sample of y in the signal (0 for the first chunk) [Default: 0]
+%> @param useMex    Use the native engine if compiled [Default: true]
+%> @param nThreads  Number of threads of the native engine, 0 for all processors [Default: 0]
+%>
+%> @retval H        Counts, ny-by-nx
+%> @retval xc       Centers of the columns of H (samples for an eye diagram)
+%> @retval yc       Centers of the rows of H
+%>
+%> @version 1
+function [H, xc, yc] = densityHistogram(y, lim, nbins, H, period, offset, useMex, nThreads)
+
+if nargin<5 || isempty(period), period = 0; end
+if nargin<2 || isempty(lim)
+    if period > 0
+        lim = 1.1*[min(real(y(:))) max(real(y(:)))];
+    else
+        lim = 1.1*max(abs([real(y(:)); imag(y(:))]))*[-1 1 -1 1];
+    end
+end
+if nargin<3 || isempty(nbins)
+    if period > 0
+        nbins = [ceil(period) 256];
+    else
+        nbins = [256 256];
+    end
+end
+if nargin<4, H = []; end
+if nargin<6 || isempty(offset), offset = 0; end
+if nargin<7, useMex = true; end
+if nargin<8, nThreads = 0; end
+if period > 0
+    limX = [0 period];
+else
+    limX = lim(1:2);
+end
+limY = lim(end-1:end);
+
+if useMex && hasMex('hist2_mex')
+    H = hist2_mex(double(y), double(lim), double(nbins), H, period, offset, nThreads);
+else
+    if isempty(H)
+        H = zeros(nbins(2), nbins(1));
+    end
+    if period > 0
+        u = mod(offset+(0:numel(y)-1).', period);
+        v = real(y(:));
+    else
+        u = real(y(:));
+        v = imag(y(:));
+    end
+    u = floor((u-limX(1))*nbins(1)/diff(limX));
+    v = floor((v-limY(1))*nbins(2)/diff(limY));
+    in = u >= 0 & u < nbins(1) & v >= 0 & v < nbins(2);
+    H = H + accumarray([v(in) u(in)]+1, 1, [nbins(2) nbins(1)]);
+end
+xc = limX(1)+((0:nbins(1)-1)+0.5)*diff(limX)/nbins(1);
+yc = limY(1)+((0:nbins(2)-1)+0.5)*diff(limY)/nbins(2);
@@ -0,0 +1,143 @@
+/*  File:           hist2_mex.c
+ *  Description:    Two-dimensional density histograms of constellations
+ *                  and eye diagrams.  Native engine of densityHistogram,
+ *                  compiled as a MATLAB MEX function (see compileMex).
+ *
+ *  Constellation (period = 0): the points are (real(y), imag(y)).
+ *  Eye diagram (period > 0): the points are (mod(offset + n, period),
+ *  real(y(n+1))), i.e. the time within the period in samples, so that
+ *  consecutive chunks of a signal are accumulated with offset set to the
+ *  number of samples already seen.  The counts are added to the histogram
+ *  of the previous chunks: the output has a fixed size whatever the
+ *  length of the signal.  Points outside the limits, and NaNs, are not
+ *  counted.  Each thread counts a part of the samples in a histogram of
+ *  its own; the counts are integers, so the sum does not depend on the
+ *  number of threads.
+ */
+
+/*
+ * USAGE:
+ * H = hist2_mex(y,lim,nbins);
+ * H = hist2_mex(y,lim,nbins,H0,period,offset);
+ * H = hist2_mex(y,lim,nbins,H0,period,offset,nthreads);
+ *
+ * INPUT
+ * y         Samples (real or complex, any size)
+ * lim       Limits [xmin xmax ymin ymax]; for eye diagrams the x limits
+ *             are [0 period] and lim can be [ymin ymax]
+ * nbins     Number of bins [nx ny]
+ * H0        Histogram of the previous chunks, ny-by-nx (default: empty)
+ * period    Period of the eye diagram in samples, 0 for a constellation
+ *             (default 0)
+ * offset    Index of the first sample of y in the signal (default 0)
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * H         Counts, ny-by-nx (rows: y bins from ymin, columns: x bins
+ *             from xmin)
+ */
+
+#include "robomex.h"
+
+#define MINCHUNK 65536       /* minimum samples per thread */
+
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  size_t n;          /* number of samples */
+  int nx, ny;        /* bins */
+  double xmin, xmax, ymin, ymax, period, offset;
+  const double *yr, *yi, *lim;
+  double* H;
+  double* hbuf;      /* histograms of the chunks */
+  size_t k;
+  int nthreads, nchunks, ch, nlim;
+
+  if (nrhs < 3)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 1)
+    mexErrMsgTxt("Too many output arguments.");
+
+  /* parse input arguments */
+  if (!mxIsDouble(prhs[0]) || !mxIsDouble(prhs[1]) || !mxIsDouble(prhs[2]))
+    mexErrMsgTxt("The arguments must be double arrays.");
+  n = mxGetNumberOfElements(prhs[0]);
+  yr = mxGetPr(prhs[0]);
+  yi = mxIsComplex(prhs[0]) ? mxGetPi(prhs[0]) : NULL;
+  if (mxGetNumberOfElements(prhs[2]) != 2)
+    mexErrMsgTxt("The number of bins must be [nx ny].");
+  nx = (int) mxGetPr(prhs[2])[0];
+  ny = (int) mxGetPr(prhs[2])[1];
+  if (nx < 1 || ny < 1)
+    mexErrMsgTxt("The number of bins must be positive.");
+  period = robomex_optional(nrhs,prhs,4,0);
+  offset = robomex_optional(nrhs,prhs,5,0);
+  if (period < 0)
+    mexErrMsgTxt("The period must be nonnegative.");
+  nlim = (int) mxGetNumberOfElements(prhs[1]);
+  lim = mxGetPr(prhs[1]);
+  if (nlim != 4 && !(nlim == 2 && period > 0))
+    mexErrMsgTxt("The limits must be [xmin xmax ymin ymax], or [ymin ymax] for an eye diagram.");
+  xmin = period > 0 ? 0 : lim[0];
+  xmax = period > 0 ? period : lim[1];
+  ymin = lim[nlim - 2];
+  ymax = lim[nlim - 1];
+  if (!(xmax > xmin) || !(ymax > ymin))
+    mexErrMsgTxt("The upper limits must be greater than the lower ones.");
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,6,0));
+
+  plhs[0] = mxCreateDoubleMatrix(ny,nx,mxREAL);
+  H = mxGetPr(plhs[0]);
+  if (nrhs > 3 && !mxIsEmpty(prhs[3])) {
+    if ((int) mxGetM(prhs[3]) != ny || (int) mxGetN(prhs[3]) != nx || !mxIsDouble(prhs[3]))
+      mexErrMsgTxt("The histogram must be ny-by-nx.");
+    memcpy(H,mxGetPr(prhs[3]),sizeof(double)*nx*ny);
+  }
+
+  if (n == 0)
+    return;
+
+  nchunks = (int) ((n + MINCHUNK - 1)/MINCHUNK);
+  if (nchunks > nthreads)
+    nchunks = nthreads;
+  hbuf = (double*) robomex_malloc(sizeof(double)*nx*ny*nchunks);
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nchunks) schedule(static)
+#endif
+  for (ch = 0; ch < nchunks; ch++) {
+    size_t a = (size_t) ((double) n*ch/nchunks);
+    size_t b = (size_t) ((double) n*(ch + 1)/nchunks);
+    double* h = hbuf + (size_t) ch*nx*ny;
+    double sx = nx/(xmax - xmin), sy = ny/(ymax - ymin), u, v;
+    size_t i;
+    int bx, by;
+
+    memset(h,0,sizeof(double)*nx*ny);
+    for (i = a; i < b; i++) {
+      if (period > 0) {
+        u = fmod(offset + (double) i,period);
+        v = yr[i];
+      } else {
+        u = yr[i];
+        v = yi ? yi[i] : 0;
+      }
+      u = floor((u - xmin)*sx);
+      v = floor((v - ymin)*sy);
+      /* false for NaNs */
+      if (!(u >= 0 && u < nx && v >= 0 && v < ny))
+        continue;
+      bx = (int) u;
+      by = (int) v;
+      h[(size_t) bx*ny + by]++;
+    }
+  }
+
+  for (ch = 0; ch < nchunks; ch++)
+    for (k = 0; k < (size_t) nx*ny; k++)
+      H[k] += hbuf[(size_t) ch*nx*ny + k];
+  FFTW_FREE(hbuf);
+}
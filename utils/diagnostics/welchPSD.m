@@ -0,0 +1,114 @@
+%> @file welchPSD.m
+%> @brief Streaming Welch estimate of the power spectral density
+%>
+%> @ingroup roboUtils
+%>
+%> Averages the periodograms of windowed, overlapping segments of each
+%> column of X. The signal can be passed in chunks: the returned state holds
+%> the sums and the samples of the unfinished segment, so that calling the
+%> function chunk by chunk gives the estimate of the whole signal with a
+%> memory that depends on nfft only. The native engine (welch_mex, see
+%> compileMex) transforms batches of segments with cached FFTW plans, in
+%> parallel.
+%>
+%> Real signals give the one-sided PSD from 0 to Fs/2, complex signals the
+%> two-sided PSD from -Fs/2 to Fs/2 (fftshift order). The PSD is in units
+%> of X^2/Hz: multiply by Fs/nfft to get the power per bin.
+%>
+%> __Example__
+%> @code
+%>   % Whole signal
+%>   [P, f] = welchPSD(sig.get, sig.Fs, 4096);
+%>   % Chunk by chunk
+%>   state = [];
+%>   for k=1:nChunks
+%>       [P, f, state] = welchPSD(chunk{k}, Fs, 4096, [], 0.5, state);
+%>   end
+%> @endcode
+%>
+%> @param X         Signal (chunk), L-by-N, one signal per column
+%> @param Fs        Sampling frequency [Hz]
+%> @param nfft      Length of the FFTs [Default: min(2^nextpow2(L), 4096)]
+%> @param win       Window (at most nfft samples, zero padded), or its length [Default: periodic Hann of nfft samples]
+%> @param overlap   Overlap of the segments, fraction of the window [Default: 0.5]
+%> @param state     State returned for the previous chunk, empty to start a new estimate;
+%>                  nfft, win and overlap are then taken from the state [Default: []]
+%> @param useMex    Use the native engine if compiled [Default: true]
+%> @param nThreads  Number of threads of the native engine, 0 for all processors [Default: 0]
+%>
+%> @retval P        PSD, nfft/2+1-by-N (real X) or nfft-by-N (complex X) [X^2/Hz]
+%> @retval f        Frequency of each row of P [Hz]
+%> @retval state    State to pass with the next chunk
+%>
+%> @version 1
+function [P, f, state] = welchPSD(X, Fs, nfft, win, overlap, state, useMex, nThreads)
+
+if isvector(X), X = X(:); end
+if nargin<6 || isempty(state)
+    if nargin<3 || isempty(nfft), nfft = min(2^nextpow2(size(X,1)), 4096); end
+    if nargin<4 || isempty(win), win = nfft; end
+    if nargin<5 || isempty(overlap), overlap = 0.5; end
+    if isscalar(win)
+        win = 0.5-0.5*cos(2*pi*(0:win-1).'/win); % Periodic Hann
+    end
+    if numel(win) > nfft || overlap < 0 || overlap >= 1
+        robolog('The window must have at most nfft samples and the overlap be in [0, 1).', 'ERR');
+    end
+    state = struct('nfft', nfft, 'win', win(:), 'noverlap', floor(overlap*numel(win)), ...
+        'cplx', ~isreal(X), 'S', [], 'nseg', 0, 'tail', []);
+end
+if nargin<7, useMex = true; end
+if nargin<8, nThreads = 0; end
+if state.cplx
+    X = complex(double(X));
+elseif ~isreal(X)
+    robolog('The signal must stay complex between the chunks.', 'ERR');
+else
+    X = double(X);
+end
+
+nfft = state.nfft;
+win = state.win;
+W = numel(win);
+hop = W-state.noverlap;
+if state.cplx
+    nb = nfft;
+else
+    nb = floor(nfft/2)+1;
+end
+
+if useMex && hasMex('welch_mex')
+    [state.S, state.nseg, state.tail] = welch_mex(X, win, state.noverlap, nfft, ...
+        state.S, state.nseg, state.tail, nThreads);
+else
+    data = [state.tail; X];
+    nseg = max(0, floor((size(data,1)-W)/hop)+1);
+    if isempty(state.S)
+        state.S = zeros(nb, size(X,2));
+    end
+    BLOCK = max(1, floor(2^20/nfft)); % Segments per FFT, bounds the memory
+    for s0=0:BLOCK:nseg-1
+        idx = bsxfun(@plus, (1:W).', (s0:min(s0+BLOCK, nseg)-1)*hop);
+        for col=1:size(X,2)
+            x = data(:,col);
+            F = fft(bsxfun(@times, x(idx), win), nfft);
+            state.S(:,col) = state.S(:,col) + sum(abs(F(1:nb,:)).^2, 2);
+        end
+    end
+    state.nseg = state.nseg + nseg;
+    state.tail = data(nseg*hop+1:end,:);
+end
+
+% Normalization to X^2/Hz
+if state.nseg == 0
+    P = nan(nb, size(X,2));
+else
+    P = state.S/(state.nseg*Fs*sum(win.^2));
+end
+if state.cplx
+    P = fftshift(P, 1);
+    f = ((0:nfft-1).'-floor(nfft/2))*Fs/nfft;
+else
+    P(2:nb-(mod(nfft,2)==0),:) = 2*P(2:nb-(mod(nfft,2)==0),:);
+    f = (0:nb-1).'*Fs/nfft;
+end
@@ -0,0 +1,236 @@
+/*  File:           welch_mex.c
+ *  Description:    Streaming Welch power spectrum: accumulates the
+ *                  periodograms of the windowed, overlapping segments of
+ *                  a chunk of signal.  Native engine of welchPSD, compiled
+ *                  as a MATLAB MEX function (see compileMex).
+ *
+ *  The signal is consumed in chunks of any length.  The samples after
+ *  the start of the next segment (fewer than one segment) are returned
+ *  as the tail and prepended to the next chunk, so the segments are the
+ *  same as for the whole signal and the memory does not depend on its
+ *  length.  The segments of a chunk are transformed in batches of BATCH
+ *  with a batched FFTW plan from the plan cache (real-to-complex for real
+ *  signals), the batches in parallel.  The sums of |FFT|^2 are returned
+ *  unnormalized: the scaling by the window power and the sampling rate is
+ *  done by welchPSD.
+ */
+
+/*
+ * USAGE:
+ * [S,nseg,tail] = welch_mex(X,win,noverlap,nfft);
+ * [S,nseg,tail] = welch_mex(X,win,noverlap,nfft,S0,nseg0,tail0);
+ * [S,nseg,tail] = welch_mex(X,win,noverlap,nfft,S0,nseg0,tail0,nthreads);
+ * welch_mex -option
+ *
+ * INPUT
+ * X         Chunk of signal, L-by-N (one signal per column, real or
+ *             complex)
+ * win       Window, W-by-1 (W <= nfft, zero padded to nfft)
+ * noverlap  Samples shared by consecutive segments (0..W-1)
+ * nfft      Length of the FFTs
+ * S0        Sums of the previous chunks (default: empty, new estimate)
+ * nseg0     Segments of the previous chunks (default 0)
+ * tail0     Tail of the previous chunk, fewer than W rows by N (default
+ *             empty)
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * S         Sum of |fft(segment.*win,nfft)|^2, nfft/2+1-by-N for real
+ *             signals (bins 0..nfft/2), nfft-by-N for complex ones
+ * nseg      Number of segments in S
+ * tail      Samples after the start of the next segment
+ *
+ * OPTIONS (i.e. welch_mex -estimate): see plancache.h
+ */
+
+#include "robomex.h"
+#include "plancache.h"
+
+#define BATCH 16             /* segments per FFT */
+
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  size_t L;          /* samples of the chunk */
+  size_t T;          /* samples of the tail of the previous chunk */
+  int N;             /* number of columns */
+  int W;             /* segment length */
+  int hop;           /* samples between segments */
+  int nfft, nb;      /* FFT length, bins */
+  int cplx;          /* complex signal */
+  int nthreads, nbatches, col, bt, ii, tt;
+  size_t insize;     /* bytes per FFT input sample */
+  COMPLEX* outbuf = NULL;
+  char* inbuf = NULL;
+  double* accbuf = NULL;
+  size_t nseg, next, ntail;
+  const double *win, *xr, *xi, *tr, *ti;
+  double *S, *outr, *outi;
+  PLAN plan;
+
+  if (plancache_option(nrhs,prhs))
+    return;
+
+  if (nrhs < 4)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 3)
+    mexErrMsgTxt("Too many output arguments.");
+
+  plancache_begin();
+
+  /* parse input arguments */
+  if (!mxIsDouble(prhs[0]) || !mxIsDouble(prhs[1]) || mxIsComplex(prhs[1]))
+    mexErrMsgTxt("The signal must be a double matrix and the window a real double vector.");
+  L = mxGetM(prhs[0]);
+  N = (int) mxGetN(prhs[0]);
+  cplx = mxIsComplex(prhs[0]);
+  W = (int) mxGetNumberOfElements(prhs[1]);
+  win = mxGetPr(prhs[1]);
+  hop = W - (int) mxGetScalar(prhs[2]);
+  nfft = (int) mxGetScalar(prhs[3]);
+  if (W < 1 || nfft < W)
+    mexErrMsgTxt("The window must have between 1 and nfft samples.");
+  if (hop < 1 || hop > W)
+    mexErrMsgTxt("The overlap must be between 0 and the window length minus 1.");
+  nb = cplx ? nfft : nfft/2 + 1;
+
+  T = 0;
+  tr = ti = NULL;
+  if (nrhs > 6 && !mxIsEmpty(prhs[6])) {
+    T = mxGetM(prhs[6]);
+    if ((int) mxGetN(prhs[6]) != N || !mxIsDouble(prhs[6]) || T >= (size_t) W)
+      mexErrMsgTxt("The tail must be the one returned for the previous chunk.");
+    if (mxIsComplex(prhs[6]) && !cplx)
+      mexErrMsgTxt("The signal must stay complex between the chunks.");
+    tr = mxGetPr(prhs[6]);
+    ti = mxIsComplex(prhs[6]) ? mxGetPi(prhs[6]) : NULL;
+  }
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,7,0));
+
+  plhs[0] = mxCreateDoubleMatrix(nb,N,mxREAL);
+  S = mxGetPr(plhs[0]);
+  if (nrhs > 4 && !mxIsEmpty(prhs[4])) {
+    if ((int) mxGetM(prhs[4]) != nb || (int) mxGetN(prhs[4]) != N || !mxIsDouble(prhs[4]))
+      mexErrMsgTxt("The sums must be the ones returned for the previous chunk.");
+    memcpy(S,mxGetPr(prhs[4]),sizeof(double)*nb*N);
+  }
+
+  /* segments of tail0 followed by X */
+  nseg = T + L >= (size_t) W ? (T + L - W)/hop + 1 : 0;
+  next = nseg*hop;
+  ntail = T + L - next;
+  xr = mxGetPr(prhs[0]);
+  xi = cplx ? mxGetPi(prhs[0]) : NULL;
+
+  nbatches = (int) ((nseg + BATCH - 1)/BATCH);
+  if (nthreads > nbatches)
+    nthreads = nbatches > 0 ? nbatches : 1;
+  plan = nseg ? plancache_get(cplx ? PLANCACHE_FORWARD : PLANCACHE_R2C,nfft,BATCH,0) : NULL;
+
+  /* buffers of each thread, allocated here since robomex_malloc can
+   * raise a MATLAB error, which is not allowed in a parallel region */
+  insize = cplx ? sizeof(COMPLEX) : sizeof(REAL);
+  if (nseg) {
+    outbuf = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*nb*BATCH*nthreads);
+    inbuf = (char*) robomex_malloc(insize*nfft*BATCH*nthreads);
+    accbuf = (double*) robomex_malloc(sizeof(double)*nb*nthreads);
+    memset(inbuf,0,insize*nfft*BATCH*nthreads);
+  }
+
+  for (col = 0; col < N && nseg; col++) {
+    const double *cr = xr + (size_t) col*L, *ci = xi ? xi + (size_t) col*L : NULL;
+    const double *pr = tr ? tr + (size_t) col*T : NULL, *pi_ = ti ? ti + (size_t) col*T : NULL;
+    double* Scol = S + (size_t) col*nb;
+
+    memset(accbuf,0,sizeof(double)*nb*nthreads);
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nthreads)
+#endif
+    {
+      int tid, k, s, ns;
+      size_t i0, i;
+      COMPLEX* out;
+      void* in;
+      double* acc;
+
+#ifdef _OPENMP
+      tid = omp_get_thread_num();
+#else
+      tid = 0;
+#endif
+      out = outbuf + (size_t) tid*nb*BATCH;
+      in = inbuf + (size_t) tid*insize*nfft*BATCH;
+      acc = accbuf + (size_t) tid*nb;
+
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+      for (bt = 0; bt < nbatches; bt++) {
+        ns = (size_t) (bt + 1)*BATCH <= nseg ? BATCH : (int) (nseg - (size_t) bt*BATCH);
+        for (s = 0; s < ns; s++) {
+          i0 = ((size_t) bt*BATCH + s)*hop;
+          for (k = 0; k < W; k++) {
+            double re, im;
+            i = i0 + k;
+            if (i < T) {
+              re = pr[i];
+              im = pi_ ? pi_[i] : 0;
+            } else {
+              re = cr[i - T];
+              im = ci ? ci[i - T] : 0;
+            }
+            if (cplx) {
+              ((COMPLEX*) in)[(size_t) s*nfft + k][0] = (REAL) (re*win[k]);
+              ((COMPLEX*) in)[(size_t) s*nfft + k][1] = (REAL) (im*win[k]);
+            } else
+              ((REAL*) in)[(size_t) s*nfft + k] = (REAL) (re*win[k]);
+          }
+        }
+        /* the unused segments of the last batch are not accumulated */
+        if (cplx)
+          EXECUTE_DFT(plan,(COMPLEX*) in,out);
+        else
+          EXECUTE_R2C(plan,(REAL*) in,out);
+        for (s = 0; s < ns; s++)
+          for (k = 0; k < nb; k++)
+            acc[k] += abs2(&out[(size_t) s*nb + k]);
+      }
+    }
+
+    /* sums of the threads, in a fixed order */
+    for (tt = 0; tt < nthreads; tt++)
+      for (ii = 0; ii < nb; ii++)
+        Scol[ii] += accbuf[(size_t) tt*nb + ii];
+  }
+
+  if (nseg) {
+    FFTW_FREE(accbuf);
+    FFTW_FREE(inbuf);
+    FFTW_FREE(outbuf);
+  }
+
+  if (nlhs > 1)
+    plhs[1] = mxCreateDoubleScalar(robomex_optional(nrhs,prhs,5,0) + (double) nseg);
+  if (nlhs > 2) {
+    plhs[2] = mxCreateDoubleMatrix(ntail,N,cplx ? mxCOMPLEX : mxREAL);
+    outr = mxGetPr(plhs[2]);
+    outi = cplx ? mxGetPi(plhs[2]) : NULL;
+    for (col = 0; col < N; col++)
+      for (ii = 0; ii < (int) ntail; ii++) {
+        size_t i = next + ii;
+        if (i < T) {
+          outr[(size_t) col*ntail + ii] = tr[(size_t) col*T + i];
+          if (outi)
+            outi[(size_t) col*ntail + ii] = ti ? ti[(size_t) col*T + i] : 0;
+        } else {
+          outr[(size_t) col*ntail + ii] = xr[(size_t) col*L + i - T];
+          if (outi)
+            outi[(size_t) col*ntail + ii] = xi[(size_t) col*L + i - T];
+        }
+      }
+  }
+}
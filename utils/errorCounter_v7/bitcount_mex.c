@@ -0,0 +1,341 @@
+/*  File:           bitcount_mex.c
+ *  Description:    Bit-sliced error counting against a periodic
+ *                  reference sequence.  Native engine of
+ *                  error_counter_v7c, compiled as a MATLAB MEX function
+ *                  (see compileMex).
+ *
+ *  The received labels of a block are given for every de-map rotation
+ *  (one column each).  For every delay d of the reference (one period)
+ *  the number of bit errors
+ *
+ *    err(d) = sum_t popcount(ref(d+t) xor rx(t))
+ *
+ *  is counted and its minimum (and, in delay & add mode, its maximum,
+ *  i.e. inverted bits) is returned with the first delay attaining it,
+ *  like min(sumbitxor(...)) on the repeated reference.
+ *
+ *  The sequences are stored as bit planes packed in 64-bit words, so a
+ *  delay costs one shift per word and plane of the reference and one
+ *  xor/popcount per word, plane and rotation.  The reference word is
+ *  extracted once per delay for all the rotations.  The delays are
+ *  distributed over the threads.
+ *
+ *  A block continuing the previous one is aligned at the predicted
+ *  delay: if the bit error ratio of one rotation there is below
+ *  TRACK_BER (a wrong alignment of a pseudo-random sequence gives about
+ *  1/2), the search over all the delays is skipped.  All the rotations
+ *  are then counted at the predicted delay: the counts of the other
+ *  rotations are not their minimum over the delays, and are not
+ *  comparable with the ones of a search.  They are only meant to rank
+ *  the rotations (error_counter_v7c uses the best one); the fourth
+ *  output tells which case applies.
+ */
+
+/*
+ * USAGE:
+ * [err,delay,inv] = bitcount_mex(ref,nbits,rx,mode);
+ * [err,delay,inv] = bitcount_mex(ref,nbits,rx,mode,hint);
+ * [err,delay,inv] = bitcount_mex(ref,nbits,rx,mode,hint,nthreads);
+ * [err,delay,inv,tracked] = bitcount_mex(...);
+ *
+ * INPUT
+ * ref       One period of the reference.  Symbols mode: labels
+ *             0 ... 2^nbits-1.  Delay & add mode: bits (0/1)
+ * nbits     Bits per received label (log2(M))
+ * rx        Received labels 0 ... 2^nbits-1, n-by-R (one column per
+ *             de-map rotation)
+ * mode      0: delay & add, every bit of the labels (tributary) is
+ *             aligned independently to the binary reference and may be
+ *             inverted.  1: symbols, all the bits of a label share the
+ *             delay
+ * hint      Predicted delay (1-based): scalar (symbols mode) or one per
+ *             tributary (delay & add mode).  Empty or 0: none
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * err       Bit errors: 1-by-R (symbols mode) or nbits-by-R (delay &
+ *             add mode, counting the inverted tributaries as inverted)
+ * delay     Delay of the reference giving err (1-based)
+ * inv       1 if the tributary is inverted (delay & add mode)
+ * tracked   1 if the block was counted at the predicted delay (then
+ *             only the counts of the rotations aligned there, i.e. with
+ *             a bit error ratio below TRACK_BER, are at their best
+ *             delay), 0 if all the delays were searched
+ */
+
+#include "robomex.h"
+
+#define TRACK_BER 0.25   /* maximum BER to accept the predicted delay */
+
+#if defined(__GNUC__)
+#define POPCOUNT64(x) __builtin_popcountll(x)
+#else
+#define POPCOUNT64(x) popcount64(x)
+#endif
+
+typedef uint64_T word;
+
+typedef struct {
+  int P;             /* reference period (labels) */
+  int n;             /* received labels per block */
+  int R;             /* number of rotations */
+  int nbits;         /* bits per received label */
+  int nref;          /* bit planes of the reference */
+  int nslot;         /* results per rotation: 1 or nbits */
+  int nw;            /* words per plane of the block */
+  word* ref;         /* reference planes, extended to P+n labels */
+  int nwref;         /* words per reference plane */
+  word* rx;          /* received planes: rx[(r*nbits+p)*nw + w] */
+  word mask;         /* valid bits of the last word */
+} bitcount_state;
+
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+#if !defined(__GNUC__)
+static int popcount64(word x)
+{
+  x = x - ((x >> 1) & 0x5555555555555555ULL);
+  x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+  x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return (int) ((x*0x0101010101010101ULL) >> 56);
+}
+#endif
+
+
+/* Element k of a logical, uint16 or double label vector */
+static unsigned label_at(const mxArray* a,size_t k)
+{
+  switch (mxGetClassID(a)) {
+  case mxLOGICAL_CLASS:
+    return ((mxLogical*) mxGetData(a))[k] != 0;
+  case mxUINT16_CLASS:
+    return ((unsigned short*) mxGetData(a))[k];
+  case mxDOUBLE_CLASS:
+    return (unsigned) mxGetPr(a)[k];
+  default:
+    mexErrMsgTxt("Labels must be logical, uint16 or double.");
+  }
+  return 0;
+}
+
+
+/* Packs the words w0 ... w1-1 of the reference planes (the reference
+ * repeated periodically) */
+static void pack_reference(bitcount_state* s,const mxArray* a,int w0,int w1)
+{
+  int w, t, p;
+  unsigned v;
+
+  if (w1 > s->nwref)
+    w1 = s->nwref;
+  for (p = 0; p < s->nref; p++)
+    for (w = w0; w < w1; w++)
+      s->ref[p*s->nwref + w] = 0;
+  for (t = 64*w0; t < 64*w1; t++) {
+    v = label_at(a,t % s->P);
+    for (p = 0; p < s->nref; p++)
+      if ((v >> p) & 1)
+        s->ref[p*s->nwref + (t >> 6)] |= (word) 1 << (t & 63);
+  }
+}
+
+
+/* Counts the errors at delay d into cnt[r*nslot + slot] */
+static void count_delay(const bitcount_state* s,int d,int* cnt)
+{
+  int q = d >> 6, sh = d & 63, w, r, p, c;
+  const word* rp;
+  const word* xp;
+  word rw[16], m;
+
+  for (r = 0; r < s->R*s->nslot; r++)
+    cnt[r] = 0;
+  for (w = 0; w < s->nw; w++) {
+    m = w == s->nw - 1 ? s->mask : ~(word) 0;
+    /* reference word of every plane at delay d */
+    for (p = 0; p < s->nref; p++) {
+      rp = s->ref + p*s->nwref + q + w;
+      rw[p] = sh ? (rp[0] >> sh) | (rp[1] << (64 - sh)) : rp[0];
+    }
+    for (r = 0; r < s->R; r++) {
+      xp = s->rx + r*s->nbits*s->nw + w;
+      if (s->nslot == 1) {
+        c = 0;
+        for (p = 0; p < s->nbits; p++)
+          c += POPCOUNT64((rw[p] ^ xp[p*s->nw]) & m);
+        cnt[r] += c;
+      } else {
+        for (p = 0; p < s->nbits; p++)
+          cnt[r*s->nbits + p] += POPCOUNT64((rw[0] ^ xp[p*s->nw]) & m);
+      }
+    }
+  }
+}
+
+
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  bitcount_state s;
+  int mode;          /* 0: delay & add, 1: symbols */
+  int nthreads;      /* number of threads */
+  int nres;          /* number of results (R*nslot) */
+  int *bmin, *dmin, *bmax, *dmax, *cnt;
+  double *perr, *pdel, *pinv;
+  int ii, t, r, p, k, d, nb, tracked, ok, h;
+  unsigned v;
+  const double* hint;
+
+  if (nrhs < 4)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 4)
+    mexErrMsgTxt("Too many output arguments.");
+
+  /* parse input arguments */
+  s.P = (int) mxGetNumberOfElements(prhs[0]);
+  s.nbits = (int) mxGetScalar(prhs[1]);
+  s.n = (int) mxGetM(prhs[2]);
+  s.R = (int) mxGetN(prhs[2]);
+  mode = (int) mxGetScalar(prhs[3]);
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,5,0));
+  if (s.P == 0 || s.n == 0 || s.R == 0)
+    mexErrMsgTxt("Empty reference or block.");
+  if (s.nbits < 1 || s.nbits > 16)
+    mexErrMsgTxt("The number of bits per label must be between 1 and 16.");
+  s.nref = mode ? s.nbits : 1;
+  s.nslot = mode ? 1 : s.nbits;
+  nb = mode ? s.n*s.nbits : s.n;   /* bits counted per result */
+  nres = s.R*s.nslot;
+
+  /* reference planes, extended periodically to P+n+64 labels (packed
+   * when needed) */
+  s.nwref = (s.P + s.n + 64)/64 + 2;
+  s.ref = (word*) robomex_malloc(sizeof(word)*s.nref*s.nwref);
+
+  /* received planes */
+  s.nw = (s.n + 63)/64;
+  s.mask = s.n % 64 ? ((word) 1 << (s.n % 64)) - 1 : ~(word) 0;
+  s.rx = (word*) robomex_malloc(sizeof(word)*s.R*s.nbits*s.nw);
+  memset(s.rx,0,sizeof(word)*s.R*s.nbits*s.nw);
+  for (r = 0; r < s.R; r++)
+    for (t = 0; t < s.n; t++) {
+      v = label_at(prhs[2],(size_t) r*s.n + t);
+      for (p = 0; p < s.nbits; p++)
+        if ((v >> p) & 1)
+          s.rx[(r*s.nbits + p)*s.nw + (t >> 6)] |= (word) 1 << (t & 63);
+    }
+
+  bmin = (int*) mxMalloc(sizeof(int)*nres*nthreads);
+  dmin = (int*) mxMalloc(sizeof(int)*nres*nthreads);
+  bmax = (int*) mxMalloc(sizeof(int)*nres*nthreads);
+  dmax = (int*) mxMalloc(sizeof(int)*nres*nthreads);
+  cnt = (int*) mxMalloc(sizeof(int)*nres*nthreads);
+
+  /* predicted delay: accepted if one rotation is aligned in all its
+   * tributaries.  Only the reference words around it are packed. */
+  tracked = 0;
+  if (nrhs > 4 && !mxIsEmpty(prhs[4]) && mxGetScalar(prhs[4]) > 0) {
+    if ((int) mxGetNumberOfElements(prhs[4]) < s.nslot)
+      mexErrMsgTxt("One predicted delay per tributary is required.");
+    hint = mxGetPr(prhs[4]);
+    for (k = 0; k < s.nslot; k++) {
+      h = ((int) hint[k] - 1) % s.P;
+      if (h < 0)
+        h += s.P;
+      pack_reference(&s,prhs[0],h >> 6,(h >> 6) + s.nw + 1);
+      count_delay(&s,h,cnt);
+      for (r = 0; r < s.R; r++) {
+        ii = r*s.nslot + k;
+        bmin[ii] = bmax[ii] = cnt[ii];
+        dmin[ii] = dmax[ii] = h;
+      }
+    }
+    for (r = 0; r < s.R && !tracked; r++) {
+      ok = 1;
+      for (k = 0; k < s.nslot; k++) {
+        ii = r*s.nslot + k;
+        if (bmin[ii] > TRACK_BER*nb && (mode || nb - bmax[ii] > TRACK_BER*nb))
+          ok = 0;
+      }
+      tracked = ok;
+    }
+  }
+
+  if (!tracked) {
+    /* search over all the delays, the first one on ties */
+    pack_reference(&s,prhs[0],0,s.nwref);
+    for (ii = 0; ii < nres*nthreads; ii++) {
+      bmin[ii] = nb + 1;
+      bmax[ii] = -1;
+      dmin[ii] = dmax[ii] = 0;
+    }
+#ifdef _OPENMP
+#pragma omp parallel for private(t,ii) num_threads(nthreads) schedule(static)
+#endif
+    for (d = 0; d < s.P; d++) {
+#ifdef _OPENMP
+      t = omp_get_thread_num();
+#else
+      t = 0;
+#endif
+      count_delay(&s,d,cnt + t*nres);
+      for (ii = 0; ii < nres; ii++) {
+        if (cnt[t*nres + ii] < bmin[t*nres + ii]) {
+          bmin[t*nres + ii] = cnt[t*nres + ii];
+          dmin[t*nres + ii] = d;
+        }
+        if (cnt[t*nres + ii] > bmax[t*nres + ii]) {
+          bmax[t*nres + ii] = cnt[t*nres + ii];
+          dmax[t*nres + ii] = d;
+        }
+      }
+    }
+    /* merge the threads (static schedule: increasing delays) */
+    for (t = 1; t < nthreads; t++)
+      for (ii = 0; ii < nres; ii++) {
+        if (bmin[t*nres + ii] < bmin[ii]) {
+          bmin[ii] = bmin[t*nres + ii];
+          dmin[ii] = dmin[t*nres + ii];
+        }
+        if (bmax[t*nres + ii] > bmax[ii]) {
+          bmax[ii] = bmax[t*nres + ii];
+          dmax[ii] = dmax[t*nres + ii];
+        }
+      }
+  }
+
+  plhs[0] = mxCreateDoubleMatrix(s.nslot,s.R,mxREAL);
+  perr = mxGetPr(plhs[0]);
+  if (nlhs > 1) {
+    plhs[1] = mxCreateDoubleMatrix(s.nslot,s.R,mxREAL);
+    pdel = mxGetPr(plhs[1]);
+  } else {
+    pdel = NULL;
+  }
+  if (nlhs > 2) {
+    plhs[2] = mxCreateDoubleMatrix(s.nslot,s.R,mxREAL);
+    pinv = mxGetPr(plhs[2]);
+  } else {
+    pinv = NULL;
+  }
+  if (nlhs > 3)
+    plhs[3] = mxCreateDoubleScalar(tracked);
+  for (ii = 0; ii < nres; ii++) {
+    /* inverted tributary only if strictly better (like min([a b])) */
+    k = !mode && nb - bmax[ii] < bmin[ii];
+    perr[ii] = k ? nb - bmax[ii] : bmin[ii];
+    if (pdel)
+      pdel[ii] = (k ? dmax[ii] : dmin[ii]) + 1;
+    if (pinv)
+      pinv[ii] = k;
+  }
+
+  FFTW_FREE(s.ref);
+  FFTW_FREE(s.rx);
+  mxFree(bmin);
+  mxFree(dmin);
+  mxFree(bmax);
+  mxFree(dmax);
+  mxFree(cnt);
+}
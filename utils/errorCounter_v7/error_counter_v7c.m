@@ -6,6 +6,12 @@
 %> length, and each block is synchronized, mapped, and counted independently.  
 %> It is not optimized for any case in particular, and  faster algorithms 
 %> may be available.  See BERT_v1 for other options and usage example.
+%>
+%> If compiled (see compileMex), the bit errors are counted by bitcount_mex:
+%> the bits are packed in 64-bit words and counted with popcount, and all
+%> the de-map rotations are evaluated in one pass over the delays. A block
+%> is first aligned at the delay predicted by the previous one, and the
+%> search over all the delays is only done if it does not fit.
 %> 
 %> @see BERT_v1
 %> @see const_ref.m
@@ -21,6 +27,7 @@
 %> @param param.coding coding type (required) {'gray' | 'bin'} 
 %> @param param.decision_type decision type (default hard) {'hard' | 'soft'}
 %> @param param.ber_th BER threshold (throw away blocks with worse BERs than this) (default 0.1)
+%> @param param.mexEnabled Use the native counter (bitcount_mex) if compiled (default true)
 %>
 %> @retval ber bit error rate of full sequence
 %> @retval ser symbol error rate of full sequence
@@ -33,9 +40,10 @@
 %> @retval totalsymb number of symbols counted
 %> @retval ORIG_SYMBOLS symbol sequence used for counting (optional)
 %> @retval RX_SYMBOLS symbol sequence counted (optional)
+%> @retval evm error vector magnitude of the full sequence with respect to the reference constellation (hard decision only, NaN otherwise)
 %> 
 %> @author Robert Borkowski
-function [ber,ser,ber_block,ser_block,blockmap,err_bits,totalbits,err_symb,totalsymb,ORIG_SYMBOLS, RX_SYMBOLS] = error_counter_v7c(RECEIVED_DATA,REFERENCE_DATA,param)
+function [ber,ser,ber_block,ser_block,blockmap,err_bits,totalbits,err_symb,totalsymb,ORIG_SYMBOLS, RX_SYMBOLS, evm] = error_counter_v7c(RECEIVED_DATA,REFERENCE_DATA,param)
 %Note: this function operates the same as way as error_counter_v7b, but allows user-specified constellation type (see const_ref.m for options) and
 %user-specified decision type ('hard', 'soft')
 %defaults to QAM and hard decision
@@ -49,6 +57,8 @@ else decision_type='hard'; end
 
 if isfield(param, 'ber_th'), ber_th=param.ber_th;
 else ber_th=0.1; end
+if isfield(param, 'mexEnabled'), mexEnabled=param.mexEnabled;
+else mexEnabled=true; end
 % err_th_rot = (0.25/ber_th-1)/2; % Tolerance (%) for BER increase between consecutive blocks, not requiring to try all de-map permutations
 
 if nargout<10
@@ -136,6 +146,8 @@ N_tx = ceil(max(totalsymb(1),totalsymb(end))/(L_tx_s-1))+1;
 D_tx_b_rep = repmat(D_tx_b,1,N_tx);
 
 perm = nan(N_loop,1);
+useMex = mexEnabled && hasMex('bitcount_mex');
+evm_acc = 0; % Sum of the squared distances to the decided points
 
 robolog('Error counter: %d block(s), %d de-map permutation(s).',N_loop,N_demap);
 %% Error counter loop
@@ -145,9 +157,49 @@ for i=1:N_loop % For each block
     %fprintf('.');
 
     idx = idx_markers(i)+1:idx_markers(i+1); % Sliding data indices
-    rx_points = decision(RECEIVED_DATA(idx),c); % Make decision on the received signal
+    if strcmp(decision_type,'hard')
+        [rx_points,dist] = decision(RECEIVED_DATA(idx),c); % Make decision on the received signal
+        evm_acc = evm_acc + sum(dist.^2);
+    else
+        rx_points = decision(RECEIVED_DATA(idx),c); % Make decision on the received signal
+    end
 
-    if ~automap % Fixed constellation map
+    if ~automap && useMex % Fixed constellation map, native counter
+        
+        labels = demap(rx_points,:)-1; % Labels of the received symbols for every de-map
+        if i==1
+            hint = [];
+        else
+            hint = mod(delay-1+totalsymb(i-1),L_tx_s)+1; % Continue the alignment of the previous block
+        end
+        switch mode
+            case 0
+                [badbits_,delay,inverted] = bitcount_mex(D_tx_b,log2M_,labels,0,hint);
+                badbits(:,i) = sum(badbits_,1)';
+            case 1
+                [badbits_,delay] = bitcount_mex(REFERENCE_DATA-1,log2M_,labels,1,hint);
+                badbits(:,i) = badbits_';
+        end
+        
+        [~,jj] = sort(badbits(:,i)'); %#ok<TRSRT>
+        perm(i) = jj(1);
+        demap_ = demap(:,perm(i));
+        rx_symbols = demap_(rx_points); % De-map received symbols
+        rx_bits = symb2bits(rx_symbols,M); % Convert to bits
+        
+        err_bits(i) = badbits(perm(i),i);
+        delay = delay(:,perm(i));
+        switch mode
+            case 0
+                D_tx_b_ref = false(log2M_,totalsymb(i));
+                for k=1:log2M_
+                    D_tx_b_ref(k,:) = xor(inverted(k,perm(i)),D_tx_b_rep(delay(k)+(0:totalsymb(i)-1)));
+                end
+            case 1
+                D_tx_b_ref = D_tx_b_rep(:,delay+(0:totalsymb(i)-1));
+        end
+        
+    elseif ~automap % Fixed constellation map
 
         switch mode
             case 0
@@ -224,7 +276,9 @@ for i=1:N_loop % For each block
             case 1
                 D_tx_b_ref = D_tx_b_rep(:,delay+(0:totalsymb(i)-1));
         end
-        
+    end
+    
+    if ~automap
         if RETURN_REFERENCE_SEQUENCE
             [~,mp] = sort(demap_);
             ORIG_SYMBOLS(idx) = mp(bits2symb(D_tx_b_ref,M));
@@ -282,3 +336,9 @@ ber = sum(err_bits(blockmap))/sum(totalbits(blockmap));
 
 ser_block = err_symb./totalsymb;
 ser = sum(err_symb(blockmap))/sum(totalsymb(blockmap));
+
+if strcmp(decision_type,'hard')
+    evm = sqrt(evm_acc/L_rx_s);
+else
+    evm = nan;
+end
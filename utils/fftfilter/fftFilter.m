@@ -0,0 +1,35 @@
+%> @file fftFilter.m
+%> @brief Frequency-domain filtering of all the columns of a signal
+%>
+%> @ingroup roboUtils
+%>
+%> Computes ifft(fft(X).*H) for each column of X. The transfer function is
+%> given in FFT order (DC first): fold any fftshift/ifftshift into H once
+%> instead of shifting the spectrum of every column. With the native
+%> engine (fftfilter_mex, see compileMex) all the columns are transformed
+%> with one batched FFTW plan, cached for the session.
+%>
+%> __Example__
+%> @code
+%>   H = ifftshift(Hcentered);  % response defined from -Fs/2 to Fs/2
+%>   sigOut = sigIn.funCols(@(X)fftFilter(X, H));
+%> @endcode
+%>
+%> @param X         Signal, L-by-N
+%> @param H         Transfer function in FFT order, L-by-1
+%> @param useMex    Use the native engine if compiled [Default: true]
+%> @param nThreads  Number of threads of the native engine, 0 for all processors [Default: 0]
+%>
+%> @retval Y        Filtered signal, L-by-N
+%>
+%> @version 1
+function Y = fftFilter(X, H, useMex, nThreads)
+
+if nargin<3, useMex = true; end
+if nargin<4, nThreads = 0; end
+
+if useMex && hasMex('fftfilter_mex')
+    Y = fftfilter_mex(X, H(:), nThreads);
+else
+    Y = ifft(bsxfun(@times, fft(X), H(:)));
+end
@@ -0,0 +1,130 @@
+/*  File:           fftfilter_mex.c
+ *  Description:    Frequency-domain filtering of a multi-column signal,
+ *                  Y = ifft(fft(X).*H) column by column.  Native engine
+ *                  of fftFilter, compiled as a MATLAB MEX function (see
+ *                  compileMex).
+ *
+ *  All the columns are transformed with one batched in-place plan from
+ *  the plan cache, so that the plans are created once per signal size
+ *  and session.  The 1/L normalization of the inverse transform is
+ *  folded into the transfer function.  If X is real and H is conjugate
+ *  symmetric (H(k) = conj(H(L-k))) the output is real, as with MATLAB's
+ *  ifft.
+ */
+
+/*
+ * USAGE:
+ * Y = fftfilter_mex(X,H);
+ * Y = fftfilter_mex(X,H,nthreads);
+ * fftfilter_mex -option
+ *
+ * INPUT
+ * X         Input signal, L-by-N (one signal per column)
+ * H         Transfer function in FFT order (DC first), L-by-1
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * Y         Filtered signal, L-by-N
+ *
+ * OPTIONS (i.e. fftfilter_mex -estimate): see plancache.h
+ */
+
+#include "robomex.h"
+#include "plancache.h"
+
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  int L;             /* samples per column */
+  int N;             /* number of columns */
+  int nthreads;      /* number of threads */
+  int realout;       /* real input and conjugate symmetric H */
+  COMPLEX* z;        /* all the columns, contiguous */
+  COMPLEX* h;        /* transfer function scaled by 1/L */
+  PLAN pf, pb;
+  double *yr, *yi;
+  int ii, col;
+
+  if (plancache_option(nrhs,prhs))
+    return;
+
+  if (nrhs < 2)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 1)
+    mexErrMsgTxt("Too many output arguments.");
+
+  plancache_begin();
+
+  /* parse input arguments */
+  L = (int) mxGetM(prhs[0]);
+  N = (int) mxGetN(prhs[0]);
+  if ((int) mxGetNumberOfElements(prhs[1]) != L)
+    mexErrMsgTxt("The transfer function must have one element per sample.");
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,2,0));
+  if (nthreads > N)
+    nthreads = N > 0 ? N : 1;
+
+  h = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*(L > 0 ? L : 1));
+  if (L > 0)
+    robomex_get_column(h,prhs[1],0);
+  realout = !mxIsComplex(prhs[0]);
+  for (ii = 1; ii < L && realout; ii++)
+    realout = h[ii][0] == h[L - ii][0] && h[ii][1] == -h[L - ii][1];
+  if (L > 0)
+    realout = realout && h[0][1] == 0;
+  for (ii = 0; ii < L; ii++) {
+    h[ii][0] /= L;
+    h[ii][1] /= L;
+  }
+
+  plhs[0] = mxCreateDoubleMatrix(L,N,realout ? mxREAL : mxCOMPLEX);
+  if (L == 0 || N == 0) {
+    FFTW_FREE(h);
+    return;
+  }
+
+  pf = plancache_get(PLANCACHE_FORWARD, L, N, 1);
+  pb = plancache_get(PLANCACHE_BACKWARD, L, N, 1);
+  z = (COMPLEX*) robomex_malloc(sizeof(COMPLEX)*L*N);
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads)
+#endif
+  for (col = 0; col < N; col++)
+    robomex_get_column(z + (size_t) col*L,prhs[0],col);
+
+  EXECUTE_DFT(pf,z,z);
+
+#ifdef _OPENMP
+#pragma omp parallel for private(ii) num_threads(nthreads)
+#endif
+  for (col = 0; col < N; col++) {
+    COMPLEX* u = z + (size_t) col*L;
+    REAL re;
+    for (ii = 0; ii < L; ii++) {
+      re = u[ii][0]*h[ii][0] - u[ii][1]*h[ii][1];
+      u[ii][1] = u[ii][0]*h[ii][1] + u[ii][1]*h[ii][0];
+      u[ii][0] = re;
+    }
+  }
+
+  EXECUTE_DFT(pb,z,z);
+
+  yr = mxGetPr(plhs[0]);
+  yi = realout ? NULL : mxGetPi(plhs[0]);
+#ifdef _OPENMP
+#pragma omp parallel for private(ii) num_threads(nthreads)
+#endif
+  for (col = 0; col < N; col++)
+    for (ii = 0; ii < L; ii++) {
+      yr[(size_t) col*L + ii] = z[(size_t) col*L + ii][0];
+      if (yi)
+        yi[(size_t) col*L + ii] = z[(size_t) col*L + ii][1];
+    }
+
+  FFTW_FREE(z);
+  FFTW_FREE(h);
+}
@@ -9,7 +9,8 @@
 %> x=gen_prbs(n)
 %> @endcode
 %>
-%> Primitive polynomials are the ones employed by SHF.
+%> Primitive polynomials are the ones employed by SHF. The sequence is
+%> generated by prbsWindow, which also gives any part of it.
  
 %> @brief Generate PRBS sequence
 %> 
@@ -31,18 +32,7 @@ switch n
         error('Allowed lengths: 2^{7|15|23|31}-1');
 end
 
-% PRBS Generation
-z = zeros(1,2^n-1);
-z(1)=1;
-for i=(n+1):(2^n-1)
-    q=z(i-g(1));
-    for j=2:length(g)
-        q=xor(q,z(i-g(j)));
-    end
-    z(i) = q;
-end
-z = [z 0];
-z=z(:);
-x = logical(z(1:2^n-1));
+% PRBS Generation, first bit set (see prbsWindow)
+x = prbsWindow(g, 1, 0, 2^n-1);
 
 end
@@ -0,0 +1,41 @@
+%> @file hasMex.m
+%> @brief Check whether a compiled MEX kernel is available
+%>
+%> @ingroup roboUtils
+%>
+%> Units with a native engine call this function before using it and fall
+%> back to their MATLAB implementation if the kernel has not been compiled.
+%> A warning is logged in that case, once per kernel and MATLAB session
+%> (clear hasMex to log it again). The native kernels are built with
+%> compileMex. The kernels found are counted by roboProfiler (native kernel
+%> selections) when it is enabled.
+%>
+%> __Example__
+%> @code
+%>   if obj.mexEnabled && hasMex('dbp_mex')
+%>       E = dbp_mex(E, ...);
+%>   else
+%>       E = obj.backPropagate(E, ...);
+%>   end
+%> @endcode
+%>
+%> @param name      Name of the MEX function
+%>
+%> @retval tf       True if the MEX function is on the path
+%>
+%> @version 1
+function tf = hasMex(name)
+
+persistent warned
+if isempty(warned)
+    warned = containers.Map('KeyType', 'char', 'ValueType', 'logical');
+end
+
+tf = exist(name, 'file') == 3;
+if tf && roboProfiler.enabled()
+    roboProfiler.countSelection(name);
+end
+if ~tf && ~isKey(warned, name)
+    warned(name) = true;
+    robolog('%s is not compiled. Using the MATLAB implementation (run compileMex to build it).', 'WRN', name);
+end
@@ -4,13 +4,23 @@
 %> This function is faster than matlab's built-in kmeans, but has worse performance
 %> in finding the cluster centroids.
 %>
+%> With the native engine (kmeans_mex, see compileMex) the points are assigned
+%> in parallel blocks without the centers-by-points distance matrix, so that
+%> millions of received symbols can be clustered. With 'batch' the centers are
+%> updated with mini-batches of randomly drawn points instead of all of them
+%> (D. Sculley, "Web-scale k-means clustering," WWW 2010).
+%>
+%> A center without datapoints stays in place (it became NaN before the
+%> native engine was added).
+%>
 %> __Example__
 %> @code
 %>   centers = kmeans_v1(initialCenters, DataPoints);
 %>   centers = kmeans_v1(initialCenters, DataPoints, 'iterations', 50);
 %>   centers = kmeans_v1(initialCenters, DataPoints, 'iterations', 50, 'tol', 1e-5);
 %>   centers = kmeans_v1(initialCenters, DataPoints, 'iterations', 50, 'tol', 1e-5, 'gamma', 0.1);
-%>%> @endcode
+%>   [centers, idx] = kmeans_v1(initialCenters, DataPoints, 'iterations', 100, 'batch', 1e4);
+%> @endcode
 %>
 %>
 %> @author Edson Porto da Silva
@@ -24,9 +34,14 @@
 %> @param iterations Max number of allowed k-means interations. [Default: 10]
 %> @param tol Convergence tolerance, i.e., if the average delta in
 %>            the position the centers is lower than tol, the algorithm stops. [Default: 2e-3]
+%> @param batch Number of points of each mini-batch iteration, 0 to use all the points. [Default: 0]
+%> @param useMex Use the native engine if compiled. [Default: true]
+%> @param nThreads Number of threads of the native engine, 0 for all processors. [Default: 0]
 %>
 %> @retval centers Clusters centroids.
-function centers = kmeans_v1(initPosArray, symbVector, varargin)
+%> @retval idx Index of the nearest centroid of each point (with the final centroids) [uint32]
+%> @retval dist Distance of each point from its centroid
+function [centers, idx, dist] = kmeans_v1(initPosArray, symbVector, varargin)
 
 % we want row vectors:
 if size(initPosArray,2) == 1
@@ -41,6 +56,9 @@ end
 iterations = 10; % Max. number of iterations
 tol = 2e-3;      % Convergence tolerance
 gamma = 0.5;     % Adaptation step
+batch = 0;       % Mini-batch size
+useMex = true;
+nThreads = 0;
 
 % configure optional variables:
 if nargin > 2
@@ -52,32 +70,68 @@ if nargin > 2
                 iterations = varargin{argidx+1};
             case 'tol'
                 tol = varargin{argidx+1};
+            case 'batch'
+                batch = varargin{argidx+1};
+            case 'useMex'
+                useMex = varargin{argidx+1};
+            case 'nThreads'
+                nThreads = varargin{argidx+1};
         end
     end
 end
 
+% mini-batches, drawn here so that they follow the random number generator
+if batch > 0 && batch < length(symbVector)
+    batches = randi(length(symbVector), batch, iterations);
+else
+    batches = [];
+end
+
+if useMex && hasMex('kmeans_mex')
+    if nargout > 1
+        [centers, idx, dist] = kmeans_mex(double(symbVector(:)), double(initPosArray(:)), iterations, tol, gamma, batches, nThreads);
+    else
+        centers = kmeans_mex(double(symbVector(:)), double(initPosArray(:)), iterations, tol, gamma, batches, nThreads);
+    end
+    centers = centers.';
+    return
+end
+
 K_Centers = initPosArray;
 deltaK    = initPosArray;
-                                     
-d = nan(length(K_Centers), length(symbVector)); % Alocate matrix of data-centers distance.
 
 %% k-means
-for n = 1:iterations
-    
-    for ii = 1:length(K_Centers) % Calculate distances from all datapoints to each center
-         d(ii,:) = abs(K_Centers(ii)-symbVector);
+if ~isempty(batches)
+    % mini-batch: each point moves its center by 1/(points seen by the center)
+    count = zeros(size(K_Centers));
+    for n = 1:iterations
+        x = symbVector(batches(:,n));
+        ind = nearestCentroid(x(:), K_Centers(:), false);
+        K_Prev = K_Centers;
+        for m = 1:batch
+            count(ind(m)) = count(ind(m)) + 1;
+            K_Centers(ind(m)) = K_Centers(ind(m)) + (x(m)-K_Centers(ind(m)))/count(ind(m));
+        end
+        if sum(abs(K_Centers-K_Prev))/length(K_Centers) < tol
+            break;
+        end
     end
-        [~, ind] = min(d);
+else
+    for n = 1:iterations
+        ind = nearestCentroid(symbVector(:), K_Centers(:), false); % Nearest center of each datapoint
         
-    for ii = 1:length(K_Centers) 
-        deltaK(ii)    = gamma*(K_Centers(ii)-mean(symbVector(ind == ii))); % Incremental position values of each center
-        K_Centers(ii) = K_Centers(ii) - deltaK(ii);                        % Update center positions
-    end
-    
-    if sum(abs(deltaK))/length(K_Centers) < tol % Convergence test (if average position increment is less than 2e-3, stop iterations)
-        break;
+        count = accumarray(double(ind), 1, [length(K_Centers) 1]).';
+        deltaK = gamma*(K_Centers-accumarray(double(ind), symbVector(:), [length(K_Centers) 1]).'./count); % Incremental position values of each center
+        deltaK(count == 0) = 0;         % Centers without datapoints stay in place
+        K_Centers = K_Centers - deltaK; % Update center positions
+        
+        if sum(abs(deltaK))/length(K_Centers) < tol % Convergence test (if average position increment is less than 2e-3, stop iterations)
+            break;
+        end
     end
-    
 end
 centers = K_Centers;
+if nargout > 1
+    [idx, dist] = nearestCentroid(symbVector(:), centers(:), false);
+end
 end
@@ -0,0 +1,75 @@
+/*  File:           philox.h
+ *  Description:    Philox4x32-10 counter-based generator and the normal
+ *                  variates of philoxRandn, for the native kernels that
+ *                  draw their noise in place (see philox_mex.c for the
+ *                  definition of the stream).
+ *
+ *  Reference:
+ *    J. K. Salmon, M. A. Moraes, R. O. Dror and D. E. Shaw, "Parallel
+ *    random numbers: as easy as 1, 2, 3," in Proc. SC11, 2011.
+ */
+
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include "robomex.h"
+
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+#define TWO_POW_M53 1.1102230246251565e-16   /* 2^-53 */
+
+
+/* Philox4x32 with 10 rounds: out = f_key(ctr) */
+static ROBOMEX_INLINE void philox4x32(const uint32_T* ctr,const uint32_T* key,uint32_T* out)
+{
+  uint32_T c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+  uint32_T k0 = key[0], k1 = key[1];
+  uint64_T p0, p1;
+  int r;
+
+  for (r = 0; r < 10; r++) {
+    p0 = (uint64_T) PHILOX_M0*c0;
+    p1 = (uint64_T) PHILOX_M1*c2;
+    c0 = (uint32_T) (p1 >> 32) ^ c1 ^ k0;
+    c2 = (uint32_T) (p0 >> 32) ^ c3 ^ k1;
+    c1 = (uint32_T) p1;
+    c3 = (uint32_T) p0;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+
+/* Uniform variate in (0,1) from two words (53 bits) */
+static ROBOMEX_INLINE double philox_uniform(uint32_T a,uint32_T b)
+{
+  return ((double) (a >> 5)*67108864.0 + (double) (b >> 6) + 0.5)*TWO_POW_M53;
+}
+
+
+/* The two normal variates of block b of column col (g[0]: sample 2b,
+ * g[1]: sample 2b+1 of a real stream) */
+static ROBOMEX_INLINE void philox_gauss2(uint32_T b,uint32_T col,const uint32_T* key,
+                          uint32_T sub,double* g)
+{
+  uint32_T ctr[4], w[4];
+  double r, t;
+
+  ctr[0] = b;
+  ctr[1] = 0;          /* blocks beyond 2^32 are not reachable with int L */
+  ctr[2] = col;
+  ctr[3] = sub;
+  philox4x32(ctr,key,w);
+  r = sqrt(-2*log(philox_uniform(w[0],w[1])));
+  t = 2*ROBOMEX_PI*philox_uniform(w[2],w[3]);
+  g[0] = r*cos(t);
+  g[1] = r*sin(t);
+}
+
+#endif
@@ -0,0 +1,222 @@
+/*  File:           plancache.h
+ *  Description:    Session cache of FFTW plans for the robochameleon MEX
+ *                  kernels.
+ *
+ *  Plans are created once per (transform kind, length, batch size,
+ *  in-place) combination and kept for the lifetime of the MEX file, i.e.
+ *  until "clear mex" or the end of the MATLAB session.  All plans are
+ *  created on FFTW-allocated scratch buffers and must be executed with
+ *  the new-array interface (EXECUTE_DFT & co.) on buffers allocated with
+ *  robomex_malloc, which is thread safe.  Plan creation itself is not
+ *  thread safe: get all the plans before entering a parallel region.
+ *
+ *  The wisdom file is loaded on the first call, as in sspropc.  The
+ *  planner options of ssprop are supported by plancache_option:
+ *
+ *    kernel -savewisdom      (save accumulated wisdom to file)
+ *    kernel -forgetwisdom    (forget accumulated wisdom)
+ *    kernel -loadwisdom      (load wisdom from file)
+ *    kernel -clearplans      (destroy all cached plans)
+ *    kernel -estimate | -measure | -patient | -exhaustive
+ */
+
+#ifndef PLANCACHE_H
+#define PLANCACHE_H
+
+#include <stdio.h>
+#include "robomex.h"
+
+#define PLANCACHE_SIZE 64
+
+#define PLANCACHE_FORWARD  0   /* complex-to-complex, FFTW_FORWARD */
+#define PLANCACHE_BACKWARD 1   /* complex-to-complex, FFTW_BACKWARD */
+#define PLANCACHE_R2C      2   /* real-to-complex (n/2+1 outputs) */
+#define PLANCACHE_C2R      3   /* complex-to-real, destroys its input */
+
+typedef struct {
+  int kind;          /* one of the PLANCACHE_ constants */
+  int n;             /* transform length */
+  int howmany;       /* number of contiguous transforms (distance n) */
+  int inplace;       /* !=0 if planned in place */
+  unsigned stamp;    /* call in which the plan was last used */
+  PLAN plan;
+} plancache_entry;
+
+static plancache_entry plancache_entries[PLANCACHE_SIZE];
+static int plancache_count = 0;
+static unsigned plancache_stamp = 0;
+static int plancache_firstcall = 1;
+static unsigned plancache_method = FFTW_MEASURE;
+
+
+/* Destroys all the cached plans */
+static void plancache_clear(void)
+{
+  int ii;
+  for (ii = 0; ii < plancache_count; ii++)
+    if (plancache_entries[ii].plan)
+      DESTROY_PLAN(plancache_entries[ii].plan);
+  plancache_count = 0;
+}
+
+
+static void plancache_save_wisdom(void)
+{
+  FILE *wisfile;
+
+  wisfile = fopen(WISFILENAME, "w");
+  if (wisfile) {
+    mexPrintf("Exporting FFTW wisdom (file = %s).\n", WISFILENAME);
+    EXPORT_WISDOM(wisfile);
+    fclose(wisfile);
+  }
+}
+
+
+static void plancache_load_wisdom(void)
+{
+  FILE *wisfile;
+
+  wisfile = fopen(WISFILENAME, "r");
+  if (wisfile) {
+    mexPrintf("Importing FFTW wisdom (file = %s).\n", WISFILENAME);
+    IMPORT_WISDOM(wisfile);
+    fclose(wisfile);
+  }
+}
+
+
+/* Must be called at the beginning of every mexFunction call that uses
+ * the cache: loads the wisdom on the first call, registers the cleanup
+ * handler, and starts a new call stamp (plans used in the current call
+ * are never evicted). */
+static void plancache_begin(void)
+{
+  if (plancache_firstcall) {
+    plancache_load_wisdom();
+    mexAtExit(plancache_clear);
+    plancache_firstcall = 0;
+  }
+  plancache_stamp++;
+}
+
+
+/* Handles the single-string options common to all the FFTW kernels.
+ * Returns 1 if prhs[0] was an option, 0 if it is a regular call.
+ * Kernels with options of their own must check them first. */
+static int plancache_option(int nrhs, const mxArray* prhs[])
+{
+  char argstr[100];
+
+  if (nrhs != 1 || !mxIsChar(prhs[0]))
+    return 0;
+  if (mxGetString(prhs[0],argstr,100))
+    mexErrMsgTxt("Unrecognized option.");
+
+  if (!strcmp(argstr,"-savewisdom"))
+    plancache_save_wisdom();
+  else if (!strcmp(argstr,"-forgetwisdom"))
+    FORGET_WISDOM();
+  else if (!strcmp(argstr,"-loadwisdom"))
+    plancache_load_wisdom();
+  else if (!strcmp(argstr,"-clearplans"))
+    plancache_clear();
+  else if (!strcmp(argstr,"-patient"))
+    plancache_method = FFTW_PATIENT;
+  else if (!strcmp(argstr,"-exhaustive"))
+    plancache_method = FFTW_EXHAUSTIVE;
+  else if (!strcmp(argstr,"-measure"))
+    plancache_method = FFTW_MEASURE;
+  else if (!strcmp(argstr,"-estimate"))
+    plancache_method = FFTW_ESTIMATE;
+  else
+    mexErrMsgTxt("Unrecognized option.");
+  return 1;
+}
+
+
+/* Returns a plan for howmany contiguous transforms of length n.  For
+ * R2C/C2R the complex side has n/2+1 elements per transform and, when
+ * in place, the real side is padded to 2*(n/2+1) elements. */
+static PLAN plancache_get(int kind, int n, int howmany, int inplace)
+{
+  plancache_entry *e;
+  int ii, nc = n/2 + 1;
+  void *in, *out;
+  size_t inbytes, outbytes;
+
+  for (ii = 0; ii < plancache_count; ii++) {
+    e = &plancache_entries[ii];
+    if (e->kind == kind && e->n == n && e->howmany == howmany &&
+        e->inplace == inplace) {
+      e->stamp = plancache_stamp;
+      return e->plan;
+    }
+  }
+
+  /* Not cached: take a free slot, or evict the least recently used plan
+   * that is not in use by the current call */
+  if (plancache_count < PLANCACHE_SIZE)
+    e = &plancache_entries[plancache_count++];
+  else {
+    e = NULL;
+    for (ii = 0; ii < PLANCACHE_SIZE; ii++)
+      if (plancache_entries[ii].stamp != plancache_stamp &&
+          (!e || plancache_entries[ii].stamp < e->stamp))
+        e = &plancache_entries[ii];
+    if (!e)
+      mexErrMsgTxt("FFTW plan cache is full.");
+    if (e->plan)
+      DESTROY_PLAN(e->plan);
+  }
+  e->kind = -1;      /* invalid until the plan is created */
+  e->plan = NULL;
+
+  switch (kind) {
+  case PLANCACHE_R2C:
+    inbytes = sizeof(REAL)*(inplace ? 2*nc : n)*howmany;
+    outbytes = sizeof(COMPLEX)*nc*howmany;
+    break;
+  case PLANCACHE_C2R:
+    inbytes = sizeof(COMPLEX)*nc*howmany;
+    outbytes = sizeof(REAL)*(inplace ? 2*nc : n)*howmany;
+    break;
+  default:
+    inbytes = outbytes = sizeof(COMPLEX)*n*howmany;
+  }
+  in = robomex_malloc(inbytes);
+  out = inplace ? in : robomex_malloc(outbytes);
+
+  switch (kind) {
+  case PLANCACHE_R2C:
+    e->plan = PLAN_MANY_R2C(1, &n, howmany, (REAL*) in, NULL, 1,
+                            inplace ? 2*nc : n, (COMPLEX*) out, NULL, 1, nc,
+                            plancache_method);
+    break;
+  case PLANCACHE_C2R:
+    e->plan = PLAN_MANY_C2R(1, &n, howmany, (COMPLEX*) in, NULL, 1, nc,
+                            (REAL*) out, NULL, 1, inplace ? 2*nc : n,
+                            plancache_method);
+    break;
+  default:
+    e->plan = PLAN_MANY_DFT(1, &n, howmany, (COMPLEX*) in, NULL, 1, n,
+                            (COMPLEX*) out, NULL, 1, n,
+                            kind == PLANCACHE_FORWARD ? FFTW_FORWARD : FFTW_BACKWARD,
+                            plancache_method);
+  }
+
+  if (!inplace)
+    FFTW_FREE(out);
+  FFTW_FREE(in);
+  if (!e->plan)
+    mexErrMsgTxt("Could not create FFTW plan.");
+
+  e->kind = kind;
+  e->n = n;
+  e->howmany = howmany;
+  e->inplace = inplace;
+  e->stamp = plancache_stamp;
+  return e->plan;
+}
+
+#endif /* PLANCACHE_H */
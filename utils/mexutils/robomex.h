@@ -0,0 +1,166 @@
+/*  File:           robomex.h
+ *  Description:    Common definitions for the robochameleon MEX kernels:
+ *                  precision switch, complex buffer helpers, argument
+ *                  parsing and thread count selection.  The header is
+ *                  included by every native kernel; compileMex adds
+ *                  this folder to the include path.
+ *
+ *  All functions are static ROBOMEX_INLINE so that each MEX file carries its own
+ *  copy (MEX files are separate shared libraries and cannot share state)
+ *  and the kernels that do not use some of them compile without
+ *  warnings.
+ */
+
+#ifndef ROBOMEX_H
+#define ROBOMEX_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "fftw3.h"
+#include "mex.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef SINGLEPREC
+
+#define REAL float
+#define COMPLEX fftwf_complex
+#define PLAN fftwf_plan
+#define FFTW_MALLOC fftwf_malloc
+#define FFTW_FREE fftwf_free
+#define DESTROY_PLAN fftwf_destroy_plan
+#define EXECUTE_DFT fftwf_execute_dft
+#define EXECUTE_R2C fftwf_execute_dft_r2c
+#define EXECUTE_C2R fftwf_execute_dft_c2r
+#define PLAN_MANY_DFT fftwf_plan_many_dft
+#define PLAN_MANY_R2C fftwf_plan_many_dft_r2c
+#define PLAN_MANY_C2R fftwf_plan_many_dft_c2r
+#define IMPORT_WISDOM fftwf_import_wisdom_from_file
+#define EXPORT_WISDOM fftwf_export_wisdom_to_file
+#define FORGET_WISDOM fftwf_forget_wisdom
+#define WISFILENAME "fftwf-wisdom.dat"
+
+#else
+
+#define REAL double
+#define COMPLEX fftw_complex
+#define PLAN fftw_plan
+#define FFTW_MALLOC fftw_malloc
+#define FFTW_FREE fftw_free
+#define DESTROY_PLAN fftw_destroy_plan
+#define EXECUTE_DFT fftw_execute_dft
+#define EXECUTE_R2C fftw_execute_dft_r2c
+#define EXECUTE_C2R fftw_execute_dft_c2r
+#define PLAN_MANY_DFT fftw_plan_many_dft
+#define PLAN_MANY_R2C fftw_plan_many_dft_r2c
+#define PLAN_MANY_C2R fftw_plan_many_dft_c2r
+#define IMPORT_WISDOM fftw_import_wisdom_from_file
+#define EXPORT_WISDOM fftw_export_wisdom_to_file
+#define FORGET_WISDOM fftw_forget_wisdom
+#define WISFILENAME "fftw-wisdom.dat"
+
+#endif
+
+/* inline is not a keyword of C89 (MSVC, gcc -ansi) */
+#if defined(_MSC_VER)
+#define ROBOMEX_INLINE __inline
+#elif defined(__GNUC__)
+#define ROBOMEX_INLINE __inline__
+#else
+#define ROBOMEX_INLINE inline
+#endif
+
+#define abs2(x) ((*x)[0] * (*x)[0] + (*x)[1] * (*x)[1])
+#define ROBOMEX_PI 3.1415926535897932384626433832795028841972
+
+
+/* Allocates a buffer through FFTW so that every buffer has the SIMD
+ * alignment the cached plans were created with.  Errors out (and thus
+ * returns to MATLAB) if the allocation fails. */
+static ROBOMEX_INLINE void* robomex_malloc(size_t nbytes)
+{
+  void* p = FFTW_MALLOC(nbytes > 0 ? nbytes : 1);
+  if (!p)
+    mexErrMsgTxt("Out of memory.");
+  return p;
+}
+
+
+/* Copies column col of a real or complex, double or single MATLAB
+ * matrix into the complex buffer dst (nt = number of rows). */
+static ROBOMEX_INLINE void robomex_get_column(COMPLEX* dst, const mxArray* a, mwSize col)
+{
+  mwSize nt = mxGetM(a);
+  mwSize jj, off = col*nt;
+
+  if (mxIsSingle(a)) {
+    float *pr = (float*) mxGetData(a), *pi_ = (float*) mxGetImagData(a);
+    for (jj = 0; jj < nt; jj++) {
+      dst[jj][0] = (REAL) pr[off+jj];
+      dst[jj][1] = pi_ ? (REAL) pi_[off+jj] : 0;
+    }
+  } else {
+    double *pr = mxGetPr(a), *pi_ = mxGetPi(a);
+    for (jj = 0; jj < nt; jj++) {
+      dst[jj][0] = (REAL) pr[off+jj];
+      dst[jj][1] = pi_ ? (REAL) pi_[off+jj] : 0;
+    }
+  }
+}
+
+
+/* Copies the complex buffer src scaled by factor into column col of the
+ * complex double matrix a. */
+static ROBOMEX_INLINE void robomex_set_column(mxArray* a, mwSize col, COMPLEX* src, REAL factor)
+{
+  mwSize nt = mxGetM(a);
+  mwSize jj, off = col*nt;
+  double *pr = mxGetPr(a), *pi_ = mxGetPi(a);
+
+  for (jj = 0; jj < nt; jj++) {
+    pr[off+jj] = (double) (factor*src[jj][0]);
+    pi_[off+jj] = (double) (factor*src[jj][1]);
+  }
+}
+
+
+/* Returns element k of a parameter vector, or its first element if the
+ * parameter was given as a scalar (MATLAB-style scalar expansion). */
+static ROBOMEX_INLINE double robomex_elem(const mxArray* a, mwSize k)
+{
+  if (mxGetNumberOfElements(a) == 0)
+    mexErrMsgTxt("Empty parameter vector.");
+  if (k < mxGetNumberOfElements(a))
+    return mxGetPr(a)[k];
+  return mxGetPr(a)[0];
+}
+
+
+/* Returns prhs[k] as a scalar, or def if the argument is missing or
+ * empty (same convention as sspropc for optional arguments). */
+static ROBOMEX_INLINE double robomex_optional(int nrhs, const mxArray* prhs[], int k, double def)
+{
+  if (nrhs > k && !mxIsEmpty(prhs[k]))
+    return mxGetScalar(prhs[k]);
+  return def;
+}
+
+
+/* Number of worker threads to use: requested <= 0 selects all the
+ * available processors.  Always 1 when compiled without OpenMP. */
+static ROBOMEX_INLINE int robomex_nthreads(int requested)
+{
+#ifdef _OPENMP
+  if (requested <= 0)
+    return omp_get_num_procs();
+  return requested;
+#else
+  (void) requested;
+  return 1;
+#endif
+}
+
+#endif /* ROBOMEX_H */
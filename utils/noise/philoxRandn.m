@@ -0,0 +1,98 @@
+%> @file philoxRandn.m
+%> @brief Counter-based, reproducible Gaussian noise
+%>
+%> @ingroup roboUtils
+%>
+%> Generates standard normal variates with the Philox4x32-10 counter-based
+%> generator and the Box-Muller transform. Every sample is a function of
+%> its address (seed, stream, column, index) only, so that:
+%>  - the noise of a unit can be regenerated from its seed without storing it;
+%>  - independent streams are obtained by changing the stream id (e.g. one per
+%>    amplifier of a link) instead of advancing a global generator;
+%>  - the native engine (philox_mex, see compileMex) fills the samples in
+%>    parallel with results that do not depend on the number of threads.
+%>
+%> The MATLAB implementation below generates the same stream (up to the
+%> rounding of log/cos/sin) and is used when the kernel is not compiled.
+%> See philox_mex.c for the definition of the stream.
+%>
+%> __Example__
+%> @code
+%>   % ASE of span 7, regenerable from (seed, stream)
+%>   noise = sqrt(Pn/2)*philoxRandn(L, 2, seed, 7, true);
+%> @endcode
+%>
+%> __References__
+%>
+%> J. K. Salmon, M. A. Moraes, R. O. Dror and D. E. Shaw, "Parallel random
+%> numbers: as easy as 1, 2, 3," in Proc. SC11, 2011.
+%>
+%> @param L         Number of samples per column
+%> @param N         Number of columns
+%> @param seed      Seed, integer in [0, 2^32-1]
+%> @param stream    Stream [id subid], integers in [0, 2^32-1] [Default: 0]
+%> @param cplx      Complex output with unit variance per quadrature [Default: false]
+%> @param useMex    Use the native engine if compiled [Default: true]
+%> @param nThreads  Number of threads of the native engine, 0 for all processors [Default: 0]
+%>
+%> @retval X        L-by-N standard normal variates
+%>
+%> @version 1
+function X = philoxRandn(L, N, seed, stream, cplx, useMex, nThreads)
+
+if nargin<4 || isempty(stream), stream = 0; end
+if nargin<5, cplx = false; end
+if nargin<6, useMex = true; end
+if nargin<7, nThreads = 0; end
+if numel(stream)<2, stream(2) = 0; end
+if any([seed stream] < 0 | [seed stream] >= 2^32 | [seed stream] ~= fix([seed stream]))
+    robolog('Seed and stream must be integers between 0 and 2^32-1.', 'ERR');
+end
+
+if useMex && hasMex('philox_mex')
+    X = philox_mex(L, N, seed, stream, cplx, nThreads);
+    return
+end
+
+if cplx
+    nBlocks = L;
+    X = complex(zeros(L, N));
+else
+    nBlocks = ceil(L/2);
+    X = zeros(L, N);
+end
+BLOCK = 2^16; % Blocks per chunk, bounds the memory of the uint64 words
+for col=1:N
+    for b0=0:BLOCK:nBlocks-1
+        b = uint64(b0:min(b0+BLOCK, nBlocks)-1).';
+        n = numel(b);
+        ctr = [b, zeros(n,1,'uint64'), repmat(uint64([col-1 stream(2)]), n, 1)];
+        w = philox4x32(ctr, [seed stream(1)]);
+        u1 = (double(bitshift(w(:,1),-5))*2^26 + double(bitshift(w(:,2),-6)) + 0.5)*2^-53;
+        u2 = (double(bitshift(w(:,3),-5))*2^26 + double(bitshift(w(:,4),-6)) + 0.5)*2^-53;
+        r = sqrt(-2*log(u1));
+        t = 2*pi*u2;
+        if cplx
+            X(b0+(1:n),col) = complex(r.*cos(t), r.*sin(t));
+        else
+            g = [r.*cos(t) r.*sin(t)].';
+            idx = 2*b0+1:min(2*(b0+n), L);
+            X(idx,col) = g(1:numel(idx));
+        end
+    end
+end
+end
+
+%> @brief Philox4x32-10 bijection of the rows of ctr (n-by-4 uint64 holding 32-bit words)
+function ctr = philox4x32(ctr, key)
+M = uint64([3528531795 3449720151]);   % 0xD2511F53 0xCD9E8D57
+W = [2654435769 3144134277];           % 0x9E3779B9 0xBB67AE85
+MASK = uint64(4294967295);
+for r=1:10
+    p0 = M(1)*ctr(:,1);
+    p1 = M(2)*ctr(:,3);
+    ctr = [bitxor(bitxor(bitshift(p1,-32), ctr(:,2)), uint64(key(1))), bitand(p1, MASK), ...
+           bitxor(bitxor(bitshift(p0,-32), ctr(:,4)), uint64(key(2))), bitand(p0, MASK)];
+    key = mod(key + W, 2^32);
+end
+end
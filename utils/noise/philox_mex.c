@@ -0,0 +1,105 @@
+/*  File:           philox_mex.c
+ *  Description:    Counter-based Gaussian noise generator (Philox4x32-10
+ *                  and Box-Muller).  Native engine of philoxRandn,
+ *                  compiled as a MATLAB MEX function (see compileMex).
+ *
+ *  Reference:
+ *    J. K. Salmon, M. A. Moraes, R. O. Dror and D. E. Shaw, "Parallel
+ *    random numbers: as easy as 1, 2, 3," in Proc. SC11, 2011.
+ *
+ *  Block b of column c is the Philox4x32-10 bijection of the counter
+ *
+ *    ctr = [b, 0, c, stream(2)]
+ *
+ *  with the key [seed, stream(1)].  The second word is reserved for
+ *  blocks beyond 2^32, which an int number of samples cannot reach.  Its four 32-bit words give two
+ *  uniform variates of 53 bits in (0,1), u1 = (w0>>5, w1>>6) and
+ *  u2 = (w2>>5, w3>>6), transformed into two normal variates
+ *
+ *    g1 = sqrt(-2*log(u1))*cos(2*pi*u2),  g2 = sqrt(-2*log(u1))*sin(2*pi*u2)
+ *
+ *  that make sample b of a complex output (g1 + 1j*g2), or samples 2b
+ *  and 2b+1 of a real output.  Every sample depends only on its
+ *  address, so the blocks are computed in parallel and the output does
+ *  not depend on the number of threads, and any part of a stream can be
+ *  regenerated.  philoxRandn implements the same generator in MATLAB.
+ */
+
+/*
+ * USAGE:
+ * X = philox_mex(L,N,seed,stream,cplx);
+ * X = philox_mex(L,N,seed,stream,cplx,nthreads);
+ *
+ * INPUT
+ * L         Number of samples per column
+ * N         Number of columns
+ * seed      Seed (integer, 0..2^32-1)
+ * stream    Stream [id subid] (integers, 0..2^32-1)
+ * cplx      Complex output (unit variance per quadrature) if nonzero
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * X         L-by-N standard normal variates
+ */
+
+#include "robomex.h"
+#include "philox.h"
+
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  int L;             /* samples per column */
+  int N;             /* number of columns */
+  int cplx;          /* complex output */
+  int nthreads;      /* number of threads */
+  int nblocks;       /* Philox blocks per column */
+  uint32_T key[2], sub;
+  double *xr, *xi;
+  int b, col;
+
+  if (nrhs < 5)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 1)
+    mexErrMsgTxt("Too many output arguments.");
+
+  /* parse input arguments */
+  L = (int) mxGetScalar(prhs[0]);
+  N = (int) mxGetScalar(prhs[1]);
+  if (L < 0 || N < 0)
+    mexErrMsgTxt("The size must be nonnegative.");
+  key[0] = (uint32_T) mxGetScalar(prhs[2]);
+  key[1] = (uint32_T) robomex_elem(prhs[3],0);
+  sub = mxGetNumberOfElements(prhs[3]) > 1 ? (uint32_T) robomex_elem(prhs[3],1) : 0;
+  cplx = mxGetScalar(prhs[4]) != 0;
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,5,0));
+
+  plhs[0] = mxCreateDoubleMatrix(L,N,cplx ? mxCOMPLEX : mxREAL);
+  xr = mxGetPr(plhs[0]);
+  xi = cplx ? mxGetPi(plhs[0]) : NULL;
+  nblocks = cplx ? L : (L + 1)/2;
+
+  for (col = 0; col < N; col++) {
+    double* yr = xr + (size_t) col*L;
+    double* yi = cplx ? xi + (size_t) col*L : NULL;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+#endif
+    for (b = 0; b < nblocks; b++) {
+      double g[2];
+
+      philox_gauss2((uint32_T) b,(uint32_T) col,key,sub,g);
+      if (cplx) {
+        yr[b] = g[0];
+        yi[b] = g[1];
+      } else {
+        yr[2*b] = g[0];
+        if (2*b + 1 < L)
+          yr[2*b + 1] = g[1];
+      }
+    }
+  }
+}
@@ -63,8 +63,9 @@ if (Nss>1)
     else
         subplot(4,3,[1 2 3])
     end
-    [ f, spectrum ] = spectra(y, Fs, 0);
-    s = 10*log10(spectrum.*conj(spectrum)*1e3);
+    nfft = min(2^nextpow2(length(y)), 2^13);
+    [P, f] = welchPSD(y, Fs, nfft);
+    s = 10*log10(P*Fs/nfft*1e3); % Power per bin
     sm = smooth(s,length(s)/100);
     adj = max(s)-max(sm);
     BW = find(sm>max(sm(10:end))-3);
@@ -75,7 +76,7 @@ if (Nss>1)
     gridxy(BW*1e-9, (max(sm)-3), 'LineStyle', '--', 'color', [1 1 1]./1.5)
     hold off
     ylim([mean(s) max(s(100:end))])
-    xlim([0 Fs/2*1e-9])
+    xlim([f(1) f(end)]*1e-9)
     grid on
     ylabel('dBm')
     xlabel('GHz')
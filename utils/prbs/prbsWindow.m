@@ -0,0 +1,98 @@
+%> @file prbsWindow.m
+%> @brief Window of a PRBS, without the bits before it
+%>
+%> @ingroup roboUtils
+%>
+%> Generates the bits start..start+len-1 (counted from 0) of the PRBS
+%>
+%>   x(i) = xor(x(i-taps(1)), x(i-taps(2)), ...),  i >= order
+%>
+%> whose first order bits are the bits of the seed, LSB first (as
+%> de2bi(seed, order)). The state of the register at the start of the
+%> window is obtained with the jump-ahead matrix A^start over GF(2), so the
+%> memory and time depend on the window only: any part of a PRBS31, or a
+%> long pattern, is generated on demand. The native engine (prbs_mex, see
+%> compileMex) produces 64 bits per word, the MATLAB implementation below
+%> the same bits in blocks.
+%>
+%> __Example__
+%> @code
+%>   % Full PRBS15 of gen_prbs
+%>   x = prbsWindow(15, 1, 0, 2^15-1);
+%>   % 1e6 bits of a PRBS31, 2^40 bits after the start, one column per seed
+%>   X = prbsWindow([31 28], [1 12345], 2^40, 1e6);
+%> @endcode
+%>
+%> @param taps      Taps of the feedback polynomial, e.g. [31 28], or the order only
+%>                  (polynomial of OrthogonalCodeGenerator_v1.PNgenpoly)
+%> @param seeds     Seeds, one column per seed, integers in [0, 2^order-1]
+%> @param start     First bit of the window [Default: 0]
+%> @param len       Number of bits of the window
+%> @param useMex    Use the native engine if compiled [Default: true]
+%> @param nThreads  Number of threads of the native engine, 0 for all processors [Default: 0]
+%>
+%> @retval X        len-by-numel(seeds) logical
+%>
+%> @version 1
+function X = prbsWindow(taps, seeds, start, len, useMex, nThreads)
+
+if isempty(start), start = 0; end
+if nargin<5, useMex = true; end
+if nargin<6, nThreads = 0; end
+if isscalar(taps)
+    taps = OrthogonalCodeGenerator_v1.PNgenpoly(taps);
+end
+taps = sort(taps(taps > 0), 'descend');
+order = taps(1);
+if order > 53 || any(taps ~= fix(taps)) || any(diff(taps) == 0)
+    robolog('The taps must be distinct integers, with an order up to 53.', 'ERR');
+end
+if any(seeds < 0 | seeds >= 2^order | seeds ~= fix(seeds))
+    robolog('The seeds must be integers between 0 and 2^%d-1.', 'ERR', order);
+end
+if start < 0 || start ~= fix(start) || start >= 2^53
+    robolog('The start must be an integer between 0 and 2^53-1.', 'ERR');
+end
+
+if useMex && hasMex('prbs_mex')
+    X = prbs_mex(double(taps), double(seeds(:)), start, len, nThreads);
+    return
+end
+
+% State s(t) = x(t..t+order-1) at the start of the window: s(t) = A^t*s(0)
+A = [zeros(order-1,1) eye(order-1); zeros(1,order)];
+A(order, order+1-taps) = 1;
+P = eye(order);
+Ak = A;
+t = start;
+while t > 0
+    if mod(t, 2)
+        P = mod(Ak*P, 2);
+    end
+    t = floor(t/2);
+    Ak = mod(Ak*Ak, 2);
+end
+
+% Squaring the polynomial doubles the taps: x(i) = xor(x(i-2*taps)) holds
+% for i >= 2*order, so the blocks grow with the generated part
+BLOCK = 2^20;
+X = false(len, numel(seeds));
+for col=1:numel(seeds)
+    x = false(max(len, order), 1);
+    x(1:order) = mod(P*bitget(seeds(col), 1:order).', 2);
+    lag = taps;
+    n = order;
+    while n < len
+        if n >= 2*lag(1) && lag(end) < BLOCK
+            lag = 2*lag;
+        end
+        idx = n+1:min(n+lag(end), len);
+        v = x(idx-lag(1));
+        for j=2:numel(lag)
+            v = xor(v, x(idx-lag(j)));
+        end
+        x(idx) = v;
+        n = idx(end);
+    end
+    X(:,col) = x(1:len);
+end
@@ -0,0 +1,266 @@
+/*  File:           prbs_mex.c
+ *  Description:    Window of a PRBS (linear feedback shift register
+ *                  sequence).  Native engine of prbsWindow, compiled as a
+ *                  MATLAB MEX function (see compileMex).
+ *
+ *  The sequence with taps g(1) > g(2) > ... (g(1) is the order n) is
+ *
+ *    x(i) = x(i-g(1)) xor x(i-g(2)) xor ...,  i >= n
+ *
+ *  with x(0..n-1) the bits of the seed (bit k of the seed is x(k)).  The
+ *  window x(start..start+len-1) is generated without the bits before it:
+ *
+ *  - jump-ahead: the state s(t) = x(t..t+n-1) is a linear function of
+ *    the seed over GF(2), s(t) = A^t*s(0), and A^t is computed with
+ *    O(log t) products of n-by-n bit matrices;
+ *  - 64 bits per word: squaring the feedback polynomial (over GF(2))
+ *    gives the same recurrence with all the taps scaled by 2^k.  With
+ *    2^k*g(end) >= 64 a whole word of the sequence is the xor of words
+ *    read at the scaled taps, all of them already computed.  The first
+ *    2^k*n bits of a window are generated bit by bit from the state.
+ *
+ *  The window is split among the threads, each one jumping to the start
+ *  of its part, so the output does not depend on the number of threads.
+ */
+
+/*
+ * USAGE:
+ * X = prbs_mex(taps,seeds,start,len);
+ * X = prbs_mex(taps,seeds,start,len,nthreads);
+ *
+ * INPUT
+ * taps      Taps of the feedback polynomial, descending, taps(1) is the
+ *             order (2..53), e.g. [31 28] for PRBS31
+ * seeds     Seeds, one sequence per seed (integers, 0..2^order-1)
+ * start     Position of the first bit of the window (integer >= 0)
+ * len       Number of bits of the window
+ * nthreads  Number of threads (default 0, i.e. all processors)
+ *
+ * OUTPUT
+ * X         len-by-numel(seeds) logical
+ */
+
+#include "robomex.h"
+
+#define MAXORDER 53          /* seeds are doubles */
+#define BLOCKWORDS 4096      /* words unpacked at a time */
+#define MINCHUNK 65536       /* minimum bits per thread */
+
+typedef struct {
+  int order;                 /* n */
+  uint64_T tapmask;          /* bits n-g(j) of the state */
+  int ntaps;
+  int lag[MAXORDER];         /* taps scaled by 2^k, 2^k*g(end) >= 64 */
+  int histwords;             /* words generated bit by bit */
+} lfsr_t;
+
+static mxLogical unpack8[256][8];   /* bits of each byte, LSB first */
+
+void lfsr_jump(const lfsr_t*,uint64_T*,uint64_T);
+void lfsr_window(const lfsr_t*,uint64_T,uint64_T*,mxLogical*,size_t);
+void mexFunction(int, mxArray* [], int, const mxArray* []);
+
+
+/* Bit matrix (columns) times vector over GF(2) */
+static uint64_T gf2_mulvec(const uint64_T* A,uint64_T s,int n)
+{
+  uint64_T y = 0;
+  int k;
+
+  for (k = 0; k < n; k++)
+    if ((s >> k) & 1)
+      y ^= A[k];
+  return y;
+}
+
+
+/* Parity of the bits of s */
+static int parity64(uint64_T s)
+{
+  s ^= s >> 32;
+  s ^= s >> 16;
+  s ^= s >> 8;
+  s ^= s >> 4;
+  s ^= s >> 2;
+  s ^= s >> 1;
+  return (int) (s & 1);
+}
+
+
+/* One step of the register: s(t) -> s(t+1) */
+static uint64_T lfsr_step(const lfsr_t* r,uint64_T s)
+{
+  return (s >> 1) | ((uint64_T) parity64(s & r->tapmask) << (r->order - 1));
+}
+
+
+/* Replaces the state s(0) with s(t) */
+void lfsr_jump(const lfsr_t* r,uint64_T* s,uint64_T t)
+{
+  uint64_T P[MAXORDER], Q[MAXORDER];
+  int n = r->order, k;
+
+  /* P = A, column k is the step of the unit vector k */
+  for (k = 0; k < n; k++)
+    P[k] = lfsr_step(r,(uint64_T) 1 << k);
+  while (t) {
+    if (t & 1)
+      *s = gf2_mulvec(P,*s,n);
+    t >>= 1;
+    if (t) {
+      for (k = 0; k < n; k++)
+        Q[k] = gf2_mulvec(P,P[k],n);
+      memcpy(P,Q,sizeof(uint64_T)*n);
+    }
+  }
+}
+
+
+/* 64 bits of buf starting at bit off */
+static uint64_T read_bits(const uint64_T* buf,size_t off)
+{
+  size_t w = off >> 6;
+  int b = (int) (off & 63);
+
+  return b ? (buf[w] >> b) | (buf[w + 1] << (64 - b)) : buf[w];
+}
+
+
+/* First len bits of the sequence of initial state s into out, using buf
+ * (histwords + BLOCKWORDS words) */
+void lfsr_window(const lfsr_t* r,uint64_T s,uint64_T* buf,
+                 mxLogical* out,size_t len)
+{
+  size_t done = 0, nbits, i;
+  int H = r->histwords, w, j, b, nw;
+  uint64_T word;
+
+  /* first words bit by bit */
+  for (w = 0; w < H; w++) {
+    word = 0;
+    for (b = 0; b < 64; b++) {
+      word |= (s & 1) << b;
+      s = lfsr_step(r,s);
+    }
+    buf[w] = word;
+  }
+  nw = H;
+
+  while (done < len) {
+    /* unpack the words nw0..nw-1 of the buffer (the history the first time) */
+    int nw0 = done ? H : 0;
+    nbits = (size_t) (nw - nw0)*64;
+    if (nbits > len - done)
+      nbits = len - done;
+    for (i = 0; i + 8 <= nbits; i += 8)
+      memcpy(out + done + i,unpack8[(buf[nw0 + (i >> 6)] >> (i & 63)) & 255],8);
+    for (; i < nbits; i++)
+      out[done + i] = (mxLogical) ((buf[nw0 + (i >> 6)] >> (i & 63)) & 1);
+    done += nbits;
+    if (done >= len)
+      break;
+
+    /* keep the last H words as history and compute the next block */
+    if (done > (size_t) H*64) {
+      memmove(buf,buf + nw - H,sizeof(uint64_T)*H);
+      nw = H;
+    }
+    for (w = nw; w < H + BLOCKWORDS; w++) {
+      word = 0;
+      for (j = 0; j < r->ntaps; j++)
+        word ^= read_bits(buf,(size_t) w*64 - r->lag[j]);
+      buf[w] = word;
+    }
+    nw = H + BLOCKWORDS;
+  }
+}
+
+
+void mexFunction(int nlhs, mxArray *plhs[],
+                 int nrhs, const mxArray *prhs[])
+{
+  lfsr_t r;
+  int nseeds;        /* number of sequences */
+  int nthreads;      /* number of threads */
+  int nchunks;       /* parts of the window */
+  size_t len;        /* bits of the window */
+  uint64_T start;    /* first bit of the window */
+  uint64_T* bufs;    /* window buffers of the chunks */
+  double *taps, v;
+  mxLogical* X;
+  int j, scale, col, ch, b;
+
+  if (nrhs < 4)
+    mexErrMsgTxt("Not enough input arguments provided.");
+  if (nlhs > 1)
+    mexErrMsgTxt("Too many output arguments.");
+
+  /* parse input arguments */
+  r.ntaps = (int) mxGetNumberOfElements(prhs[0]);
+  if (r.ntaps < 1 || r.ntaps > MAXORDER || !mxIsDouble(prhs[0]))
+    mexErrMsgTxt("The taps must be a double vector.");
+  taps = mxGetPr(prhs[0]);
+  r.order = (int) taps[0];
+  if (r.order < 2 || r.order > MAXORDER)
+    mexErrMsgTxt("The order must be between 2 and 53.");
+  r.tapmask = 0;
+  for (j = 0; j < r.ntaps; j++) {
+    if (taps[j] != floor(taps[j]) || taps[j] < 1 || (j > 0 && taps[j] >= taps[j - 1]))
+      mexErrMsgTxt("The taps must be positive integers in descending order.");
+    r.tapmask |= (uint64_T) 1 << (r.order - (int) taps[j]);
+  }
+  /* scaled taps: 2^k*g(end) >= 64 */
+  for (scale = 1; scale*taps[r.ntaps - 1] < 64; scale *= 2)
+    ;
+  for (j = 0; j < r.ntaps; j++)
+    r.lag[j] = scale*(int) taps[j];
+  r.histwords = (r.lag[0] + 63)/64;
+
+  nseeds = (int) mxGetNumberOfElements(prhs[1]);
+  if (nseeds > 0 && !mxIsDouble(prhs[1]))
+    mexErrMsgTxt("The seeds must be doubles.");
+  for (col = 0; col < nseeds; col++) {
+    v = mxGetPr(prhs[1])[col];
+    if (v < 0 || v != floor(v) || v >= ldexp(1.0,r.order))
+      mexErrMsgTxt("The seeds must be integers between 0 and 2^order-1.");
+  }
+  v = mxGetScalar(prhs[2]);
+  if (v < 0 || v != floor(v))
+    mexErrMsgTxt("The start must be a nonnegative integer.");
+  start = (uint64_T) v;
+  v = mxGetScalar(prhs[3]);
+  len = v > 0 ? (size_t) v : 0;
+  nthreads = robomex_nthreads((int) robomex_optional(nrhs,prhs,4,0));
+
+  plhs[0] = mxCreateLogicalMatrix(len,nseeds);
+  if (len == 0 || nseeds == 0)
+    return;
+  X = mxGetLogicals(plhs[0]);
+  for (j = 0; j < 256; j++)
+    for (b = 0; b < 8; b++)
+      unpack8[j][b] = (mxLogical) ((j >> b) & 1);
+
+  nchunks = (int) ((len + MINCHUNK - 1)/MINCHUNK);
+  if (nchunks > nthreads)
+    nchunks = nthreads;
+  /* window buffers of the chunks, allocated outside the parallel region */
+  bufs = (uint64_T*) robomex_malloc(sizeof(uint64_T)*(r.histwords + BLOCKWORDS)*nchunks);
+
+  for (col = 0; col < nseeds; col++) {
+    uint64_T seed = (uint64_T) mxGetPr(prhs[1])[col];
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(nchunks) schedule(static)
+#endif
+    for (ch = 0; ch < nchunks; ch++) {
+      size_t a = (size_t) ((double) len*ch/nchunks);
+      size_t b = (size_t) ((double) len*(ch + 1)/nchunks);
+      uint64_T s = seed;
+      uint64_T* buf = bufs + (size_t) ch*(r.histwords + BLOCKWORDS);
+
+      lfsr_jump(&r,&s,start + a);
+      lfsr_window(&r,s,buf,X + (size_t) col*len + a,b - a);
+    }
+  }
+  FFTW_FREE(bufs);
+}
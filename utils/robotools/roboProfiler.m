@@ -0,0 +1,334 @@
+%>@file roboProfiler.m
+%>@brief Traverse profiler class definition
+%>
+%>@class roboProfiler
+%>@brief Records where the time and the memory go in a setup
+%>
+%> @ingroup roboUtils
+%>
+%> When enabled, every traverse of a unit or a module records:
+%>  - the wall time, and the time spent in the unit itself (self time, i.e.
+%>    without the units of a module);
+%>  - the CPU time of the MATLAB process (all threads);
+%>  - the bytes of the input and output signals;
+%>  - the peak memory: the increase of the resident memory of the process
+%>    above its value at the start of the traverse (Linux: exact peak, the
+%>    peak counter of the process is reset at each traverse; Windows:
+%>    largest value seen at the start and end of the traverses);
+%>  - the number of selections of each native kernel, i.e. of hasMex
+%>    checks that found it compiled (a unit calling a kernel several
+%>    times after one check counts one selection).
+%> The traverses are aggregated by their path in the graph
+%> (setup;module;unit, made of the labels, or the classes of the units
+%> without label), across the modules and the calls.
+%>
+%> When disabled, the cost is one check of a persistent flag per traverse.
+%> The profiler is enabled by start, or for all the sessions by the
+%> preference robochameleon.profile (read on the first traverse). Units
+%> traversed on the workers of a parallel module (see module.maxInFlight)
+%> are not recorded.
+%>
+%> __Example__
+%> @code
+%>   roboProfiler.start();
+%>   setup.traverse(sig);
+%>   roboProfiler.report();                       % table sorted by self time
+%>   roboProfiler.exportFolded('setup.folded');   % flamegraph.pl, speedscope
+%>   roboProfiler.exportJSON('setup.json');       % summary
+%>   roboProfiler.stop();
+%> @endcode
+%>
+%> @see unit::processInputs, module::traverse
+%>
+%> @version 1
+classdef roboProfiler < handle
+
+    properties (SetAccess=private)
+        %> Aggregated traverses, struct array with fields path, class,
+        %> calls, wall, self, cpu, inBytes, outBytes, peakBytes,
+        %> kernelSelections
+        entries;
+    end
+
+    properties (Access=private)
+        %> Traverses in progress
+        stack = {};
+        %> Index of each path in entries
+        index;
+        %> The peak counter of the process can be reset (Linux)
+        resetPeak;
+    end
+
+    methods (Access=private)
+
+        function obj = roboProfiler()
+            obj.clearEntries();
+            obj.resetPeak = exist('/proc/self/clear_refs', 'file') == 2;
+        end
+
+        function clearEntries(obj)
+            obj.entries = struct('path', {}, 'class', {}, 'calls', {}, 'wall', {}, 'self', {}, 'cpu', {}, ...
+                'inBytes', {}, 'outBytes', {}, 'peakBytes', {}, 'kernelSelections', {});
+            obj.index = containers.Map();
+        end
+
+        %> @brief Resident memory [current peak] of the process in bytes
+        function m = memoryBytes(obj)
+            m = [NaN NaN];
+            if obj.resetPeak
+                txt = fileread('/proc/self/status');
+                rss = regexp(txt, 'VmRSS:\s*(\d+)', 'tokens', 'once');
+                hwm = regexp(txt, 'VmHWM:\s*(\d+)', 'tokens', 'once');
+                if ~isempty(rss) && ~isempty(hwm)
+                    m = 1024*[str2double(rss{1}) str2double(hwm{1})];
+                end
+            elseif ispc
+                u = memory;
+                m = [u.MemUsedMATLAB u.MemUsedMATLAB];
+            end
+        end
+
+        %> @brief Restart the peak memory counter of the process at the current value
+        function restartPeak(obj)
+            if obj.resetPeak
+                fid = fopen('/proc/self/clear_refs', 'w');
+                if fid < 0
+                    obj.resetPeak = false;
+                    return
+                end
+                fprintf(fid, '5');
+                fclose(fid);
+            end
+        end
+
+        %> @brief Add a finished traverse to its entry
+        function record(obj, f, wall, cpu, outBytes, peak)
+            if isKey(obj.index, f.path)
+                k = obj.index(f.path);
+            else
+                k = numel(obj.entries)+1;
+                obj.index(f.path) = k;
+                obj.entries(k) = struct('path', f.path, 'class', f.class, 'calls', 0, 'wall', 0, 'self', 0, ...
+                    'cpu', 0, 'inBytes', 0, 'outBytes', 0, 'peakBytes', 0, 'kernelSelections', struct());
+            end
+            e = obj.entries(k);
+            e.calls = e.calls+1;
+            e.wall = e.wall+wall;
+            e.self = e.self+wall-f.childWall;
+            e.cpu = e.cpu+cpu;
+            e.inBytes = e.inBytes+f.inBytes;
+            e.outBytes = e.outBytes+outBytes;
+            e.peakBytes = max(e.peakBytes, peak);
+            names = fieldnames(f.kernelSelections);
+            for i=1:numel(names)
+                if isfield(e.kernelSelections, names{i})
+                    e.kernelSelections.(names{i}) = e.kernelSelections.(names{i})+f.kernelSelections.(names{i});
+                else
+                    e.kernelSelections.(names{i}) = f.kernelSelections.(names{i});
+                end
+            end
+            obj.entries(k) = e;
+        end
+
+    end
+
+    methods (Static)
+
+        %> @brief True if the traverses are recorded
+        %>
+        %> @param on enable (true) or disable (false) the recording
+        function tf = enabled(on)
+            persistent state
+            if nargin > 0
+                state = logical(on);
+            elseif isempty(state)
+                state = ispref('robochameleon', 'profile') && getpref('robochameleon', 'profile');
+            end
+            tf = state;
+        end
+
+        %> @brief Start recording (the previous records are kept)
+        function start()
+            roboProfiler.enabled(true);
+        end
+
+        %> @brief Stop recording
+        function stop()
+            roboProfiler.enabled(false);
+        end
+
+        %> @brief Delete the records
+        function reset()
+            p = roboProfiler.instance();
+            p.clearEntries();
+            p.stack = {};
+        end
+
+        %> @brief The profiler
+        function p = instance()
+            persistent singleton
+            if isempty(singleton) || ~isvalid(singleton)
+                singleton = roboProfiler();
+            end
+            p = singleton;
+        end
+
+        %> @brief Start recording the traverse of a unit
+        %>
+        %> @param u      unit or module
+        %> @param inputs cell array of input signals
+        %> @retval depth number of traverses in progress before this one (see unwind)
+        function depth = enter(u, inputs)
+            p = roboProfiler.instance();
+            name = u.label;
+            if isempty(name)
+                name = class(u);
+            end
+            name = strrep(name, ';', ',');
+            if isempty(p.stack)
+                path = name;
+            else
+                path = [p.stack{end}.path ';' name];
+            end
+            m = p.memoryBytes();
+            if ~isempty(p.stack)
+                p.stack{end}.peak = max(p.stack{end}.peak, m(2));
+            end
+            p.restartPeak();
+            depth = numel(p.stack);
+            f = struct('unit', u, 'path', path, 'class', class(u), 'tic', tic, 'cpu', cputime, ...
+                'rss', m(1), 'peak', m(1), 'inBytes', roboProfiler.signalBytes(inputs), ...
+                'childWall', 0, 'kernelSelections', struct());
+            p.stack{end+1} = f;
+        end
+
+        %> @brief Finish recording the traverse started by the last enter
+        %>
+        %> @param outputs cell array of output signals
+        function leave(outputs)
+            p = roboProfiler.instance();
+            if isempty(p.stack)
+                return
+            end
+            f = p.stack{end};
+            p.stack(end) = [];
+            wall = toc(f.tic);
+            cpu = cputime-f.cpu;
+            m = p.memoryBytes();
+            f.peak = max([f.peak m]);
+            p.record(f, wall, cpu, roboProfiler.signalBytes(outputs), max(f.peak-f.rss, 0));
+            if ~isempty(p.stack)
+                p.stack{end}.childWall = p.stack{end}.childWall+wall;
+                p.stack{end}.peak = max(p.stack{end}.peak, f.peak);
+            end
+        end
+
+        %> @brief Drop the traverses left in progress by an error
+        %>
+        %> @param depth value returned by enter
+        function unwind(depth)
+            p = roboProfiler.instance();
+            if numel(p.stack) > depth
+                p.stack(depth+1:end) = [];
+            end
+        end
+
+        %> @brief Count a selection of a native kernel (hasMex) in the current traverse
+        %>
+        %> @param name name of the MEX function
+        function countSelection(name)
+            p = roboProfiler.instance();
+            if isempty(p.stack)
+                return
+            end
+            k = p.stack{end}.kernelSelections;
+            if isfield(k, name)
+                k.(name) = k.(name)+1;
+            else
+                k.(name) = 1;
+            end
+            p.stack{end}.kernelSelections = k;
+        end
+
+        %> @brief Aggregated records
+        %>
+        %> @retval s struct array, one element per path, sorted by self time
+        function s = summary()
+            s = roboProfiler.instance().entries;
+            [~, order] = sort([s.self], 'descend');
+            s = s(order);
+        end
+
+        %> @brief Print the records sorted by self time
+        function report()
+            s = roboProfiler.summary();
+            fprintf(1, '%8s %10s %10s %10s %10s %10s %10s  %s\n', 'calls', 'wall [s]', 'self [s]', ...
+                'cpu [s]', 'in [MB]', 'out [MB]', 'peak [MB]', 'path (native kernel selections)');
+            for i=1:numel(s)
+                k = fieldnames(s(i).kernelSelections);
+                selections = '';
+                if ~isempty(k)
+                    selections = [' (' strjoin(cellfun(@(n)sprintf('%s: %d', n, s(i).kernelSelections.(n)), k, ...
+                        'UniformOutput', false), ', ') ')'];
+                end
+                fprintf(1, '%8d %10.3f %10.3f %10.3f %10.1f %10.1f %10.1f  %s%s\n', s(i).calls, s(i).wall, ...
+                    s(i).self, s(i).cpu, s(i).inBytes/2^20, s(i).outBytes/2^20, s(i).peakBytes/2^20, ...
+                    s(i).path, selections);
+            end
+        end
+
+        %> @brief Write the self times as folded stacks
+        %>
+        %> One line per path, "setup;module;unit microseconds", the input of
+        %> flame graph tools (flamegraph.pl, speedscope).
+        %>
+        %> @param filename name of the file
+        function exportFolded(filename)
+            s = roboProfiler.instance().entries;
+            fid = fopen(filename, 'w');
+            if fid < 0
+                robolog('Cannot open %s for writing.', 'ERR', filename);
+            end
+            for i=1:numel(s)
+                fprintf(fid, '%s %d\n', strrep(s(i).path, ' ', '_'), round(1e6*s(i).self));
+            end
+            fclose(fid);
+        end
+
+        %> @brief Write the summary as JSON
+        %>
+        %> @param filename name of the file
+        function exportJSON(filename)
+            fid = fopen(filename, 'w');
+            if fid < 0
+                robolog('Cannot open %s for writing.', 'ERR', filename);
+            end
+            fprintf(fid, '%s', jsonencode(struct('units', roboProfiler.summary())));
+            fclose(fid);
+        end
+
+    end
+
+    methods (Static,Access=private)
+
+        %> @brief Bytes of the waveforms of a cell array of signals
+        function b = signalBytes(signals)
+            b = 0;
+            for i=1:numel(signals)
+                s = signals{i};
+                if ~isa(s, 'signal_interface')
+                    continue
+                end
+                if isMapped(s)
+                    b = b+16*s.L*s.N;
+                else
+                    E = getRaw(s);
+                    info = whos('E');
+                    b = b+info.bytes;
+                end
+            end
+        end
+
+    end
+
+end
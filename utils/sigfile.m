@@ -0,0 +1,379 @@
+%>@file sigfile.m
+%>@brief Signal file class definition
+%>
+%>@class sigfile
+%>@brief Memory-mapped binary file holding a signal
+%>
+%> @ingroup roboUtils
+%>
+%> sigfile stores a waveform on disk with the parameters of a
+%> signal_interface (Fs, Rs, Fc and the power of each column), so that long
+%> captures and simulated traces can be written chunk by chunk and read back
+%> in parts without loading the whole waveform. The data are mapped in
+%> memory (memmapfile): reading some samples of some columns only touches
+%> the pages holding them.
+%>
+%> A signal_interface constructed over a sigfile keeps the file instead of
+%> the waveform and reads it when needed; indexing it (sig(rows, cols))
+%> only reads the selected samples, which allows to stream a capture
+%> through the chunked engines (e.g. welchPSD, densityHistogram) with a
+%> memory that does not depend on its length.
+%>
+%> __File format__ (little endian)
+%> @code
+%>   offset  type        content
+%>   0       char[8]     'ROBOSIG1'
+%>   8       uint32      version (1)
+%>   12      uint32      N, number of columns
+%>   16      uint64      L, number of samples per column
+%>   24      uint32      1 for complex data, 0 for real
+%>   28      uint32      bytes per value (8: double, 4: single)
+%>   32      uint32      1 if PCol is the power of the data
+%>   36      uint32      offset of the data (multiple of 4096)
+%>   40      double[3]   Fs, Rs, Fc
+%>   64      double[N]   power of each column (PCol) [W]
+%>           double[N]   SNR of each column (PCol) [dB]
+%>           double[N]   mean power of the data of each column [W]
+%>   data    L rows of N values, real and imaginary parts interleaved
+%> @endcode
+%> The samples are stored one row (all the columns) after the other, so
+%> that chunks can be appended to the file.
+%>
+%> __Example__
+%> @code
+%>   % Write a capture chunk by chunk
+%>   f = sigfile.create('capture.rsig', struct('Fs', 80e9, 'Rs', 28e9, 'Fc', 193.4e12), 2);
+%>   for k=1:nChunks
+%>       append(f, readScope(k));
+%>   end
+%>   % Stream it
+%>   sig = signal_interface(sigfile('capture.rsig'));
+%>   state = [];
+%>   for k=1:ceil(sig.L/2^20)
+%>       rows = (k-1)*2^20+1:min(k*2^20, sig.L);
+%>       [P, f, state] = welchPSD(sig(rows, :), sig.Fs, 4096, [], 0.5, state);
+%>   end
+%>   % Save a signal
+%>   sigfile.save('trace.rsig', sig);
+%> @endcode
+%>
+%> @see signal_interface
+%>
+%> @version 1
+classdef sigfile < handle
+
+    properties (SetAccess=private)
+        %> Name of the file
+        filename;
+        %> Number of samples per column
+        L = 0;
+        %> Number of columns
+        N;
+        %> Sampling rate (S/sec)
+        Fs;
+        %> Symbol rate (Baud)
+        Rs;
+        %> Carrier frequency (Hz)
+        Fc;
+        %> Complex data
+        cplx;
+        %> Precision of the data on disk ('double' or 'single')
+        precision;
+        %> Mean power of the data of each column (W)
+        Praw;
+    end
+
+    properties (Dependent)
+        %> Signal power per column (array of pwr objects)
+        PCol;
+    end
+
+    properties (SetAccess=private,Hidden=true)
+        %> Power of each column (W)
+        PW;
+        %> SNR of each column (dB)
+        SNRdB;
+        %> The power of the columns is the power of the data
+        autoP;
+        %> Offset of the data in the file (bytes)
+        dataOffset;
+    end
+
+    properties (Access=private,Transient=true)
+        %> Map of the data, made when first read
+        map = [];
+    end
+
+    properties (Constant,Hidden=true)
+        magic = 'ROBOSIG1';
+        version = 1;
+    end
+
+    methods
+
+        %> @brief Class constructor
+        %>
+        %> Opens an existing signal file.
+        %>
+        %> @param filename Name of the file
+        function obj = sigfile(filename)
+            obj.filename = filename;
+            obj.readHeader();
+        end
+
+        %> @brief Power of the columns as pwr objects
+        function PCol = get.PCol(obj)
+            PCol = pwr(obj.SNRdB(1), {obj.PW(1), 'W'});
+            for jj=2:obj.N
+                PCol(jj) = pwr(obj.SNRdB(jj), {obj.PW(jj), 'W'});
+            end
+            PCol = PCol(:);
+        end
+
+        %> @brief Size of the waveform, L-by-N
+        function varargout = size(obj, dim)
+            sz = [obj.L obj.N];
+            if nargin > 1
+                varargout{1} = sz(dim);
+            elseif nargout <= 1
+                varargout{1} = sz;
+            else
+                varargout = num2cell([sz ones(1, nargout-2)]);
+            end
+        end
+
+        %> @brief True if the data are real
+        function r = isreal(obj)
+            r = ~obj.cplx;
+        end
+
+        %> @brief Read samples of the waveform
+        %>
+        %> @param rows Samples to read [Default: all]
+        %> @param cols Columns to read [Default: all]
+        %>
+        %> @retval X   Samples (double), numel(rows)-by-numel(cols)
+        function X = read(obj, rows, cols)
+            if nargin < 2, rows = ':'; end
+            if nargin < 3, cols = ':'; end
+            if ischar(cols), cols = 1:obj.N; end
+            if obj.L == 0
+                X = zeros(0, numel(cols));
+                return
+            end
+            if isempty(obj.map)
+                obj.map = memmapfile(obj.filename, 'Offset', obj.dataOffset, ...
+                    'Format', {obj.precision, [(1+obj.cplx)*obj.N obj.L], 'x'}, 'Writable', false);
+            end
+            if obj.cplx
+                X = complex(double(obj.map.Data.x(2*cols-1, rows).'), double(obj.map.Data.x(2*cols, rows).'));
+            else
+                X = double(obj.map.Data.x(cols, rows).');
+            end
+        end
+
+        %> @brief Number of chunks of Lc samples
+        function n = nChunks(obj, Lc)
+            n = ceil(obj.L/Lc);
+        end
+
+        %> @brief Read the k-th chunk of Lc samples (the last one can be shorter)
+        %>
+        %> @param k    Index of the chunk, 1 to nChunks(Lc)
+        %> @param Lc   Samples per chunk
+        %> @param cols Columns to read [Default: all]
+        %>
+        %> @retval X    Samples of the chunk
+        %> @retval rows Indices of the samples in the waveform
+        function [X, rows] = chunk(obj, k, Lc, cols)
+            if nargin < 4, cols = ':'; end
+            rows = (k-1)*Lc+1:min(k*Lc, obj.L);
+            X = read(obj, rows, cols);
+        end
+
+        %> @brief Append samples to the file
+        %>
+        %> The mean power of the data, and the power of the columns if it
+        %> was not given on creation, are updated.
+        %>
+        %> @param X Samples, n-by-N
+        function append(obj, X)
+            if size(X, 2) ~= obj.N
+                robolog('The chunk must have %d columns.', 'ERR', obj.N);
+            end
+            if ~obj.cplx && ~isreal(X)
+                robolog('Complex samples cannot be appended to a real signal file.', 'ERR');
+            end
+            n = size(X, 1);
+            if obj.cplx
+                D = zeros(2*obj.N, n, obj.precision);
+                D(1:2:end, :) = real(X).';
+                D(2:2:end, :) = imag(X).';
+            else
+                D = X.';
+            end
+            fid = fopen(obj.filename, 'r+', 'ieee-le');
+            if fid < 0
+                robolog('Cannot open %s for writing.', 'ERR', obj.filename);
+            end
+            fseek(fid, obj.dataOffset+(1+obj.cplx)*obj.N*obj.L*obj.bytes(), 'bof');
+            fwrite(fid, D, obj.precision);
+            obj.Praw = (obj.Praw*obj.L+sum(double(X).*conj(double(X)), 1))/max(obj.L+n, 1);
+            obj.L = obj.L+n;
+            if obj.autoP
+                obj.PW = obj.Praw;
+            end
+            obj.writeHeader(fid);
+            fclose(fid);
+            obj.map = [];
+        end
+
+    end
+
+    methods (Static)
+
+        %> @brief Create an empty signal file
+        %>
+        %> @param filename  Name of the file (overwritten)
+        %> @param param     Signal parameters: Fs, and optionally Rs, Fc, and
+        %>                  PCol or P as for signal_interface (if not given,
+        %>                  the power of the data is used)
+        %> @param N         Number of columns
+        %> @param cplx      Complex data [Default: true]
+        %> @param precision Precision on disk, 'double' or 'single' [Default: 'double']
+        %>
+        %> @retval obj      The file, open for append
+        function obj = create(filename, param, N, cplx, precision)
+            if nargin < 4, cplx = true; end
+            if nargin < 5, precision = 'double'; end
+            if ~isfield(param, 'Fs')
+                robolog('Sampling frequency must be specified', 'ERR');
+            end
+            if ~any(strcmp(precision, {'double', 'single'}))
+                robolog('The precision must be ''double'' or ''single''.', 'ERR');
+            end
+            h = struct('N', N, 'L', 0, 'cplx', logical(cplx), 'precision', precision, ...
+                'Fs', param.Fs, 'Rs', paramdefault(param, 'Rs', 1), 'Fc', paramdefault(param, 'Fc', 1), ...
+                'Praw', zeros(1, N), 'autoP', true, 'PW', zeros(1, N), 'SNRdB', inf(1, N));
+            if isfield(param, 'P') && ~isfield(param, 'PCol')
+                param.PCol = repmat(param.P/N, N, 1);
+            end
+            if isfield(param, 'PCol')
+                if numel(param.PCol) ~= N
+                    robolog('The number of "pwr" objects in PCol must match the number of columns of the signal.', 'ERR');
+                end
+                h.autoP = false;
+                for jj=1:N
+                    h.PW(jj) = param.PCol(jj).Ptot('W');
+                    h.SNRdB(jj) = param.PCol(jj).SNR('dB');
+                end
+            end
+            fid = fopen(filename, 'w', 'ieee-le');
+            if fid < 0
+                robolog('Cannot create %s.', 'ERR', filename);
+            end
+            h.dataOffset = 4096*ceil((64+24*N)/4096);
+            sigfile.writeHeaderStruct(fid, h);
+            fclose(fid);
+            obj = sigfile(filename);
+        end
+
+        %> @brief Save a signal_interface to a signal file
+        %>
+        %> The scaled waveform (get) is written with the parameters of the
+        %> signal. A signal on disk is copied chunk by chunk.
+        %>
+        %> @param filename    Name of the file (overwritten)
+        %> @param sig         signal_interface
+        %> @param precision   Precision on disk [Default: 'double']
+        %> @param chunkLength Samples written at once [Default: 2^20]
+        %>
+        %> @retval obj        The file
+        function obj = save(filename, sig, precision, chunkLength)
+            if nargin < 3, precision = 'double'; end
+            if nargin < 4, chunkLength = 2^20; end
+            param = rmfield(params(sig), 'P');
+            if isMapped(sig)
+                obj = sigfile.create(filename, param, sig.N, ~isreal(sig.getRaw(1)), precision);
+                for k=1:ceil(sig.L/chunkLength)
+                    append(obj, sig((k-1)*chunkLength+1:min(k*chunkLength, sig.L), :));
+                end
+            else
+                X = get(sig);
+                obj = sigfile.create(filename, param, sig.N, ~isreal(X), precision);
+                for k=1:ceil(sig.L/chunkLength)
+                    append(obj, X((k-1)*chunkLength+1:min(k*chunkLength, sig.L), :));
+                end
+            end
+        end
+
+    end
+
+    methods (Access=private)
+
+        %> @brief Bytes per value on disk
+        function b = bytes(obj)
+            b = 4+4*strcmp(obj.precision, 'double');
+        end
+
+        %> @brief Read the header of the file
+        function readHeader(obj)
+            fid = fopen(obj.filename, 'r', 'ieee-le');
+            if fid < 0
+                robolog('Cannot open %s.', 'ERR', obj.filename);
+            end
+            magic = fread(fid, [1 8], '*char');
+            v = fread(fid, 2, 'uint32');
+            if ~strcmp(magic, sigfile.magic) || numel(v) < 2 || v(1) > sigfile.version
+                fclose(fid);
+                robolog('%s is not a signal file.', 'ERR', obj.filename);
+            end
+            obj.N = v(2);
+            obj.L = fread(fid, 1, 'uint64');
+            v = fread(fid, 4, 'uint32');
+            obj.cplx = v(1) ~= 0;
+            if v(2) == 4
+                obj.precision = 'single';
+            else
+                obj.precision = 'double';
+            end
+            obj.autoP = v(3) ~= 0;
+            obj.dataOffset = v(4);
+            v = fread(fid, 3, 'double');
+            obj.Fs = v(1);
+            obj.Rs = v(2);
+            obj.Fc = v(3);
+            obj.PW = fread(fid, [1 obj.N], 'double');
+            obj.SNRdB = fread(fid, [1 obj.N], 'double');
+            obj.Praw = fread(fid, [1 obj.N], 'double');
+            fclose(fid);
+        end
+
+        %> @brief Rewrite the header of the open file
+        function writeHeader(obj, fid)
+            h = struct('N', obj.N, 'L', obj.L, 'cplx', obj.cplx, 'precision', obj.precision, ...
+                'Fs', obj.Fs, 'Rs', obj.Rs, 'Fc', obj.Fc, 'Praw', obj.Praw, 'autoP', obj.autoP, ...
+                'PW', obj.PW, 'SNRdB', obj.SNRdB, 'dataOffset', obj.dataOffset);
+            sigfile.writeHeaderStruct(fid, h);
+        end
+
+    end
+
+    methods (Static,Access=private)
+
+        %> @brief Write a header from a struct with the fields of the class
+        function writeHeaderStruct(fid, h)
+            fseek(fid, 0, 'bof');
+            fwrite(fid, sigfile.magic, 'char*1');
+            fwrite(fid, [sigfile.version h.N], 'uint32');
+            fwrite(fid, h.L, 'uint64');
+            fwrite(fid, [h.cplx 4+4*strcmp(h.precision, 'double') h.autoP h.dataOffset], 'uint32');
+            fwrite(fid, [h.Fs h.Rs h.Fc h.PW h.SNRdB h.Praw], 'double');
+            if ftell(fid) < h.dataOffset
+                fwrite(fid, zeros(1, h.dataOffset-ftell(fid)), 'uint8');
+            end
+        end
+
+    end
+
+end